@@ -0,0 +1,5 @@
+#version 330 core
+out vec4 o_color;
+void main(){
+  o_color = vec4(0.25, 0.08, 0.02, 1.0);
+}
@@ -0,0 +1,18 @@
+#version 330 core
+in vec2 v_uv;
+in float v_light;
+in float v_depth;
+out vec4 o_color;
+uniform vec2 u_fogRange;
+uniform vec3 u_fogColor;
+uniform sampler2D u_atlas;
+uniform int u_cutout;
+void main(){
+  vec4 tex = texture(u_atlas, v_uv);
+  if (u_cutout != 0 && tex.a < 0.5) discard;
+  vec3 col = tex.rgb * v_light;
+  float fog = clamp((v_depth - u_fogRange.x) / (u_fogRange.y - u_fogRange.x),
+                    0.0, 1.0);
+  col = mix(col, u_fogColor, fog);
+  o_color = vec4(col, u_cutout != 0 ? 1.0 : tex.a);
+}
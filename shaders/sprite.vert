@@ -0,0 +1,20 @@
+#version 330 core
+layout(location=0) in vec2 a_corner;
+layout(location=1) in vec3 i_pos;
+layout(location=2) in vec2 i_size;
+layout(location=3) in vec4 i_rect;
+layout(location=4) in float i_light;
+out vec2 v_uv;
+out float v_light;
+out float v_depth;
+uniform mat4 u_viewProj;
+uniform vec3 u_camRight;
+void main(){
+  vec3 world = i_pos + u_camRight * (a_corner.x * i_size.x) +
+               vec3(0.0, a_corner.y * i_size.y, 0.0);
+  v_uv = mix(i_rect.xy, i_rect.zw, vec2(a_corner.x + 0.5, 1.0 - a_corner.y));
+  v_light = i_light;
+  vec4 pos = u_viewProj * vec4(world, 1.0);
+  v_depth = pos.w;
+  gl_Position = pos;
+}
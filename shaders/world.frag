@@ -0,0 +1,73 @@
+#version 330 core
+in vec3 v_col;
+in vec2 v_uv;
+in vec2 v_lmuv;
+in float v_depth;
+in vec3 v_world;
+out vec4 o_color;
+// Fog starts at x and is solid at y, in view depth.
+uniform vec2 u_fogRange;
+uniform vec3 u_fogColor;
+// Clustered point lights: per cluster the first entry in u_lightIndex and a
+// count, per light the texels (position, radius) and (color, 0).
+uniform usamplerBuffer u_clusterGrid;
+uniform usamplerBuffer u_lightIndex;
+uniform samplerBuffer u_lights;
+uniform ivec3 u_clusters;
+uniform vec2 u_tileScale;
+// Depth slice: log(view depth) * x + y.
+uniform vec2 u_slice;
+uniform vec3 u_eye;
+// Baked static light; v_lmuv is in luxels.
+uniform sampler2D u_lightmap;
+
+vec3 point_lights(){
+  vec3 n = normalize(cross(dFdx(v_world), dFdy(v_world)));
+  if (dot(n, u_eye - v_world) < 0.0) n = -n;
+
+  ivec3 c = ivec3(ivec2(gl_FragCoord.xy * u_tileScale),
+                  int(log(max(v_depth, 1e-4)) * u_slice.x + u_slice.y));
+  c = clamp(c, ivec3(0), u_clusters - 1);
+  uvec2 range = texelFetch(u_clusterGrid,
+                           (c.z * u_clusters.y + c.y) * u_clusters.x + c.x).xy;
+
+  vec3 sum = vec3(0.0);
+  for (uint i = 0u; i < range.y; i++) {
+    int l = int(texelFetch(u_lightIndex, int(range.x + i)).r);
+    vec4 light = texelFetch(u_lights, l * 2);
+    vec3 to = light.xyz - v_world;
+    float d2 = dot(to, to);
+    float f = clamp(1.0 - d2 / (light.w * light.w), 0.0, 1.0);
+    float lambert = max(dot(n, to) * inversesqrt(max(d2, 1e-6)), 0.0);
+    sum += texelFetch(u_lights, l * 2 + 1).rgb * (f * f * lambert);
+  }
+  return sum;
+}
+void main(){
+  vec3 col = v_col;
+  if (v_col.r == 0.2 && v_col.g == 0.8 && v_col.b == 0.2) {
+    vec2 grid = floor(v_uv * 2.0);
+    float checker = mod(grid.x + grid.y, 2.0);
+    col *= 0.8 + 0.2 * checker;
+  } else if (v_col.r == 0.2 && v_col.g == 0.2 && v_col.b == 0.8) {
+    float d = length(fract(v_uv * 4.0) - 0.5);
+    float star = smoothstep(0.1, 0.05, d);
+    col += vec3(star * 0.5);
+  } else {
+    vec2 uv = v_uv * vec2(2.0, 4.0);
+    if (mod(floor(uv.y), 2.0) > 0.5) uv.x += 0.5;
+    vec2 f = fract(uv);
+    float border = 0.05;
+    float brick = (1.0 - smoothstep(0.0, border, f.x)) + 
+                  (smoothstep(1.0 - border, 1.0, f.x)) +
+                  (1.0 - smoothstep(0.0, border, f.y)) + 
+                  (smoothstep(1.0 - border, 1.0, f.y));
+    col *= (1.0 - clamp(brick, 0.0, 1.0) * 0.5);
+  }
+  vec2 lm = v_lmuv / vec2(textureSize(u_lightmap, 0));
+  col *= texture(u_lightmap, lm).r + point_lights();
+  float fog = clamp((v_depth - u_fogRange.x) / (u_fogRange.y - u_fogRange.x),
+                    0.0, 1.0);
+  col = mix(col, u_fogColor, fog);
+  o_color = vec4(col, 1.0);
+}
@@ -0,0 +1,27 @@
+#version 330 core
+layout(location=0) in vec3 a_pos;
+#ifndef DEPTH_ONLY
+layout(location=1) in vec3 a_col;
+layout(location=2) in vec2 a_uv;
+layout(location=3) in vec2 a_lmuv;
+out vec3 v_col;
+out vec2 v_uv;
+out vec2 v_lmuv;
+out float v_depth;
+out vec3 v_world;
+#endif
+uniform mat4 u_viewProj;
+uniform mat4 u_model;
+invariant gl_Position;
+void main(){
+  vec4 world = u_model * vec4(a_pos, 1.0);
+  vec4 pos = u_viewProj * world;
+#ifndef DEPTH_ONLY
+  v_world = world.xyz;
+  v_col = a_col;
+  v_uv = a_uv;
+  v_lmuv = a_lmuv;
+  v_depth = pos.w;
+#endif
+  gl_Position = pos;
+}
@@ -0,0 +1,152 @@
+#include "bench_report.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const int k_report_version = 1;
+
+void bench_report_init(BenchReport *r) { memset(r, 0, sizeof(*r)); }
+
+void bench_report_free(BenchReport *r) {
+  free(r->results);
+  memset(r, 0, sizeof(*r));
+}
+
+bool bench_report_add(BenchReport *r, const char *name, double ns_per_op,
+                      long ops) {
+  if (r->count == r->capacity) {
+    int cap = r->capacity ? r->capacity * 2 : 64;
+    BenchResult *grown =
+        (BenchResult *)realloc(r->results, (size_t)cap * sizeof(BenchResult));
+    if (!grown)
+      return false;
+    r->results = grown;
+    r->capacity = cap;
+  }
+  BenchResult *res = &r->results[r->count++];
+  snprintf(res->name, sizeof(res->name), "%s", name);
+  res->ns_per_op = ns_per_op;
+  res->ops = ops;
+  return true;
+}
+
+bool bench_report_write_json(const BenchReport *r, const char *path) {
+  FILE *f = fopen(path, "w");
+  if (!f) {
+    fprintf(stderr, "Failed to open %s for writing\n", path);
+    return false;
+  }
+  fprintf(f, "{\n  \"version\": %d,\n  \"results\": [\n", k_report_version);
+  for (int i = 0; i < r->count; i++) {
+    const BenchResult *res = &r->results[i];
+    fprintf(f, "    {\"name\": \"%s\", \"ns_per_op\": %.3f, \"ops\": %ld}%s\n",
+            res->name, res->ns_per_op, res->ops,
+            (i + 1 < r->count) ? "," : "");
+  }
+  fprintf(f, "  ]\n}\n");
+  bool ok = !ferror(f);
+  if (fclose(f) != 0)
+    ok = false;
+  return ok;
+}
+
+static char *read_file(const char *path) {
+  FILE *f = fopen(path, "rb");
+  if (!f)
+    return NULL;
+  char *text = NULL;
+  if (fseek(f, 0, SEEK_END) == 0) {
+    long size = ftell(f);
+    if (size >= 0 && fseek(f, 0, SEEK_SET) == 0) {
+      text = (char *)malloc((size_t)size + 1);
+      if (text && fread(text, 1, (size_t)size, f) != (size_t)size) {
+        free(text);
+        text = NULL;
+      } else if (text) {
+        text[size] = '\0';
+      }
+    }
+  }
+  fclose(f);
+  return text;
+}
+
+// Baseline entries in file order. Only the layout this file writes is
+// understood: each "name" string followed by its "ns_per_op" number.
+static int parse_results(const char *text, BenchResult *out, int max) {
+  int n = 0;
+  const char *at = text;
+  while (n < max && (at = strstr(at, "\"name\"")) != NULL) {
+    const char *open = strchr(at + 6, '"');
+    const char *close = open ? strchr(open + 1, '"') : NULL;
+    const char *ns = close ? strstr(close, "\"ns_per_op\"") : NULL;
+    const char *colon = ns ? strchr(ns, ':') : NULL;
+    if (!colon)
+      break;
+
+    size_t len = (size_t)(close - open - 1);
+    if (len >= BENCH_NAME_MAX)
+      len = BENCH_NAME_MAX - 1;
+    memcpy(out[n].name, open + 1, len);
+    out[n].name[len] = '\0';
+    out[n].ns_per_op = strtod(colon + 1, NULL);
+    out[n].ops = 0;
+    n++;
+    at = colon;
+  }
+  return n;
+}
+
+static const BenchResult *find(const BenchResult *list, int count,
+                               const char *name) {
+  for (int i = 0; i < count; i++) {
+    if (strcmp(list[i].name, name) == 0)
+      return &list[i];
+  }
+  return NULL;
+}
+
+int bench_report_compare(const BenchReport *r, const char *baseline_path,
+                         double threshold) {
+  char *text = read_file(baseline_path);
+  if (!text) {
+    fprintf(stderr, "Failed to read baseline %s\n", baseline_path);
+    return -1;
+  }
+  // Every entry needs a "name" key, so this bounds the count.
+  int max = 0;
+  for (const char *at = text; (at = strstr(at, "\"name\"")) != NULL; at++)
+    max++;
+  BenchResult *base =
+      (BenchResult *)malloc((size_t)(max ? max : 1) * sizeof(BenchResult));
+  if (!base) {
+    free(text);
+    return -1;
+  }
+  int base_count = parse_results(text, base, max);
+  free(text);
+
+  printf("Baseline %s, threshold %.0f%%:\n", baseline_path, threshold * 100.0);
+  int regressions = 0;
+  for (int i = 0; i < r->count; i++) {
+    const BenchResult *cur = &r->results[i];
+    const BenchResult *old = find(base, base_count, cur->name);
+    if (!old || old->ns_per_op <= 0.0) {
+      printf("  %-40s new\n", cur->name);
+      continue;
+    }
+    double change = cur->ns_per_op / old->ns_per_op - 1.0;
+    bool slow = change > threshold;
+    regressions += slow;
+    printf("  %-40s %+7.1f%%%s\n", cur->name, change * 100.0,
+           slow ? "  REGRESSION" : "");
+  }
+  for (int i = 0; i < base_count; i++) {
+    if (!find(r->results, r->count, base[i].name))
+      printf("  %-40s missing\n", base[i].name);
+  }
+  printf("%d regression%s\n", regressions, regressions == 1 ? "" : "s");
+  free(base);
+  return regressions;
+}
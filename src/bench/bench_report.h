@@ -0,0 +1,35 @@
+#ifndef BENCH_REPORT_H
+#define BENCH_REPORT_H
+
+#include <stdbool.h>
+
+enum { BENCH_NAME_MAX = 64 };
+
+typedef struct BenchResult {
+  char name[BENCH_NAME_MAX];
+  double ns_per_op;
+  long ops;
+} BenchResult;
+
+typedef struct BenchReport {
+  BenchResult *results;
+  int count;
+  int capacity;
+} BenchReport;
+
+void bench_report_init(BenchReport *r);
+void bench_report_free(BenchReport *r);
+bool bench_report_add(BenchReport *r, const char *name, double ns_per_op,
+                      long ops);
+
+// {"version": 1, "results": [{"name", "ns_per_op", "ops"}, ...]}
+bool bench_report_write_json(const BenchReport *r, const char *path);
+
+// Checks every result against the same name in a baseline written by
+// bench_report_write_json. Slower by more than `threshold` (0.1 = 10%) is a
+// regression; names missing on either side are listed but not counted.
+// Returns the regression count, or -1 when the baseline cannot be read.
+int bench_report_compare(const BenchReport *r, const char *baseline_path,
+                         double threshold);
+
+#endif // !BENCH_REPORT_H
@@ -0,0 +1,171 @@
+#include "ecs_bench.h"
+#include "../game/ecs.h"
+#include "../math/vec2.h"
+#include "../time.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef struct Position {
+  Vec2 pos;
+} Position;
+
+typedef struct Velocity {
+  Vec2 vel;
+} Velocity;
+
+typedef struct SectorRef {
+  int sector;
+} SectorRef;
+
+typedef struct Health {
+  float hp;
+} Health;
+
+// What the entity data would look like as one heap object per actor.
+typedef struct Actor {
+  Vec2 pos;
+  Vec2 vel;
+  int sector;
+  float hp;
+} Actor;
+
+static const float k_dt = 1.0f / 60.0f;
+
+static uint32_t xorshift32(uint32_t *s) {
+  uint32_t x = *s;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  *s = x;
+  return x;
+}
+
+static float rand01(uint32_t *s) {
+  return (float)(xorshift32(s) >> 8) * (1.0f / 16777216.0f);
+}
+
+static void step(Vec2 *pos, Vec2 *vel, int *sector, const MapGenParams *g,
+                 float extent) {
+  pos->x += vel->x * k_dt;
+  pos->y += vel->y * k_dt;
+  if (pos->x < 0.0f || pos->x >= extent) {
+    vel->x = -vel->x;
+    pos->x = (pos->x < 0.0f) ? 0.0f : extent - 0.001f;
+  }
+  if (pos->y < 0.0f || pos->y >= extent) {
+    vel->y = -vel->y;
+    pos->y = (pos->y < 0.0f) ? 0.0f : extent - 0.001f;
+  }
+  int cx = (int)(pos->x / g->cell_size);
+  int cy = (int)(pos->y / g->cell_size);
+  *sector = cy * g->cols + cx;
+}
+
+int ecs_bench_run(const MapGenParams *grid, int entities, int ticks) {
+  EcsWorld w;
+  ecs_init(&w);
+  int c_pos = ecs_register_component(&w, sizeof(Position));
+  int c_vel = ecs_register_component(&w, sizeof(Velocity));
+  int c_sec = ecs_register_component(&w, sizeof(SectorRef));
+  int c_hp = ecs_register_component(&w, sizeof(Health));
+  ComponentMask moving = ECS_MASK(c_pos) | ECS_MASK(c_vel) | ECS_MASK(c_sec);
+
+  int n = grid->cols < grid->rows ? grid->cols : grid->rows;
+  float extent = (float)n * grid->cell_size;
+
+  EntityId *ids = (EntityId *)malloc((size_t)entities * sizeof(EntityId));
+  Actor **actors = (Actor **)malloc((size_t)entities * sizeof(Actor *));
+  if (!ids || !actors) {
+    free(ids);
+    free(actors);
+    ecs_shutdown(&w);
+    return 1;
+  }
+
+  uint32_t rng = 99u;
+  int failed = 0;
+  for (int i = 0; i < entities; i++) {
+    Vec2 pos = v2(rand01(&rng) * extent, rand01(&rng) * extent);
+    Vec2 vel = v2(rand01(&rng) * 4.0f - 2.0f, rand01(&rng) * 4.0f - 2.0f);
+
+    ComponentMask mask = moving | ((i & 1) ? ECS_MASK(c_hp) : 0);
+    ids[i] = ecs_spawn(&w, mask);
+    if (ids[i] == ECS_NULL) {
+      failed = 1;
+      break;
+    }
+    ((Position *)ecs_get(&w, ids[i], c_pos))->pos = pos;
+    ((Velocity *)ecs_get(&w, ids[i], c_vel))->vel = vel;
+
+    actors[i] = (Actor *)calloc(1, sizeof(Actor));
+    if (!actors[i]) {
+      failed = 1;
+      break;
+    }
+    actors[i]->pos = pos;
+    actors[i]->vel = vel;
+  }
+
+  // Shuffle so the pointer walk hits the heap in allocation-independent
+  // order, as it would after a while of spawning and despawning.
+  for (int i = entities - 1; !failed && i > 0; i--) {
+    int j = (int)(xorshift32(&rng) % (uint32_t)(i + 1));
+    Actor *t = actors[i];
+    actors[i] = actors[j];
+    actors[j] = t;
+  }
+
+  if (failed) {
+    printf("ECS bench: failed to create %d entities\n", entities);
+  } else {
+    printf("ECS bench: %d entities in %d archetypes, %d ticks\n", w.alive,
+           w.archetype_count, ticks);
+
+    double t0 = time_now_seconds();
+    for (int t = 0; t < ticks; t++) {
+      for (EcsIter it = ecs_query(&w, moving); ecs_next(&it);) {
+        Position *p = (Position *)ecs_column(&it, c_pos);
+        Velocity *v = (Velocity *)ecs_column(&it, c_vel);
+        SectorRef *s = (SectorRef *)ecs_column(&it, c_sec);
+        for (int i = 0; i < it.count; i++)
+          step(&p[i].pos, &v[i].vel, &s[i].sector, grid, extent);
+      }
+    }
+    double ecs_s = time_now_seconds() - t0;
+
+    t0 = time_now_seconds();
+    for (int t = 0; t < ticks; t++) {
+      for (int i = 0; i < entities; i++)
+        step(&actors[i]->pos, &actors[i]->vel, &actors[i]->sector, grid,
+             extent);
+    }
+    double ptr_s = time_now_seconds() - t0;
+
+    double per = (double)entities * ticks;
+    printf("  chunks:   %.3f ms/tick, %.2f ns/entity\n", 1000.0 * ecs_s / ticks,
+           1e9 * ecs_s / per);
+    printf("  pointers: %.3f ms/tick, %.2f ns/entity\n", 1000.0 * ptr_s / ticks,
+           1e9 * ptr_s / per);
+
+    // Churn a slice of entities; the old ids must all read as dead.
+    int churn = entities / 100;
+    int stale = 0;
+    for (int i = 0; i < churn; i++)
+      ecs_destroy(&w, ids[i]);
+    for (int i = 0; i < churn; i++) {
+      EntityId e = ecs_spawn(&w, moving);
+      stale += ecs_alive(&w, ids[i]) ? 1 : 0;
+      ids[i] = e;
+    }
+    printf("  churned %d entities, %d stale ids still alive\n", churn, stale);
+    failed = stale != 0;
+  }
+
+  for (int i = 0; i < entities; i++)
+    free(actors[i]);
+  free(actors);
+  free(ids);
+  ecs_shutdown(&w);
+  return failed;
+}
@@ -0,0 +1,8 @@
+#ifndef ECS_BENCH_H
+#define ECS_BENCH_H
+
+#include "../map/map_gen.h"
+
+int ecs_bench_run(const MapGenParams *grid, int entities, int ticks);
+
+#endif // !ECS_BENCH_H
@@ -0,0 +1,212 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../map/map.h"
+#include "../map/map_gen.h"
+#include "../time.h"
+#include "bench_report.h"
+#include "ecs_bench.h"
+#include "micro_bench.h"
+#include "nav_bench.h"
+#include "raycast_bench.h"
+
+enum { MAX_SIZES = 8, LAYOUT_COUNT = 3 };
+
+static const char *const k_layout_names[LAYOUT_COUNT] = {"rooms", "corridors",
+                                                         "concave"};
+
+typedef struct Options {
+  MapGenParams gen;
+  bool raycast;
+  bool nav;
+  bool ecs;
+  bool micro;
+  int rays;
+  int actors;
+  int entities;
+  int ticks;
+  // Micro bench maps: every chosen layout at every line count.
+  bool layouts[LAYOUT_COUNT];
+  int sizes[MAX_SIZES];
+  int size_count;
+  const char *json_path;
+  const char *baseline_path;
+  double threshold;
+} Options;
+
+static void parse_layouts(const char *val, Options *opt) {
+  for (int l = 0; l < LAYOUT_COUNT; l++)
+    opt->layouts[l] = strcmp(val, "all") == 0 ||
+                      strcmp(val, k_layout_names[l]) == 0;
+}
+
+// Comma-separated line counts.
+static void parse_sizes(const char *val, Options *opt) {
+  opt->size_count = 0;
+  while (*val && opt->size_count < MAX_SIZES) {
+    char *end;
+    long n = strtol(val, &end, 10);
+    if (end == val)
+      break;
+    if (n > 0)
+      opt->sizes[opt->size_count++] = (int)n;
+    val = (*end == ',') ? end + 1 : end;
+  }
+}
+
+static void parse_args(int argc, char **argv, Options *opt) {
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    const char *val = (i + 1 < argc) ? argv[i + 1] : NULL;
+
+    if (strcmp(arg, "--grid") == 0 && val) {
+      opt->gen.cols = atoi(val);
+      opt->gen.rows = opt->gen.cols;
+      i++;
+    } else if (strcmp(arg, "--seed") == 0 && val) {
+      opt->gen.seed = (uint32_t)strtoul(val, NULL, 10);
+      i++;
+    } else if (strcmp(arg, "--raycast") == 0) {
+      opt->raycast = true;
+    } else if (strcmp(arg, "--nav") == 0) {
+      opt->nav = true;
+    } else if (strcmp(arg, "--ecs") == 0) {
+      opt->ecs = true;
+    } else if (strcmp(arg, "--micro") == 0) {
+      opt->micro = true;
+    } else if (strcmp(arg, "--layout") == 0 && val) {
+      parse_layouts(val, opt);
+      i++;
+    } else if (strcmp(arg, "--lines") == 0 && val) {
+      parse_sizes(val, opt);
+      i++;
+    } else if (strcmp(arg, "--json") == 0 && val) {
+      opt->json_path = val;
+      i++;
+    } else if (strcmp(arg, "--baseline") == 0 && val) {
+      opt->baseline_path = val;
+      i++;
+    } else if (strcmp(arg, "--threshold") == 0 && val) {
+      opt->threshold = atof(val);
+      i++;
+    } else if (strcmp(arg, "--entities") == 0 && val) {
+      opt->entities = atoi(val);
+      i++;
+    } else if (strcmp(arg, "--actors") == 0 && val) {
+      opt->actors = atoi(val);
+      i++;
+    } else if (strcmp(arg, "--rays") == 0 && val) {
+      opt->rays = atoi(val);
+      i++;
+    } else if (strcmp(arg, "--ticks") == 0 && val) {
+      opt->ticks = atoi(val);
+      i++;
+    } else {
+      fprintf(stderr, "Ignoring unknown argument: %s\n", arg);
+    }
+  }
+}
+
+static int run_micro_maps(const Options *opt, BenchReport *report) {
+  int status = 0;
+  for (int l = 0; l < LAYOUT_COUNT; l++) {
+    if (!opt->layouts[l])
+      continue;
+    for (int i = 0; i < opt->size_count; i++) {
+      MapGenParams gen = opt->gen;
+      gen.layout = (MapGenLayout)l;
+      map_gen_size_for_lines(&gen, opt->sizes[i]);
+
+      Map map;
+      if (!map_generate_grid(&map, &gen)) {
+        fprintf(stderr, "Failed to generate %s map of %d lines\n",
+                k_layout_names[l], opt->sizes[i]);
+        status = 1;
+        continue;
+      }
+      char label[32];
+      snprintf(label, sizeof(label), "%s/%d", k_layout_names[l],
+               opt->sizes[i]);
+      status |= micro_bench_run_map(&map, label, report);
+      map_destroy(&map);
+    }
+  }
+  return status;
+}
+
+// Microbenchmarks, written as JSON and checked against a baseline when
+// asked; any regression fails the run.
+static int run_micro(const Options *opt) {
+  BenchReport report;
+  bench_report_init(&report);
+  int status = micro_bench_run_math(&report);
+  status |= run_micro_maps(opt, &report);
+
+  if (opt->json_path) {
+    if (bench_report_write_json(&report, opt->json_path))
+      printf("Wrote %s\n", opt->json_path);
+    else
+      status = 1;
+  }
+  if (opt->baseline_path &&
+      bench_report_compare(&report, opt->baseline_path, opt->threshold) != 0)
+    status = 1;
+  bench_report_free(&report);
+  return status;
+}
+
+int main(int argc, char **argv) {
+  Options opt = {
+      .gen = map_gen_default_params(),
+      .rays = 10000,
+      .actors = 500,
+      .entities = 100000,
+      .ticks = 60,
+      .layouts = {true, true, true},
+      .sizes = {1000, 10000, 100000},
+      .size_count = 3,
+      .threshold = 0.1,
+  };
+  opt.gen.cols = 100;
+  opt.gen.rows = 100;
+  parse_args(argc, argv, &opt);
+
+  if (opt.rays < 1 || opt.actors < 1 || opt.entities < 1 || opt.ticks < 1) {
+    fprintf(stderr, "Invalid ray, actor, entity or tick count\n");
+    return 1;
+  }
+  if (!opt.raycast && !opt.nav && !opt.ecs && !opt.micro) {
+    opt.raycast = true;
+    opt.nav = true;
+    opt.ecs = true;
+    opt.micro = true;
+  }
+
+  time_init();
+
+  int status = 0;
+  if (opt.micro)
+    status |= run_micro(&opt);
+  if (!opt.raycast && !opt.nav && !opt.ecs)
+    return status;
+
+  Map map;
+  double t0 = time_now_seconds();
+  if (!map_generate_grid(&map, &opt.gen)) {
+    fprintf(stderr, "Failed to generate map\n");
+    return 1;
+  }
+  printf("Generated %dx%d grid in %.1f ms\n", opt.gen.cols, opt.gen.rows,
+         1000.0 * (time_now_seconds() - t0));
+
+  if (opt.raycast)
+    status |= raycast_bench_run(&map, opt.rays, opt.ticks);
+  if (opt.nav)
+    status |= nav_bench_run(&map, opt.actors, opt.ticks);
+  if (opt.ecs)
+    status |= ecs_bench_run(&opt.gen, opt.entities, opt.ticks);
+  map_destroy(&map);
+  return status;
+}
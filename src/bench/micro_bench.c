@@ -0,0 +1,350 @@
+#include "micro_bench.h"
+#include "../game/player.h"
+#include "../geom/geom2d.h"
+#include "../geom/geom2d_batch.h"
+#include "../geom/lightmap.h"
+#include "../geom/sector_mesh.h"
+#include "../geom/wall_mesh.h"
+#include "../math/mat4.h"
+#include "../time.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+enum { QUERIES = 4096, MATRICES = 256, MAX_SAMPLES = 5 };
+// Batch kernels run WINDOW_QUERIES queries against a run of WINDOW
+// consecutive lines each, one op per line tested.
+enum { WINDOW = 256, WINDOW_QUERIES = 64 };
+
+// A sample repeats the kernel until it has run this long; samples stop
+// early once they have taken k_max_total together. The best one counts.
+static const double k_min_sample = 0.02;
+static const double k_max_total = 1.0;
+// Player moves: long enough to cross portals and reach walls.
+static const float k_move = 0.5f;
+
+// Keeps results alive so the kernels are not optimized away.
+static volatile float g_sink;
+
+static uint32_t xorshift32(uint32_t *s) {
+  uint32_t x = *s;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  *s = x;
+  return x;
+}
+
+static float rand01(uint32_t *s) {
+  return (float)(xorshift32(s) >> 8) * (1.0f / 16777216.0f);
+}
+
+// Somewhere between the loop centroid and one of its corners, which stays
+// inside any convex sector.
+static Vec2 random_point_in_sector(const Map *m, int s, uint32_t *rng) {
+  const SectorLoop *loop = &m->sectors[s].loop;
+  Vec2 c = v2(0.0f, 0.0f);
+  for (int i = 0; i < loop->count; i++)
+    c = v2_add(c, m->verts[loop->indices[i]]);
+  c = v2_mul(c, 1.0f / (float)loop->count);
+
+  Vec2 corner = m->verts[loop->indices[xorshift32(rng) % loop->count]];
+  return v2_add(c, v2_mul(v2_sub(corner, c), 0.9f * rand01(rng)));
+}
+
+typedef struct MicroCtx {
+  const Map *map;
+  Vec2 *points;
+  Vec2 *ends;
+  int *lines;
+  Player *players;
+  Mat4 *mats;
+  int window;
+  float dist2[WINDOW];
+} MicroCtx;
+
+// Runs one batch and returns the operations it did.
+typedef long (*MicroFn)(MicroCtx *ctx);
+
+static double measure(MicroFn fn, MicroCtx *ctx, long *ops_out) {
+  double best = -1.0;
+  double total = 0.0;
+  for (int s = 0; s < MAX_SAMPLES && total < k_max_total; s++) {
+    long ops = 0;
+    double t0 = time_now_seconds();
+    double dt = 0.0;
+    while (dt < k_min_sample) {
+      ops += fn(ctx);
+      dt = time_now_seconds() - t0;
+    }
+    total += dt;
+    double ns = 1e9 * dt / (double)ops;
+    if (best < 0.0 || ns < best) {
+      best = ns;
+      *ops_out = ops;
+    }
+  }
+  return best;
+}
+
+static int record(BenchReport *report, MicroFn fn, MicroCtx *ctx,
+                  const char *kernel, const char *label) {
+  char name[BENCH_NAME_MAX];
+  if (label)
+    snprintf(name, sizeof(name), "%s/%s", kernel, label);
+  else
+    snprintf(name, sizeof(name), "%s", kernel);
+
+  long ops = 0;
+  double ns = measure(fn, ctx, &ops);
+  printf("  %-40s %12.1f ns/op\n", name, ns);
+  return bench_report_add(report, name, ns, ops) ? 0 : 1;
+}
+
+static Vec2 line_start(const Map *m, int li) {
+  return v2(m->linetab.x0[li], m->linetab.y0[li]);
+}
+
+static Vec2 line_end(const Map *m, int li) {
+  return v2(m->linetab.x1[li], m->linetab.y1[li]);
+}
+
+static long run_seg2_intersect(MicroCtx *ctx) {
+  int hits = 0;
+  for (int i = 0; i < QUERIES; i++) {
+    int li = ctx->lines[i];
+    hits += seg2_intersect(ctx->points[i], ctx->ends[i],
+                           line_start(ctx->map, li), line_end(ctx->map, li));
+  }
+  g_sink += (float)hits;
+  return QUERIES;
+}
+
+static long run_seg2_closest_point(MicroCtx *ctx) {
+  float sum = 0.0f;
+  for (int i = 0; i < QUERIES; i++) {
+    int li = ctx->lines[i];
+    Vec2 c = seg2_closest_point(ctx->points[i], line_start(ctx->map, li),
+                                line_end(ctx->map, li));
+    sum += c.x + c.y;
+  }
+  g_sink += sum;
+  return QUERIES;
+}
+
+static Seg2Batch window_batch(const MicroCtx *ctx, int i) {
+  const LineTable *t = &ctx->map->linetab;
+  int first = ctx->lines[i];
+  if (first > ctx->map->line_count - ctx->window)
+    first = ctx->map->line_count - ctx->window;
+  Seg2Batch b = {t->x0 + first, t->y0 + first,       t->dx + first,
+                 t->dy + first, t->inv_len2 + first, NULL,
+                 ctx->window};
+  return b;
+}
+
+// The scalar loops next to each batch kernel test the same windows.
+static long run_intersect_loop(MicroCtx *ctx) {
+  int hits = 0;
+  for (int i = 0; i < WINDOW_QUERIES; i++) {
+    Seg2Batch b = window_batch(ctx, i);
+    for (int k = 0; k < b.count; k++) {
+      Vec2 a = v2(b.x0[k], b.y0[k]);
+      hits += seg2_intersect(ctx->points[i], ctx->ends[i], a,
+                             v2_add(a, v2(b.dx[k], b.dy[k])));
+    }
+  }
+  g_sink += (float)hits;
+  return (long)WINDOW_QUERIES * ctx->window;
+}
+
+static long run_intersect_batch(MicroCtx *ctx) {
+  uint32_t mask[WINDOW / 32];
+  int hits = 0;
+  for (int i = 0; i < WINDOW_QUERIES; i++) {
+    Seg2Batch b = window_batch(ctx, i);
+    hits += seg2_intersect_batch(ctx->points[i], ctx->ends[i], &b, mask);
+  }
+  g_sink += (float)hits;
+  return (long)WINDOW_QUERIES * ctx->window;
+}
+
+static long run_dist2_loop(MicroCtx *ctx) {
+  float sum = 0.0f;
+  for (int i = 0; i < WINDOW_QUERIES; i++) {
+    Seg2Batch b = window_batch(ctx, i);
+    for (int k = 0; k < b.count; k++) {
+      Line2 l = {0};
+      l.a = v2(b.x0[k], b.y0[k]);
+      l.dir = v2(b.dx[k], b.dy[k]);
+      l.inv_len2 = b.inv_len2[k];
+      sum += v2_len2(v2_sub(ctx->points[i],
+                            line2_closest_point(ctx->points[i], &l)));
+    }
+  }
+  g_sink += sum;
+  return (long)WINDOW_QUERIES * ctx->window;
+}
+
+static long run_dist2_batch(MicroCtx *ctx) {
+  float sum = 0.0f;
+  for (int i = 0; i < WINDOW_QUERIES; i++) {
+    Seg2Batch b = window_batch(ctx, i);
+    seg2_dist2_batch(ctx->points[i], &b, ctx->dist2);
+    sum += ctx->dist2[i & (WINDOW - 1)];
+  }
+  g_sink += sum;
+  return (long)WINDOW_QUERIES * ctx->window;
+}
+
+static long run_ray2_cast_batch(MicroCtx *ctx) {
+  float sum = 0.0f;
+  for (int i = 0; i < WINDOW_QUERIES; i++) {
+    Seg2Batch b = window_batch(ctx, i);
+    Vec2 d = v2_norm(v2_sub(ctx->ends[i], ctx->points[i]));
+    float t = 0.0f;
+    ray2_cast_batch(ctx->points[i], d, 0.0f, 1e30f, &b, -1, &t);
+    sum += t;
+  }
+  g_sink += sum;
+  return (long)WINDOW_QUERIES * ctx->window;
+}
+
+// Both player kernels start every move from the same state.
+static long run_collide_and_slide(MicroCtx *ctx) {
+  float sum = 0.0f;
+  for (int i = 0; i < QUERIES; i++) {
+    Player p = ctx->players[i];
+    player_slide(&p, ctx->map, ctx->ends[i]);
+    sum += p.pos.x;
+  }
+  g_sink += sum;
+  return QUERIES;
+}
+
+static long run_update_sector(MicroCtx *ctx) {
+  int sum = 0;
+  for (int i = 0; i < QUERIES; i++) {
+    Player p = ctx->players[i];
+    player_track_sector(&p, ctx->map, p.pos, ctx->ends[i]);
+    sum += p.sector;
+  }
+  g_sink += (float)sum;
+  return QUERIES;
+}
+
+static long run_sector_mesh(MicroCtx *ctx) {
+  Lightmap lm;
+  MeshData mesh;
+  if (lightmap_begin(&lm, ctx->map) && sector_mesh_bake(&mesh, ctx->map, &lm)) {
+    g_sink += (float)mesh.index_count;
+    mesh_data_free(&mesh);
+  }
+  lightmap_free(&lm);
+  return 1;
+}
+
+static long run_wall_mesh(MicroCtx *ctx) {
+  Lightmap lm;
+  MeshData mesh;
+  if (lightmap_begin(&lm, ctx->map) && wall_mesh_bake(&mesh, ctx->map, &lm)) {
+    g_sink += (float)mesh.index_count;
+    mesh_data_free(&mesh);
+  }
+  lightmap_free(&lm);
+  return 1;
+}
+
+static long run_m4_mul(MicroCtx *ctx) {
+  Mat4 acc = m4_identity();
+  for (int i = 0; i < MATRICES; i++)
+    acc = m4_mul(acc, ctx->mats[i]);
+  g_sink += acc.m[0] + acc.m[15];
+  return MATRICES;
+}
+
+int micro_bench_run_map(const Map *map, const char *label,
+                        BenchReport *report) {
+  MicroCtx ctx = {0};
+  ctx.map = map;
+  ctx.window = (map->line_count < WINDOW) ? map->line_count : WINDOW;
+  ctx.points = (Vec2 *)malloc(QUERIES * sizeof(Vec2));
+  ctx.ends = (Vec2 *)malloc(QUERIES * sizeof(Vec2));
+  ctx.lines = (int *)malloc(QUERIES * sizeof(int));
+  ctx.players = (Player *)malloc(QUERIES * sizeof(Player));
+  if (!ctx.points || !ctx.ends || !ctx.lines || !ctx.players) {
+    free(ctx.points);
+    free(ctx.ends);
+    free(ctx.lines);
+    free(ctx.players);
+    return 1;
+  }
+
+  printf("Micro bench %s: %d sectors, %d lines\n", label, map->sector_count,
+         map->line_count);
+
+  // Queries start in a random sector and test a line of that sector, the
+  // way movement and tracking use them.
+  uint32_t rng = 777u;
+  for (int i = 0; i < QUERIES; i++) {
+    int s = (int)(xorshift32(&rng) % (uint32_t)map->sector_count);
+    int begin = map->sector_line_start[s];
+    int count = map->sector_line_start[s + 1] - begin;
+    float a = rand01(&rng) * 6.28318530718f;
+
+    ctx.points[i] = random_point_in_sector(map, s, &rng);
+    ctx.ends[i] = v2_add(ctx.points[i], v2(cosf(a) * k_move, sinf(a) * k_move));
+    ctx.lines[i] =
+        map->sector_lines[begin + (int)(xorshift32(&rng) % (uint32_t)count)];
+
+    Player *p = &ctx.players[i];
+    player_init(p);
+    p->pos = ctx.points[i];
+    p->sector = s;
+    p->z = map->sectors[s].floor_h;
+  }
+
+  int status = 0;
+  status |= record(report, run_seg2_intersect, &ctx, "seg2_intersect", label);
+  status |= record(report, run_seg2_closest_point, &ctx,
+                   "seg2_closest_point", label);
+  status |=
+      record(report, run_intersect_loop, &ctx, "seg2_intersect_loop", label);
+  status |=
+      record(report, run_intersect_batch, &ctx, "seg2_intersect_batch", label);
+  status |= record(report, run_dist2_loop, &ctx, "seg2_dist2_loop", label);
+  status |= record(report, run_dist2_batch, &ctx, "seg2_dist2_batch", label);
+  status |=
+      record(report, run_ray2_cast_batch, &ctx, "ray2_cast_batch", label);
+  status |=
+      record(report, run_collide_and_slide, &ctx, "collide_and_slide", label);
+  status |= record(report, run_update_sector, &ctx, "update_sector", label);
+  status |= record(report, run_sector_mesh, &ctx, "sector_mesh_bake", label);
+  status |= record(report, run_wall_mesh, &ctx, "wall_mesh_bake", label);
+
+  free(ctx.points);
+  free(ctx.ends);
+  free(ctx.lines);
+  free(ctx.players);
+  return status;
+}
+
+int micro_bench_run_math(BenchReport *report) {
+  MicroCtx ctx = {0};
+  ctx.mats = (Mat4 *)malloc(MATRICES * sizeof(Mat4));
+  if (!ctx.mats)
+    return 1;
+
+  // Rotations keep the running product bounded.
+  uint32_t rng = 4242u;
+  for (int i = 0; i < MATRICES; i++) {
+    ctx.mats[i] = m4_mul(m4_rotate_y(rand01(&rng) * 6.28318530718f),
+                         m4_rotate_x(rand01(&rng) * 6.28318530718f));
+  }
+
+  printf("Micro bench math\n");
+  int status = record(report, run_m4_mul, &ctx, "m4_mul", NULL);
+  free(ctx.mats);
+  return status;
+}
@@ -0,0 +1,15 @@
+#ifndef MICRO_BENCH_H
+#define MICRO_BENCH_H
+
+#include "../map/map.h"
+#include "bench_report.h"
+
+// Segment tests, player movement and mesh generation over one map, recorded
+// as "<kernel>/<label>".
+int micro_bench_run_map(const Map *map, const char *label,
+                        BenchReport *report);
+
+// Kernels that do not depend on a map.
+int micro_bench_run_math(BenchReport *report);
+
+#endif // !MICRO_BENCH_H
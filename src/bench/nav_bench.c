@@ -0,0 +1,156 @@
+#include "nav_bench.h"
+#include "../game/nav.h"
+#include "../time.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+enum { GOALS = 8, COLD_SEARCHES = 200 };
+
+static uint32_t xorshift32(uint32_t *s) {
+  uint32_t x = *s;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  *s = x;
+  return x;
+}
+
+static int random_sector(const Map *map, uint32_t *rng) {
+  return (int)(xorshift32(rng) % (uint32_t)map->sector_count);
+}
+
+// Consecutive path sectors must share a usable edge.
+static bool path_valid(const NavGraph *nav, const int *path, int count) {
+  for (int i = 0; i + 1 < count; i++) {
+    bool linked = false;
+    for (int e = nav->edge_start[path[i]]; e < nav->edge_start[path[i] + 1];
+         e++) {
+      if (nav->edges[e].to == path[i + 1] && !isinf(nav->edges[e].cost))
+        linked = true;
+    }
+    if (!linked)
+      return false;
+  }
+  return true;
+}
+
+// Actors drift one sector at a time and chase a handful of shared goals,
+// the pattern the cache is meant for.
+static void drift_actors(const NavGraph *nav, NavRequest *reqs, int count,
+                         uint32_t *rng) {
+  for (int i = 0; i < count; i++) {
+    if (xorshift32(rng) % 20 != 0)
+      continue;
+    int s = reqs[i].start;
+    int degree = nav->edge_start[s + 1] - nav->edge_start[s];
+    if (degree > 0)
+      reqs[i].start =
+          nav->edges[nav->edge_start[s] + (int)(xorshift32(rng) % degree)].to;
+  }
+}
+
+static double run_tick(NavPlanner *pl, const NavRequest *reqs, int count,
+                       NavResult *results, int *found, int *invalid) {
+  double t0 = time_now_seconds();
+  *found += nav_find_paths(pl, reqs, count, results);
+  double dt = time_now_seconds() - t0;
+
+  for (int i = 0; i < count; i++) {
+    if (results[i].found &&
+        !path_valid(pl->graph, nav_result_path(pl, &results[i]),
+                    results[i].count))
+      (*invalid)++;
+  }
+  return dt;
+}
+
+int nav_bench_run(Map *map, int actors, int ticks) {
+  NavGraph nav;
+  NavPlanner pl;
+  double t0 = time_now_seconds();
+  if (!nav_build(&nav, map, 0.25f, 1.6f, 0.6f))
+    return 1;
+  double build_s = time_now_seconds() - t0;
+
+  NavRequest *reqs =
+      (NavRequest *)malloc((size_t)actors * sizeof(NavRequest));
+  NavResult *results =
+      (NavResult *)malloc((size_t)actors * sizeof(NavResult));
+  if (!reqs || !results || !nav_planner_init(&pl, &nav, actors * 4)) {
+    free(reqs);
+    free(results);
+    nav_destroy(&nav);
+    return 1;
+  }
+
+  printf("Nav bench: %d sectors, %d edges (built in %.2f ms), %d actors, "
+         "%d ticks\n",
+         nav.node_count, nav.edge_count, 1000.0 * build_s, actors, ticks);
+
+  uint32_t rng = 777u;
+  int found = 0;
+  int invalid = 0;
+
+  double cold_s = 0.0;
+  long cold_exp = pl.stats.expansions;
+  for (int i = 0; i < COLD_SEARCHES; i++) {
+    NavResult r;
+    int a = random_sector(map, &rng);
+    int b = random_sector(map, &rng);
+    t0 = time_now_seconds();
+    nav_find_path(&pl, a, b, &r);
+    cold_s += time_now_seconds() - t0;
+    if (r.found && !path_valid(&nav, nav_result_path(&pl, &r), r.count))
+      invalid++;
+  }
+  cold_exp = pl.stats.expansions - cold_exp;
+  printf("  cold A*:    %.3f ms/search, %.0f expansions/search\n",
+         1000.0 * cold_s / COLD_SEARCHES, (double)cold_exp / COLD_SEARCHES);
+
+  int goals[GOALS];
+  for (int i = 0; i < GOALS; i++)
+    goals[i] = random_sector(map, &rng);
+  for (int i = 0; i < actors; i++) {
+    reqs[i].start = random_sector(map, &rng);
+    reqs[i].goal = goals[i % GOALS];
+  }
+
+  NavStats before = pl.stats;
+  double total_s = 0.0;
+  double worst_s = 0.0;
+  for (int t = 0; t < ticks; t++) {
+    drift_actors(&nav, reqs, actors, &rng);
+    double dt = run_tick(&pl, reqs, actors, results, &found, &invalid);
+    total_s += dt;
+    if (dt > worst_s)
+      worst_s = dt;
+  }
+  long searches = pl.stats.searches - before.searches;
+  long hits = pl.stats.cache_hits - before.cache_hits;
+  printf("  batched:    %.3f ms/tick avg, %.3f ms worst, %ld searches, "
+         "%.1f%% cache hits, %d/%d found\n",
+         1000.0 * total_s / ticks, 1000.0 * worst_s, searches,
+         100.0 * hits / ((double)actors * ticks), found, actors * ticks);
+
+  // Raising one floor out of step reach must invalidate every cached path.
+  int s = goals[0];
+  map_set_sector_heights(map, s, map->sectors[s].floor_h + 2.0f,
+                         map->sectors[s].ceil_h + 2.0f);
+  nav_refresh(&nav, map);
+  found = 0;
+  double dt = run_tick(&pl, reqs, actors, results, &found, &invalid);
+  int reached = 0;
+  for (int i = 0; i < actors; i++)
+    reached += (results[i].found && reqs[i].goal == s) ? 1 : 0;
+  printf("  after height change: %.3f ms, %ld invalidations, %d paths still "
+         "reach the raised sector, %d invalid paths\n",
+         1000.0 * dt, pl.stats.invalidations, reached, invalid);
+
+  nav_planner_destroy(&pl);
+  nav_destroy(&nav);
+  free(reqs);
+  free(results);
+  return invalid == 0 ? 0 : 1;
+}
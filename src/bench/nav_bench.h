@@ -0,0 +1,8 @@
+#ifndef NAV_BENCH_H
+#define NAV_BENCH_H
+
+#include "../map/map.h"
+
+int nav_bench_run(Map *map, int actors, int ticks);
+
+#endif // !NAV_BENCH_H
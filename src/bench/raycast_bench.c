@@ -0,0 +1,132 @@
+#include "raycast_bench.h"
+#include "../map/raycast.h"
+#include "../time.h"
+
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+enum { VERIFY_RAYS = 200 };
+
+static uint32_t xorshift32(uint32_t *s) {
+  uint32_t x = *s;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  *s = x;
+  return x;
+}
+
+static float rand01(uint32_t *s) {
+  return (float)(xorshift32(s) >> 8) * (1.0f / 16777216.0f);
+}
+
+// Somewhere between the loop centroid and one of its corners, which stays
+// inside any convex sector.
+static Vec2 random_point_in_sector(const Map *m, int s, uint32_t *rng) {
+  const SectorLoop *loop = &m->sectors[s].loop;
+  Vec2 c = v2(0.0f, 0.0f);
+  for (int i = 0; i < loop->count; i++)
+    c = v2_add(c, m->verts[loop->indices[i]]);
+  c = v2_mul(c, 1.0f / (float)loop->count);
+
+  Vec2 corner = m->verts[loop->indices[xorshift32(rng) % loop->count]];
+  return v2_add(c, v2_mul(v2_sub(corner, c), 0.9f * rand01(rng)));
+}
+
+static void make_rays(const Map *m, Ray *rays, int count, uint32_t *rng) {
+  for (int i = 0; i < count; i++) {
+    Ray *r = &rays[i];
+    float a = rand01(rng) * 6.28318530718f;
+    r->sector = (int)(xorshift32(rng) % (uint32_t)m->sector_count);
+    r->origin = random_point_in_sector(m, r->sector, rng);
+    r->dir = v2(cosf(a), sinf(a));
+    r->z = 1.6f;
+    r->max_dist = 64.0f;
+  }
+}
+
+// Reference answer: nearest blocking line over the whole map.
+static float brute_force_dist(const Map *m, const Ray *r) {
+  float best = r->max_dist;
+  for (int i = 0; i < m->line_count; i++) {
+    const Linedef *l = &m->lines[i];
+    if (l->back_sector >= 0) {
+      const Sector *a = &m->sectors[l->front_sector];
+      const Sector *b = &m->sectors[l->back_sector];
+      float floor = fmaxf(a->floor_h, b->floor_h);
+      float ceil = fminf(a->ceil_h, b->ceil_h);
+      if (r->z > floor && r->z < ceil)
+        continue;
+    }
+
+    Vec2 a = m->verts[l->v0];
+    Vec2 e = v2_sub(m->verts[l->v1], a);
+    float denom = r->dir.x * e.y - r->dir.y * e.x;
+    if (fabsf(denom) <= 1e-12f)
+      continue;
+    Vec2 ao = v2_sub(a, r->origin);
+    float t = (ao.x * e.y - ao.y * e.x) / denom;
+    float u = (ao.x * r->dir.y - ao.y * r->dir.x) / denom;
+    if (u >= 0.0f && u <= 1.0f && t >= 0.0f && t < best)
+      best = t;
+  }
+  return best;
+}
+
+int raycast_bench_run(const Map *map, int rays_per_tick, int ticks) {
+  Ray *rays = (Ray *)malloc((size_t)rays_per_tick * sizeof(Ray));
+  RayHit *hits = (RayHit *)malloc((size_t)rays_per_tick * sizeof(RayHit));
+  if (!rays || !hits) {
+    free(rays);
+    free(hits);
+    return 1;
+  }
+
+  printf("Raycast bench: %d sectors, %d lines, %d rays/tick, %d ticks\n",
+         map->sector_count, map->line_count, rays_per_tick, ticks);
+
+  uint32_t rng = 12345u;
+  double total_s = 0.0;
+  double worst_s = 0.0;
+  long total_hits = 0;
+
+  for (int t = 0; t < ticks; t++) {
+    make_rays(map, rays, rays_per_tick, &rng);
+
+    double t0 = time_now_seconds();
+    total_hits += map_raycast_batch(map, rays, rays_per_tick, hits);
+    double dt = time_now_seconds() - t0;
+
+    total_s += dt;
+    if (dt > worst_s)
+      worst_s = dt;
+  }
+
+  double rays_total = (double)rays_per_tick * ticks;
+  printf("  portal walk: %.3f ms/tick avg, %.3f ms worst, %.1f ns/ray, "
+         "%.1f%% hit\n",
+         1000.0 * total_s / ticks, 1000.0 * worst_s,
+         1e9 * total_s / rays_total, 100.0 * total_hits / rays_total);
+
+  int verify = rays_per_tick < VERIFY_RAYS ? rays_per_tick : VERIFY_RAYS;
+  int mismatches = 0;
+  make_rays(map, rays, verify, &rng);
+  map_raycast_batch(map, rays, verify, hits);
+
+  double t0 = time_now_seconds();
+  for (int i = 0; i < verify; i++) {
+    float ref = brute_force_dist(map, &rays[i]);
+    if (fabsf(ref - hits[i].dist) > 1e-3f)
+      mismatches++;
+  }
+  double brute_s = time_now_seconds() - t0;
+
+  printf("  brute force: %.1f ns/ray (%d rays), %d mismatches\n",
+         1e9 * brute_s / verify, verify, mismatches);
+
+  free(rays);
+  free(hits);
+  return mismatches == 0 ? 0 : 1;
+}
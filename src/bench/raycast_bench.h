@@ -0,0 +1,8 @@
+#ifndef RAYCAST_BENCH_H
+#define RAYCAST_BENCH_H
+
+#include "../map/map.h"
+
+int raycast_bench_run(const Map *map, int rays_per_tick, int ticks);
+
+#endif // !RAYCAST_BENCH_H
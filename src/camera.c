@@ -10,15 +10,22 @@ void camera_init(Camera *c) {
   c->zfar = 2000.0f;
 }
 
-Mat4 camera_view(Camera *c) {
+Vec3 camera_forward(Camera *c) {
   float cy = cosf(c->yaw);
   float sy = sinf(c->yaw);
 
   Vec3 forward = v3(0.0f, 0.0f, -1.0f);
   forward = v3(forward.x * cy + forward.z * sy, 0.0f,
                -forward.x * sy + forward.z * cy);
-  forward = v3_norm(forward);
+  return v3_norm(forward);
+}
 
+Vec3 camera_right(Camera *c) {
+  return v3_norm(v3_cross(camera_forward(c), v3(0.0f, 1.0f, 0.0f)));
+}
+
+Mat4 camera_view(Camera *c) {
+  Vec3 forward = camera_forward(c);
   Vec3 up = v3(0.0f, 1.0f, 0.0f);
   Vec3 right = v3_norm(v3_cross(forward, up));
 
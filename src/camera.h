@@ -13,6 +13,8 @@ typedef struct Camera {
 } Camera;
 
 void camera_init(Camera *c);
+Vec3 camera_forward(Camera *c);
+Vec3 camera_right(Camera *c);
 Mat4 camera_view(Camera *c);
 Mat4 camera_proj(Camera *c, float aspect);
 Mat4 camera_view_proj(Camera *c, float aspect);
@@ -0,0 +1,278 @@
+#include "jobs.h"
+
+#include <stdatomic.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+enum { JOBS_MAX_WORKERS = 64 };
+
+#ifdef _WIN32
+typedef SRWLOCK JobMutex;
+typedef CONDITION_VARIABLE JobCond;
+
+static void mutex_init(JobMutex *m) { InitializeSRWLock(m); }
+static void mutex_destroy(JobMutex *m) { (void)m; }
+static void mutex_lock(JobMutex *m) { AcquireSRWLockExclusive(m); }
+static void mutex_unlock(JobMutex *m) { ReleaseSRWLockExclusive(m); }
+static void cond_init(JobCond *c) { InitializeConditionVariable(c); }
+static void cond_destroy(JobCond *c) { (void)c; }
+static void cond_signal(JobCond *c) { WakeConditionVariable(c); }
+
+static void cond_wait(JobCond *c, JobMutex *m) {
+  SleepConditionVariableSRW(c, m, INFINITE, 0);
+}
+#else
+typedef pthread_mutex_t JobMutex;
+typedef pthread_cond_t JobCond;
+
+static void mutex_init(JobMutex *m) { pthread_mutex_init(m, NULL); }
+static void mutex_destroy(JobMutex *m) { pthread_mutex_destroy(m); }
+static void mutex_lock(JobMutex *m) { pthread_mutex_lock(m); }
+static void mutex_unlock(JobMutex *m) { pthread_mutex_unlock(m); }
+static void cond_init(JobCond *c) { pthread_cond_init(c, NULL); }
+static void cond_destroy(JobCond *c) { pthread_cond_destroy(c); }
+static void cond_signal(JobCond *c) { pthread_cond_signal(c); }
+static void cond_wait(JobCond *c, JobMutex *m) { pthread_cond_wait(c, m); }
+#endif
+
+typedef struct JobShared {
+  atomic_int next;
+  int count;
+  int grain;
+  JobRangeFn fn;
+  void *ctx;
+} JobShared;
+
+typedef struct JobWorker {
+  JobShared *shared;
+  int index;
+  // Pool threads park on their own `wake` while shared is NULL, so a call
+  // wakes only the workers it hands the job to.
+  bool pooled;
+  JobCond wake;
+} JobWorker;
+
+// Threads started by jobs_start; workers[i] is worker index i, and index 0
+// (the calling thread) has no slot of its own.
+typedef struct JobPool {
+  JobMutex lock;
+  JobCond done;
+  JobWorker workers[JOBS_MAX_WORKERS];
+  int count;
+  int busy;
+  bool in_use;
+  bool quit;
+  bool running;
+} JobPool;
+
+static JobPool g_pool;
+
+static void run_worker(JobWorker *w) {
+  JobShared *s = w->shared;
+  for (;;) {
+    int begin = atomic_fetch_add(&s->next, s->grain);
+    if (begin >= s->count)
+      break;
+    int end = begin + s->grain;
+    if (end > s->count)
+      end = s->count;
+    s->fn(s->ctx, w->index, begin, end);
+  }
+}
+
+static void pool_loop(JobWorker *w) {
+  mutex_lock(&g_pool.lock);
+  for (;;) {
+    while (!w->shared && !g_pool.quit)
+      cond_wait(&w->wake, &g_pool.lock);
+    if (!w->shared)
+      break;
+    mutex_unlock(&g_pool.lock);
+    run_worker(w);
+    mutex_lock(&g_pool.lock);
+    w->shared = NULL;
+    if (--g_pool.busy == 0)
+      cond_signal(&g_pool.done);
+  }
+  mutex_unlock(&g_pool.lock);
+}
+
+static void worker_main(JobWorker *w) {
+  if (w->pooled)
+    pool_loop(w);
+  else
+    run_worker(w);
+}
+
+#ifdef _WIN32
+typedef HANDLE JobThread;
+
+static DWORD WINAPI thread_main(LPVOID arg) {
+  worker_main((JobWorker *)arg);
+  return 0;
+}
+
+static bool thread_start(JobThread *t, JobWorker *w) {
+  *t = CreateThread(NULL, 0, thread_main, w, 0, NULL);
+  return *t != NULL;
+}
+
+static void thread_join(JobThread t) {
+  WaitForSingleObject(t, INFINITE);
+  CloseHandle(t);
+}
+
+int jobs_hardware_threads(void) {
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  return info.dwNumberOfProcessors > 0 ? (int)info.dwNumberOfProcessors : 1;
+}
+#else
+typedef pthread_t JobThread;
+
+static void *thread_main(void *arg) {
+  worker_main((JobWorker *)arg);
+  return NULL;
+}
+
+static bool thread_start(JobThread *t, JobWorker *w) {
+  return pthread_create(t, NULL, thread_main, w) == 0;
+}
+
+static void thread_join(JobThread t) { pthread_join(t, NULL); }
+
+int jobs_hardware_threads(void) {
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  return n > 0 ? (int)n : 1;
+}
+#endif
+
+static JobThread g_pool_threads[JOBS_MAX_WORKERS];
+
+bool jobs_start(int workers) {
+  if (g_pool.running)
+    jobs_stop();
+  if (workers > JOBS_MAX_WORKERS)
+    workers = JOBS_MAX_WORKERS;
+
+  memset(&g_pool, 0, sizeof(g_pool));
+  mutex_init(&g_pool.lock);
+  cond_init(&g_pool.done);
+  g_pool.running = true;
+  for (int i = 1; i < workers; i++) {
+    JobWorker *w = &g_pool.workers[i];
+    w->index = i;
+    w->pooled = true;
+    cond_init(&w->wake);
+    if (!thread_start(&g_pool_threads[i], w)) {
+      cond_destroy(&w->wake);
+      return false;
+    }
+    g_pool.count = i;
+  }
+  return true;
+}
+
+void jobs_stop(void) {
+  if (!g_pool.running)
+    return;
+  mutex_lock(&g_pool.lock);
+  g_pool.quit = true;
+  for (int i = 1; i <= g_pool.count; i++)
+    cond_signal(&g_pool.workers[i].wake);
+  mutex_unlock(&g_pool.lock);
+
+  for (int i = 1; i <= g_pool.count; i++) {
+    thread_join(g_pool_threads[i]);
+    cond_destroy(&g_pool.workers[i].wake);
+  }
+  cond_destroy(&g_pool.done);
+  mutex_destroy(&g_pool.lock);
+  memset(&g_pool, 0, sizeof(g_pool));
+}
+
+int jobs_pool_workers(void) { return g_pool.running ? g_pool.count + 1 : 0; }
+
+// Hands the job to pool workers 1 .. helpers, or returns false when the
+// pool is missing or already serving another call.
+static bool pool_begin(JobShared *shared, int helpers) {
+  if (!g_pool.running || g_pool.count == 0)
+    return false;
+  mutex_lock(&g_pool.lock);
+  if (g_pool.in_use) {
+    mutex_unlock(&g_pool.lock);
+    return false;
+  }
+  if (helpers > g_pool.count)
+    helpers = g_pool.count;
+  g_pool.in_use = true;
+  g_pool.busy = helpers;
+  for (int i = 1; i <= helpers; i++) {
+    g_pool.workers[i].shared = shared;
+    cond_signal(&g_pool.workers[i].wake);
+  }
+  mutex_unlock(&g_pool.lock);
+  return true;
+}
+
+static void pool_end(void) {
+  mutex_lock(&g_pool.lock);
+  while (g_pool.busy > 0)
+    cond_wait(&g_pool.done, &g_pool.lock);
+  g_pool.in_use = false;
+  mutex_unlock(&g_pool.lock);
+}
+
+bool jobs_parallel_for(int count, int grain, int workers, JobRangeFn fn,
+                       void *ctx) {
+  if (count <= 0)
+    return true;
+  if (grain < 1)
+    grain = 1;
+  if (workers < 1)
+    workers = 1;
+  if (workers > JOBS_MAX_WORKERS)
+    workers = JOBS_MAX_WORKERS;
+
+  JobShared shared;
+  atomic_init(&shared.next, 0);
+  shared.count = count;
+  shared.grain = grain;
+  shared.fn = fn;
+  shared.ctx = ctx;
+
+  JobWorker self;
+  memset(&self, 0, sizeof(self));
+  self.shared = &shared;
+
+  if (workers > 1 && pool_begin(&shared, workers - 1)) {
+    run_worker(&self);
+    pool_end();
+    return true;
+  }
+
+  JobWorker ws[JOBS_MAX_WORKERS];
+  JobThread threads[JOBS_MAX_WORKERS];
+  int started = 0;
+  for (int i = 1; i < workers; i++) {
+    ws[i].shared = &shared;
+    ws[i].index = i;
+    ws[i].pooled = false;
+    if (!thread_start(&threads[started], &ws[i]))
+      break;
+    started++;
+  }
+
+  // Anything a failed thread would have taken is picked up here.
+  run_worker(&self);
+
+  for (int i = 0; i < started; i++)
+    thread_join(threads[i]);
+  return true;
+}
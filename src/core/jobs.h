@@ -0,0 +1,31 @@
+#ifndef JOBS_H
+#define JOBS_H
+
+#include <stdbool.h>
+
+// Called with a half-open range of item indices. `worker` is in
+// [0, workers) and stays fixed for the whole call, so per-worker scratch can
+// be indexed by it.
+typedef void (*JobRangeFn)(void *ctx, int worker, int begin, int end);
+
+// Hardware threads available, at least 1.
+int jobs_hardware_threads(void);
+
+// Starts workers - 1 threads that sleep between jobs_parallel_for calls, so
+// per-frame work does not pay for thread creation. Start and stop from one
+// thread with no call in flight. Returns false if a thread failed to start;
+// the pool keeps the ones that did.
+bool jobs_start(int workers);
+void jobs_stop(void);
+// Threads the pool offers a call, the caller included; 0 when not started.
+int jobs_pool_workers(void);
+
+// Runs fn over [0, count) in ranges of `grain` items pulled from a shared
+// counter by `workers` threads, the caller being worker 0. Returns once every
+// item is done. Workers may use the counted heap but not the frame arena.
+// Pool threads are used when the pool is free (capping `workers` at its
+// size); otherwise threads are started for the call.
+bool jobs_parallel_for(int count, int grain, int workers, JobRangeFn fn,
+                       void *ctx);
+
+#endif // !JOBS_H
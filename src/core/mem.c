@@ -0,0 +1,218 @@
+#include "mem.h"
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Size header in front of every counted block, padded to keep 16-byte
+// alignment for SIMD users.
+typedef union MemHeader {
+  size_t size;
+  max_align_t align;
+  unsigned char pad[16];
+} MemHeader;
+
+// Atomic so job workers can use the counted heap alongside the main thread.
+static atomic_uint_least64_t g_allocs;
+static atomic_uint_least64_t g_frees;
+static atomic_size_t g_live_bytes;
+static atomic_size_t g_peak_bytes;
+static Arena g_frame;
+
+static void note_alloc(size_t size) {
+  atomic_fetch_add_explicit(&g_allocs, 1, memory_order_relaxed);
+  size_t live =
+      atomic_fetch_add_explicit(&g_live_bytes, size, memory_order_relaxed) +
+      size;
+  size_t peak = atomic_load_explicit(&g_peak_bytes, memory_order_relaxed);
+  while (live > peak &&
+         !atomic_compare_exchange_weak_explicit(&g_peak_bytes, &peak, live,
+                                                memory_order_relaxed,
+                                                memory_order_relaxed)) {
+  }
+}
+
+static void note_free(size_t size) {
+  atomic_fetch_add_explicit(&g_frees, 1, memory_order_relaxed);
+  atomic_fetch_sub_explicit(&g_live_bytes, size, memory_order_relaxed);
+}
+
+void *mem_alloc(size_t size) {
+  MemHeader *h = (MemHeader *)malloc(sizeof(MemHeader) + size);
+  if (!h)
+    return NULL;
+  h->size = size;
+  note_alloc(size);
+  return h + 1;
+}
+
+void *mem_calloc(size_t count, size_t size) {
+  if (size && count > (size_t)-1 / size)
+    return NULL;
+  void *p = mem_alloc(count * size);
+  if (p)
+    memset(p, 0, count * size);
+  return p;
+}
+
+void *mem_realloc(void *p, size_t size) {
+  if (!p)
+    return mem_alloc(size);
+
+  MemHeader *old = (MemHeader *)p - 1;
+  size_t old_size = old->size;
+  MemHeader *h = (MemHeader *)realloc(old, sizeof(MemHeader) + size);
+  if (!h)
+    return NULL;
+
+  h->size = size;
+  note_free(old_size);
+  note_alloc(size);
+  return h + 1;
+}
+
+void mem_free(void *p) {
+  if (!p)
+    return;
+  MemHeader *h = (MemHeader *)p - 1;
+  note_free(h->size);
+  free(h);
+}
+
+MemStats mem_stats(void) {
+  MemStats s;
+  s.allocs = atomic_load(&g_allocs);
+  s.frees = atomic_load(&g_frees);
+  s.live_bytes = atomic_load(&g_live_bytes);
+  s.peak_bytes = atomic_load(&g_peak_bytes);
+  return s;
+}
+
+bool arena_init(Arena *a, size_t capacity) {
+  memset(a, 0, sizeof(*a));
+  a->base = (unsigned char *)mem_alloc(capacity);
+  if (!a->base)
+    return false;
+  a->capacity = capacity;
+  return true;
+}
+
+void arena_destroy(Arena *a) {
+  if (!a)
+    return;
+  mem_free(a->base);
+  memset(a, 0, sizeof(*a));
+}
+
+void *arena_alloc(Arena *a, size_t size, size_t align) {
+  size_t at = (a->used + (align - 1)) & ~(align - 1);
+  if (at > a->capacity || size > a->capacity - at)
+    return NULL;
+  a->used = at + size;
+  if (a->used > a->high_water)
+    a->high_water = a->used;
+  return a->base + at;
+}
+
+size_t arena_mark(const Arena *a) { return a->used; }
+
+void arena_rewind(Arena *a, size_t mark) {
+  if (mark <= a->used)
+    a->used = mark;
+}
+
+bool pool_init(Pool *p, size_t block_size, int blocks_per_slab) {
+  memset(p, 0, sizeof(*p));
+  if (block_size < sizeof(void *))
+    block_size = sizeof(void *);
+  p->block_size = (block_size + 15) & ~(size_t)15;
+  p->blocks_per_slab = blocks_per_slab > 0 ? blocks_per_slab : 1;
+  return true;
+}
+
+void pool_destroy(Pool *p) {
+  if (!p)
+    return;
+  for (int i = 0; i < p->slab_count; i++)
+    mem_free(p->slabs[i]);
+  mem_free(p->slabs);
+  memset(p, 0, sizeof(*p));
+}
+
+static bool add_slab(Pool *p) {
+  if (p->slab_count == p->slab_capacity) {
+    int cap = p->slab_capacity ? p->slab_capacity * 2 : 8;
+    void **slabs =
+        (void **)mem_realloc(p->slabs, (size_t)cap * sizeof(void *));
+    if (!slabs)
+      return false;
+    p->slabs = slabs;
+    p->slab_capacity = cap;
+  }
+
+  unsigned char *slab =
+      (unsigned char *)mem_alloc(p->block_size * (size_t)p->blocks_per_slab);
+  if (!slab)
+    return false;
+  p->slabs[p->slab_count++] = slab;
+
+  for (int i = p->blocks_per_slab - 1; i >= 0; i--) {
+    void **block = (void **)(slab + (size_t)i * p->block_size);
+    *block = p->free_list;
+    p->free_list = block;
+  }
+  return true;
+}
+
+void *pool_alloc(Pool *p) {
+  if (!p->free_list && !add_slab(p))
+    return NULL;
+  void **block = (void **)p->free_list;
+  p->free_list = *block;
+  if (++p->in_use > p->high_water)
+    p->high_water = p->in_use;
+  return block;
+}
+
+void pool_free(Pool *p, void *block) {
+  if (!block)
+    return;
+  *(void **)block = p->free_list;
+  p->free_list = block;
+  p->in_use--;
+}
+
+bool mem_frame_init(size_t capacity) { return arena_init(&g_frame, capacity); }
+
+void mem_frame_shutdown(void) { arena_destroy(&g_frame); }
+
+void mem_frame_reset(void) { g_frame.used = 0; }
+
+Arena *mem_frame(void) { return &g_frame; }
+
+bool mem_temp_begin(MemTemp *t, size_t size) {
+  t->mark = arena_mark(&g_frame);
+  t->ptr = arena_alloc(&g_frame, size, 16);
+  t->heap = (t->ptr == NULL);
+  if (t->heap)
+    t->ptr = mem_alloc(size);
+  return t->ptr != NULL;
+}
+
+void mem_temp_end(MemTemp *t) {
+  if (t->heap)
+    mem_free(t->ptr);
+  else
+    arena_rewind(&g_frame, t->mark);
+  t->ptr = NULL;
+}
+
+void mem_report(const char *label) {
+  MemStats s = mem_stats();
+  printf("%s: %llu allocs, %llu frees, %.1f KiB live, %.1f KiB peak, "
+         "frame scratch high water %.1f of %.1f KiB\n",
+         label, (unsigned long long)s.allocs, (unsigned long long)s.frees,
+         s.live_bytes / 1024.0, s.peak_bytes / 1024.0,
+         g_frame.high_water / 1024.0, g_frame.capacity / 1024.0);
+}
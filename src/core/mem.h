@@ -0,0 +1,75 @@
+#ifndef MEM_H
+#define MEM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct MemStats {
+  uint64_t allocs;
+  uint64_t frees;
+  size_t live_bytes;
+  size_t peak_bytes;
+} MemStats;
+
+// Counted heap. Everything the engine owns goes through these so the frame
+// loop can be checked for allocations; pair them, never mix with free().
+// Safe to call from any thread; arenas, pools and frame scratch are not.
+void *mem_alloc(size_t size);
+void *mem_calloc(size_t count, size_t size);
+void *mem_realloc(void *p, size_t size);
+void mem_free(void *p);
+MemStats mem_stats(void);
+
+// Bump allocator over one block. Marks let callers give back temporaries.
+typedef struct Arena {
+  unsigned char *base;
+  size_t capacity;
+  size_t used;
+  size_t high_water;
+} Arena;
+
+bool arena_init(Arena *a, size_t capacity);
+void arena_destroy(Arena *a);
+void *arena_alloc(Arena *a, size_t size, size_t align);
+size_t arena_mark(const Arena *a);
+void arena_rewind(Arena *a, size_t mark);
+
+// Fixed-size blocks carved from slabs; freed blocks are reused before any
+// new slab is requested.
+typedef struct Pool {
+  size_t block_size;
+  int blocks_per_slab;
+  void *free_list;
+  void **slabs;
+  int slab_count;
+  int slab_capacity;
+  int in_use;
+  int high_water;
+} Pool;
+
+bool pool_init(Pool *p, size_t block_size, int blocks_per_slab);
+void pool_destroy(Pool *p);
+void *pool_alloc(Pool *p);
+void pool_free(Pool *p, void *block);
+
+// Scratch memory valid until the next mem_frame_reset.
+bool mem_frame_init(size_t capacity);
+void mem_frame_shutdown(void);
+void mem_frame_reset(void);
+Arena *mem_frame(void);
+
+// Temporary block from the frame arena, falling back to the counted heap
+// when it does not fit. Release in reverse order of acquisition.
+typedef struct MemTemp {
+  void *ptr;
+  size_t mark;
+  bool heap;
+} MemTemp;
+
+bool mem_temp_begin(MemTemp *t, size_t size);
+void mem_temp_end(MemTemp *t);
+
+void mem_report(const char *label);
+
+#endif // !MEM_H
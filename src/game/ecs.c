@@ -0,0 +1,319 @@
+#include "ecs.h"
+
+#include <string.h>
+
+#define INDEX_MASK ((1u << ECS_INDEX_BITS) - 1u)
+#define GEN_MASK ((1u << (32 - ECS_INDEX_BITS)) - 1u)
+
+static const size_t k_chunk_header = (sizeof(EcsChunk) + 63) & ~(size_t)63;
+
+static uint32_t id_index(EntityId e) { return e & INDEX_MASK; }
+static uint32_t id_generation(EntityId e) { return e >> ECS_INDEX_BITS; }
+
+static size_t align16(size_t n) { return (n + 15) & ~(size_t)15; }
+
+bool ecs_init(EcsWorld *w) {
+  memset(w, 0, sizeof(*w));
+  return pool_init(&w->chunk_pool, ECS_CHUNK_BYTES, 16);
+}
+
+void ecs_shutdown(EcsWorld *w) {
+  if (!w)
+    return;
+  for (int a = 0; a < w->archetype_count; a++) {
+    mem_free(w->archetypes[a].chunks);
+  }
+  pool_destroy(&w->chunk_pool);
+  mem_free(w->generation);
+  mem_free(w->slot_archetype);
+  mem_free(w->slot_chunk);
+  mem_free(w->slot_row);
+  mem_free(w->free_slots);
+  memset(w, 0, sizeof(*w));
+}
+
+int ecs_register_component(EcsWorld *w, size_t size) {
+  if (w->comp_count >= ECS_MAX_COMPONENTS || w->archetype_count > 0)
+    return -1;
+  w->comp_size[w->comp_count] = size;
+  return w->comp_count++;
+}
+
+static int find_archetype(EcsWorld *w, ComponentMask mask) {
+  for (int a = 0; a < w->archetype_count; a++) {
+    if (w->archetypes[a].mask == mask)
+      return a;
+  }
+  if (w->archetype_count >= ECS_MAX_ARCHETYPES)
+    return -1;
+
+  EcsArchetype *arch = &w->archetypes[w->archetype_count];
+  memset(arch, 0, sizeof(*arch));
+  arch->mask = mask;
+
+  // Leave room for aligning every column within the fixed chunk size.
+  size_t row_bytes = sizeof(EntityId);
+  size_t padding = 16;
+  for (int c = 0; c < w->comp_count; c++) {
+    if (mask & ECS_MASK(c)) {
+      row_bytes += w->comp_size[c];
+      padding += 16;
+    }
+  }
+  arch->capacity =
+      (int)((ECS_CHUNK_BYTES - k_chunk_header - padding) / row_bytes);
+  if (arch->capacity < 1)
+    return -1;
+
+  size_t offset = align16((size_t)arch->capacity * sizeof(EntityId));
+  for (int c = 0; c < w->comp_count; c++) {
+    if (!(mask & ECS_MASK(c)))
+      continue;
+    arch->offsets[c] = offset;
+    offset = align16(offset + (size_t)arch->capacity * w->comp_size[c]);
+  }
+  arch->bytes = offset;
+
+  return w->archetype_count++;
+}
+
+static EcsChunk *new_chunk(EcsWorld *w, EcsArchetype *arch) {
+  if (arch->chunk_count == arch->chunk_capacity) {
+    int cap = arch->chunk_capacity ? arch->chunk_capacity * 2 : 4;
+    EcsChunk **p = (EcsChunk **)mem_realloc(arch->chunks,
+                                            (size_t)cap * sizeof(EcsChunk *));
+    if (!p)
+      return NULL;
+    arch->chunks = p;
+    arch->chunk_capacity = cap;
+  }
+
+  unsigned char *block = (unsigned char *)pool_alloc(&w->chunk_pool);
+  if (!block)
+    return NULL;
+
+  EcsChunk *chunk = (EcsChunk *)block;
+  unsigned char *data = block + k_chunk_header;
+  memset(chunk, 0, sizeof(*chunk));
+  chunk->entities = (EntityId *)data;
+  for (int c = 0; c < w->comp_count; c++) {
+    if (arch->mask & ECS_MASK(c))
+      chunk->columns[c] = data + arch->offsets[c];
+  }
+
+  arch->chunks[arch->chunk_count++] = chunk;
+  return chunk;
+}
+
+// Rows are packed so that only the last chunk of an archetype is partial.
+static bool alloc_row(EcsWorld *w, int a, EntityId e, int *out_chunk,
+                      int *out_row) {
+  EcsArchetype *arch = &w->archetypes[a];
+  EcsChunk *chunk = arch->chunk_count ? arch->chunks[arch->chunk_count - 1]
+                                      : NULL;
+  if (!chunk || chunk->count == arch->capacity) {
+    chunk = new_chunk(w, arch);
+    if (!chunk)
+      return false;
+  }
+
+  int row = chunk->count++;
+  chunk->entities[row] = e;
+  for (int c = 0; c < w->comp_count; c++) {
+    if (arch->mask & ECS_MASK(c))
+      memset(chunk->columns[c] + (size_t)row * w->comp_size[c], 0,
+             w->comp_size[c]);
+  }
+
+  *out_chunk = arch->chunk_count - 1;
+  *out_row = row;
+  return true;
+}
+
+// Fills the hole with the archetype's last row and fixes that entity's slot.
+static void remove_row(EcsWorld *w, int a, int chunk_i, int row) {
+  EcsArchetype *arch = &w->archetypes[a];
+  EcsChunk *chunk = arch->chunks[chunk_i];
+  int last_i = arch->chunk_count - 1;
+  EcsChunk *last = arch->chunks[last_i];
+  int last_row = last->count - 1;
+
+  if (chunk != last || row != last_row) {
+    EntityId moved = last->entities[last_row];
+    chunk->entities[row] = moved;
+    for (int c = 0; c < w->comp_count; c++) {
+      if (!(arch->mask & ECS_MASK(c)))
+        continue;
+      size_t sz = w->comp_size[c];
+      memcpy(chunk->columns[c] + (size_t)row * sz,
+             last->columns[c] + (size_t)last_row * sz, sz);
+    }
+    uint32_t idx = id_index(moved);
+    w->slot_chunk[idx] = chunk_i;
+    w->slot_row[idx] = row;
+  }
+
+  if (--last->count == 0) {
+    pool_free(&w->chunk_pool, last);
+    arch->chunk_count--;
+  }
+}
+
+static bool grow_slots(EcsWorld *w) {
+  int cap = w->slot_capacity ? w->slot_capacity * 2 : 256;
+  if ((uint32_t)cap > INDEX_MASK)
+    cap = (int)INDEX_MASK;
+  if (cap <= w->slot_capacity)
+    return false;
+
+  uint32_t *gen = (uint32_t *)mem_realloc(w->generation, (size_t)cap * 4);
+  if (gen)
+    w->generation = gen;
+  int32_t *arch = (int32_t *)mem_realloc(w->slot_archetype, (size_t)cap * 4);
+  if (arch)
+    w->slot_archetype = arch;
+  int32_t *chunk = (int32_t *)mem_realloc(w->slot_chunk, (size_t)cap * 4);
+  if (chunk)
+    w->slot_chunk = chunk;
+  int32_t *row = (int32_t *)mem_realloc(w->slot_row, (size_t)cap * 4);
+  if (row)
+    w->slot_row = row;
+  uint32_t *fr = (uint32_t *)mem_realloc(w->free_slots, (size_t)cap * 4);
+  if (fr)
+    w->free_slots = fr;
+  if (!gen || !arch || !chunk || !row || !fr)
+    return false;
+
+  w->slot_capacity = cap;
+  return true;
+}
+
+EntityId ecs_spawn(EcsWorld *w, ComponentMask mask) {
+  int a = find_archetype(w, mask);
+  if (a < 0)
+    return ECS_NULL;
+
+  uint32_t idx;
+  if (w->free_count > 0) {
+    idx = w->free_slots[--w->free_count];
+  } else {
+    if (w->slot_count == w->slot_capacity && !grow_slots(w))
+      return ECS_NULL;
+    idx = (uint32_t)w->slot_count++;
+    w->generation[idx] = 0;
+  }
+
+  EntityId e = (w->generation[idx] << ECS_INDEX_BITS) | idx;
+  int chunk, row;
+  if (!alloc_row(w, a, e, &chunk, &row)) {
+    w->slot_archetype[idx] = -1;
+    w->free_slots[w->free_count++] = idx;
+    return ECS_NULL;
+  }
+
+  w->slot_archetype[idx] = a;
+  w->slot_chunk[idx] = chunk;
+  w->slot_row[idx] = row;
+  w->alive++;
+  return e;
+}
+
+bool ecs_alive(const EcsWorld *w, EntityId e) {
+  uint32_t idx = id_index(e);
+  return e != ECS_NULL && idx < (uint32_t)w->slot_count &&
+         w->slot_archetype[idx] >= 0 && w->generation[idx] == id_generation(e);
+}
+
+void ecs_destroy(EcsWorld *w, EntityId e) {
+  if (!ecs_alive(w, e))
+    return;
+  uint32_t idx = id_index(e);
+  remove_row(w, w->slot_archetype[idx], w->slot_chunk[idx], w->slot_row[idx]);
+  w->slot_archetype[idx] = -1;
+  if (w->generation[idx] < GEN_MASK) {
+    w->generation[idx]++;
+    w->free_slots[w->free_count++] = idx;
+  }
+  w->alive--;
+}
+
+ComponentMask ecs_mask(const EcsWorld *w, EntityId e) {
+  if (!ecs_alive(w, e))
+    return 0;
+  return w->archetypes[w->slot_archetype[id_index(e)]].mask;
+}
+
+bool ecs_set_mask(EcsWorld *w, EntityId e, ComponentMask mask) {
+  if (!ecs_alive(w, e))
+    return false;
+
+  uint32_t idx = id_index(e);
+  int from = w->slot_archetype[idx];
+  if (w->archetypes[from].mask == mask)
+    return true;
+
+  int to = find_archetype(w, mask);
+  int chunk, row;
+  if (to < 0 || !alloc_row(w, to, e, &chunk, &row))
+    return false;
+
+  const EcsArchetype *src_arch = &w->archetypes[from];
+  const EcsChunk *src = src_arch->chunks[w->slot_chunk[idx]];
+  EcsChunk *dst = w->archetypes[to].chunks[chunk];
+  int src_row = w->slot_row[idx];
+  for (int c = 0; c < w->comp_count; c++) {
+    if (!(src_arch->mask & mask & ECS_MASK(c)))
+      continue;
+    size_t sz = w->comp_size[c];
+    memcpy(dst->columns[c] + (size_t)row * sz,
+           src->columns[c] + (size_t)src_row * sz, sz);
+  }
+
+  remove_row(w, from, w->slot_chunk[idx], src_row);
+  w->slot_archetype[idx] = to;
+  w->slot_chunk[idx] = chunk;
+  w->slot_row[idx] = row;
+  return true;
+}
+
+void *ecs_get(EcsWorld *w, EntityId e, int comp) {
+  if (!ecs_alive(w, e))
+    return NULL;
+  uint32_t idx = id_index(e);
+  const EcsArchetype *arch = &w->archetypes[w->slot_archetype[idx]];
+  if (!(arch->mask & ECS_MASK(comp)))
+    return NULL;
+  EcsChunk *chunk = arch->chunks[w->slot_chunk[idx]];
+  return chunk->columns[comp] + (size_t)w->slot_row[idx] * w->comp_size[comp];
+}
+
+EcsIter ecs_query(EcsWorld *w, ComponentMask mask) {
+  EcsIter it;
+  memset(&it, 0, sizeof(it));
+  it.world = w;
+  it.mask = mask;
+  it.chunk = -1;
+  return it;
+}
+
+bool ecs_next(EcsIter *it) {
+  EcsWorld *w = it->world;
+  while (it->archetype < w->archetype_count) {
+    const EcsArchetype *arch = &w->archetypes[it->archetype];
+    if ((arch->mask & it->mask) == it->mask &&
+        ++it->chunk < arch->chunk_count) {
+      it->cur = arch->chunks[it->chunk];
+      it->count = it->cur->count;
+      return true;
+    }
+    it->archetype++;
+    it->chunk = -1;
+  }
+  it->cur = NULL;
+  it->count = 0;
+  return false;
+}
+
+void *ecs_column(const EcsIter *it, int comp) {
+  return it->cur->columns[comp];
+}
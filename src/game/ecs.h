@@ -0,0 +1,93 @@
+#ifndef ECS_H
+#define ECS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../core/mem.h"
+
+enum {
+  ECS_MAX_COMPONENTS = 32,
+  ECS_MAX_ARCHETYPES = 64,
+  ECS_CHUNK_BYTES = 16 * 1024,
+  ECS_INDEX_BITS = 22,
+};
+
+// Low ECS_INDEX_BITS are the slot index, the rest is a generation that
+// changes every time the slot is reused, so stale ids never alias. A slot
+// whose generation runs out is retired rather than wrapped, and the top
+// index is never handed out, so no live id equals ECS_NULL.
+typedef uint32_t EntityId;
+typedef uint32_t ComponentMask;
+
+#define ECS_NULL ((EntityId)0xFFFFFFFFu)
+#define ECS_MASK(c) ((ComponentMask)1u << (c))
+
+// One block of entities sharing an archetype. Each component is a packed
+// column of `capacity` elements; rows [0, count) are live.
+typedef struct EcsChunk {
+  int count;
+  EntityId *entities;
+  unsigned char *columns[ECS_MAX_COMPONENTS];
+} EcsChunk;
+
+typedef struct EcsArchetype {
+  ComponentMask mask;
+  int capacity;
+  size_t bytes;
+  size_t offsets[ECS_MAX_COMPONENTS];
+  EcsChunk **chunks;
+  int chunk_count;
+  int chunk_capacity;
+} EcsArchetype;
+
+typedef struct EcsWorld {
+  // Every chunk is one ECS_CHUNK_BYTES block from this pool.
+  Pool chunk_pool;
+
+  size_t comp_size[ECS_MAX_COMPONENTS];
+  int comp_count;
+
+  EcsArchetype archetypes[ECS_MAX_ARCHETYPES];
+  int archetype_count;
+
+  uint32_t *generation;
+  int32_t *slot_archetype;
+  int32_t *slot_chunk;
+  int32_t *slot_row;
+  uint32_t *free_slots;
+  int free_count;
+  int slot_count;
+  int slot_capacity;
+  int alive;
+} EcsWorld;
+
+typedef struct EcsIter {
+  EcsWorld *world;
+  ComponentMask mask;
+  int archetype;
+  int chunk;
+  EcsChunk *cur;
+  int count;
+} EcsIter;
+
+bool ecs_init(EcsWorld *w);
+void ecs_shutdown(EcsWorld *w);
+
+int ecs_register_component(EcsWorld *w, size_t size);
+
+EntityId ecs_spawn(EcsWorld *w, ComponentMask mask);
+void ecs_destroy(EcsWorld *w, EntityId e);
+bool ecs_alive(const EcsWorld *w, EntityId e);
+bool ecs_set_mask(EcsWorld *w, EntityId e, ComponentMask mask);
+ComponentMask ecs_mask(const EcsWorld *w, EntityId e);
+void *ecs_get(EcsWorld *w, EntityId e, int comp);
+
+// Visits every chunk whose archetype has all components in `mask`:
+//   for (EcsIter it = ecs_query(w, m); ecs_next(&it);) { ... it.count ... }
+EcsIter ecs_query(EcsWorld *w, ComponentMask mask);
+bool ecs_next(EcsIter *it);
+void *ecs_column(const EcsIter *it, int comp);
+
+#endif // !ECS_H
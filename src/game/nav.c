@@ -0,0 +1,390 @@
+#include "nav.h"
+#include "../core/mem.h"
+
+#include <math.h>
+#include <string.h>
+
+static const float k_climb_cost = 2.0f;
+
+void nav_destroy(NavGraph *nav) {
+  if (!nav)
+    return;
+  mem_free(nav->centers);
+  mem_free(nav->edge_start);
+  mem_free(nav->edges);
+  memset(nav, 0, sizeof(*nav));
+}
+
+static Vec2 sector_center(const Map *map, const Sector *s) {
+  Vec2 c = v2(0.0f, 0.0f);
+  for (int i = 0; i < s->loop.count; i++)
+    c = v2_add(c, map->verts[s->loop.indices[i]]);
+  return s->loop.count > 0 ? v2_mul(c, 1.0f / (float)s->loop.count) : c;
+}
+
+static void update_costs(NavGraph *nav, const Map *map) {
+  for (int s = 0; s < nav->node_count; s++) {
+    const Sector *from = &map->sectors[s];
+    for (int e = nav->edge_start[s]; e < nav->edge_start[s + 1]; e++) {
+      NavEdge *edge = &nav->edges[e];
+      const Sector *to = &map->sectors[edge->to];
+
+      if (edge->width < 2.0f * nav->agent_radius ||
+          !map_portal_passable(from, to, from->floor_h, nav->agent_height,
+                               nav->step_height)) {
+        edge->cost = INFINITY;
+        continue;
+      }
+      edge->cost =
+          edge->length + k_climb_cost * fabsf(to->floor_h - from->floor_h);
+    }
+  }
+  nav->revision = map->height_revision;
+}
+
+bool nav_build(NavGraph *nav, const Map *map, float agent_radius,
+               float agent_height, float step_height) {
+  memset(nav, 0, sizeof(*nav));
+  nav->node_count = map->sector_count;
+  nav->agent_radius = agent_radius;
+  nav->agent_height = agent_height;
+  nav->step_height = step_height;
+
+  int portals = 0;
+  for (int i = 0; i < map->line_count; i++)
+    portals += (map->lines[i].back_sector >= 0) ? 1 : 0;
+
+  nav->centers = (Vec2 *)mem_alloc((size_t)nav->node_count * sizeof(Vec2));
+  nav->edge_start =
+      (int *)mem_alloc(((size_t)nav->node_count + 1) * sizeof(int));
+  nav->edges =
+      (NavEdge *)mem_alloc(((size_t)portals * 2 + 1) * sizeof(NavEdge));
+  if (!nav->centers || !nav->edge_start || !nav->edges) {
+    nav_destroy(nav);
+    return false;
+  }
+
+  for (int s = 0; s < nav->node_count; s++)
+    nav->centers[s] = sector_center(map, &map->sectors[s]);
+
+  for (int s = 0; s < nav->node_count; s++) {
+    nav->edge_start[s] = nav->edge_count;
+    for (int k = map->sector_line_start[s]; k < map->sector_line_start[s + 1];
+         k++) {
+      int li = map->sector_lines[k];
+      const Linedef *l = &map->lines[li];
+      if (l->back_sector < 0)
+        continue;
+
+      int other = (l->front_sector == s) ? l->back_sector : l->front_sector;
+      Vec2 a = map->verts[l->v0];
+      Vec2 b = map->verts[l->v1];
+      Vec2 mid = v2_mul(v2_add(a, b), 0.5f);
+
+      NavEdge *e = &nav->edges[nav->edge_count++];
+      e->to = other;
+      e->line = li;
+      e->width = v2_len(v2_sub(b, a));
+      e->length = v2_len(v2_sub(mid, nav->centers[s])) +
+                  v2_len(v2_sub(nav->centers[other], mid));
+    }
+  }
+  nav->edge_start[nav->node_count] = nav->edge_count;
+
+  update_costs(nav, map);
+  return true;
+}
+
+void nav_refresh(NavGraph *nav, const Map *map) {
+  if (nav->revision != map->height_revision)
+    update_costs(nav, map);
+}
+
+void nav_planner_destroy(NavPlanner *pl) {
+  if (!pl)
+    return;
+  mem_free(pl->g);
+  mem_free(pl->f);
+  mem_free(pl->parent);
+  mem_free(pl->heap_index);
+  mem_free(pl->stamp);
+  mem_free(pl->heap);
+  mem_free(pl->cache);
+  mem_free(pl->cache_paths);
+  mem_free(pl->out_paths);
+  memset(pl, 0, sizeof(*pl));
+}
+
+static void cache_clear(NavPlanner *pl) {
+  for (int i = 0; i < pl->cache_capacity; i++)
+    pl->cache[i].start = -1;
+  pl->cache_count = 0;
+  pl->cache_path_count = 0;
+}
+
+bool nav_planner_init(NavPlanner *pl, const NavGraph *nav, int cache_capacity) {
+  memset(pl, 0, sizeof(*pl));
+  pl->graph = nav;
+
+  int cap = 64;
+  while (cap < cache_capacity * 2)
+    cap *= 2;
+  pl->cache_capacity = cap;
+  pl->cache_path_capacity = cap * 16;
+
+  size_t n = (size_t)nav->node_count;
+  pl->g = (float *)mem_alloc(n * sizeof(float));
+  pl->f = (float *)mem_alloc(n * sizeof(float));
+  pl->parent = (int *)mem_alloc(n * sizeof(int));
+  pl->heap_index = (int *)mem_alloc(n * sizeof(int));
+  pl->stamp = (uint32_t *)mem_calloc(n, sizeof(uint32_t));
+  pl->heap = (int *)mem_alloc(n * sizeof(int));
+  pl->cache = (NavCacheEntry *)mem_alloc((size_t)cap * sizeof(NavCacheEntry));
+  pl->cache_paths =
+      (int *)mem_alloc((size_t)pl->cache_path_capacity * sizeof(int));
+  if (!pl->g || !pl->f || !pl->parent || !pl->heap_index || !pl->stamp ||
+      !pl->heap || !pl->cache || !pl->cache_paths) {
+    nav_planner_destroy(pl);
+    return false;
+  }
+
+  cache_clear(pl);
+  pl->cache_revision = nav->revision;
+  return true;
+}
+
+static bool reserve_out(NavPlanner *pl, int extra) {
+  if (pl->out_count + extra <= pl->out_capacity)
+    return true;
+  int cap = pl->out_capacity ? pl->out_capacity : 256;
+  while (cap < pl->out_count + extra)
+    cap *= 2;
+  int *p = (int *)mem_realloc(pl->out_paths, (size_t)cap * sizeof(int));
+  if (!p)
+    return false;
+  pl->out_paths = p;
+  pl->out_capacity = cap;
+  return true;
+}
+
+static uint32_t cache_slot(const NavPlanner *pl, int start, int goal) {
+  uint32_t h = (uint32_t)start * 0x9E3779B1u ^ (uint32_t)goal * 0x85EBCA77u;
+  h ^= h >> 15;
+  return h & (uint32_t)(pl->cache_capacity - 1);
+}
+
+static const NavCacheEntry *cache_find(const NavPlanner *pl, int start,
+                                       int goal) {
+  uint32_t i = cache_slot(pl, start, goal);
+  for (;;) {
+    const NavCacheEntry *e = &pl->cache[i];
+    if (e->start < 0)
+      return NULL;
+    if (e->start == start && e->goal == goal)
+      return e;
+    i = (i + 1) & (uint32_t)(pl->cache_capacity - 1);
+  }
+}
+
+static void cache_insert(NavPlanner *pl, int start, int goal,
+                         const NavResult *r, const int *path) {
+  if (pl->cache_count >= pl->cache_capacity / 2 ||
+      pl->cache_path_count + r->count > pl->cache_path_capacity)
+    cache_clear(pl);
+  if (r->count > pl->cache_path_capacity)
+    return;
+
+  uint32_t i = cache_slot(pl, start, goal);
+  while (pl->cache[i].start >= 0)
+    i = (i + 1) & (uint32_t)(pl->cache_capacity - 1);
+
+  NavCacheEntry *e = &pl->cache[i];
+  e->start = start;
+  e->goal = goal;
+  e->result = *r;
+  e->result.offset = pl->cache_path_count;
+  memcpy(pl->cache_paths + pl->cache_path_count, path,
+         (size_t)r->count * sizeof(int));
+  pl->cache_path_count += r->count;
+  pl->cache_count++;
+}
+
+static void heap_swap(NavPlanner *pl, int a, int b) {
+  int na = pl->heap[a];
+  int nb = pl->heap[b];
+  pl->heap[a] = nb;
+  pl->heap[b] = na;
+  pl->heap_index[nb] = a;
+  pl->heap_index[na] = b;
+}
+
+static void heap_up(NavPlanner *pl, int i) {
+  while (i > 0) {
+    int parent = (i - 1) / 2;
+    if (pl->f[pl->heap[parent]] <= pl->f[pl->heap[i]])
+      break;
+    heap_swap(pl, i, parent);
+    i = parent;
+  }
+}
+
+static void heap_down(NavPlanner *pl, int i) {
+  for (;;) {
+    int l = 2 * i + 1;
+    int r = l + 1;
+    int m = i;
+    if (l < pl->heap_count && pl->f[pl->heap[l]] < pl->f[pl->heap[m]])
+      m = l;
+    if (r < pl->heap_count && pl->f[pl->heap[r]] < pl->f[pl->heap[m]])
+      m = r;
+    if (m == i)
+      return;
+    heap_swap(pl, i, m);
+    i = m;
+  }
+}
+
+static int heap_pop(NavPlanner *pl) {
+  int n = pl->heap[0];
+  pl->heap_count--;
+  if (pl->heap_count > 0) {
+    pl->heap[0] = pl->heap[pl->heap_count];
+    pl->heap_index[pl->heap[0]] = 0;
+    heap_down(pl, 0);
+  }
+  pl->heap_index[n] = -1;
+  return n;
+}
+
+static void touch(NavPlanner *pl, int n) {
+  if (pl->stamp[n] == pl->cur_stamp)
+    return;
+  pl->stamp[n] = pl->cur_stamp;
+  pl->g[n] = INFINITY;
+  pl->parent[n] = -1;
+  pl->heap_index[n] = -1;
+}
+
+// Returns false only when the path could not be stored; an unreachable
+// goal is a completed search with out->found unset.
+static bool astar(NavPlanner *pl, int start, int goal, NavResult *out) {
+  const NavGraph *nav = pl->graph;
+  Vec2 goal_c = nav->centers[goal];
+
+  if (++pl->cur_stamp == 0) {
+    memset(pl->stamp, 0, (size_t)nav->node_count * sizeof(uint32_t));
+    pl->cur_stamp = 1;
+  }
+  pl->heap_count = 0;
+  pl->stats.searches++;
+
+  touch(pl, start);
+  pl->g[start] = 0.0f;
+  pl->f[start] = v2_len(v2_sub(goal_c, nav->centers[start]));
+  pl->heap[pl->heap_count] = start;
+  pl->heap_index[start] = pl->heap_count++;
+
+  out->found = false;
+  out->cost = INFINITY;
+  out->offset = pl->out_count;
+  out->count = 0;
+
+  // Edge lengths run centre-portal-centre, so the straight line between
+  // centres never overestimates and the first pop of the goal is optimal.
+  while (pl->heap_count > 0) {
+    int n = heap_pop(pl);
+    if (n == goal)
+      break;
+    pl->stats.expansions++;
+
+    for (int e = nav->edge_start[n]; e < nav->edge_start[n + 1]; e++) {
+      const NavEdge *edge = &nav->edges[e];
+      if (isinf(edge->cost))
+        continue;
+
+      int m = edge->to;
+      touch(pl, m);
+      float g = pl->g[n] + edge->cost;
+      if (g >= pl->g[m])
+        continue;
+
+      pl->g[m] = g;
+      pl->parent[m] = n;
+      pl->f[m] = g + v2_len(v2_sub(goal_c, nav->centers[m]));
+      if (pl->heap_index[m] < 0) {
+        pl->heap[pl->heap_count] = m;
+        pl->heap_index[m] = pl->heap_count++;
+      }
+      heap_up(pl, pl->heap_index[m]);
+    }
+  }
+
+  if (pl->stamp[goal] != pl->cur_stamp || isinf(pl->g[goal]))
+    return true;
+
+  int count = 0;
+  for (int n = goal; n >= 0; n = pl->parent[n])
+    count++;
+  if (!reserve_out(pl, count))
+    return false;
+
+  int *path = pl->out_paths + pl->out_count;
+  int i = count;
+  for (int n = goal; n >= 0; n = pl->parent[n])
+    path[--i] = n;
+
+  out->found = true;
+  out->cost = pl->g[goal];
+  out->count = count;
+  pl->out_count += count;
+  return true;
+}
+
+static void find_one(NavPlanner *pl, int start, int goal, NavResult *out) {
+  const NavCacheEntry *hit = cache_find(pl, start, goal);
+  if (hit) {
+    pl->stats.cache_hits++;
+    *out = hit->result;
+    out->offset = pl->out_count;
+    if (!reserve_out(pl, hit->result.count)) {
+      out->found = false;
+      out->count = 0;
+      return;
+    }
+    memcpy(pl->out_paths + pl->out_count,
+           pl->cache_paths + hit->result.offset,
+           (size_t)hit->result.count * sizeof(int));
+    pl->out_count += hit->result.count;
+    return;
+  }
+
+  // A failed allocation says nothing about the pair, so it is not cached.
+  if (astar(pl, start, goal, out))
+    cache_insert(pl, start, goal, out, pl->out_paths + out->offset);
+}
+
+int nav_find_paths(NavPlanner *pl, const NavRequest *reqs, int count,
+                   NavResult *results) {
+  pl->out_count = 0;
+  if (pl->cache_revision != pl->graph->revision) {
+    cache_clear(pl);
+    pl->cache_revision = pl->graph->revision;
+    pl->stats.invalidations++;
+  }
+
+  int found = 0;
+  for (int i = 0; i < count; i++) {
+    find_one(pl, reqs[i].start, reqs[i].goal, &results[i]);
+    found += results[i].found ? 1 : 0;
+  }
+  return found;
+}
+
+bool nav_find_path(NavPlanner *pl, int start, int goal, NavResult *out) {
+  NavRequest req = {start, goal};
+  return nav_find_paths(pl, &req, 1, out) == 1;
+}
+
+const int *nav_result_path(const NavPlanner *pl, const NavResult *r) {
+  return pl->out_paths + r->offset;
+}
@@ -0,0 +1,101 @@
+#ifndef NAV_H
+#define NAV_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "../map/map.h"
+#include "../math/vec2.h"
+
+typedef struct NavEdge {
+  int to;
+  int line;
+  float length;
+  float width;
+  float cost;
+} NavEdge;
+
+// Sector nodes joined by portal edges. Geometry is fixed at build time;
+// passability and height costs follow map->height_revision.
+typedef struct NavGraph {
+  int node_count;
+  Vec2 *centers;
+  int *edge_start;
+  NavEdge *edges;
+  int edge_count;
+
+  float agent_radius;
+  float agent_height;
+  float step_height;
+  uint32_t revision;
+} NavGraph;
+
+typedef struct NavRequest {
+  int start;
+  int goal;
+} NavRequest;
+
+typedef struct NavResult {
+  bool found;
+  float cost;
+  int offset;
+  int count;
+} NavResult;
+
+typedef struct NavCacheEntry {
+  int start;
+  int goal;
+  NavResult result;
+} NavCacheEntry;
+
+typedef struct NavStats {
+  long searches;
+  long cache_hits;
+  long expansions;
+  long invalidations;
+} NavStats;
+
+typedef struct NavPlanner {
+  const NavGraph *graph;
+
+  // Per-node search state, reused across searches via a stamp.
+  float *g;
+  float *f;
+  int *parent;
+  int *heap_index;
+  uint32_t *stamp;
+  uint32_t cur_stamp;
+  int *heap;
+  int heap_count;
+
+  NavCacheEntry *cache;
+  int cache_capacity;
+  int cache_count;
+  int *cache_paths;
+  int cache_path_count;
+  int cache_path_capacity;
+  uint32_t cache_revision;
+
+  int *out_paths;
+  int out_count;
+  int out_capacity;
+
+  NavStats stats;
+} NavPlanner;
+
+bool nav_build(NavGraph *nav, const Map *map, float agent_radius,
+               float agent_height, float step_height);
+void nav_destroy(NavGraph *nav);
+void nav_refresh(NavGraph *nav, const Map *map);
+
+bool nav_planner_init(NavPlanner *pl, const NavGraph *nav, int cache_capacity);
+void nav_planner_destroy(NavPlanner *pl);
+
+// Results of one batch point into the planner's output buffer and stay valid
+// until the next call. Call nav_refresh first when heights may have moved.
+bool nav_find_path(NavPlanner *pl, int start, int goal, NavResult *out);
+int nav_find_paths(NavPlanner *pl, const NavRequest *reqs, int count,
+                   NavResult *results);
+const int *nav_result_path(const NavPlanner *pl, const NavResult *r);
+
+#endif // !NAV_H
@@ -1,6 +1,7 @@
 #include "player.h"
 #include "../geom/geom2d.h"
 #include <math.h>
+#include <stddef.h>
 
 static Vec2 yaw_forward(float yaw) {
   float cy = cosf(yaw);
@@ -14,111 +15,348 @@ static Vec2 yaw_right(float yaw) {
   return v2(cy, sy);
 }
 
-static bool portal_passable(const Sector *a, const Sector *b, float player_h) {
-  float floor = (a->floor_h > b->floor_h) ? a->floor_h : b->floor_h;
-  float ceil = (a->ceil_h < b->ceil_h) ? a->ceil_h : b->ceil_h;
-  return (ceil - floor) >= player_h;
+static const float k_gravity = 20.0f;
+
+static bool portal_passable(const Sector *a, const Sector *b, const Player *p) {
+  return map_portal_passable(a, b, p->z, p->height, p->step_height);
 }
 
-static void collide_and_slide(Player *p, const Map *map, Vec2 old_pos,
-                              Vec2 new_pos) {
-  Vec2 pos = new_pos;
+enum {
+  SLIDE_ITERATIONS = 4,
+  DEPENETRATE_ITERATIONS = 2,
+  // Candidate lists up to this long live on the stack; longer ones borrow
+  // frame scratch.
+  CANDIDATE_STACK = 256,
+  SECTOR_HOPS = 4,
+  MAX_SECTOR_LINES = 256,
+  // Neighbours remembered while gathering; past this a sector reached
+  // through several portals may be scanned more than once.
+  MAX_NEIGHBOURS = 32,
+};
+
+static const float k_skin = 0.001f;
+
+// Lines to collide with and room for a squared distance to each.
+typedef struct Candidates {
+  int count;
+  int *lines;
+  float *d2;
+} Candidates;
+
+static bool standard_body(const Player *p) {
+  return p->height == MAP_STD_HEIGHT && p->step_height == MAP_STD_STEP;
+}
 
-  for (int i = 0; i < map->line_count; i++) {
-    const Linedef *l = &map->lines[i];
+// Whether line li stops the player crossing it out of sector `from`. A
+// grounded player of standard size standing on `from`'s floor reads the
+// precomputed flag; anything else falls back to the full height test.
+static bool line_blocks(const Map *map, int li, const Player *p, int from) {
+  uint8_t flags = map->linetab.flags[li];
+  if (!(flags & LINE_TWO_SIDED))
+    return true;
+
+  const Linedef *l = &map->lines[li];
+  const Sector *src = &map->sectors[from];
+  if (p->on_ground && p->z == src->floor_h && standard_body(p)) {
+    uint8_t bit = (l->front_sector == from) ? LINE_PASS_FRONT_TO_BACK
+                                            : LINE_PASS_BACK_TO_FRONT;
+    return !(flags & bit);
+  }
+
+  int other = (l->front_sector == from) ? l->back_sector : l->front_sector;
+  return !portal_passable(src, &map->sectors[other], p);
+}
 
-    if (l->front_sector != p->sector && l->back_sector != p->sector)
+// Most gather_candidates can find: the sector's own lines plus every line
+// of each sector across one of its two-sided lines.
+static int candidate_bound(const Map *map, int s) {
+  const int *start = map->sector_line_start;
+  int n = start[s + 1] - start[s];
+  for (int k = start[s]; k < start[s + 1]; k++) {
+    int li = map->sector_lines[k];
+    if (!(map->linetab.flags[li] & LINE_TWO_SIDED))
       continue;
+    const Linedef *l = &map->lines[li];
+    int other = (l->front_sector == s) ? l->back_sector : l->front_sector;
+    n += start[other + 1] - start[other];
+  }
+  return n;
+}
+
+static void add_candidate(Candidates *c, int li) {
+  c->lines[c->count++] = li;
+}
 
-    const Sector *sf = &map->sectors[l->front_sector];
-    const Sector *sb =
-        (l->back_sector >= 0) ? &map->sectors[l->back_sector] : NULL;
-
-    bool solid = (l->back_sector < 0);
-    if (!solid && sb) {
-      int other =
-          (l->front_sector == p->sector) ? l->back_sector : l->front_sector;
-      const Sector *so = &map->sectors[other];
-      if (!portal_passable(sf, so, p->height))
-        solid = true;
+static bool touches_sector(const Linedef *l, int sector) {
+  return l->front_sector == sector || l->back_sector == sector;
+}
+
+// Blocking lines of the player's sector and of the sectors behind its open
+// portals, so a move that crosses a portal still sees the far walls. Built
+// once per move from the adjacency lists; each neighbour is scanned once
+// and lines the sector's own pass already took are not repeated.
+static void gather_candidates(const Map *map, const Player *p,
+                              Candidates *c) {
+  const int *start = map->sector_line_start;
+  int s = p->sector;
+  int seen[MAX_NEIGHBOURS];
+  int seen_count = 0;
+  c->count = 0;
+
+  for (int k = start[s]; k < start[s + 1]; k++) {
+    int li = map->sector_lines[k];
+    if (line_blocks(map, li, p, s)) {
+      add_candidate(c, li);
+      continue;
     }
 
-    if (!solid)
+    const Linedef *l = &map->lines[li];
+    int other = (l->front_sector == s) ? l->back_sector : l->front_sector;
+    bool scanned = false;
+    for (int i = 0; i < seen_count && !scanned; i++)
+      scanned = (seen[i] == other);
+    if (scanned)
       continue;
+    if (seen_count < MAX_NEIGHBOURS)
+      seen[seen_count++] = other;
 
-    Vec2 a = map->verts[l->v0];
-    Vec2 b = map->verts[l->v1];
+    for (int k2 = start[other]; k2 < start[other + 1]; k2++) {
+      int far = map->sector_lines[k2];
+      if (far == li || !line_blocks(map, far, p, other))
+        continue;
+      if (touches_sector(&map->lines[far], s) && line_blocks(map, far, p, s))
+        continue;
+      add_candidate(c, far);
+    }
+  }
+}
+
+static Line2 table_line(const LineTable *t, int i) {
+  Line2 l;
+  l.a = v2(t->x0[i], t->y0[i]);
+  l.b = v2(t->x1[i], t->y1[i]);
+  l.dir = v2(t->dx[i], t->dy[i]);
+  l.n = v2(t->nx[i], t->ny[i]);
+  l.inv_len2 = t->inv_len2[i];
+  return l;
+}
+
+static Seg2Batch candidate_batch(const Map *map, const Candidates *c) {
+  const LineTable *t = &map->linetab;
+  Seg2Batch b;
+  b.x0 = t->x0;
+  b.y0 = t->y0;
+  b.dx = t->dx;
+  b.dy = t->dy;
+  b.inv_len2 = t->inv_len2;
+  b.index = c->lines;
+  b.count = c->count;
+  return b;
+}
+
+// Nothing changes until the first line within reach pushes the player, so
+// one batched distance pass finds where the sequential pass has to start.
+static Vec2 depenetrate(const Player *p, const Map *map,
+                        const Candidates *c, Vec2 pos) {
+  float r = p->radius;
+  Seg2Batch lines = candidate_batch(map, c);
+
+  for (int iter = 0; iter < DEPENETRATE_ITERATIONS; iter++) {
+    seg2_dist2_batch(pos, &lines, c->d2);
+    int first = 0;
+    while (first < c->count && c->d2[first] >= r * r)
+      first++;
+    if (first == c->count)
+      break;
 
-    Vec2 cp = seg2_closest_point(pos, a, b);
-    Vec2 d = v2_sub(pos, cp);
-    float dist2 = v2_len2(d);
-    float r = p->radius;
+    bool moved = false;
+    for (int i = first; i < c->count; i++) {
+      Line2 l = table_line(&map->linetab, c->lines[i]);
+      Vec2 cp = line2_closest_point(pos, &l);
+      Vec2 d = v2_sub(pos, cp);
+      float dist2 = v2_len2(d);
 
-    if (dist2 < r * r) {
-      float dist = sqrtf(dist2);
-      Vec2 n =
-          (dist > 1e-6f) ? v2_mul(d, 1.0f / dist) : v2_norm(v2_sub(pos, a));
-      pos = v2_add(cp, v2_mul(n, r));
+      if (dist2 < r * r) {
+        float dist = sqrtf(dist2);
+        Vec2 n = l.n;
+        if (dist > 1e-6f) {
+          n = v2_mul(d, 1.0f / dist);
+        } else if (map->lines[c->lines[i]].back_sector == p->sector) {
+          // Exactly on the wall: push back into the player's own sector.
+          n = v2_mul(n, -1.0f);
+        }
+        pos = v2_add(cp, v2_mul(n, r + k_skin));
+        moved = true;
+      }
     }
+    if (!moved)
+      break;
+  }
+  return pos;
+}
+
+static void collide_and_slide(Player *p, const Map *map, const Candidates *c,
+                              Vec2 old_pos, Vec2 new_pos) {
+  Vec2 pos = depenetrate(p, map, c, old_pos);
+  Vec2 delta = v2_sub(new_pos, old_pos);
+  Seg2Batch lines = candidate_batch(map, c);
+  Vec2 prev_n = v2(0.0f, 0.0f);
+  bool has_prev = false;
+
+  for (int iter = 0; iter < SLIDE_ITERATIONS; iter++) {
+    if (v2_len2(delta) <= 1e-12f)
+      break;
+
+    float hit_t = 2.0f;
+    Vec2 hit_n = v2(0.0f, 0.0f);
+
+    // The sweep can only touch lines within radius plus move length.
+    float reach = p->radius + v2_len(delta) + k_skin;
+    seg2_dist2_batch(pos, &lines, c->d2);
+
+    for (int i = 0; i < c->count; i++) {
+      if (c->d2[i] > reach * reach)
+        continue;
+      Line2 l = table_line(&map->linetab, c->lines[i]);
+      float t;
+      Vec2 n;
+      if (circle2_sweep_line(pos, delta, p->radius, &l, &t, &n) &&
+          t < hit_t) {
+        hit_t = t;
+        hit_n = n;
+      }
+    }
+
+    if (hit_t > 1.0f) {
+      pos = v2_add(pos, delta);
+      break;
+    }
+
+    pos = v2_add(v2_add(pos, v2_mul(delta, hit_t)), v2_mul(hit_n, k_skin));
+
+    // Slide the remaining motion along the contact plane. Hitting a second
+    // plane that pushes back into the first means a corner: stop there.
+    Vec2 rest = v2_mul(delta, 1.0f - hit_t);
+    delta = v2_sub(rest, v2_mul(hit_n, v2_dot(rest, hit_n)));
+    if (has_prev && v2_dot(delta, prev_n) < 0.0f)
+      break;
+
+    prev_n = hit_n;
+    has_prev = true;
   }
 
   p->pos = pos;
 }
 
+// A move can clip the corner between sectors and cross several portals in
+// one tick, so keep hopping until no portal of the current sector is hit.
 static void update_sector(Player *p, const Map *map, Vec2 old_pos,
                           Vec2 new_pos) {
-  for (int i = 0; i < map->line_count; i++) {
-    const Linedef *l = &map->lines[i];
-    if (l->back_sector < 0)
-      continue;
+  const LineTable *t = &map->linetab;
+  int entered_by = -1;
+  uint32_t hits[(MAX_SECTOR_LINES + 31) / 32];
 
-    int a = l->front_sector;
-    int b = l->back_sector;
+  for (int hop = 0; hop < SECTOR_HOPS; hop++) {
+    int s = p->sector;
+    int next = -1;
+    Seg2Batch all = map_sector_batch(map, s);
 
-    if (p->sector != a && p->sector != b)
-      continue;
+    // Portals crossed, checked in line order, a bounded run at a time.
+    for (int base = 0; base < all.count && next < 0;
+         base += MAX_SECTOR_LINES) {
+      Seg2Batch lines = all;
+      lines.index += base;
+      lines.count = all.count - base;
+      if (lines.count > MAX_SECTOR_LINES)
+        lines.count = MAX_SECTOR_LINES;
+      if (!seg2_intersect_batch(old_pos, new_pos, &lines, hits))
+        continue;
 
-    Vec2 s0 = map->verts[l->v0];
-    Vec2 s1 = map->verts[l->v1];
+      for (int i = 0; i < lines.count; i++) {
+        int li = lines.index[i];
+        if (!((hits[i >> 5] >> (i & 31)) & 1) || li == entered_by ||
+            !(t->flags[li] & LINE_TWO_SIDED))
+          continue;
+        if (!line_blocks(map, li, p, s)) {
+          next = li;
+          break;
+        }
+      }
+    }
 
-    if (!seg2_intersect(old_pos, new_pos, s0, s1))
-      continue;
+    if (next < 0)
+      return;
 
-    int other = (p->sector == a) ? b : a;
+    const Linedef *l = &map->lines[next];
+    p->sector = (l->front_sector == s) ? l->back_sector : l->front_sector;
+    entered_by = next;
+  }
+}
 
-    if (portal_passable(&map->sectors[p->sector], &map->sectors[other],
-                        p->height)) {
-      p->sector = other;
-      return;
+// Only the containing sector is consulted: stepping up snaps onto a floor
+// within step reach, anything lower starts a fall under gravity.
+static void update_vertical(Player *p, const Map *map, float dt) {
+  const Sector *s = &map->sectors[p->sector];
+
+  if (p->on_ground || p->z <= s->floor_h) {
+    if (p->z - s->floor_h <= 1e-4f) {
+      p->z = s->floor_h;
+      p->vz = 0.0f;
+      p->on_ground = true;
+    } else {
+      p->on_ground = false;
+    }
+  }
+
+  if (!p->on_ground) {
+    p->vz -= k_gravity * dt;
+    p->z += p->vz * dt;
+    if (p->z <= s->floor_h) {
+      p->z = s->floor_h;
+      p->vz = 0.0f;
+      p->on_ground = true;
     }
   }
+
+  if (p->z + p->height > s->ceil_h) {
+    p->z = s->ceil_h - p->height;
+    if (p->z < s->floor_h)
+      p->z = s->floor_h;
+    if (p->vz > 0.0f)
+      p->vz = 0.0f;
+  }
 }
 
 void player_init(Player *p) {
   p->pos = v2(1.0f, 1.0f);
+  p->z = 0.0f;
+  p->vz = 0.0f;
   p->yaw = 0.0f;
   p->radius = 0.25f;
   p->height = 1.6f;
+  p->eye_height = 1.6f;
+  p->step_height = 0.6f;
+  p->on_ground = true;
   p->sector = 0;
 }
 
-void player_update(Player *p, const Map *map, const InputState *in, float dt) {
-  if (in->key_down[SDL_SCANCODE_LEFT])
-    p->yaw += dt * 1.6f;
-  if (in->key_down[SDL_SCANCODE_RIGHT])
-    p->yaw -= dt * 1.6f;
+void player_update(Player *p, const Map *map, const PlayerCmd *cmd, float dt) {
+  if (cmd->buttons & PLAYER_BTN_TURN_LEFT)
+    p->yaw += dt * PLAYER_TURN_SPEED;
+  if (cmd->buttons & PLAYER_BTN_TURN_RIGHT)
+    p->yaw -= dt * PLAYER_TURN_SPEED;
 
   Vec2 f = yaw_forward(p->yaw);
   Vec2 r = yaw_right(p->yaw);
 
   Vec2 wish = v2(0.0f, 0.0f);
-  if (in->key_down[SDL_SCANCODE_W])
+  if (cmd->buttons & PLAYER_BTN_FORWARD)
     wish = v2_add(wish, f);
-  if (in->key_down[SDL_SCANCODE_S])
+  if (cmd->buttons & PLAYER_BTN_BACK)
     wish = v2_sub(wish, f);
-  if (in->key_down[SDL_SCANCODE_D])
+  if (cmd->buttons & PLAYER_BTN_STRAFE_RIGHT)
     wish = v2_add(wish, r);
-  if (in->key_down[SDL_SCANCODE_A])
+  if (cmd->buttons & PLAYER_BTN_STRAFE_LEFT)
     wish = v2_sub(wish, r);
 
   float len = v2_len(wish);
@@ -129,6 +367,57 @@ void player_update(Player *p, const Map *map, const InputState *in, float dt) {
   Vec2 old_pos = p->pos;
   Vec2 new_pos = v2_add(p->pos, v2_mul(wish, speed * dt));
 
-  collide_and_slide(p, map, old_pos, new_pos);
-  update_sector(p, map, old_pos, p->pos);
+  player_slide(p, map, new_pos);
+  player_track_sector(p, map, old_pos, p->pos);
+  update_vertical(p, map, dt);
+}
+
+void player_slide(Player *p, const Map *map, Vec2 to) {
+  int stack_lines[CANDIDATE_STACK];
+  float stack_d2[CANDIDATE_STACK];
+  Candidates c = {0, stack_lines, stack_d2};
+
+  MemTemp temp = {0};
+  int bound = candidate_bound(map, p->sector);
+  if (bound > CANDIDATE_STACK) {
+    // Without room for every line the player stays put rather than moving
+    // past walls it could not test.
+    if (!mem_temp_begin(&temp, (size_t)bound * (sizeof(int) + sizeof(float))))
+      return;
+    c.lines = (int *)temp.ptr;
+    c.d2 = (float *)(c.lines + bound);
+  }
+
+  gather_candidates(map, p, &c);
+  collide_and_slide(p, map, &c, p->pos, to);
+  if (temp.ptr)
+    mem_temp_end(&temp);
+}
+
+void player_track_sector(Player *p, const Map *map, Vec2 from, Vec2 to) {
+  update_sector(p, map, from, to);
+}
+
+float player_eye_z(const Player *p) { return p->z + p->eye_height; }
+
+static uint32_t hash_bytes(uint32_t h, const void *data, size_t len) {
+  const unsigned char *p = (const unsigned char *)data;
+  for (size_t i = 0; i < len; i++) {
+    h ^= p[i];
+    h *= 16777619u;
+  }
+  return h;
+}
+
+uint32_t player_checksum(const Player *p) {
+  uint32_t h = 2166136261u;
+  h = hash_bytes(h, &p->pos.x, sizeof(float));
+  h = hash_bytes(h, &p->pos.y, sizeof(float));
+  h = hash_bytes(h, &p->z, sizeof(float));
+  h = hash_bytes(h, &p->vz, sizeof(float));
+  h = hash_bytes(h, &p->yaw, sizeof(float));
+  h = hash_bytes(h, &p->sector, sizeof(int));
+  uint8_t grounded = p->on_ground ? 1 : 0;
+  h = hash_bytes(h, &grounded, 1);
+  return h;
 }
@@ -1,19 +1,49 @@
 #ifndef PLAYER_H
 #define PLAYER_H
 
-#include "../input.h"
+#include <stdint.h>
+
 #include "../map/map.h"
 #include "../math/vec2.h"
 
+enum {
+  PLAYER_BTN_FORWARD = 1 << 0,
+  PLAYER_BTN_BACK = 1 << 1,
+  PLAYER_BTN_STRAFE_LEFT = 1 << 2,
+  PLAYER_BTN_STRAFE_RIGHT = 1 << 3,
+  PLAYER_BTN_TURN_LEFT = 1 << 4,
+  PLAYER_BTN_TURN_RIGHT = 1 << 5,
+};
+
+// Radians per second while a turn button is held.
+#define PLAYER_TURN_SPEED 1.6f
+
+typedef struct PlayerCmd {
+  uint8_t buttons;
+} PlayerCmd;
+
 typedef struct Player {
   Vec2 pos;
+  float z;
+  float vz;
   float yaw;
   float radius;
   float height;
+  float eye_height;
+  float step_height;
+  bool on_ground;
   int sector;
 } Player;
 
 void player_init(Player *p);
-void player_update(Player *p, const Map *map, const InputState *in, float dt);
+void player_update(Player *p, const Map *map, const PlayerCmd *cmd, float dt);
+float player_eye_z(const Player *p);
+
+// The horizontal halves of player_update: slide the body from its position
+// toward `to` against the walls, then follow a move from `from` to `to`
+// across portals.
+void player_slide(Player *p, const Map *map, Vec2 to);
+void player_track_sector(Player *p, const Map *map, Vec2 from, Vec2 to);
+uint32_t player_checksum(const Player *p);
 
 #endif // !PLAYER_H
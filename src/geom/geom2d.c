@@ -30,19 +30,122 @@ Vec2 seg2_closest_point(Vec2 p, Vec2 a, Vec2 b) {
 
 static float cross2(Vec2 a, Vec2 b) { return a.x * b.y - a.y * b.x; }
 
+// Parallel and collinear pairs never count. Folding the sign of rxs into
+// the numerators turns t, u in [0, 1] into a division-free range check.
 bool seg2_intersect(Vec2 p0, Vec2 p1, Vec2 q0, Vec2 q1) {
   Vec2 r = v2_sub(p1, p0);
   Vec2 s = v2_sub(q1, q0);
+  Vec2 qp = v2_sub(q0, p0);
   float rxs = cross2(r, s);
-  float qpxr = cross2(v2_sub(q0, p0), r);
-  if (fabsf(rxs) <= 1e-6f && fabsf(qpxr) <= 1e-6f) {
+  float tn = cross2(qp, s);
+  float un = cross2(qp, r);
+  if (!(fabsf(rxs) > 1e-6f))
     return false;
+  // Scaling by +-1 is exact and, unlike a branch, cheap when unpredictable.
+  float sign = copysignf(1.0f, rxs);
+  float den = rxs * sign;
+  tn *= sign;
+  un *= sign;
+  return (tn >= 0.0f) & (tn <= den) & (un >= 0.0f) & (un <= den);
+}
+
+static bool sweep_point(Vec2 c, Vec2 d, float r, Vec2 v, float *out_t,
+                        Vec2 *out_n) {
+  Vec2 m = v2_sub(c, v);
+  float b = v2_dot(m, d);
+  float cc = v2_dot(m, m) - r * r;
+  if (b >= 0.0f)
+    return false;
+
+  float a = v2_dot(d, d);
+  float disc = b * b - a * cc;
+  if (a <= 1e-12f || disc < 0.0f)
+    return false;
+
+  float t = (-b - sqrtf(disc)) / a;
+  if (t < 0.0f)
+    t = 0.0f;
+  if (t > 1.0f)
+    return false;
+
+  *out_t = t;
+  *out_n = v2_norm(v2_add(m, v2_mul(d, t)));
+  return true;
+}
+
+Line2 line2_make(Vec2 a, Vec2 b) {
+  Line2 l;
+  l.a = a;
+  l.b = b;
+  l.dir = v2_sub(b, a);
+  float len2 = v2_dot(l.dir, l.dir);
+  l.inv_len2 = (len2 > 1e-12f) ? 1.0f / len2 : 0.0f;
+  l.n = v2_mul(v2_perp_left(l.dir), sqrtf(l.inv_len2));
+  return l;
+}
+
+Vec2 line2_closest_point(Vec2 p, const Line2 *l) {
+  float t = v2_dot(v2_sub(p, l->a), l->dir) * l->inv_len2;
+  if (t < 0.0f)
+    t = 0.0f;
+  if (t > 1.0f)
+    t = 1.0f;
+  return v2_add(l->a, v2_mul(l->dir, t));
+}
+
+bool circle2_sweep_line(Vec2 c, Vec2 d, float r, const Line2 *l, float *out_t,
+                        Vec2 *out_n) {
+  Vec2 n = l->n;
+  float dist = v2_dot(v2_sub(c, l->a), n);
+  float dn = v2_dot(d, n);
+  if (dist < 0.0f) {
+    n = v2_mul(n, -1.0f);
+    dist = -dist;
+    dn = -dn;
   }
-  if (fabs(rxs) <= 1e-6f && fabs(qpxr) > 1e-6f)
+
+  // Never within reach of the carrier line, so not of the endpoints either.
+  if (dist > r && dist + dn > r)
     return false;
 
-  float t = cross2(v2_sub(q0, p0), s) / rxs;
-  float u = cross2(v2_sub(q0, p0), r) / rxs;
+  bool hit = false;
+  float best = 2.0f;
+  Vec2 best_n = v2(0.0f, 0.0f);
+
+  if (dn < 0.0f && dist >= r && l->inv_len2 > 0.0f) {
+    float t = (r - dist) / dn;
+    Vec2 contact = v2_sub(v2_add(c, v2_mul(d, t)), v2_mul(n, r));
+    float s = v2_dot(v2_sub(contact, l->a), l->dir) * l->inv_len2;
+    if (t <= 1.0f && s >= 0.0f && s <= 1.0f) {
+      hit = true;
+      best = t;
+      best_n = n;
+    }
+  }
+
+  // Endpoints behave like round caps, which keeps corners order independent.
+  float t;
+  Vec2 en;
+  if (sweep_point(c, d, r, l->a, &t, &en) && t < best) {
+    hit = true;
+    best = t;
+    best_n = en;
+  }
+  if (sweep_point(c, d, r, l->b, &t, &en) && t < best) {
+    hit = true;
+    best = t;
+    best_n = en;
+  }
+
+  if (hit) {
+    *out_t = best;
+    *out_n = best_n;
+  }
+  return hit;
+}
 
-  return (t >= 0.0f && t <= 1.0f && u >= 0.0f && u <= 1.0f);
+bool circle2_sweep_segment(Vec2 c, Vec2 d, float r, Vec2 a, Vec2 b,
+                           float *out_t, Vec2 *out_n) {
+  Line2 l = line2_make(a, b);
+  return circle2_sweep_line(c, d, r, &l, out_t, out_n);
 }
@@ -10,9 +10,27 @@ typedef struct Segment2 {
   Vec2 b;
 } Segment2;
 
+// A segment with its direction, unit normal and 1/|b-a|^2 ready for use.
+// n is dir turned left, so for a map line it points into the front sector.
+typedef struct Line2 {
+  Vec2 a;
+  Vec2 b;
+  Vec2 dir;
+  Vec2 n;
+  float inv_len2;
+} Line2;
+
 float seg2_signed_distance(Vec2 p, Vec2 a, Vec2 b);
 Vec2 seg2_closest_point(Vec2 p, Vec2 a, Vec2 b);
 
 bool seg2_intersect(Vec2 p0, Vec2 p1, Vec2 q0, Vec2 q1);
 
+Line2 line2_make(Vec2 a, Vec2 b);
+Vec2 line2_closest_point(Vec2 p, const Line2 *l);
+
+bool circle2_sweep_line(Vec2 c, Vec2 d, float r, const Line2 *l, float *out_t,
+                        Vec2 *out_n);
+bool circle2_sweep_segment(Vec2 c, Vec2 d, float r, Vec2 a, Vec2 b,
+                           float *out_t, Vec2 *out_n);
+
 #endif // !GEOM_2D_H
@@ -0,0 +1,262 @@
+#include "geom2d_batch.h"
+
+#include <math.h>
+#include <string.h>
+
+// Lane width is picked at compile time: AVX2 when the build targets it
+// (DAEMON_AVX2), SSE2 on any x86-64, plain C elsewhere. Every kernel runs
+// the same arithmetic in the same order on each path, so results match
+// the scalar functions in geom2d.c bit for bit.
+#if defined(__AVX2__)
+#define GEOM_AVX2 1
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) ||                                  \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GEOM_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(GEOM_AVX2)
+#define GEOM_SIMD 1
+enum { LANES = 8 };
+typedef __m256 VFloat;
+#define vf_set1 _mm256_set1_ps
+#define vf_add _mm256_add_ps
+#define vf_sub _mm256_sub_ps
+#define vf_mul _mm256_mul_ps
+#define vf_div _mm256_div_ps
+#define vf_min _mm256_min_ps
+#define vf_max _mm256_max_ps
+#define vf_and _mm256_and_ps
+#define vf_xor _mm256_xor_ps
+#define vf_ge(a, b) _mm256_cmp_ps(a, b, _CMP_GE_OQ)
+#define vf_gt(a, b) _mm256_cmp_ps(a, b, _CMP_GT_OQ)
+#define vf_le(a, b) _mm256_cmp_ps(a, b, _CMP_LE_OQ)
+#define vf_lt(a, b) _mm256_cmp_ps(a, b, _CMP_LT_OQ)
+#define vf_store _mm256_storeu_ps
+#define vf_mask _mm256_movemask_ps
+
+static inline VFloat vf_load(const float *base, const int *index, int i) {
+  if (index) {
+    __m256i k = _mm256_loadu_si256((const __m256i *)(index + i));
+    return _mm256_i32gather_ps(base, k, 4);
+  }
+  return _mm256_loadu_ps(base + i);
+}
+#elif defined(GEOM_SSE2)
+#define GEOM_SIMD 1
+enum { LANES = 4 };
+typedef __m128 VFloat;
+#define vf_set1 _mm_set1_ps
+#define vf_add _mm_add_ps
+#define vf_sub _mm_sub_ps
+#define vf_mul _mm_mul_ps
+#define vf_div _mm_div_ps
+#define vf_min _mm_min_ps
+#define vf_max _mm_max_ps
+#define vf_and _mm_and_ps
+#define vf_xor _mm_xor_ps
+#define vf_ge _mm_cmpge_ps
+#define vf_gt _mm_cmpgt_ps
+#define vf_le _mm_cmple_ps
+#define vf_lt _mm_cmplt_ps
+#define vf_store _mm_storeu_ps
+#define vf_mask _mm_movemask_ps
+
+static inline VFloat vf_load(const float *base, const int *index, int i) {
+  if (index) {
+    const int *k = index + i;
+    return _mm_setr_ps(base[k[0]], base[k[1]], base[k[2]], base[k[3]]);
+  }
+  return _mm_loadu_ps(base + i);
+}
+#endif
+
+static inline float at(const float *base, const int *index, int i) {
+  return base[index ? index[i] : i];
+}
+
+// Division-free form of seg2_intersect: with the signs of rxs folded into
+// tn and un, t = tn / rxs and u = un / rxs lie in [0, 1] exactly when both
+// numerators lie in [0, |rxs|].
+static bool intersect_one(Vec2 p0, Vec2 r, float x0, float y0, float dx,
+                          float dy) {
+  float qx = x0 - p0.x;
+  float qy = y0 - p0.y;
+  float rxs = r.x * dy - r.y * dx;
+  float tn = qx * dy - qy * dx;
+  float un = qx * r.y - qy * r.x;
+  if (!(fabsf(rxs) > 1e-6f))
+    return false;
+  // Scaling by +-1 is exact and, unlike a branch, cheap when unpredictable.
+  float sign = copysignf(1.0f, rxs);
+  float den = rxs * sign;
+  tn *= sign;
+  un *= sign;
+  return (tn >= 0.0f) & (tn <= den) & (un >= 0.0f) & (un <= den);
+}
+
+int seg2_intersect_batch(Vec2 p0, Vec2 p1, const Seg2Batch *b,
+                         uint32_t *mask) {
+  const int *ix = b->index;
+  Vec2 r = v2_sub(p1, p0);
+  int hits = 0;
+  int i = 0;
+  memset(mask, 0, (size_t)((b->count + 31) / 32) * sizeof(uint32_t));
+
+#ifdef GEOM_SIMD
+  const VFloat px = vf_set1(p0.x), py = vf_set1(p0.y);
+  const VFloat rx = vf_set1(r.x), ry = vf_set1(r.y);
+  const VFloat zero = vf_set1(0.0f), sign = vf_set1(-0.0f);
+  const VFloat eps = vf_set1(1e-6f);
+  for (; i + LANES <= b->count; i += LANES) {
+    VFloat dx = vf_load(b->dx, ix, i);
+    VFloat dy = vf_load(b->dy, ix, i);
+    VFloat qx = vf_sub(vf_load(b->x0, ix, i), px);
+    VFloat qy = vf_sub(vf_load(b->y0, ix, i), py);
+    VFloat rxs = vf_sub(vf_mul(rx, dy), vf_mul(ry, dx));
+    VFloat s = vf_and(rxs, sign);
+    VFloat den = vf_xor(rxs, s);
+    VFloat tn = vf_xor(vf_sub(vf_mul(qx, dy), vf_mul(qy, dx)), s);
+    VFloat un = vf_xor(vf_sub(vf_mul(qx, ry), vf_mul(qy, rx)), s);
+    VFloat hit = vf_and(vf_gt(den, eps),
+                        vf_and(vf_and(vf_ge(tn, zero), vf_le(tn, den)),
+                               vf_and(vf_ge(un, zero), vf_le(un, den))));
+    uint32_t bits = (uint32_t)vf_mask(hit);
+    mask[i >> 5] |= bits << (i & 31);
+    for (; bits; bits &= bits - 1)
+      hits++;
+  }
+#endif
+
+  for (; i < b->count; i++) {
+    if (intersect_one(p0, r, at(b->x0, ix, i), at(b->y0, ix, i),
+                      at(b->dx, ix, i), at(b->dy, ix, i))) {
+      mask[i >> 5] |= 1u << (i & 31);
+      hits++;
+    }
+  }
+  return hits;
+}
+
+void seg2_dist2_batch(Vec2 p, const Seg2Batch *b, float *dist2) {
+  const int *ix = b->index;
+  int i = 0;
+
+#ifdef GEOM_SIMD
+  const VFloat px = vf_set1(p.x), py = vf_set1(p.y);
+  const VFloat zero = vf_set1(0.0f), one = vf_set1(1.0f);
+  for (; i + LANES <= b->count; i += LANES) {
+    VFloat x0 = vf_load(b->x0, ix, i);
+    VFloat y0 = vf_load(b->y0, ix, i);
+    VFloat dx = vf_load(b->dx, ix, i);
+    VFloat dy = vf_load(b->dy, ix, i);
+    VFloat t = vf_add(vf_mul(vf_sub(px, x0), dx), vf_mul(vf_sub(py, y0), dy));
+    t = vf_min(vf_max(vf_mul(t, vf_load(b->inv_len2, ix, i)), zero), one);
+    VFloat ex = vf_sub(px, vf_add(x0, vf_mul(dx, t)));
+    VFloat ey = vf_sub(py, vf_add(y0, vf_mul(dy, t)));
+    vf_store(dist2 + i, vf_add(vf_mul(ex, ex), vf_mul(ey, ey)));
+  }
+#endif
+
+  for (; i < b->count; i++) {
+    float x0 = at(b->x0, ix, i), y0 = at(b->y0, ix, i);
+    float dx = at(b->dx, ix, i), dy = at(b->dy, ix, i);
+    float t = ((p.x - x0) * dx + (p.y - y0) * dy) * at(b->inv_len2, ix, i);
+    t = fminf(fmaxf(t, 0.0f), 1.0f);
+    float ex = p.x - (x0 + dx * t);
+    float ey = p.y - (y0 + dy * t);
+    dist2[i] = ex * ex + ey * ey;
+  }
+}
+
+int ray2_cast_batch(Vec2 o, Vec2 d, float t_min, float t_max,
+                    const Seg2Batch *b, int skip, float *out_t) {
+  const int *ix = b->index;
+  int best = -1;
+  float best_t = t_max;
+  int i = 0;
+
+#ifdef GEOM_SIMD
+  const VFloat ox = vf_set1(o.x), oy = vf_set1(o.y);
+  const VFloat rx = vf_set1(d.x), ry = vf_set1(d.y);
+  const VFloat zero = vf_set1(0.0f), one = vf_set1(1.0f);
+  const VFloat sign = vf_set1(-0.0f), eps = vf_set1(1e-12f);
+  const VFloat lo = vf_set1(t_min);
+  float lane_t[LANES];
+  for (; i + LANES <= b->count; i += LANES) {
+    VFloat ex = vf_load(b->dx, ix, i);
+    VFloat ey = vf_load(b->dy, ix, i);
+    VFloat ax = vf_sub(vf_load(b->x0, ix, i), ox);
+    VFloat ay = vf_sub(vf_load(b->y0, ix, i), oy);
+    VFloat denom = vf_sub(vf_mul(rx, ey), vf_mul(ry, ex));
+    VFloat t = vf_div(vf_sub(vf_mul(ax, ey), vf_mul(ay, ex)), denom);
+    VFloat u = vf_div(vf_sub(vf_mul(ax, ry), vf_mul(ay, rx)), denom);
+    VFloat ok = vf_and(vf_gt(vf_xor(denom, vf_and(denom, sign)), eps),
+                       vf_and(vf_and(vf_ge(u, zero), vf_le(u, one)),
+                              vf_and(vf_ge(t, lo), vf_lt(t, vf_set1(best_t)))));
+    uint32_t bits = (uint32_t)vf_mask(ok);
+    if (!bits)
+      continue;
+    // Few lanes survive; settle them in order so ties keep the first.
+    vf_store(lane_t, t);
+    for (int j = 0; j < LANES; j++) {
+      if (((bits >> j) & 1) && lane_t[j] < best_t &&
+          seg2_batch_id(b, i + j) != skip) {
+        best = i + j;
+        best_t = lane_t[j];
+      }
+    }
+  }
+#endif
+
+  for (; i < b->count; i++) {
+    if (seg2_batch_id(b, i) == skip)
+      continue;
+    float ex = at(b->dx, ix, i), ey = at(b->dy, ix, i);
+    float ax = at(b->x0, ix, i) - o.x;
+    float ay = at(b->y0, ix, i) - o.y;
+    float denom = d.x * ey - d.y * ex;
+    if (!(fabsf(denom) > 1e-12f))
+      continue;
+    float t = (ax * ey - ay * ex) / denom;
+    float u = (ax * d.y - ay * d.x) / denom;
+    if (u < 0.0f || u > 1.0f || t < t_min || t >= best_t)
+      continue;
+    best = i;
+    best_t = t;
+  }
+
+  if (best >= 0)
+    *out_t = best_t;
+  return best;
+}
+
+void seg2_side_batch(Vec2 a, Vec2 b, const float *px, const float *py,
+                     int count, float *out) {
+  Vec2 ab = v2_sub(b, a);
+  float len = v2_len(ab);
+  if (len <= 0.000001f) {
+    memset(out, 0, (size_t)count * sizeof(float));
+    return;
+  }
+  int i = 0;
+
+#ifdef GEOM_SIMD
+  const VFloat ax = vf_set1(a.x), ay = vf_set1(a.y);
+  const VFloat bx = vf_set1(ab.x), by = vf_set1(ab.y);
+  const VFloat vlen = vf_set1(len);
+  for (; i + LANES <= count; i += LANES) {
+    VFloat qx = vf_sub(vf_load(px, NULL, i), ax);
+    VFloat qy = vf_sub(vf_load(py, NULL, i), ay);
+    vf_store(out + i,
+             vf_div(vf_sub(vf_mul(bx, qy), vf_mul(by, qx)), vlen));
+  }
+#endif
+
+  for (; i < count; i++) {
+    float qx = px[i] - a.x;
+    float qy = py[i] - a.y;
+    out[i] = (ab.x * qy - ab.y * qx) / len;
+  }
+}
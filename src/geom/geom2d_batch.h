@@ -0,0 +1,44 @@
+#ifndef GEOM_2D_BATCH_H
+#define GEOM_2D_BATCH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "../math/vec2.h"
+
+// Segments in structure-of-arrays form: segment k runs from (x0[k], y0[k])
+// by (dx[k], dy[k]). Element i of the batch is segment index[i], or segment
+// i when index is NULL, so a slice of the map's line table can be read in
+// place. inv_len2 is only needed by seg2_dist2_batch.
+typedef struct Seg2Batch {
+  const float *x0, *y0;
+  const float *dx, *dy;
+  const float *inv_len2;
+  const int *index;
+  int count;
+} Seg2Batch;
+
+static inline int seg2_batch_id(const Seg2Batch *b, int i) {
+  return b->index ? b->index[i] : i;
+}
+
+// Sets bit i of mask (count + 31) / 32 words long when p0-p1 crosses element
+// i, with the same rules as seg2_intersect. Returns the number of hits.
+int seg2_intersect_batch(Vec2 p0, Vec2 p1, const Seg2Batch *b,
+                         uint32_t *mask);
+
+// Squared distance from p to each element, as line2_closest_point measures.
+void seg2_dist2_batch(Vec2 p, const Seg2Batch *b, float *dist2);
+
+// Nearest element the ray o + t * d crosses with t in [t_min, t_max),
+// ignoring segment `skip` (an index into the arrays, or -1). Returns its
+// position in the batch and sets *out_t, or returns -1. Ties go to the
+// earlier element.
+int ray2_cast_batch(Vec2 o, Vec2 d, float t_min, float t_max,
+                    const Seg2Batch *b, int skip, float *out_t);
+
+// seg2_signed_distance of each point (px[i], py[i]) from the line a-b.
+void seg2_side_batch(Vec2 a, Vec2 b, const float *px, const float *py,
+                     int count, float *out);
+
+#endif // !GEOM_2D_BATCH_H
@@ -0,0 +1,357 @@
+#include "lightmap.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "../core/jobs.h"
+#include "../core/mem.h"
+#include "../map/raycast.h"
+#include "../map/sector_grid.h"
+
+// Luxels per map unit, unless the map would need more than the budget.
+static const float k_density = 4.0f;
+static const double k_luxel_budget = 4.0 * 1024.0 * 1024.0;
+// Emitters sit this far under their sector's ceiling and reach this far.
+static const float k_emitter_drop = 0.25f;
+static const float k_emitter_radius = 8.0f;
+// Share of its sector's light level a luxel gets with no emitter in sight.
+static const float k_ambient = 0.35f;
+// Samples are lifted off their surface so walks do not start on its line.
+static const float k_surface_offset = 0.01f;
+
+enum { MIN_SIDE = 64, MAX_SIDE = 8192, MAX_TRACE_WORKERS = 64 };
+
+// Floors and ceilings over their loop boxes, walls over every piece.
+static double surface_area(const Map *map) {
+  double area = 0.0;
+  for (int s = 0; s < map->sector_count; s++) {
+    const SectorLoop *loop = &map->sectors[s].loop;
+    if (loop->count < 3)
+      continue;
+    Vec2 lo = map->verts[loop->indices[0]];
+    Vec2 hi = lo;
+    for (int i = 1; i < loop->count; i++) {
+      Vec2 p = map->verts[loop->indices[i]];
+      lo = v2(fminf(lo.x, p.x), fminf(lo.y, p.y));
+      hi = v2(fmaxf(hi.x, p.x), fmaxf(hi.y, p.y));
+    }
+    area += 2.0 * (double)(hi.x - lo.x) * (double)(hi.y - lo.y);
+  }
+  for (int i = 0; i < map->line_count; i++) {
+    const Linedef *l = &map->lines[i];
+    const Sector *f = &map->sectors[l->front_sector];
+    float h = f->ceil_h - f->floor_h;
+    if (l->back_sector >= 0) {
+      const Sector *b = &map->sectors[l->back_sector];
+      h = fabsf(f->floor_h - b->floor_h) + fabsf(f->ceil_h - b->ceil_h);
+    }
+    area += (double)map->linetab.len[i] * (double)h;
+  }
+  return area;
+}
+
+bool lightmap_begin(Lightmap *lm, const Map *map) {
+  memset(lm, 0, sizeof(*lm));
+  double area = surface_area(map);
+  double density = k_density;
+  if (area * density * density > k_luxel_budget)
+    density = sqrt(k_luxel_budget / area);
+  lm->density = (float)density;
+
+  // Borders and shelf gaps roughly double the luxels the surfaces need.
+  double luxels = area * density * density * 2.0 +
+                  (double)(map->sector_count + map->line_count) * 16.0;
+  int width = MIN_SIDE;
+  while (width < MAX_SIDE && (double)width * width < luxels)
+    width *= 2;
+  lm->width = width;
+  return true;
+}
+
+bool lightmap_reserve(Lightmap *lm, int charts) {
+  if (charts <= lm->chart_capacity)
+    return true;
+  LightChart *grown = (LightChart *)mem_realloc(
+      lm->charts, (size_t)charts * sizeof(LightChart));
+  if (!grown)
+    return false;
+  lm->charts = grown;
+  lm->chart_capacity = charts;
+  return true;
+}
+
+int lightmap_add_chart(Lightmap *lm, const LightChart *c) {
+  if (lm->chart_count == lm->chart_capacity &&
+      !lightmap_reserve(lm, lm->chart_count ? lm->chart_count * 2 : 256))
+    return -1;
+
+  LightChart *out = &lm->charts[lm->chart_count];
+  *out = *c;
+  // Surfaces longer than the atlas is wide get fewer luxels per unit.
+  float density = lm->density;
+  float longest = fmaxf(c->size_u, c->size_v);
+  if (longest * density > (float)(lm->width - 3))
+    density = (float)(lm->width - 3) / longest;
+  out->density = density;
+  out->w = (int)fmaxf(ceilf(c->size_u * density), 1.0f) + 2;
+  out->h = (int)fmaxf(ceilf(c->size_v * density), 1.0f) + 2;
+
+  if (lm->shelf_x + out->w > lm->width) {
+    lm->shelf_y += lm->shelf_h;
+    lm->shelf_x = 0;
+    lm->shelf_h = 0;
+  }
+  out->x = lm->shelf_x;
+  out->y = lm->shelf_y;
+  lm->shelf_x += out->w;
+  if (out->h > lm->shelf_h)
+    lm->shelf_h = out->h;
+  return lm->chart_count++;
+}
+
+void lightmap_chart_uv(const Lightmap *lm, int chart, float s, float t,
+                       float *lu, float *lv) {
+  const LightChart *c = &lm->charts[chart];
+  *lu = (float)(c->x + 1) + s * c->density;
+  *lv = (float)(c->y + 1) + t * c->density;
+}
+
+LightmapMark lightmap_mark(const Lightmap *lm) {
+  LightmapMark m = {lm->chart_count, lm->shelf_x, lm->shelf_y, lm->shelf_h};
+  return m;
+}
+
+void lightmap_rewind(Lightmap *lm, LightmapMark mark) {
+  lm->chart_count = mark.charts;
+  lm->shelf_x = mark.shelf_x;
+  lm->shelf_y = mark.shelf_y;
+  lm->shelf_h = mark.shelf_h;
+}
+
+bool lightmap_finish(Lightmap *lm) {
+  int height = lm->shelf_y + lm->shelf_h;
+  if (height < 1)
+    height = 1;
+  if (height > MAX_SIDE)
+    return false;
+  lm->block = mem_calloc((size_t)lm->width * (size_t)height, 1);
+  if (!lm->block)
+    return false;
+  lm->height = height;
+  lm->pixels = (uint8_t *)lm->block;
+  return true;
+}
+
+static uint8_t to_luxel(float v) {
+  v = fminf(fmaxf(v, 0.0f), 1.0f);
+  return (uint8_t)(v * 255.0f + 0.5f);
+}
+
+void lightmap_fill_flat(Lightmap *lm, const Map *map) {
+  for (int i = 0; i < lm->chart_count; i++) {
+    const LightChart *c = &lm->charts[i];
+    uint8_t v = to_luxel(map->sectors[c->sector].light_level);
+    for (int y = c->y; y < c->y + c->h; y++)
+      memset(lm->pixels + (size_t)y * lm->width + c->x, v, (size_t)c->w);
+  }
+}
+
+typedef struct Emitter {
+  Vec3 pos;
+  float intensity;
+} Emitter;
+
+typedef struct TraceJob {
+  Lightmap *lm;
+  const Map *map;
+  const Emitter *emitters;
+  // Emitters bucketed by cells of k_emitter_radius.
+  const int *cell_start;
+  const int *cell_emitters;
+  float origin_x, origin_y;
+  int cols, rows;
+  LightmapStats stats[MAX_TRACE_WORKERS];
+} TraceJob;
+
+// A point inside sector s: the first fan triangle centroid the loop
+// contains, since a concave loop's first corner can point outward.
+static bool interior_point(const Map *map, int s, Vec2 *out) {
+  const SectorLoop *loop = &map->sectors[s].loop;
+  Vec2 a = map->verts[loop->indices[0]];
+  for (int i = 1; i + 1 < loop->count; i++) {
+    Vec2 b = map->verts[loop->indices[i]];
+    Vec2 c = map->verts[loop->indices[i + 1]];
+    Vec2 p = v2((a.x + b.x + c.x) / 3.0f, (a.y + b.y + c.y) / 3.0f);
+    if (sector_loop_contains(map, loop, p)) {
+      *out = p;
+      return true;
+    }
+  }
+  return false;
+}
+
+static int clamp_cell(float v, int n) {
+  int c = (int)floorf(v);
+  return (c < 0) ? 0 : (c >= n ? n - 1 : c);
+}
+
+static float luxel_light(TraceJob *job, const LightChart *c, Vec3 p,
+                         LightmapStats *st) {
+  const Map *map = job->map;
+  const float r = k_emitter_radius;
+  float sum = k_ambient * map->sectors[c->sector].light_level;
+
+  int cx0 = clamp_cell((p.x - r - job->origin_x) / r, job->cols);
+  int cx1 = clamp_cell((p.x + r - job->origin_x) / r, job->cols);
+  int cy0 = clamp_cell((p.z - r - job->origin_y) / r, job->rows);
+  int cy1 = clamp_cell((p.z + r - job->origin_y) / r, job->rows);
+
+  for (int cy = cy0; cy <= cy1; cy++) {
+    for (int cx = cx0; cx <= cx1; cx++) {
+      int cell = cy * job->cols + cx;
+      for (int k = job->cell_start[cell]; k < job->cell_start[cell + 1];
+           k++) {
+        const Emitter *e = &job->emitters[job->cell_emitters[k]];
+        Vec3 d = v3_sub(e->pos, p);
+        float d2 = v3_len2(d);
+        if (d2 >= r * r || d2 <= 1e-8f)
+          continue;
+        float dist = sqrtf(d2);
+        float lambert = v3_dot(c->normal, d) / dist;
+        if (lambert <= 0.0f)
+          continue;
+
+        st->rays++;
+        if (!map_segment_visible(map, c->sector, v2(p.x, p.z), p.y,
+                                 v2(e->pos.x, e->pos.z), e->pos.y)) {
+          st->occluded++;
+          continue;
+        }
+        float f = 1.0f - dist / r;
+        sum += e->intensity * f * f * lambert;
+      }
+    }
+  }
+  return sum;
+}
+
+// Where luxel i of a chart side n luxels long samples its surface. Border
+// luxels repeat their interior neighbour, whose centre stays off the edge.
+static float surface_coord(int i, int n, float density, float size) {
+  int inner = (i < 1) ? 1 : (i > n - 2 ? n - 2 : i);
+  return fminf(((float)inner - 0.5f) / density, size);
+}
+
+static void trace_charts(void *ctx, int worker, int begin, int end) {
+  TraceJob *job = (TraceJob *)ctx;
+  Lightmap *lm = job->lm;
+  LightmapStats *st = &job->stats[worker];
+
+  for (int i = begin; i < end; i++) {
+    const LightChart *c = &lm->charts[i];
+    Vec3 lift = v3_mul(c->normal, k_surface_offset);
+    for (int y = 0; y < c->h; y++) {
+      float t = surface_coord(y, c->h, c->density, c->size_v);
+      uint8_t *row = lm->pixels + (size_t)(c->y + y) * lm->width + c->x;
+      for (int x = 0; x < c->w; x++) {
+        float s = surface_coord(x, c->w, c->density, c->size_u);
+        Vec3 p = v3_add(c->origin, v3_add(v3_mul(c->axis_u, s),
+                                          v3_mul(c->axis_v, t)));
+        row[x] = to_luxel(luxel_light(job, c, v3_add(p, lift), st));
+      }
+      st->luxels += c->w;
+    }
+  }
+}
+
+bool lightmap_trace(Lightmap *lm, const Map *map, int threads,
+                    LightmapStats *stats) {
+  memset(stats, 0, sizeof(*stats));
+  size_t n_sec = (size_t)map->sector_count;
+  Vec2 lo = v2(1e30f, 1e30f);
+  Vec2 hi = v2(-1e30f, -1e30f);
+  for (int i = 0; i < map->vert_count; i++) {
+    lo = v2(fminf(lo.x, map->verts[i].x), fminf(lo.y, map->verts[i].y));
+    hi = v2(fmaxf(hi.x, map->verts[i].x), fmaxf(hi.y, map->verts[i].y));
+  }
+  int cols = (int)((hi.x - lo.x) / k_emitter_radius) + 1;
+  int rows = (int)((hi.y - lo.y) / k_emitter_radius) + 1;
+  size_t cells = (size_t)cols * (size_t)rows;
+
+  TraceJob *job = (TraceJob *)mem_calloc(1, sizeof(TraceJob));
+  unsigned char *block = (unsigned char *)mem_alloc(
+      n_sec * (sizeof(Emitter) + 2 * sizeof(int)) +
+      (cells + 1) * sizeof(int));
+  if (!job || !block) {
+    mem_free(job);
+    mem_free(block);
+    return false;
+  }
+  Emitter *emitters = (Emitter *)block;
+  int *cell_emitters = (int *)(emitters + n_sec);
+  int *emitter_cell = cell_emitters + n_sec;
+  int *cell_start = emitter_cell + n_sec;
+
+  int count = 0;
+  for (int s = 0; s < map->sector_count; s++) {
+    const Sector *sec = &map->sectors[s];
+    Vec2 p;
+    if (sec->loop.count < 3 || sec->ceil_h - sec->floor_h <= 1e-3f ||
+        sec->light_level <= 0.0f || !interior_point(map, s, &p))
+      continue;
+    float y = fmaxf(sec->ceil_h - k_emitter_drop,
+                    (sec->floor_h + sec->ceil_h) * 0.5f);
+    emitters[count].pos = v3(p.x, y, p.y);
+    emitters[count].intensity = sec->light_level;
+    emitter_cell[count] =
+        clamp_cell((p.y - lo.y) / k_emitter_radius, rows) * cols +
+        clamp_cell((p.x - lo.x) / k_emitter_radius, cols);
+    count++;
+  }
+
+  // Counting sort of emitters into their cells.
+  memset(cell_start, 0, (cells + 1) * sizeof(int));
+  for (int i = 0; i < count; i++)
+    cell_start[emitter_cell[i] + 1]++;
+  for (size_t c = 0; c < cells; c++)
+    cell_start[c + 1] += cell_start[c];
+  for (int i = 0; i < count; i++)
+    cell_emitters[cell_start[emitter_cell[i]]++] = i;
+  for (size_t c = cells; c > 0; c--)
+    cell_start[c] = cell_start[c - 1];
+  cell_start[0] = 0;
+
+  job->lm = lm;
+  job->map = map;
+  job->emitters = emitters;
+  job->cell_start = cell_start;
+  job->cell_emitters = cell_emitters;
+  job->origin_x = lo.x;
+  job->origin_y = lo.y;
+  job->cols = cols;
+  job->rows = rows;
+
+  if (threads < 1)
+    threads = 1;
+  if (threads > MAX_TRACE_WORKERS)
+    threads = MAX_TRACE_WORKERS;
+  bool ok = jobs_parallel_for(lm->chart_count, 16, threads, trace_charts, job);
+
+  stats->emitters = count;
+  for (int w = 0; w < threads; w++) {
+    stats->luxels += job->stats[w].luxels;
+    stats->rays += job->stats[w].rays;
+    stats->occluded += job->stats[w].occluded;
+  }
+  mem_free(block);
+  mem_free(job);
+  return ok;
+}
+
+void lightmap_free(Lightmap *lm) {
+  if (!lm)
+    return;
+  mem_free(lm->charts);
+  mem_free(lm->block);
+  memset(lm, 0, sizeof(*lm));
+}
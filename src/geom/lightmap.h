@@ -0,0 +1,85 @@
+#ifndef LIGHTMAP_H
+#define LIGHTMAP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "../map/map.h"
+#include "../math/vec3.h"
+
+// One flat surface's rectangle in the atlas. Luxel (x + 1 + i, y + 1 + j)
+// covers surface coordinates around (i + 0.5, j + 0.5) / density along
+// axis_u and axis_v from origin; a one-luxel border keeps bilinear taps
+// inside the chart.
+typedef struct LightChart {
+  int x, y, w, h;
+  float density;
+  Vec3 origin;
+  Vec3 axis_u;
+  Vec3 axis_v;
+  float size_u;
+  float size_v;
+  // Unit normal on the lit side and the sector that side faces.
+  Vec3 normal;
+  int sector;
+} LightChart;
+
+typedef struct LightmapMark {
+  int charts;
+  int shelf_x, shelf_y, shelf_h;
+} LightmapMark;
+
+typedef struct LightmapStats {
+  int luxels;
+  int emitters;
+  int64_t rays;
+  int64_t occluded;
+} LightmapStats;
+
+// Single-channel light atlas, width * height luxels in rows. Charts are
+// shelf-packed as the mesh builders add them; pixels exist once finished.
+// Either owns its memory or is a view into a loaded package (block NULL).
+typedef struct Lightmap {
+  int width;
+  int height;
+  uint8_t *pixels;
+  float density;
+  LightChart *charts;
+  int chart_count;
+  int chart_capacity;
+  int shelf_x, shelf_y, shelf_h;
+  void *block;
+} Lightmap;
+
+// Picks luxel density and atlas width from the map's surface area.
+bool lightmap_begin(Lightmap *lm, const Map *map);
+
+// Room for `charts` charts in total, so adding up to that many cannot fail.
+bool lightmap_reserve(Lightmap *lm, int charts);
+
+// Packs a chart of c->size_u by c->size_v surface units and fills in its
+// rectangle. Returns its index, or -1 when out of memory.
+int lightmap_add_chart(Lightmap *lm, const LightChart *c);
+
+// Atlas coordinates, in luxels, of the point (s, t) on a chart.
+void lightmap_chart_uv(const Lightmap *lm, int chart, float s, float t,
+                       float *lu, float *lv);
+
+LightmapMark lightmap_mark(const Lightmap *lm);
+void lightmap_rewind(Lightmap *lm, LightmapMark mark);
+
+// Allocates the pixels for everything packed so far, all black.
+bool lightmap_finish(Lightmap *lm);
+
+// Every chart at its sector's light level: the unbaked look.
+void lightmap_fill_flat(Lightmap *lm, const Map *map);
+
+// Direct light from one emitter per sector, under its ceiling, with
+// shadows from portal walks between each luxel and each emitter in reach.
+// Charts are split across `threads` workers.
+bool lightmap_trace(Lightmap *lm, const Map *map, int threads,
+                    LightmapStats *stats);
+
+void lightmap_free(Lightmap *lm);
+
+#endif // !LIGHTMAP_H
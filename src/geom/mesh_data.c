@@ -0,0 +1,44 @@
+#include "mesh_data.h"
+
+#include <string.h>
+
+#include "../core/mem.h"
+
+bool mesh_data_init(MeshData *d, const WorldVertex *verts, int vertex_count,
+                    const uint32_t *indices, int index_count,
+                    const int *ranges, int range_count,
+                    const MeshOptStats *stats) {
+  memset(d, 0, sizeof(*d));
+  d->stats = *stats;
+
+  size_t range_bytes = (size_t)range_count * 4 * sizeof(int);
+  size_t vtx_bytes = (size_t)vertex_count * sizeof(WorldVertex);
+  size_t idx_bytes = (size_t)index_count * sizeof(uint32_t);
+  unsigned char *block =
+      (unsigned char *)mem_alloc(range_bytes + vtx_bytes + idx_bytes + 1);
+  if (!block)
+    return false;
+
+  d->block = block;
+  d->sector_first = (int *)block;
+  d->sector_count = d->sector_first + range_count;
+  d->lod_first = d->sector_count + range_count;
+  d->lod_count = d->lod_first + range_count;
+  d->verts = (WorldVertex *)(block + range_bytes);
+  d->indices = (uint32_t *)(block + range_bytes + vtx_bytes);
+  d->vertex_count = vertex_count;
+  d->index_count = index_count;
+  d->range_count = range_count;
+
+  memcpy(d->sector_first, ranges, range_bytes);
+  memcpy(d->verts, verts, vtx_bytes);
+  memcpy(d->indices, indices, idx_bytes);
+  return true;
+}
+
+void mesh_data_free(MeshData *d) {
+  if (!d)
+    return;
+  mem_free(d->block);
+  memset(d, 0, sizeof(*d));
+}
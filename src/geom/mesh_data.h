@@ -0,0 +1,44 @@
+#ifndef MESH_DATA_H
+#define MESH_DATA_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "mesh_opt.h"
+
+// GPU vertex layout shared by the floor and wall meshes (world.vert);
+// (lu, lv) is the lightmap position in luxels.
+typedef struct WorldVertex {
+  float px, py, pz;
+  float cr, cg, cb;
+  float u, v;
+  float lu, lv;
+} WorldVertex;
+
+// CPU side of an indexed world mesh, grouped by sector: sector s owns
+// indices [sector_first[s], sector_first[s] + sector_count[s]) and its LOD
+// [lod_first[s], lod_first[s] + lod_count[s]). Either owns one block (baked
+// here) or is a view into a loaded package (block NULL).
+typedef struct MeshData {
+  WorldVertex *verts;
+  int vertex_count;
+  uint32_t *indices;
+  int index_count;
+  int range_count;
+  int *sector_first;
+  int *sector_count;
+  int *lod_first;
+  int *lod_count;
+  MeshOptStats stats;
+  void *block;
+} MeshData;
+
+// Copies the welded arrays and the 4 * range_count range ints (first,
+// count, lod first, lod count) into one block.
+bool mesh_data_init(MeshData *d, const WorldVertex *verts, int vertex_count,
+                    const uint32_t *indices, int index_count,
+                    const int *ranges, int range_count,
+                    const MeshOptStats *stats);
+void mesh_data_free(MeshData *d);
+
+#endif // !MESH_DATA_H
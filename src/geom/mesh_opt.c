@@ -0,0 +1,259 @@
+#include "mesh_opt.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../core/mem.h"
+
+enum { CACHE_SIZE = 32 };
+
+static uint32_t hash_bytes(const unsigned char *p, size_t n) {
+  uint32_t h = 2166136261u;
+  for (size_t i = 0; i < n; i++)
+    h = (h ^ p[i]) * 16777619u;
+  return h;
+}
+
+int mesh_weld(void *verts, int count, size_t stride, uint32_t *indices) {
+  size_t slots = 16;
+  while (slots < (size_t)count * 2)
+    slots <<= 1;
+
+  MemTemp temp;
+  if (!mem_temp_begin(&temp, slots * sizeof(int)))
+    return -1;
+  int *table = (int *)temp.ptr;
+  memset(table, 0xff, slots * sizeof(int));
+
+  unsigned char *base = (unsigned char *)verts;
+  int unique = 0;
+  for (int i = 0; i < count; i++) {
+    const unsigned char *v = base + (size_t)i * stride;
+    size_t at = hash_bytes(v, stride) & (slots - 1);
+    while (table[at] >= 0 &&
+           memcmp(base + (size_t)table[at] * stride, v, stride) != 0)
+      at = (at + 1) & (slots - 1);
+
+    if (table[at] < 0) {
+      if (unique != i)
+        memcpy(base + (size_t)unique * stride, v, stride);
+      table[at] = unique++;
+    }
+    indices[i] = (uint32_t)table[at];
+  }
+
+  mem_temp_end(&temp);
+  return unique;
+}
+
+static float vertex_score(int cache_pos, int live) {
+  if (live <= 0)
+    return -1.0f;
+
+  float s = 0.0f;
+  if (cache_pos >= 0) {
+    // The last triangle's vertices get a fixed score so the next triangle
+    // is not biased towards any one of them.
+    if (cache_pos < 3)
+      s = 0.75f;
+    else
+      s = powf(1.0f - (float)(cache_pos - 3) / (float)(CACHE_SIZE - 3),
+               1.5f);
+  }
+  // Vertices with few triangles left are finished off first.
+  return s + 2.0f / sqrtf((float)live);
+}
+
+typedef struct ForsythScratch {
+  int *live;
+  int *cache_pos;
+  float *score;
+  int *adj_start;
+  int *adj;
+  float *tri_score;
+  uint8_t *emitted;
+  uint32_t *out;
+} ForsythScratch;
+
+static float tri_score(const ForsythScratch *f, const uint32_t *idx, int t) {
+  return f->score[idx[t * 3]] + f->score[idx[t * 3 + 1]] +
+         f->score[idx[t * 3 + 2]];
+}
+
+static void optimize_range(ForsythScratch *f, uint32_t *idx, int t0,
+                           int t1) {
+  for (int t = t0; t < t1; t++) {
+    for (int k = 0; k < 3; k++)
+      f->live[idx[t * 3 + k]]++;
+  }
+  for (int t = t0; t < t1; t++) {
+    for (int k = 0; k < 3; k++) {
+      uint32_t v = idx[t * 3 + k];
+      f->score[v] = vertex_score(-1, f->live[v]);
+    }
+  }
+  for (int t = t0; t < t1; t++)
+    f->tri_score[t] = tri_score(f, idx, t);
+
+  int cache[CACHE_SIZE + 3];
+  int cache_len = 0;
+  int cursor = t0;
+  int best = -1;
+  int written = 0;
+
+  for (int done = t0; done < t1; done++) {
+    if (best < 0) {
+      while (f->emitted[cursor])
+        cursor++;
+      best = cursor;
+    }
+
+    const uint32_t *tri = &idx[best * 3];
+    f->emitted[best] = 1;
+    for (int k = 0; k < 3; k++) {
+      f->out[written++] = tri[k];
+      f->live[tri[k]]--;
+    }
+
+    // Most recent first: the new triangle, then the survivors.
+    int next[CACHE_SIZE + 3];
+    int next_len = 0;
+    for (int k = 0; k < 3; k++) {
+      bool dup = false;
+      for (int j = 0; j < next_len; j++)
+        dup = dup || next[j] == (int)tri[k];
+      if (!dup)
+        next[next_len++] = (int)tri[k];
+    }
+    for (int j = 0; j < cache_len; j++) {
+      int v = cache[j];
+      if (v != (int)tri[0] && v != (int)tri[1] && v != (int)tri[2])
+        next[next_len++] = v;
+    }
+
+    best = -1;
+    float best_score = -1.0f;
+    for (int j = 0; j < next_len; j++) {
+      int v = next[j];
+      f->cache_pos[v] = (j < CACHE_SIZE) ? j : -1;
+      f->score[v] = vertex_score(f->cache_pos[v], f->live[v]);
+
+      for (int a = f->adj_start[v]; a < f->adj_start[v + 1]; a++) {
+        int t = f->adj[a];
+        if (t < t0 || t >= t1 || f->emitted[t])
+          continue;
+        f->tri_score[t] = tri_score(f, idx, t);
+        if (f->tri_score[t] > best_score) {
+          best_score = f->tri_score[t];
+          best = t;
+        }
+      }
+    }
+
+    cache_len = (next_len < CACHE_SIZE) ? next_len : CACHE_SIZE;
+    memcpy(cache, next, (size_t)cache_len * sizeof(int));
+  }
+
+  for (int j = 0; j < cache_len; j++)
+    f->cache_pos[cache[j]] = -1;
+  memcpy(idx + (size_t)t0 * 3, f->out, (size_t)written * sizeof(uint32_t));
+}
+
+bool mesh_optimize_ranges(uint32_t *indices, int index_count,
+                          int vertex_count, const int *first,
+                          const int *count, int ranges) {
+  int tris = index_count / 3;
+  int longest = 0;
+  for (int r = 0; r < ranges; r++)
+    longest = (count[r] > longest) ? count[r] : longest;
+
+  size_t v = (size_t)vertex_count;
+  size_t t = (size_t)tris;
+  size_t bytes = v * 3 * sizeof(int) + (v + 1) * sizeof(int) +
+                 t * 3 * sizeof(int) + t * sizeof(float) + t +
+                 (size_t)longest * sizeof(uint32_t) + 64;
+  MemTemp temp;
+  if (!mem_temp_begin(&temp, bytes))
+    return false;
+
+  ForsythScratch f;
+  unsigned char *p = (unsigned char *)temp.ptr;
+  f.live = (int *)p;
+  f.cache_pos = f.live + v;
+  f.score = (float *)(f.cache_pos + v);
+  f.adj_start = (int *)(f.score + v);
+  f.adj = f.adj_start + v + 1;
+  f.tri_score = (float *)(f.adj + t * 3);
+  f.out = (uint32_t *)(f.tri_score + t);
+  f.emitted = (uint8_t *)(f.out + longest);
+
+  memset(f.live, 0, v * sizeof(int));
+  memset(f.cache_pos, 0xff, v * sizeof(int));
+  memset(f.adj_start, 0, (v + 1) * sizeof(int));
+  memset(f.emitted, 0, t);
+
+  // Vertex to triangle lists, counted then filled back to front.
+  for (size_t i = 0; i < t * 3; i++)
+    f.adj_start[indices[i] + 1]++;
+  for (size_t i = 0; i < v; i++)
+    f.adj_start[i + 1] += f.adj_start[i];
+  for (size_t i = 0; i < v; i++)
+    f.live[i] = f.adj_start[i + 1];
+  for (size_t i = t * 3; i-- > 0;)
+    f.adj[--f.live[indices[i]]] = (int)(i / 3);
+  memset(f.live, 0, v * sizeof(int));
+
+  for (int r = 0; r < ranges; r++) {
+    if (count[r] >= 3)
+      optimize_range(&f, indices, first[r] / 3, (first[r] + count[r]) / 3);
+  }
+
+  mem_temp_end(&temp);
+  return true;
+}
+
+float mesh_acmr(const uint32_t *indices, int index_count, int vertex_count) {
+  if (index_count < 3)
+    return 0.0f;
+
+  MemTemp temp;
+  if (!mem_temp_begin(&temp, (size_t)vertex_count * sizeof(int)))
+    return 0.0f;
+  int *stamp = (int *)temp.ptr;
+  for (int i = 0; i < vertex_count; i++)
+    stamp[i] = -MESH_OPT_FIFO_SIZE - 1;
+
+  int misses = 0;
+  for (int i = 0; i < index_count; i++) {
+    uint32_t v = indices[i];
+    if (misses - stamp[v] > MESH_OPT_FIFO_SIZE) {
+      stamp[v] = misses;
+      misses++;
+    }
+  }
+
+  mem_temp_end(&temp);
+  return (float)misses / (float)(index_count / 3);
+}
+
+int mesh_opt_index(void *verts, int count, size_t stride, uint32_t *indices,
+                   const int *first, const int *counts, int ranges,
+                   MeshOptStats *stats) {
+  int unique = mesh_weld(verts, count, stride, indices);
+  if (unique < 0)
+    return -1;
+
+  stats->verts_after = unique;
+  stats->acmr_before = mesh_acmr(indices, count, unique);
+  if (!mesh_optimize_ranges(indices, count, unique, first, counts, ranges))
+    return -1;
+  stats->acmr_after = mesh_acmr(indices, count, unique);
+  return unique;
+}
+
+void mesh_opt_report(const char *label, const MeshOptStats *s) {
+  printf("%s: %d -> %d triangles, %d -> %d vertices, ACMR %.3f -> %.3f\n",
+         label, s->tris_before, s->tris_after, s->verts_before,
+         s->verts_after, s->acmr_before, s->acmr_after);
+}
@@ -0,0 +1,45 @@
+#ifndef MESH_OPT_H
+#define MESH_OPT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Before/after counts for one mesh. Before is the unmerged, unindexed
+// triangle list; ACMR (vertex shader runs per triangle) is simulated on a
+// FIFO cache of MESH_OPT_FIFO_SIZE entries.
+typedef struct MeshOptStats {
+  int tris_before;
+  int tris_after;
+  int verts_before;
+  int verts_after;
+  float acmr_before;
+  float acmr_after;
+} MeshOptStats;
+
+enum { MESH_OPT_FIFO_SIZE = 16 };
+
+// Collapses bit-identical vertices of a triangle list in place. On return
+// the first (returned) vertices are distinct and indices[i] names the
+// survivor of input vertex i. Returns -1 when out of memory.
+int mesh_weld(void *verts, int count, size_t stride, uint32_t *indices);
+
+// Reorders the triangles inside each index range [first[r], first[r] +
+// count[r]) for the post-transform vertex cache using Forsyth's linear-speed
+// algorithm. Triangles never move between ranges.
+bool mesh_optimize_ranges(uint32_t *indices, int index_count,
+                          int vertex_count, const int *first,
+                          const int *count, int ranges);
+
+float mesh_acmr(const uint32_t *indices, int index_count, int vertex_count);
+
+// Welds a triangle list of count vertices into verts/indices, then
+// cache-orders every range. Fills verts_after and both ACMR figures of
+// stats. Returns the welded vertex count, or -1 when out of memory.
+int mesh_opt_index(void *verts, int count, size_t stride, uint32_t *indices,
+                   const int *first, const int *counts, int ranges,
+                   MeshOptStats *stats);
+
+void mesh_opt_report(const char *label, const MeshOptStats *s);
+
+#endif // !MESH_OPT_H
@@ -1,14 +1,12 @@
 #include "sector_mesh.h"
 
-#include <stdlib.h>
+#include <math.h>
 #include <string.h>
 
-typedef struct Vtx {
-  float px, py, pz;
-  float cr, cg, cb;
-  float u, v;
-  float light;
-} Vtx;
+// Largest distance a dropped floor vertex may lie from the simplified edge.
+static const float k_lod_tolerance = 0.05f;
+
+typedef WorldVertex Vtx;
 
 static void push_tri(Vtx *dst, int *at, Vtx a, Vtx b, Vtx c) {
   dst[(*at)++] = a;
@@ -16,117 +14,195 @@ static void push_tri(Vtx *dst, int *at, Vtx a, Vtx b, Vtx c) {
   dst[(*at)++] = c;
 }
 
-bool sector_mesh_build(SectorMesh *out, const Map *map) {
+static Vtx fan_vertex(const Lightmap *lm, int chart, Vec2 p, float h,
+                      float r, float g, float b) {
+  const LightChart *c = &lm->charts[chart];
+  Vtx v = {p.x, h, p.y, r, g, b, p.x, p.y, 0.0f, 0.0f};
+  lightmap_chart_uv(lm, chart, p.x - c->origin.x, p.y - c->origin.z, &v.lu,
+                    &v.lv);
+  return v;
+}
+
+// Floor and ceiling fans over the loop indices idx[0..n), lit through the
+// sector's floor and ceiling charts.
+static void add_fans(const Map *map, const Sector *sec, const int *idx, int n,
+                     const Lightmap *lm, int floor_chart, Vtx *verts,
+                     int *at) {
+  Vec2 p0_2 = map->verts[idx[0]];
+  int ceil_chart = floor_chart + 1;
+
+  for (int i = 1; i < n - 1; i++) {
+    Vec2 p1_2 = map->verts[idx[i]];
+    Vec2 p2_2 = map->verts[idx[i + 1]];
+
+    Vtx f0 = fan_vertex(lm, floor_chart, p0_2, sec->floor_h, 0.2f, 0.8f, 0.2f);
+    Vtx f1 = fan_vertex(lm, floor_chart, p1_2, sec->floor_h, 0.2f, 0.8f, 0.2f);
+    Vtx f2 = fan_vertex(lm, floor_chart, p2_2, sec->floor_h, 0.2f, 0.8f, 0.2f);
+
+    Vtx c0 = fan_vertex(lm, ceil_chart, p0_2, sec->ceil_h, 0.2f, 0.2f, 0.8f);
+    Vtx c1 = fan_vertex(lm, ceil_chart, p1_2, sec->ceil_h, 0.2f, 0.2f, 0.8f);
+    Vtx c2 = fan_vertex(lm, ceil_chart, p2_2, sec->ceil_h, 0.2f, 0.2f, 0.8f);
+
+    push_tri(verts, at, f0, f1, f2);
+    push_tri(verts, at, c2, c1, c0);
+  }
+}
+
+// Adds the floor chart and, right after it, the ceiling chart over the
+// loop's box. Returns the floor chart, or -1.
+static int add_charts(const Map *map, int s, Lightmap *lm) {
+  const Sector *sec = &map->sectors[s];
+  const SectorLoop *loop = &sec->loop;
+  Vec2 lo = map->verts[loop->indices[0]];
+  Vec2 hi = lo;
+  for (int i = 1; i < loop->count; i++) {
+    Vec2 p = map->verts[loop->indices[i]];
+    lo = v2(fminf(lo.x, p.x), fminf(lo.y, p.y));
+    hi = v2(fmaxf(hi.x, p.x), fmaxf(hi.y, p.y));
+  }
+
+  LightChart c = {0};
+  c.origin = v3(lo.x, sec->floor_h, lo.y);
+  c.axis_u = v3(1.0f, 0.0f, 0.0f);
+  c.axis_v = v3(0.0f, 0.0f, 1.0f);
+  c.size_u = hi.x - lo.x;
+  c.size_v = hi.y - lo.y;
+  c.normal = v3(0.0f, 1.0f, 0.0f);
+  c.sector = s;
+  int floor_chart = lightmap_add_chart(lm, &c);
+
+  c.origin.y = sec->ceil_h;
+  c.normal = v3(0.0f, -1.0f, 0.0f);
+  if (floor_chart < 0 || lightmap_add_chart(lm, &c) < 0)
+    return -1;
+  return floor_chart;
+}
+
+static bool within_tolerance(Vec2 a, Vec2 b, Vec2 p) {
+  Vec2 ab = v2_sub(b, a);
+  Vec2 ap = v2_sub(p, a);
+  float len2 = v2_len2(ab);
+  if (len2 <= 1e-12f)
+    return false;
+  float t = v2_dot(ap, ab) / len2;
+  float cross = ab.x * ap.y - ab.y * ap.x;
+  return t >= 0.0f && t <= 1.0f &&
+         cross * cross <= k_lod_tolerance * k_lod_tolerance * len2;
+}
+
+// Drops loop vertices that lie within k_lod_tolerance of the edge joining
+// their kept neighbours. Returns the kept count.
+static int simplify_loop(const Map *map, const SectorLoop *loop, int *out) {
+  const int n = loop->count;
+  int kept = 0;
+  int last = 0;
+  out[kept++] = loop->indices[0];
+
+  for (int i = 1; i < n; i++) {
+    Vec2 a = map->verts[loop->indices[last]];
+    Vec2 b = map->verts[loop->indices[(i + 1) % n]];
+    bool drop = true;
+    // Every vertex dropped since the last kept one must stay in tolerance.
+    for (int j = last + 1; drop && j <= i; j++)
+      drop = within_tolerance(a, b, map->verts[loop->indices[j]]);
+    if (!drop) {
+      out[kept++] = loop->indices[i];
+      last = i;
+    }
+  }
+  return kept;
+}
+
+bool sector_mesh_bake(MeshData *out, const Map *map, Lightmap *lm) {
   memset(out, 0, sizeof(*out));
   if (!map || map->sector_count <= 0)
     return false;
 
   int total_tris = 0;
+  int max_loop = 0;
   for (int s = 0; s < map->sector_count; s++) {
     int n = map->sectors[s].loop.count;
+    if (n > max_loop)
+      max_loop = n;
     if (n < 3)
       continue;
     total_tris += (n - 2) * 2;
   }
-  int total_vtx = total_tris * 3;
-
-  Vtx *verts = (Vtx *)malloc((size_t)total_vtx * sizeof(Vtx));
-  if (!verts)
+  // Room for the full mesh and a LOD mesh that is never larger.
+  int total_vtx = total_tris * 3 * 2;
+
+  MemTemp temp;
+  size_t n_sec = (size_t)map->sector_count;
+  size_t vtx_bytes = (size_t)total_vtx * sizeof(Vtx);
+  size_t idx_bytes = (size_t)total_vtx * sizeof(uint32_t);
+  if (!mem_temp_begin(&temp, vtx_bytes + idx_bytes +
+                                 (n_sec * 9 + (size_t)max_loop) *
+                                     sizeof(int)))
     return false;
+  Vtx *verts = (Vtx *)temp.ptr;
+  uint32_t *indices = (uint32_t *)((unsigned char *)temp.ptr + vtx_bytes);
+  int *first = (int *)(indices + total_vtx);
+  int *count = first + n_sec;
+  int *lod_first = count + n_sec;
+  int *lod_count = lod_first + n_sec;
+  int *opt_first = lod_count + n_sec;
+  int *opt_count = opt_first + n_sec * 2;
+  int *lod_loop = opt_count + n_sec * 2;
+  int *charts = lod_loop + max_loop;
 
   int at = 0;
 
   for (int s = 0; s < map->sector_count; s++) {
     const Sector *sec = &map->sectors[s];
     const int n = sec->loop.count;
+    first[s] = at;
+    count[s] = 0;
     if (n < 3)
       continue;
-
-    int i0 = sec->loop.indices[0];
-    Vec2 p0_2 = map->verts[i0];
-
-    for (int i = 1; i < n - 1; i++) {
-      int i1 = sec->loop.indices[i];
-      int i2 = sec->loop.indices[i + 1];
-
-      Vec2 p1_2 = map->verts[i1];
-      Vec2 p2_2 = map->verts[i2];
-
-      Vtx f0 = {p0_2.x, sec->floor_h, p0_2.y,          0.2f, 0.8f, 0.2f,
-                p0_2.x, p0_2.y,       sec->light_level};
-      Vtx f1 = {p1_2.x, sec->floor_h, p1_2.y,          0.2f, 0.8f, 0.2f,
-                p1_2.x, p1_2.y,       sec->light_level};
-      Vtx f2 = {p2_2.x, sec->floor_h, p2_2.y,          0.2f, 0.8f, 0.2f,
-                p2_2.x, p2_2.y,       sec->light_level};
-
-      Vtx c0 = {p0_2.x, sec->ceil_h, p0_2.y,          0.2f, 0.2f, 0.8f,
-                p0_2.x, p0_2.y,      sec->light_level};
-      Vtx c1 = {p1_2.x, sec->ceil_h, p1_2.y,          0.2f, 0.2f, 0.8f,
-                p1_2.x, p1_2.y,      sec->light_level};
-      Vtx c2 = {p2_2.x, sec->ceil_h, p2_2.y,          0.2f, 0.2f, 0.8f,
-                p2_2.x, p2_2.y,      sec->light_level};
-
-      push_tri(verts, &at, f0, f1, f2);
-      push_tri(verts, &at, c2, c1, c0);
+    charts[s] = add_charts(map, s, lm);
+    if (charts[s] < 0) {
+      mem_temp_end(&temp);
+      return false;
     }
+    add_fans(map, sec, sec->loop.indices, n, lm, charts[s], verts, &at);
+    count[s] = at - first[s];
   }
+  int full = at;
 
-  glGenVertexArrays(1, &out->vao);
-  glGenBuffers(1, &out->vbo);
-
-  glBindVertexArray(out->vao);
-  glBindBuffer(GL_ARRAY_BUFFER, out->vbo);
-  glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)(at * (int)sizeof(Vtx)), verts,
-               GL_STATIC_DRAW);
-
-  GLsizei stride = (GLsizei)sizeof(Vtx);
-  glEnableVertexAttribArray(0);
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void *)0);
-
-  glEnableVertexAttribArray(1);
-  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride,
-                        (void *)(3 * sizeof(float)));
-
-  glEnableVertexAttribArray(2);
-  glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride,
-                        (void *)(6 * sizeof(float)));
-
-  glEnableVertexAttribArray(3);
-  glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, stride,
-                        (void *)(8 * sizeof(float)));
-
-  glBindBuffer(GL_ARRAY_BUFFER, 0);
-  glBindVertexArray(0);
-
-  free(verts);
-
-  out->vertex_count = at;
-  return true;
-}
-
-void sector_mesh_destroy(SectorMesh *m) {
-  if (!m)
-    return;
-
-  if (m->vbo)
-    glDeleteBuffers(1, &m->vbo);
-  if (m->vao)
-    glDeleteVertexArrays(1, &m->vao);
-
-  memset(m, 0, sizeof(*m));
-}
-
-void sector_mesh_draw(const SectorMesh *m, GLuint program, GLint u_viewProj) {
-  if (!m || m->vao == 0 || m->vertex_count <= 0)
-    return;
-
-  glUseProgram(program);
-  glUniformMatrix4fv(u_viewProj, 1, GL_FALSE, m4_identity().m);
-  (void)u_viewProj;
+  for (int s = 0; s < map->sector_count; s++) {
+    const Sector *sec = &map->sectors[s];
+    lod_first[s] = at;
+    lod_count[s] = 0;
+    if (sec->loop.count < 3)
+      continue;
+    int n = simplify_loop(map, &sec->loop, lod_loop);
+    if (n < 3 || n == sec->loop.count) {
+      lod_first[s] = first[s];
+      lod_count[s] = count[s];
+      continue;
+    }
+    add_fans(map, sec, lod_loop, n, lm, charts[s], verts, &at);
+    lod_count[s] = at - lod_first[s];
+  }
 
-  glBindVertexArray(m->vao);
-  glDrawArrays(GL_TRIANGLES, 0, m->vertex_count);
-  glBindVertexArray(0);
+  // Aliased LOD ranges are the full ranges, already in the list once.
+  for (size_t i = 0; i < n_sec; i++) {
+    bool alias = lod_first[i] == first[i];
+    opt_first[i] = first[i];
+    opt_count[i] = count[i];
+    opt_first[n_sec + i] = lod_first[i];
+    opt_count[n_sec + i] = alias ? 0 : lod_count[i];
+  }
 
-  glUseProgram(0);
+  MeshOptStats stats = {0};
+  stats.tris_before = full / 3;
+  stats.tris_after = full / 3;
+  stats.verts_before = full;
+
+  int unique = mesh_opt_index(verts, at, sizeof(Vtx), indices, opt_first,
+                              opt_count, (int)n_sec * 2, &stats);
+  bool ok = unique >= 0 && mesh_data_init(out, verts, unique, indices, at,
+                                          first, (int)n_sec, &stats);
+  mem_temp_end(&temp);
+  return ok;
 }
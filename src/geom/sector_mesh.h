@@ -1,21 +1,16 @@
 #ifndef SECTOR_MESH_H
 #define SECTOR_MESH_H
 
-#include <glad/glad.h>
 #include <stdbool.h>
 
 #include "../map/map.h"
-#include "../math/mat4.h"
+#include "lightmap.h"
+#include "mesh_data.h"
 
-typedef struct SectorMesh {
-  GLuint vao;
-  GLuint vbo;
-  int vertex_count;
-} SectorMesh;
-
-bool sector_mesh_build(SectorMesh *out, const Map *map);
-void sector_mesh_destroy(SectorMesh *m);
-
-void sector_mesh_draw(const SectorMesh*m, GLuint program, GLint u_viewProj);
+// Floor and ceiling fans per sector over welded, cache-ordered vertices.
+// The LOD ranges hold a coarser triangulation with near-collinear loop
+// vertices dropped, or alias the full range when nothing could be removed.
+// Each sector packs a floor and a ceiling chart into lm, shared by both.
+bool sector_mesh_bake(MeshData *out, const Map *map, Lightmap *lm);
 
 #endif // !SECTOR_MESH_H
@@ -1,14 +1,14 @@
 #include "wall_mesh.h"
 
-#include <stdlib.h>
+#include <math.h>
 #include <string.h>
 
-typedef struct Vtx {
-  float px, py, pz;
-  float cr, cg, cb;
-  float u, v;
-  float light;
-} Vtx;
+// Largest distance a merged joint may lie from its run's chord: exact
+// merges for the full mesh, a visible but fogged bend for the LOD mesh.
+static const float k_merge_tolerance = 1e-4f;
+static const float k_lod_tolerance = 0.05f;
+
+typedef WorldVertex Vtx;
 
 static void push_tri(Vtx *dst, int *at, Vtx a, Vtx b, Vtx c) {
   dst[(*at)++] = a;
@@ -21,110 +21,274 @@ static void push_quad(Vtx *dst, int *at, Vtx a, Vtx b, Vtx c, Vtx d) {
   push_tri(dst, at, a, c, d);
 }
 
-static void add_wall_segment(Vtx *verts, int *at, float x0, float z0, float x1,
-                             float z1, float y0, float y1, float u0, float u1,
-                             float r, float g, float b, float light) {
-  Vtx a = {x0, y0, z0, r, g, b, u0, y0, light};
-  Vtx b0 = {x1, y0, z1, r, g, b, u1, y0, light};
-  Vtx c = {x1, y1, z1, r, g, b, u1, y1, light};
-  Vtx d = {x0, y1, z0, r, g, b, u0, y1, light};
-  push_quad(verts, at, a, b0, c, d);
+// One quad from p0 to p1 between heights y0 and y1, lit through a new
+// chart on the side facing `sector`, the line's front sector or not.
+static void add_wall_segment(Vtx *verts, int *at, Lightmap *lm, int sector,
+                             bool faces_front, Vec2 p0, Vec2 p1, float y0,
+                             float y1, float u0, float u1, float r, float g,
+                             float b) {
+  Vec2 d = v2_sub(p1, p0);
+  float len = v2_len(d);
+  Vec2 dir = v2_mul(d, 1.0f / len);
+  // The line normal points away from the front sector.
+  float side = faces_front ? -1.0f : 1.0f;
+
+  LightChart c = {0};
+  c.origin = v3(p0.x, y0, p0.y);
+  c.axis_u = v3(dir.x, 0.0f, dir.y);
+  c.axis_v = v3(0.0f, 1.0f, 0.0f);
+  c.size_u = len;
+  c.size_v = y1 - y0;
+  c.normal = v3(dir.y * side, 0.0f, -dir.x * side);
+  c.sector = sector;
+  int chart = lightmap_add_chart(lm, &c);
+
+  Vtx a = {p0.x, y0, p0.y, r, g, b, u0, y0, 0.0f, 0.0f};
+  Vtx b0 = {p1.x, y0, p1.y, r, g, b, u1, y0, 0.0f, 0.0f};
+  Vtx c0 = {p1.x, y1, p1.y, r, g, b, u1, y1, 0.0f, 0.0f};
+  Vtx d0 = {p0.x, y1, p0.y, r, g, b, u0, y1, 0.0f, 0.0f};
+  lightmap_chart_uv(lm, chart, 0.0f, 0.0f, &a.lu, &a.lv);
+  lightmap_chart_uv(lm, chart, len, 0.0f, &b0.lu, &b0.lv);
+  lightmap_chart_uv(lm, chart, len, c.size_v, &c0.lu, &c0.lv);
+  lightmap_chart_uv(lm, chart, 0.0f, c.size_v, &d0.lu, &d0.lv);
+  push_quad(verts, at, a, b0, c0, d0);
 }
 
-bool wall_mesh_build(WallMesh *out, const Map *map) {
-  memset(out, 0, sizeof(*out));
-  if (!map || map->line_count <= 0)
-    return false;
+// Walls of line i from p0 to p1; u runs from 0 to len along them. Steps face
+// the lower floor and the higher ceiling.
+static void add_line_walls(const Map *map, int i, Vec2 p0, Vec2 p1, float len,
+                           Lightmap *lm, Vtx *verts, int *at) {
+  const Linedef *l = &map->lines[i];
 
-  int max_quads = map->line_count * 2;
-  int max_vtx = max_quads * 6;
+  float u0 = 0.0f;
+  float u1 = len;
 
-  Vtx *verts = (Vtx *)malloc((size_t)max_vtx * sizeof(Vtx));
-  if (!verts)
+  const Sector *sf = &map->sectors[l->front_sector];
+
+  if (l->back_sector < 0) {
+    add_wall_segment(verts, at, lm, l->front_sector, true, p0, p1,
+                     sf->floor_h, sf->ceil_h, u0, u1, 0.8f, 0.8f, 0.8f);
+  } else {
+    const Sector *sb = &map->sectors[l->back_sector];
+
+    float f0 = sf->floor_h;
+    float c0 = sf->ceil_h;
+    float f1 = sb->floor_h;
+    float c1 = sb->ceil_h;
+
+    float low_top = (f0 > f1) ? f0 : f1;
+    float low_bot = (f0 < f1) ? f0 : f1;
+    if (low_top - low_bot > 0.0001f) {
+      bool front = f0 < f1;
+      add_wall_segment(verts, at, lm,
+                       front ? l->front_sector : l->back_sector, front, p0,
+                       p1, low_bot, low_top, u0, u1, 0.7f, 0.5f, 0.2f);
+    }
+
+    float up_top = (c0 > c1) ? c0 : c1;
+    float up_bot = (c0 < c1) ? c0 : c1;
+    if (up_top - up_bot > 0.0001f) {
+      bool front = c0 > c1;
+      add_wall_segment(verts, at, lm,
+                       front ? l->front_sector : l->back_sector, front, p0,
+                       p1, up_bot, up_top, u0, u1, 0.2f, 0.6f, 0.8f);
+    }
+  }
+}
+
+enum { RUN_USED = 1, RUN_HAS_PREV = 2 };
+
+static int line_pieces(const Map *map, int i) {
+  const Linedef *l = &map->lines[i];
+  if (l->back_sector < 0)
+    return 1;
+  const Sector *sf = &map->sectors[l->front_sector];
+  const Sector *sb = &map->sectors[l->back_sector];
+  return (fabsf(sf->floor_h - sb->floor_h) > 0.0001f) +
+         (fabsf(sf->ceil_h - sb->ceil_h) > 0.0001f);
+}
+
+// True when line b starts where line a ends and produces the same wall
+// pieces: same front sector, back sectors with the same heights.
+static bool same_profile(const Map *map, int a, int b) {
+  const Linedef *la = &map->lines[a];
+  const Linedef *lb = &map->lines[b];
+  if (la->v1 != lb->v0 || la->front_sector != lb->front_sector)
     return false;
 
-  int at = 0;
+  if ((la->back_sector < 0) != (lb->back_sector < 0))
+    return false;
+  if (la->back_sector >= 0 && la->back_sector != lb->back_sector) {
+    const Sector *sa = &map->sectors[la->back_sector];
+    const Sector *sb = &map->sectors[lb->back_sector];
+    if (sa->floor_h != sb->floor_h || sa->ceil_h != sb->ceil_h)
+      return false;
+  }
+  return true;
+}
 
-  for (int i = 0; i < map->line_count; i++) {
-    const Linedef *l = &map->lines[i];
+// p lies on the chord a-b, between its ends and within tol of it.
+static bool near_chord(Vec2 a, Vec2 b, Vec2 p, float tol) {
+  Vec2 ab = v2_sub(b, a);
+  Vec2 ap = v2_sub(p, a);
+  float len2 = v2_len2(ab);
+  if (len2 <= 1e-12f)
+    return false;
+  float t = v2_dot(ap, ab) / len2;
+  float cross = ab.x * ap.y - ab.y * ap.x;
+  return t > 0.0f && t < 1.0f && cross * cross <= tol * tol * len2;
+}
 
-    const Vec2 p0 = map->verts[l->v0];
-    const Vec2 p1 = map->verts[l->v1];
+// Finds an unused line of sector s that continues line i, or -1.
+static int next_in_run(const Map *map, int s, int i, const uint8_t *flags) {
+  for (int k = map->sector_line_start[s]; k < map->sector_line_start[s + 1];
+       k++) {
+    int j = map->sector_lines[k];
+    if (j != i && !(flags[j] & RUN_USED) && same_profile(map, i, j))
+      return j;
+  }
+  return -1;
+}
 
-    float dx = p1.x - p0.x;
-    float dy = p1.y - p0.y;
-    float wall_len = sqrtf(dx * dx + dy * dy);
-    float u0 = 0.0f;
-    float u1 = wall_len;
+// Grows a run from line first while every joint stays within tol of the
+// chord from its start to its end, then emits it as one quad per wall piece
+// with u running over the summed length. Returns the last line of the run.
+static int add_run(const Map *map, int s, int first, float tol,
+                   uint8_t *flags, int *run, Lightmap *lm, Vtx *verts,
+                   int *at) {
+  Vec2 a = map->verts[map->lines[first].v0];
+  float len = map->linetab.len[first];
+  int n = 0;
+  run[n++] = first;
+  flags[first] |= RUN_USED;
 
-    const Sector *sf = &map->sectors[l->front_sector];
+  for (;;) {
+    int j = next_in_run(map, s, run[n - 1], flags);
+    if (j < 0)
+      break;
+    Vec2 b = map->verts[map->lines[j].v1];
+    bool ok = true;
+    for (int r = 0; ok && r < n; r++)
+      ok = near_chord(a, b, map->verts[map->lines[run[r]].v1], tol);
+    if (!ok)
+      break;
+    run[n++] = j;
+    flags[j] |= RUN_USED;
+    len += map->linetab.len[j];
+  }
 
-    if (l->back_sector < 0) {
-      add_wall_segment(verts, &at, p0.x, p0.y, p1.x, p1.y, sf->floor_h,
-                       sf->ceil_h, u0, u1, 0.8f, 0.8f, 0.8f, sf->light_level);
-    } else {
-      const Sector *sb = &map->sectors[l->back_sector];
+  int last = run[n - 1];
+  add_line_walls(map, first, a, map->verts[map->lines[last].v1], len, lm,
+                 verts, at);
+  return last;
+}
 
-      float f0 = sf->floor_h;
-      float c0 = sf->ceil_h;
-      float f1 = sb->floor_h;
-      float c1 = sb->ceil_h;
+// Walls of sector s with runs merged under tol. Runs start at lines with no
+// mergeable predecessor; a run that breaks continues from the breaking line.
+// Anything left over lies on a closed run and starts anywhere.
+static void add_sector_walls(const Map *map, int s, float tol, uint8_t *flags,
+                             int *run, Lightmap *lm, Vtx *verts, int *at) {
+  int begin = map->sector_line_start[s];
+  int end = map->sector_line_start[s + 1];
 
-      float low_top = (f0 > f1) ? f0 : f1;
-      float low_bot = (f0 < f1) ? f0 : f1;
-      if (low_top - low_bot > 0.0001f) {
-        add_wall_segment(verts, &at, p0.x, p0.y, p1.x, p1.y, low_bot, low_top,
-                         u0, u1, 0.7f, 0.5f, 0.2f, sf->light_level);
-      }
+  for (int k = begin; k < end; k++)
+    flags[map->sector_lines[k]] = 0;
+  for (int k = begin; k < end; k++) {
+    int i = map->sector_lines[k];
+    if (map->lines[i].front_sector != s)
+      continue;
+    int j = next_in_run(map, s, i, flags);
+    if (j >= 0 && near_chord(map->verts[map->lines[i].v0],
+                             map->verts[map->lines[j].v1],
+                             map->verts[map->lines[i].v1], tol))
+      flags[j] |= RUN_HAS_PREV;
+  }
 
-      float up_top = (c0 > c1) ? c0 : c1;
-      float up_bot = (c0 < c1) ? c0 : c1;
-      if (up_top - up_bot > 0.0001f) {
-        add_wall_segment(verts, &at, p0.x, p0.y, p1.x, p1.y, up_bot, up_top, u0,
-                         u1, 0.2f, 0.6f, 0.8f, sf->light_level);
+  for (int pass = 0; pass < 2; pass++) {
+    for (int k = begin; k < end; k++) {
+      int i = map->sector_lines[k];
+      if (map->lines[i].front_sector != s || (flags[i] & RUN_USED) ||
+          (pass == 0 && (flags[i] & RUN_HAS_PREV)))
+        continue;
+      while (i >= 0) {
+        int last = add_run(map, s, i, tol, flags, run, lm, verts, at);
+        i = next_in_run(map, s, last, flags);
       }
     }
   }
+}
 
-  glGenVertexArrays(1, &out->vao);
-  glGenBuffers(1, &out->vbo);
-
-  glBindVertexArray(out->vao);
-  glBindBuffer(GL_ARRAY_BUFFER, out->vbo);
-  glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)(at * (int)sizeof(Vtx)), verts,
-               GL_STATIC_DRAW);
+bool wall_mesh_bake(MeshData *out, const Map *map, Lightmap *lm) {
+  memset(out, 0, sizeof(*out));
+  if (!map || map->line_count <= 0)
+    return false;
 
-  GLsizei stride = (GLsizei)sizeof(Vtx);
-  glEnableVertexAttribArray(0);
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void *)0);
+  int pieces = 0;
+  for (int i = 0; i < map->line_count; i++)
+    pieces += line_pieces(map, i);
+  // Room for the full mesh and a LOD mesh that is never larger.
+  int max_vtx = pieces * 6 * 2;
+  if (!lightmap_reserve(lm, lm->chart_count + pieces * 2))
+    return false;
 
-  glEnableVertexAttribArray(1);
-  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride,
-                        (void *)(3 * sizeof(float)));
+  MemTemp temp;
+  size_t n_sec = (size_t)map->sector_count;
+  size_t vtx_bytes = (size_t)max_vtx * sizeof(Vtx);
+  size_t idx_bytes = (size_t)max_vtx * sizeof(uint32_t);
+  size_t int_count = n_sec * 8 + (size_t)map->line_count;
+  if (!mem_temp_begin(&temp, vtx_bytes + idx_bytes + int_count * sizeof(int) +
+                                 (size_t)map->line_count))
+    return false;
+  Vtx *verts = (Vtx *)temp.ptr;
+  uint32_t *indices = (uint32_t *)((unsigned char *)temp.ptr + vtx_bytes);
+  int *first = (int *)(indices + max_vtx);
+  int *count = first + n_sec;
+  int *lod_first = count + n_sec;
+  int *lod_count = lod_first + n_sec;
+  int *opt_first = lod_count + n_sec;
+  int *opt_count = opt_first + n_sec * 2;
+  int *run = opt_count + n_sec * 2;
+  uint8_t *flags = (uint8_t *)(run + map->line_count);
 
-  glEnableVertexAttribArray(2);
-  glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride,
-                        (void *)(6 * sizeof(float)));
+  int at = 0;
 
-  glEnableVertexAttribArray(3);
-  glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, stride,
-                        (void *)(8 * sizeof(float)));
+  for (int s = 0; s < map->sector_count; s++) {
+    first[s] = at;
+    add_sector_walls(map, s, k_merge_tolerance, flags, run, lm, verts, &at);
+    count[s] = at - first[s];
+  }
+  int full = at;
 
-  glBindBuffer(GL_ARRAY_BUFFER, 0);
-  glBindVertexArray(0);
+  for (int s = 0; s < map->sector_count; s++) {
+    LightmapMark mark = lightmap_mark(lm);
+    lod_first[s] = at;
+    add_sector_walls(map, s, k_lod_tolerance, flags, run, lm, verts, &at);
+    lod_count[s] = at - lod_first[s];
+    if (lod_count[s] == count[s]) {
+      at = lod_first[s];
+      lod_first[s] = first[s];
+      lightmap_rewind(lm, mark);
+    }
+  }
 
-  out->vertex_count = at;
+  // Aliased LOD ranges are the full ranges, already in the list once.
+  for (size_t i = 0; i < n_sec; i++) {
+    bool alias = lod_first[i] == first[i];
+    opt_first[i] = first[i];
+    opt_count[i] = count[i];
+    opt_first[n_sec + i] = lod_first[i];
+    opt_count[n_sec + i] = alias ? 0 : lod_count[i];
+  }
 
-  free(verts);
-  return true;
-}
+  MeshOptStats stats = {0};
+  stats.tris_before = pieces * 2;
+  stats.verts_before = pieces * 6;
+  stats.tris_after = full / 3;
 
-void wall_mesh_destroy(WallMesh *m) {
-  if (!m)
-    return;
-  if (m->vbo)
-    glDeleteBuffers(1, &m->vbo);
-  if (m->vao)
-    glDeleteVertexArrays(1, &m->vao);
-  memset(m, 0, sizeof(*m));
+  int unique = mesh_opt_index(verts, at, sizeof(Vtx), indices, opt_first,
+                              opt_count, (int)n_sec * 2, &stats);
+  bool ok = unique >= 0 && mesh_data_init(out, verts, unique, indices, at,
+                                          first, (int)n_sec, &stats);
+  mem_temp_end(&temp);
+  return ok;
 }
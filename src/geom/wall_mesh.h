@@ -1,18 +1,16 @@
 #ifndef WALL_MESH_H
 #define WALL_MESH_H
 
-#include <glad/glad.h>
 #include <stdbool.h>
 
 #include "../map/map.h"
+#include "lightmap.h"
+#include "mesh_data.h"
 
-typedef struct WallMesh {
-  GLuint vao;
-  GLuint vbo;
-  int vertex_count;
-} WallMesh;
-
-bool wall_mesh_build(WallMesh *out, const Map *map);
-void wall_mesh_destroy(WallMesh *m);
+// Walls are emitted with their front sector and grouped by it. Collinear
+// runs of lines with the same neighbours are one quad per wall piece. The
+// LOD ranges also merge runs that bend slightly, or alias the full range
+// when that changes nothing. Every quad packs its own chart into lm.
+bool wall_mesh_bake(MeshData *out, const Map *map, Lightmap *lm);
 
 #endif // !WALL_MESH_H
@@ -0,0 +1,75 @@
+#include "world_bake.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "sector_mesh.h"
+#include "wall_mesh.h"
+
+static void compute_sector_bounds(const Map *map, Vec3 *out_min,
+                                  Vec3 *out_max) {
+  for (int s = 0; s < map->sector_count; s++) {
+    const Sector *sec = &map->sectors[s];
+    Vec3 lo = v3(1e30f, sec->floor_h, 1e30f);
+    Vec3 hi = v3(-1e30f, sec->ceil_h, -1e30f);
+
+    for (int k = map->sector_line_start[s]; k < map->sector_line_start[s + 1];
+         k++) {
+      const Linedef *l = &map->lines[map->sector_lines[k]];
+      Vec2 ends[2] = {map->verts[l->v0], map->verts[l->v1]};
+      for (int e = 0; e < 2; e++) {
+        lo.x = fminf(lo.x, ends[e].x);
+        lo.z = fminf(lo.z, ends[e].y);
+        hi.x = fmaxf(hi.x, ends[e].x);
+        hi.z = fmaxf(hi.z, ends[e].y);
+      }
+      if (l->front_sector == s && l->back_sector >= 0) {
+        const Sector *back = &map->sectors[l->back_sector];
+        lo.y = fminf(lo.y, back->floor_h);
+        hi.y = fmaxf(hi.y, back->ceil_h);
+      }
+    }
+    for (int i = 0; i < sec->loop.count; i++) {
+      Vec2 p = map->verts[sec->loop.indices[i]];
+      lo.x = fminf(lo.x, p.x);
+      lo.z = fminf(lo.z, p.y);
+      hi.x = fmaxf(hi.x, p.x);
+      hi.z = fmaxf(hi.z, p.y);
+    }
+    out_min[s] = lo;
+    out_max[s] = hi;
+  }
+}
+
+bool world_bake(WorldBake *b, const Map *map) {
+  memset(b, 0, sizeof(*b));
+  if (!lightmap_begin(&b->lightmap, map) ||
+      !sector_mesh_bake(&b->floors, map, &b->lightmap) ||
+      !wall_mesh_bake(&b->walls, map, &b->lightmap) ||
+      !lightmap_finish(&b->lightmap)) {
+    world_bake_free(b);
+    return false;
+  }
+  lightmap_fill_flat(&b->lightmap, map);
+
+  size_t n = (size_t)map->sector_count;
+  b->block = mem_alloc(n * 2 * sizeof(Vec3));
+  if (!b->block) {
+    world_bake_free(b);
+    return false;
+  }
+  b->sector_min = (Vec3 *)b->block;
+  b->sector_max = b->sector_min + n;
+  compute_sector_bounds(map, b->sector_min, b->sector_max);
+  return true;
+}
+
+void world_bake_free(WorldBake *b) {
+  if (!b)
+    return;
+  mesh_data_free(&b->floors);
+  mesh_data_free(&b->walls);
+  lightmap_free(&b->lightmap);
+  mem_free(b->block);
+  memset(b, 0, sizeof(*b));
+}
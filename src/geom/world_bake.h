@@ -0,0 +1,27 @@
+#ifndef WORLD_BAKE_H
+#define WORLD_BAKE_H
+
+#include <stdbool.h>
+
+#include "../map/map.h"
+#include "../math/vec3.h"
+#include "lightmap.h"
+#include "mesh_data.h"
+
+// Everything the renderer derives from a map, in upload-ready form: both
+// world meshes and a world-space box per sector around its floor, ceiling
+// and the walls it owns as a front sector. The lightmap comes out flat
+// filled from sector light levels; lightmap_trace bakes it properly.
+typedef struct WorldBake {
+  MeshData floors;
+  MeshData walls;
+  Lightmap lightmap;
+  Vec3 *sector_min;
+  Vec3 *sector_max;
+  void *block;
+} WorldBake;
+
+bool world_bake(WorldBake *b, const Map *map);
+void world_bake_free(WorldBake *b);
+
+#endif // !WORLD_BAKE_H
@@ -0,0 +1,73 @@
+#include "dynres.h"
+
+#include <math.h>
+
+enum { DYNRES_SETTLE_FRAMES = 8 };
+
+static const double k_smoothing = 0.1;
+static const double k_upscale_headroom = 0.8;
+static const float k_upscale_step = 0.02f;
+static const float k_scale_quantum = 1.0f / 64.0f;
+
+static float clampf(float v, float lo, float hi) {
+  return (v < lo) ? lo : (v > hi) ? hi : v;
+}
+
+DynResConfig dynres_default_config(void) {
+  DynResConfig cfg = {
+      .enabled = true,
+      .target_ms = 16.6,
+      .min_scale = 0.5f,
+      .max_scale = 1.0f,
+  };
+  return cfg;
+}
+
+void dynres_init(DynRes *d, const DynResConfig *cfg) {
+  d->cfg = *cfg;
+  if (d->cfg.min_scale <= 0.0f)
+    d->cfg.min_scale = 0.1f;
+  if (d->cfg.max_scale < d->cfg.min_scale)
+    d->cfg.max_scale = d->cfg.min_scale;
+  if (d->cfg.target_ms <= 0.0)
+    d->cfg.target_ms = 16.6;
+
+  d->scale = d->cfg.max_scale;
+  d->smoothed_ms = 0.0;
+  d->cooldown = DYNRES_SETTLE_FRAMES;
+}
+
+float dynres_update(DynRes *d, double cpu_ms, double gpu_ms) {
+  if (!d->cfg.enabled)
+    return d->scale;
+
+  double ms = (gpu_ms > cpu_ms) ? gpu_ms : cpu_ms;
+  if (d->smoothed_ms <= 0.0)
+    d->smoothed_ms = ms;
+  else
+    d->smoothed_ms += (ms - d->smoothed_ms) * k_smoothing;
+
+  if (d->cooldown > 0) {
+    d->cooldown--;
+    return d->scale;
+  }
+
+  float next = d->scale;
+  double target = d->cfg.target_ms;
+
+  if (d->smoothed_ms > target) {
+    // Shaded pixel count goes with scale squared.
+    next = d->scale * (float)sqrt(target / d->smoothed_ms);
+  } else if (d->smoothed_ms < target * k_upscale_headroom) {
+    next = d->scale + k_upscale_step;
+  }
+
+  next = floorf(next / k_scale_quantum) * k_scale_quantum;
+  next = clampf(next, d->cfg.min_scale, d->cfg.max_scale);
+
+  if (next != d->scale) {
+    d->scale = next;
+    d->cooldown = DYNRES_SETTLE_FRAMES;
+  }
+  return d->scale;
+}
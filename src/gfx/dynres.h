@@ -0,0 +1,24 @@
+#ifndef DYNRES_H
+#define DYNRES_H
+
+#include <stdbool.h>
+
+typedef struct DynResConfig {
+  bool enabled;
+  double target_ms;
+  float min_scale;
+  float max_scale;
+} DynResConfig;
+
+typedef struct DynRes {
+  DynResConfig cfg;
+  float scale;
+  double smoothed_ms;
+  int cooldown;
+} DynRes;
+
+DynResConfig dynres_default_config(void);
+void dynres_init(DynRes *d, const DynResConfig *cfg);
+float dynres_update(DynRes *d, double cpu_ms, double gpu_ms);
+
+#endif // !DYNRES_H
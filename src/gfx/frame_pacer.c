@@ -0,0 +1,155 @@
+#include "frame_pacer.h"
+#include "../time.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Sleeps overshoot by up to about this much, so the last stretch spins.
+static const double k_sleep_slack = 0.001;
+// Per-frame decay of the work peak: one hitch costs latency only briefly.
+static const double k_peak_decay = 0.98;
+static const GLuint64 k_fence_timeout_ns = 100000000;
+
+FramePacerConfig frame_pacer_default_config(void) {
+  FramePacerConfig cfg = {
+      .enabled = true,
+      .adaptive_vsync = true,
+      .max_queued = 1,
+      .margin_ms = 1.0,
+  };
+  return cfg;
+}
+
+static int set_swap_interval(bool vsync, bool adaptive) {
+  if (vsync && adaptive && SDL_GL_SetSwapInterval(-1) == 0)
+    return -1;
+  if (vsync && SDL_GL_SetSwapInterval(1) == 0)
+    return 1;
+  SDL_GL_SetSwapInterval(0);
+  return 0;
+}
+
+void frame_pacer_init(FramePacer *fp, const FramePacerConfig *cfg,
+                      SDL_Window *window, bool vsync) {
+  memset(fp, 0, sizeof(*fp));
+  fp->cfg = *cfg;
+  if (fp->cfg.max_queued < 0)
+    fp->cfg.max_queued = 0;
+  if (fp->cfg.max_queued > FRAME_PACER_MAX_QUEUED)
+    fp->cfg.max_queued = FRAME_PACER_MAX_QUEUED;
+  if (fp->cfg.margin_ms < 0.0)
+    fp->cfg.margin_ms = 0.0;
+
+  fp->swap_interval = set_swap_interval(vsync, fp->cfg.adaptive_vsync);
+  SDL_DisplayMode mode;
+  if (SDL_GetWindowDisplayMode(window, &mode) == 0 && mode.refresh_rate > 0)
+    fp->refresh = 1.0 / (double)mode.refresh_rate;
+
+  double now = time_now_seconds();
+  fp->last_swap = now;
+  fp->wake = now;
+  fp->latch = now;
+}
+
+void frame_pacer_shutdown(FramePacer *fp) {
+  for (int i = 0; i < fp->fence_count; i++)
+    glDeleteSync(fp->fences[i]);
+  fp->fence_count = 0;
+}
+
+double frame_pacer_wait(FramePacer *fp, double max_dt) {
+  if (fp->cfg.enabled && fp->swap_interval != 0 && fp->refresh > 0.0) {
+    // Swaps return on a vblank, so the next one is a refresh later; wake
+    // early enough for the slowest recent frame to make it.
+    double target = fp->last_swap + fp->refresh - fp->work_peak -
+                    fp->cfg.margin_ms * 1e-3;
+    double now = time_now_seconds();
+    if (target - now > k_sleep_slack)
+      time_sleep(target - now - k_sleep_slack);
+    while (time_now_seconds() < target) {
+    }
+  }
+
+  double prev = fp->wake;
+  fp->wake = time_now_seconds();
+  fp->latch = fp->wake;
+  double dt = fp->wake - prev;
+  return (dt > max_dt) ? max_dt : dt;
+}
+
+void frame_pacer_latch(FramePacer *fp) { fp->latch = time_now_seconds(); }
+
+static void record(FramePacer *fp, double frame_ms, double latency_ms,
+                   double fence_ms) {
+  fp->frame_ms[fp->sample_next] = (float)frame_ms;
+  fp->latency_ms[fp->sample_next] = (float)latency_ms;
+  fp->fence_ms[fp->sample_next] = (float)fence_ms;
+  fp->sample_next = (fp->sample_next + 1) % FRAME_PACER_SAMPLES;
+  if (fp->sample_count < FRAME_PACER_SAMPLES)
+    fp->sample_count++;
+}
+
+void frame_pacer_swap(FramePacer *fp, SDL_Window *window) {
+  double work = time_now_seconds() - fp->wake;
+  fp->work_peak = (work > fp->work_peak * k_peak_decay)
+                      ? work
+                      : fp->work_peak * k_peak_decay;
+
+  SDL_GL_SwapWindow(window);
+  double swapped = time_now_seconds();
+
+  // Waiting on the frame max_queued back, rather than glFinish on this
+  // one, leaves the GPU that many frames of work to overlap with the CPU.
+  if (fp->cfg.max_queued > 0) {
+    GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    if (fence)
+      fp->fences[fp->fence_count++] = fence;
+    while (fp->fence_count > fp->cfg.max_queued) {
+      glClientWaitSync(fp->fences[0], GL_SYNC_FLUSH_COMMANDS_BIT,
+                       k_fence_timeout_ns);
+      glDeleteSync(fp->fences[0]);
+      fp->fence_count--;
+      memmove(fp->fences, fp->fences + 1,
+              (size_t)fp->fence_count * sizeof(GLsync));
+    }
+  }
+
+  // The fence wait only throttles the next frame; it is no part of this
+  // frame's input latency, so it is kept apart.
+  double now = time_now_seconds();
+  record(fp, (now - fp->last_swap) * 1000.0, (swapped - fp->latch) * 1000.0,
+         (now - swapped) * 1000.0);
+  fp->last_swap = now;
+}
+
+static int cmp_float(const void *a, const void *b) {
+  float x = *(const float *)a;
+  float y = *(const float *)b;
+  return (x > y) - (x < y);
+}
+
+static FrameTimeStats percentiles(const float *samples, int count) {
+  FrameTimeStats s = {0};
+  if (count == 0)
+    return s;
+  float sorted[FRAME_PACER_SAMPLES];
+  memcpy(sorted, samples, (size_t)count * sizeof(float));
+  qsort(sorted, (size_t)count, sizeof(float), cmp_float);
+  s.count = count;
+  s.p50_ms = sorted[(count - 1) * 50 / 100];
+  s.p99_ms = sorted[(count - 1) * 99 / 100];
+  s.max_ms = sorted[count - 1];
+  return s;
+}
+
+FrameTimeStats frame_pacer_frame_stats(const FramePacer *fp) {
+  return percentiles(fp->frame_ms, fp->sample_count);
+}
+
+FrameTimeStats frame_pacer_latency_stats(const FramePacer *fp) {
+  return percentiles(fp->latency_ms, fp->sample_count);
+}
+
+FrameTimeStats frame_pacer_fence_stats(const FramePacer *fp) {
+  return percentiles(fp->fence_ms, fp->sample_count);
+}
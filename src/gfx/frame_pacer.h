@@ -0,0 +1,74 @@
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+#include <SDL2/SDL.h>
+#include <glad/glad.h>
+#include <stdbool.h>
+
+enum { FRAME_PACER_SAMPLES = 512, FRAME_PACER_MAX_QUEUED = 3 };
+
+typedef struct FramePacerConfig {
+  // Sleep until just before the frame has to start to make the next vblank.
+  bool enabled;
+  // Swap interval -1 where the driver has it: a late frame tears instead of
+  // waiting for the following refresh.
+  bool adaptive_vsync;
+  // Frames the GPU may fall behind the CPU, enforced with fences; 0 leaves
+  // queueing to the driver.
+  int max_queued;
+  // Extra time the schedule keeps between waking and the deadline.
+  double margin_ms;
+} FramePacerConfig;
+
+typedef struct FrameTimeStats {
+  int count;
+  double p50_ms;
+  double p99_ms;
+  double max_ms;
+} FrameTimeStats;
+
+typedef struct FramePacer {
+  FramePacerConfig cfg;
+  int swap_interval;
+  // Seconds per refresh, 0 when the display does not say.
+  double refresh;
+  double last_swap;
+  double wake;
+  double latch;
+  // Decaying peak of wake-to-swap time, which the schedule budgets for.
+  double work_peak;
+  GLsync fences[FRAME_PACER_MAX_QUEUED + 1];
+  int fence_count;
+  // Swap-to-swap intervals, latch-to-swap latencies and time spent waiting
+  // on the queue fence after the swap, in ms.
+  float frame_ms[FRAME_PACER_SAMPLES];
+  float latency_ms[FRAME_PACER_SAMPLES];
+  float fence_ms[FRAME_PACER_SAMPLES];
+  int sample_count;
+  int sample_next;
+} FramePacer;
+
+FramePacerConfig frame_pacer_default_config(void);
+
+// Sets the swap interval: 0 without vsync, otherwise -1 when adaptive sync
+// is asked for and accepted, else 1. Reads the refresh rate off the window.
+void frame_pacer_init(FramePacer *fp, const FramePacerConfig *cfg,
+                      SDL_Window *window, bool vsync);
+void frame_pacer_shutdown(FramePacer *fp);
+
+// Sleeps until the predicted start of this frame's work. Returns the time
+// since the previous frame's wake, clamped to max_dt.
+double frame_pacer_wait(FramePacer *fp, double max_dt);
+
+// Marks the moment input was last read for this frame.
+void frame_pacer_latch(FramePacer *fp);
+
+// Presents, fences the frame and waits until no more than max_queued
+// frames are in flight.
+void frame_pacer_swap(FramePacer *fp, SDL_Window *window);
+
+FrameTimeStats frame_pacer_frame_stats(const FramePacer *fp);
+FrameTimeStats frame_pacer_latency_stats(const FramePacer *fp);
+FrameTimeStats frame_pacer_fence_stats(const FramePacer *fp);
+
+#endif // !FRAME_PACER_H
@@ -0,0 +1,222 @@
+#include "light_clusters.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "../core/jobs.h"
+#include "../core/mem.h"
+#include "../time.h"
+
+// Waking the job pool still costs more than binning a few lights inline.
+enum { MAX_BIN_WORKERS = 4, PARALLEL_LIGHTS = 64 };
+
+bool light_clusters_init(LightClusters *lc) {
+  memset(lc, 0, sizeof(*lc));
+  size_t clusters = CLUSTER_COUNT;
+  size_t bytes = clusters * 2 * sizeof(uint32_t) +
+                 clusters * MAX_CLUSTER_LIGHTS * sizeof(uint32_t) +
+                 MAX_POINT_LIGHTS * 8 * sizeof(float) +
+                 clusters * 6 * sizeof(float) +
+                 MAX_POINT_LIGHTS * sizeof(Vec3) +
+                 clusters * MAX_CLUSTER_LIGHTS * sizeof(uint16_t);
+  unsigned char *block = (unsigned char *)mem_alloc(bytes);
+  if (!block)
+    return false;
+
+  lc->grid = (uint32_t *)block;
+  lc->indices = lc->grid + clusters * 2;
+  lc->data = (float *)(lc->indices + clusters * MAX_CLUSTER_LIGHTS);
+  lc->bounds = lc->data + MAX_POINT_LIGHTS * 8;
+  lc->view_pos = (Vec3 *)(lc->bounds + clusters * 6);
+  lc->slots = (uint16_t *)(lc->view_pos + MAX_POINT_LIGHTS);
+  memset(lc->grid, 0, clusters * 2 * sizeof(uint32_t));
+
+  lc->workers = jobs_hardware_threads();
+  if (lc->workers > MAX_BIN_WORKERS)
+    lc->workers = MAX_BIN_WORKERS;
+  return true;
+}
+
+void light_clusters_destroy(LightClusters *lc) {
+  if (!lc)
+    return;
+  mem_free(lc->grid);
+  memset(lc, 0, sizeof(*lc));
+}
+
+static float slice_depth(const LightClusters *lc, int z) {
+  return lc->znear * powf(lc->zfar / lc->znear, (float)z / CLUSTER_Z);
+}
+
+// View-space boxes (x right, y up, z forward) around every cluster; they
+// only change with the projection.
+static void update_bounds(LightClusters *lc, const Camera *cam,
+                          float aspect) {
+  lc->fov_y = cam->fov_y;
+  lc->aspect = aspect;
+  lc->znear = cam->znear;
+  lc->zfar = cam->zfar;
+  float range = logf(lc->zfar / lc->znear);
+  lc->slice_scale = CLUSTER_Z / range;
+  lc->slice_bias = -CLUSTER_Z * logf(lc->znear) / range;
+
+  float ty = tanf(cam->fov_y * 0.5f);
+  float tx = ty * aspect;
+  for (int z = 0; z < CLUSTER_Z; z++) {
+    float d0 = slice_depth(lc, z);
+    float d1 = slice_depth(lc, z + 1);
+    for (int y = 0; y < CLUSTER_Y; y++) {
+      float y0 = (-1.0f + 2.0f * (float)y / CLUSTER_Y) * ty;
+      float y1 = (-1.0f + 2.0f * (float)(y + 1) / CLUSTER_Y) * ty;
+      for (int x = 0; x < CLUSTER_X; x++) {
+        float x0 = (-1.0f + 2.0f * (float)x / CLUSTER_X) * tx;
+        float x1 = (-1.0f + 2.0f * (float)(x + 1) / CLUSTER_X) * tx;
+        float *b = lc->bounds + ((z * CLUSTER_Y + y) * CLUSTER_X + x) * 6;
+        b[0] = fminf(x0 * d0, x0 * d1);
+        b[1] = fminf(y0 * d0, y0 * d1);
+        b[2] = d0;
+        b[3] = fmaxf(x1 * d0, x1 * d1);
+        b[4] = fmaxf(y1 * d0, y1 * d1);
+        b[5] = d1;
+      }
+    }
+  }
+}
+
+static bool sphere_touches_box(Vec3 c, float r, const float *b) {
+  float dx = fmaxf(fmaxf(b[0] - c.x, c.x - b[3]), 0.0f);
+  float dy = fmaxf(fmaxf(b[1] - c.y, c.y - b[4]), 0.0f);
+  float dz = fmaxf(fmaxf(b[2] - c.z, c.z - b[5]), 0.0f);
+  return dx * dx + dy * dy + dz * dz <= r * r;
+}
+
+typedef struct BinJob {
+  LightClusters *lc;
+  const PointLight *lights;
+  int count;
+  float tile_x;
+  float tile_y;
+  int dropped[CLUSTER_Z];
+} BinJob;
+
+// Tiles [*t0, *t1] reached by the view coordinate range [lo, hi] anywhere
+// in the depths [d0, d1]; tan_half is the frustum half-extent at depth 1.
+static void tile_span(float lo, float hi, float d0, float d1, float tan_half,
+                      int tiles, int *t0, int *t1) {
+  float n0 = lo / ((lo < 0.0f ? d0 : d1) * tan_half);
+  float n1 = hi / ((hi > 0.0f ? d0 : d1) * tan_half);
+  int a = (int)floorf((n0 + 1.0f) * 0.5f * (float)tiles);
+  int b = (int)floorf((n1 + 1.0f) * 0.5f * (float)tiles);
+  *t0 = (a < 0) ? 0 : a;
+  *t1 = (b >= tiles) ? tiles - 1 : b;
+}
+
+// Each slice owns its clusters' counts and slots, so slices never share a
+// write. Within a slice a light is only tested against the tiles its box
+// projects to.
+static void bin_slices(void *ctx, int worker, int begin, int end) {
+  (void)worker;
+  BinJob *job = (BinJob *)ctx;
+  LightClusters *lc = job->lc;
+  const int per_slice = CLUSTER_X * CLUSTER_Y;
+
+  for (int z = begin; z < end; z++) {
+    int first = z * per_slice;
+    float d0 = lc->bounds[first * 6 + 2];
+    float d1 = lc->bounds[first * 6 + 5];
+    for (int c = first; c < first + per_slice; c++)
+      lc->grid[c * 2 + 1] = 0;
+
+    for (int i = 0; i < job->count; i++) {
+      Vec3 v = lc->view_pos[i];
+      float r = job->lights[i].radius;
+      if (v.z + r < d0 || v.z - r > d1)
+        continue;
+
+      float near = fmaxf(d0, v.z - r);
+      float far = fminf(d1, v.z + r);
+      int x0, x1, y0, y1;
+      tile_span(v.x - r, v.x + r, near, far, job->tile_x, CLUSTER_X, &x0,
+                &x1);
+      tile_span(v.y - r, v.y + r, near, far, job->tile_y, CLUSTER_Y, &y0,
+                &y1);
+
+      for (int y = y0; y <= y1; y++) {
+        for (int x = x0; x <= x1; x++) {
+          int c = first + y * CLUSTER_X + x;
+          if (!sphere_touches_box(v, r, lc->bounds + c * 6))
+            continue;
+          uint32_t n = lc->grid[c * 2 + 1];
+          if (n == MAX_CLUSTER_LIGHTS) {
+            job->dropped[z]++;
+            continue;
+          }
+          lc->slots[c * MAX_CLUSTER_LIGHTS + n] = (uint16_t)i;
+          lc->grid[c * 2 + 1] = n + 1;
+        }
+      }
+    }
+  }
+}
+
+void light_clusters_build(LightClusters *lc, Camera *cam, float aspect,
+                          const PointLight *lights, int count) {
+  double start = time_now_seconds();
+  if (cam->fov_y != lc->fov_y || aspect != lc->aspect ||
+      cam->znear != lc->znear || cam->zfar != lc->zfar)
+    update_bounds(lc, cam, aspect);
+
+  memset(&lc->stats, 0, sizeof(lc->stats));
+  lc->stats.lights = count;
+  if (count > MAX_POINT_LIGHTS) {
+    lc->stats.dropped = count - MAX_POINT_LIGHTS;
+    count = MAX_POINT_LIGHTS;
+  }
+
+  Vec3 eye = cam->pos;
+  Vec3 fwd = camera_forward(cam);
+  Vec3 right = camera_right(cam);
+  for (int i = 0; i < count; i++) {
+    const PointLight *l = &lights[i];
+    Vec3 d = v3_sub(l->pos, eye);
+    lc->view_pos[i] = v3(v3_dot(d, right), d.y, v3_dot(d, fwd));
+    float *o = lc->data + i * 8;
+    o[0] = l->pos.x;
+    o[1] = l->pos.y;
+    o[2] = l->pos.z;
+    o[3] = l->radius;
+    o[4] = l->color.x;
+    o[5] = l->color.y;
+    o[6] = l->color.z;
+    o[7] = 0.0f;
+  }
+  lc->light_count = count;
+
+  BinJob job;
+  memset(&job, 0, sizeof(job));
+  job.lc = lc;
+  job.lights = lights;
+  job.count = count;
+  job.tile_y = tanf(cam->fov_y * 0.5f);
+  job.tile_x = job.tile_y * aspect;
+  int workers = (count >= PARALLEL_LIGHTS) ? lc->workers : 1;
+  jobs_parallel_for(CLUSTER_Z, 1, workers, bin_slices, &job);
+
+  uint32_t at = 0;
+  for (int c = 0; c < CLUSTER_COUNT; c++) {
+    uint32_t n = lc->grid[c * 2 + 1];
+    const uint16_t *src = lc->slots + c * MAX_CLUSTER_LIGHTS;
+    lc->grid[c * 2] = at;
+    for (uint32_t k = 0; k < n; k++)
+      lc->indices[at + k] = src[k];
+    at += n;
+    if ((int)n > lc->stats.max_per_cluster)
+      lc->stats.max_per_cluster = (int)n;
+  }
+  lc->index_count = (int)at;
+
+  for (int z = 0; z < CLUSTER_Z; z++)
+    lc->stats.dropped += job.dropped[z];
+  lc->stats.refs = (int)at;
+  lc->stats.cpu_ms = (time_now_seconds() - start) * 1000.0;
+}
@@ -0,0 +1,65 @@
+#ifndef LIGHT_CLUSTERS_H
+#define LIGHT_CLUSTERS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "../camera.h"
+#include "../math/vec3.h"
+
+// Screen tiles by depth slices; slices are spaced exponentially between the
+// camera near and far planes so they stay roughly cube-shaped.
+enum {
+  CLUSTER_X = 16,
+  CLUSTER_Y = 9,
+  CLUSTER_Z = 24,
+  CLUSTER_COUNT = CLUSTER_X * CLUSTER_Y * CLUSTER_Z,
+  MAX_POINT_LIGHTS = 1024,
+  MAX_CLUSTER_LIGHTS = 64,
+};
+
+typedef struct PointLight {
+  Vec3 pos;
+  float radius;
+  Vec3 color;
+} PointLight;
+
+typedef struct LightClusterStats {
+  int lights;
+  int refs;
+  int max_per_cluster;
+  int dropped;
+  double cpu_ms;
+} LightClusterStats;
+
+// Per-frame light lists in upload-ready form: cluster c's lights are
+// indices[grid[c * 2] .. grid[c * 2] + grid[c * 2 + 1]), and light i is
+// the two vec4s data[i * 8 ..] (position, radius) and (color, 0).
+typedef struct LightClusters {
+  uint32_t *grid;
+  uint32_t *indices;
+  int index_count;
+  float *data;
+  int light_count;
+  // Depth slice of view depth d: log(d) * slice_scale + slice_bias.
+  float slice_scale;
+  float slice_bias;
+  LightClusterStats stats;
+
+  float *bounds;
+  uint16_t *slots;
+  Vec3 *view_pos;
+  float fov_y, aspect, znear, zfar;
+  int workers;
+} LightClusters;
+
+bool light_clusters_init(LightClusters *lc);
+void light_clusters_destroy(LightClusters *lc);
+
+// Bins the lights into the camera's clusters, one depth slice per job.
+// Lights past MAX_POINT_LIGHTS, and past MAX_CLUSTER_LIGHTS in a cluster,
+// are dropped and counted.
+void light_clusters_build(LightClusters *lc, Camera *cam, float aspect,
+                          const PointLight *lights, int count);
+
+#endif // !LIGHT_CLUSTERS_H
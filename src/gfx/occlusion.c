@@ -0,0 +1,321 @@
+#include "occlusion.h"
+#include "../core/mem.h"
+
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) ||                                    \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OCC_SSE2 1
+#include <emmintrin.h>
+#endif
+
+typedef struct ClipVert {
+  float x, y, z, w;
+} ClipVert;
+
+// Screen-space x, y in pixels and NDC depth remapped to [0, 1].
+typedef struct ScreenVert {
+  float x, y, z;
+} ScreenVert;
+
+static ClipVert transform(const Mat4 *m, Vec3 p) {
+  const float *a = m->m;
+  ClipVert c;
+  c.x = a[0] * p.x + a[4] * p.y + a[8] * p.z + a[12];
+  c.y = a[1] * p.x + a[5] * p.y + a[9] * p.z + a[13];
+  c.z = a[2] * p.x + a[6] * p.y + a[10] * p.z + a[14];
+  c.w = a[3] * p.x + a[7] * p.y + a[11] * p.z + a[15];
+  return c;
+}
+
+static ScreenVert to_screen(ClipVert c) {
+  float inv_w = 1.0f / c.w;
+  ScreenVert s;
+  s.x = (c.x * inv_w * 0.5f + 0.5f) * (float)OCC_WIDTH;
+  s.y = (0.5f - c.y * inv_w * 0.5f) * (float)OCC_HEIGHT;
+  s.z = c.z * inv_w * 0.5f + 0.5f;
+  return s;
+}
+
+bool occlusion_init(OcclusionBuffer *ob) {
+  memset(ob, 0, sizeof(*ob));
+
+  size_t total = 0;
+  int w = OCC_WIDTH;
+  int h = OCC_HEIGHT;
+  while (ob->level_count < OCC_MAX_LEVELS && w >= 1 && h >= 1) {
+    ob->level_w[ob->level_count] = w;
+    ob->level_h[ob->level_count] = h;
+    ob->level_count++;
+    total += (size_t)w * (size_t)h;
+    w /= 2;
+    h /= 2;
+  }
+
+  float *block = (float *)mem_alloc(total * sizeof(float));
+  if (!block)
+    return false;
+  for (int i = 0; i < ob->level_count; i++) {
+    ob->levels[i] = block;
+    block += (size_t)ob->level_w[i] * (size_t)ob->level_h[i];
+  }
+  return true;
+}
+
+void occlusion_destroy(OcclusionBuffer *ob) {
+  if (!ob)
+    return;
+  mem_free(ob->levels[0]);
+  memset(ob, 0, sizeof(*ob));
+}
+
+void occlusion_begin(OcclusionBuffer *ob, const Mat4 *view_proj) {
+  ob->view_proj = *view_proj;
+  memset(&ob->stats, 0, sizeof(ob->stats));
+  float *depth = ob->levels[0];
+  for (int i = 0; i < OCC_WIDTH * OCC_HEIGHT; i++)
+    depth[i] = 1.0f;
+}
+
+// Edge function a->b evaluated as A * x + B * y + C; positive inside a
+// counter-clockwise (in screen space) triangle.
+typedef struct Edge {
+  float a, b, c;
+} Edge;
+
+static Edge make_edge(ScreenVert p, ScreenVert q) {
+  Edge e;
+  e.a = -(q.y - p.y);
+  e.b = q.x - p.x;
+  e.c = (q.y - p.y) * p.x - (q.x - p.x) * p.y;
+  // Tested at pixel centres, the edge passes only pixels lying wholly on its
+  // inner side: an occluder must not cover texels it only clips.
+  e.c -= 0.5f * (fabsf(e.a) + fabsf(e.b));
+  return e;
+}
+
+static void raster_triangle(OcclusionBuffer *ob, ScreenVert v0, ScreenVert v1,
+                            ScreenVert v2) {
+  float area = (v1.x - v0.x) * (v2.y - v0.y) - (v2.x - v0.x) * (v1.y - v0.y);
+  if (fabsf(area) < 1e-6f)
+    return;
+  if (area < 0.0f) {
+    ScreenVert t = v1;
+    v1 = v2;
+    v2 = t;
+    area = -area;
+  }
+
+  int minx = (int)floorf(fminf(v0.x, fminf(v1.x, v2.x)));
+  int maxx = (int)ceilf(fmaxf(v0.x, fmaxf(v1.x, v2.x)));
+  int miny = (int)floorf(fminf(v0.y, fminf(v1.y, v2.y)));
+  int maxy = (int)ceilf(fmaxf(v0.y, fmaxf(v1.y, v2.y)));
+  if (minx < 0)
+    minx = 0;
+  if (miny < 0)
+    miny = 0;
+  if (maxx > OCC_WIDTH - 1)
+    maxx = OCC_WIDTH - 1;
+  if (maxy > OCC_HEIGHT - 1)
+    maxy = OCC_HEIGHT - 1;
+  if (minx > maxx || miny > maxy)
+    return;
+
+  Edge e0 = make_edge(v1, v2);
+  Edge e1 = make_edge(v2, v0);
+  Edge e2 = make_edge(v0, v1);
+
+  // Depth is affine in screen space: z = zc + zx * x + zy * y.
+  float inv = 1.0f / area;
+  float zx = ((v1.z - v0.z) * (v2.y - v0.y) - (v2.z - v0.z) * (v1.y - v0.y)) *
+             inv;
+  float zy = ((v1.x - v0.x) * (v2.z - v0.z) - (v2.x - v0.x) * (v1.z - v0.z)) *
+             inv;
+  // Store the farthest depth the plane reaches inside each texel, so no
+  // part of the texel is claimed nearer than the occluder really is.
+  float zc = v0.z - zx * v0.x - zy * v0.y + 0.5f * (fabsf(zx) + fabsf(zy));
+
+  ob->stats.triangles++;
+  float *depth = ob->levels[0];
+
+#ifdef OCC_SSE2
+  // Four pixels per step; rows start on a 4-aligned column so whole
+  // groups stay inside the (multiple of four) buffer width.
+  int start = minx & ~3;
+  const __m128 lane = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 step_e0 = _mm_set1_ps(e0.a * 4.0f);
+  const __m128 step_e1 = _mm_set1_ps(e1.a * 4.0f);
+  const __m128 step_e2 = _mm_set1_ps(e2.a * 4.0f);
+  const __m128 step_z = _mm_set1_ps(zx * 4.0f);
+  const __m128 px0 = _mm_add_ps(_mm_set1_ps((float)start), lane);
+
+  for (int y = miny; y <= maxy; y++) {
+    float py = (float)y + 0.5f;
+    __m128 w0 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(e0.a), px0),
+                           _mm_set1_ps(e0.b * py + e0.c));
+    __m128 w1 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(e1.a), px0),
+                           _mm_set1_ps(e1.b * py + e1.c));
+    __m128 w2 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(e2.a), px0),
+                           _mm_set1_ps(e2.b * py + e2.c));
+    __m128 z = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(zx), px0),
+                          _mm_set1_ps(zy * py + zc));
+    float *row = depth + (size_t)y * OCC_WIDTH;
+
+    for (int x = start; x <= maxx; x += 4) {
+      __m128 inside = _mm_and_ps(
+          _mm_and_ps(_mm_cmpge_ps(w0, zero), _mm_cmpge_ps(w1, zero)),
+          _mm_cmpge_ps(w2, zero));
+      if (_mm_movemask_ps(inside)) {
+        __m128 old = _mm_loadu_ps(row + x);
+        __m128 nearer = _mm_min_ps(old, z);
+        _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer),
+                                         _mm_andnot_ps(inside, old)));
+      }
+      w0 = _mm_add_ps(w0, step_e0);
+      w1 = _mm_add_ps(w1, step_e1);
+      w2 = _mm_add_ps(w2, step_e2);
+      z = _mm_add_ps(z, step_z);
+    }
+  }
+#else
+  for (int y = miny; y <= maxy; y++) {
+    float py = (float)y + 0.5f;
+    float *row = depth + (size_t)y * OCC_WIDTH;
+    for (int x = minx; x <= maxx; x++) {
+      float px = (float)x + 0.5f;
+      if (e0.a * px + e0.b * py + e0.c < 0.0f ||
+          e1.a * px + e1.b * py + e1.c < 0.0f ||
+          e2.a * px + e2.b * py + e2.c < 0.0f)
+        continue;
+      float z = zc + zx * px + zy * py;
+      if (z < row[x])
+        row[x] = z;
+    }
+  }
+#endif
+}
+
+void occlusion_add_quad(OcclusionBuffer *ob, const Vec3 corners[4]) {
+  ClipVert in[4];
+  for (int i = 0; i < 4; i++)
+    in[i] = transform(&ob->view_proj, corners[i]);
+
+  // Sutherland-Hodgman against the near plane (z >= -w).
+  ClipVert out[5];
+  int n = 0;
+  for (int i = 0; i < 4; i++) {
+    ClipVert a = in[i];
+    ClipVert b = in[(i + 1) & 3];
+    float da = a.z + a.w;
+    float db = b.z + b.w;
+    if (da >= 0.0f)
+      out[n++] = a;
+    if ((da >= 0.0f) != (db >= 0.0f)) {
+      float t = da / (da - db);
+      out[n++] = (ClipVert){a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t,
+                            a.z + (b.z - a.z) * t, a.w + (b.w - a.w) * t};
+    }
+  }
+  if (n < 3)
+    return;
+
+  ScreenVert s[5];
+  for (int i = 0; i < n; i++) {
+    if (out[i].w <= 1e-6f)
+      return;
+    s[i] = to_screen(out[i]);
+  }
+
+  ob->stats.occluders++;
+  for (int i = 1; i < n - 1; i++)
+    raster_triangle(ob, s[0], s[i], s[i + 1]);
+}
+
+void occlusion_build_pyramid(OcclusionBuffer *ob) {
+  for (int l = 1; l < ob->level_count; l++) {
+    const float *src = ob->levels[l - 1];
+    float *dst = ob->levels[l];
+    int sw = ob->level_w[l - 1];
+    int w = ob->level_w[l];
+    int h = ob->level_h[l];
+    for (int y = 0; y < h; y++) {
+      const float *r0 = src + (size_t)(y * 2) * sw;
+      const float *r1 = r0 + sw;
+      for (int x = 0; x < w; x++) {
+        float a = fmaxf(r0[x * 2], r0[x * 2 + 1]);
+        float b = fmaxf(r1[x * 2], r1[x * 2 + 1]);
+        dst[(size_t)y * w + x] = fmaxf(a, b);
+      }
+    }
+  }
+}
+
+bool occlusion_test_box(OcclusionBuffer *ob, Vec3 min, Vec3 max) {
+  ob->stats.tested++;
+
+  float sx0 = FLT_MAX, sy0 = FLT_MAX, sx1 = -FLT_MAX, sy1 = -FLT_MAX;
+  float zmin = FLT_MAX;
+  unsigned all_out = 0x3f;
+  bool crosses_near = false;
+
+  for (int i = 0; i < 8; i++) {
+    Vec3 p = v3((i & 1) ? max.x : min.x, (i & 2) ? max.y : min.y,
+                (i & 4) ? max.z : min.z);
+    ClipVert c = transform(&ob->view_proj, p);
+
+    unsigned code = 0;
+    code |= (c.x < -c.w) ? 1u : 0u;
+    code |= (c.x > c.w) ? 2u : 0u;
+    code |= (c.y < -c.w) ? 4u : 0u;
+    code |= (c.y > c.w) ? 8u : 0u;
+    code |= (c.z < -c.w) ? 16u : 0u;
+    code |= (c.z > c.w) ? 32u : 0u;
+    all_out &= code;
+
+    if (c.z < -c.w || c.w <= 1e-6f) {
+      crosses_near = true;
+      continue;
+    }
+    ScreenVert s = to_screen(c);
+    sx0 = fminf(sx0, s.x);
+    sy0 = fminf(sy0, s.y);
+    sx1 = fmaxf(sx1, s.x);
+    sy1 = fmaxf(sy1, s.y);
+    zmin = fminf(zmin, s.z);
+  }
+
+  if (all_out) {
+    ob->stats.frustum_rejected++;
+    return false;
+  }
+  if (crosses_near)
+    return true;
+
+  int x0 = (int)floorf(fmaxf(sx0, 0.0f));
+  int y0 = (int)floorf(fmaxf(sy0, 0.0f));
+  int x1 = (int)floorf(fminf(sx1, (float)(OCC_WIDTH - 1)));
+  int y1 = (int)floorf(fminf(sy1, (float)(OCC_HEIGHT - 1)));
+  if (x0 > x1 || y0 > y1)
+    return true;
+
+  // Pick the level where the rectangle spans at most about four texels.
+  int size = (x1 - x0 > y1 - y0) ? x1 - x0 : y1 - y0;
+  int l = 0;
+  while (l + 1 < ob->level_count && (size >> l) > 3)
+    l++;
+
+  const float *level = ob->levels[l];
+  int lw = ob->level_w[l];
+  for (int ty = y0 >> l; ty <= (y1 >> l); ty++) {
+    for (int tx = x0 >> l; tx <= (x1 >> l); tx++) {
+      if (level[(size_t)ty * lw + tx] >= zmin)
+        return true;
+    }
+  }
+
+  ob->stats.occlusion_rejected++;
+  return false;
+}
@@ -0,0 +1,50 @@
+#ifndef OCCLUSION_H
+#define OCCLUSION_H
+
+#include <stdbool.h>
+
+#include "../math/mat4.h"
+#include "../math/vec3.h"
+
+enum {
+  OCC_WIDTH = 256,
+  OCC_HEIGHT = 128,
+  OCC_MAX_LEVELS = 8,
+};
+
+typedef struct OcclusionStats {
+  int occluders;
+  int triangles;
+  int tested;
+  int frustum_rejected;
+  int occlusion_rejected;
+} OcclusionStats;
+
+// Low-resolution software depth buffer (NDC depth in [0, 1], 1 = empty)
+// plus a pyramid where every texel holds the farthest depth of the four
+// below it. A box is hidden when, at the level where it covers only a few
+// texels, its nearest point lies behind every texel it touches.
+typedef struct OcclusionBuffer {
+  float *levels[OCC_MAX_LEVELS];
+  int level_w[OCC_MAX_LEVELS];
+  int level_h[OCC_MAX_LEVELS];
+  int level_count;
+  Mat4 view_proj;
+  OcclusionStats stats;
+} OcclusionBuffer;
+
+bool occlusion_init(OcclusionBuffer *ob);
+void occlusion_destroy(OcclusionBuffer *ob);
+
+// Clears depth and stats for a new view.
+void occlusion_begin(OcclusionBuffer *ob, const Mat4 *view_proj);
+
+// Rasterizes a planar convex quad (corners in order), clipped at the near
+// plane. Call occlusion_build_pyramid once all occluders are in.
+void occlusion_add_quad(OcclusionBuffer *ob, const Vec3 corners[4]);
+void occlusion_build_pyramid(OcclusionBuffer *ob);
+
+// False when the box is outside the frustum or behind the occluders.
+bool occlusion_test_box(OcclusionBuffer *ob, Vec3 min, Vec3 max);
+
+#endif // !OCCLUSION_H
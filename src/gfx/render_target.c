@@ -0,0 +1,68 @@
+#include "render_target.h"
+
+#include <stdio.h>
+#include <string.h>
+
+bool render_target_create(RenderTarget *rt, int w, int h) {
+  memset(rt, 0, sizeof(*rt));
+  if (w < 1)
+    w = 1;
+  if (h < 1)
+    h = 1;
+
+  glGenTextures(1, &rt->color);
+  glBindTexture(GL_TEXTURE_2D, rt->color);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+               NULL);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  glGenRenderbuffers(1, &rt->depth);
+  glBindRenderbuffer(GL_RENDERBUFFER, rt->depth);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, w, h);
+  glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+  glGenFramebuffers(1, &rt->fbo);
+  glBindFramebuffer(GL_FRAMEBUFFER, rt->fbo);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                         rt->color, 0);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT,
+                            GL_RENDERBUFFER, rt->depth);
+
+  GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+  if (status != GL_FRAMEBUFFER_COMPLETE) {
+    fprintf(stderr, "Render target incomplete: 0x%x\n", status);
+    render_target_destroy(rt);
+    return false;
+  }
+
+  rt->width = w;
+  rt->height = h;
+  return true;
+}
+
+void render_target_destroy(RenderTarget *rt) {
+  if (!rt)
+    return;
+  if (rt->fbo)
+    glDeleteFramebuffers(1, &rt->fbo);
+  if (rt->depth)
+    glDeleteRenderbuffers(1, &rt->depth);
+  if (rt->color)
+    glDeleteTextures(1, &rt->color);
+  memset(rt, 0, sizeof(*rt));
+}
+
+void render_target_blit(const RenderTarget *rt, int src_w, int src_h,
+                        int dst_w, int dst_h) {
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, rt->fbo);
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+  glBlitFramebuffer(0, 0, src_w, src_h, 0, 0, dst_w, dst_h,
+                    GL_COLOR_BUFFER_BIT, GL_LINEAR);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
@@ -0,0 +1,21 @@
+#ifndef RENDER_TARGET_H
+#define RENDER_TARGET_H
+
+#include <glad/glad.h>
+#include <stdbool.h>
+
+typedef struct RenderTarget {
+  GLuint fbo;
+  GLuint color;
+  GLuint depth;
+  int width;
+  int height;
+} RenderTarget;
+
+bool render_target_create(RenderTarget *rt, int w, int h);
+void render_target_destroy(RenderTarget *rt);
+
+void render_target_blit(const RenderTarget *rt, int src_w, int src_h,
+                        int dst_w, int dst_h);
+
+#endif // !RENDER_TARGET_H
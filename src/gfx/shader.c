@@ -1,11 +1,32 @@
 #include "shader.h"
+#include "../core/mem.h"
 
 #include <stdio.h>
-#include <stdlib.h>
+#include <string.h>
+
+static bool compile_stage(GLuint *out_shader, GLenum type, const char *src,
+                          const char *defines) {
+  const char *parts[3];
+  GLint lens[3];
+  GLsizei count = 0;
+
+  // Defines have to follow the #version line, so split the source there.
+  const char *body = src;
+  if (defines && defines[0] && strncmp(src, "#version", 8) == 0) {
+    const char *nl = strchr(src, '\n');
+    body = nl ? nl + 1 : src + strlen(src);
+    parts[count] = src;
+    lens[count++] = (GLint)(body - src);
+  }
+  if (defines && defines[0]) {
+    parts[count] = defines;
+    lens[count++] = (GLint)strlen(defines);
+  }
+  parts[count] = body;
+  lens[count++] = (GLint)strlen(body);
 
-static bool compile_stage(GLuint *out_shader, GLenum type, const char *src) {
   GLuint sh = glCreateShader(type);
-  glShaderSource(sh, 1, &src, NULL);
+  glShaderSource(sh, count, parts, lens);
   glCompileShader(sh);
 
   GLint ok = 0;
@@ -13,12 +34,12 @@ static bool compile_stage(GLuint *out_shader, GLenum type, const char *src) {
   if (!ok) {
     GLint len = 0;
     glGetShaderiv(sh, GL_INFO_LOG_LENGTH, &len);
-    char *log = (char *)malloc((size_t)len + 1);
+    char *log = (char *)mem_alloc((size_t)len + 1);
     if (log) {
       glGetShaderInfoLog(sh, len, NULL, log);
       log[len] = 0;
       fprintf(stderr, "Shader compile error:\n%s\n", log);
-      free(log);
+      mem_free(log);
     }
     glDeleteShader(sh);
     return false;
@@ -28,18 +49,40 @@ static bool compile_stage(GLuint *out_shader, GLenum type, const char *src) {
   return true;
 }
 
-bool shader_build(ShaderProgram *out, const char *vs_src, const char *fs_src) {
+bool shader_check_link(GLuint prog) {
+  GLint ok = 0;
+  glGetProgramiv(prog, GL_LINK_STATUS, &ok);
+  if (ok)
+    return true;
+
+  GLint len = 0;
+  glGetProgramiv(prog, GL_INFO_LOG_LENGTH, &len);
+  char *log = (char *)mem_alloc((size_t)len + 1);
+  if (log) {
+    glGetProgramInfoLog(prog, len, NULL, log);
+    log[len] = 0;
+    fprintf(stderr, "Program link error:\n%s\n", log);
+    mem_free(log);
+  }
+  return false;
+}
+
+bool shader_build_ex(ShaderProgram *out, const char *vs_src,
+                     const char *fs_src, const char *defines,
+                     bool retrievable) {
   GLuint vs = 0;
   GLuint fs = 0;
 
-  if (!compile_stage(&vs, GL_VERTEX_SHADER, vs_src))
+  if (!compile_stage(&vs, GL_VERTEX_SHADER, vs_src, defines))
     return false;
-  if (!compile_stage(&fs, GL_FRAGMENT_SHADER, fs_src)) {
+  if (!compile_stage(&fs, GL_FRAGMENT_SHADER, fs_src, defines)) {
     glDeleteShader(vs);
     return false;
   }
 
   GLuint prog = glCreateProgram();
+  if (retrievable && glProgramParameteri)
+    glProgramParameteri(prog, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
   glAttachShader(prog, vs);
   glAttachShader(prog, fs);
   glLinkProgram(prog);
@@ -47,18 +90,7 @@ bool shader_build(ShaderProgram *out, const char *vs_src, const char *fs_src) {
   glDeleteShader(vs);
   glDeleteShader(fs);
 
-  GLint ok = 0;
-  glGetProgramiv(prog, GL_LINK_STATUS, &ok);
-  if (!ok) {
-    GLint len = 0;
-    glGetProgramiv(prog, GL_LINK_STATUS, &ok);
-    char *log = (char *)malloc((size_t)len + 1);
-    if (log) {
-      glGetProgramInfoLog(prog, len, NULL, log);
-      log[len] = 0;
-      fprintf(stderr, "Program link error:\n%s\n", log);
-      free(log);
-    }
+  if (!shader_check_link(prog)) {
     glDeleteProgram(prog);
     return false;
   }
@@ -67,6 +99,32 @@ bool shader_build(ShaderProgram *out, const char *vs_src, const char *fs_src) {
   return true;
 }
 
+bool shader_build_compute(ShaderProgram *out, const char *cs_src,
+                          const char *defines, bool retrievable) {
+  GLuint cs = 0;
+  if (!compile_stage(&cs, GL_COMPUTE_SHADER, cs_src, defines))
+    return false;
+
+  GLuint prog = glCreateProgram();
+  if (retrievable && glProgramParameteri)
+    glProgramParameteri(prog, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+  glAttachShader(prog, cs);
+  glLinkProgram(prog);
+  glDeleteShader(cs);
+
+  if (!shader_check_link(prog)) {
+    glDeleteProgram(prog);
+    return false;
+  }
+
+  out->program = prog;
+  return true;
+}
+
+bool shader_build(ShaderProgram *out, const char *vs_src, const char *fs_src) {
+  return shader_build_ex(out, vs_src, fs_src, NULL, false);
+}
+
 void shader_destroy(ShaderProgram *s) {
   if (s && s->program) {
     glDeleteProgram(s->program);
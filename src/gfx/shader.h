@@ -9,6 +9,13 @@ typedef struct ShaderProgram {
 } ShaderProgram;
 
 bool shader_build(ShaderProgram *out, const char *vs_src, const char *fs_src);
+bool shader_build_ex(ShaderProgram *out, const char *vs_src,
+                     const char *fs_src, const char *defines,
+                     bool retrievable);
+// GL 4.3 compute program from a single stage.
+bool shader_build_compute(ShaderProgram *out, const char *cs_src,
+                          const char *defines, bool retrievable);
+bool shader_check_link(GLuint prog);
 void shader_destroy(ShaderProgram *s);
 
 #endif // !SHADER_H
@@ -0,0 +1,366 @@
+#include "shader_cache.h"
+#include "shader.h"
+#include "../core/mem.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#define make_dir(path) _mkdir(path)
+#else
+#define make_dir(path) mkdir(path, 0755)
+#endif
+
+enum { SHADER_CACHE_MAX = 32, SHADER_PATH_MAX = 512, SHADER_DEFINES_MAX = 256 };
+
+static const char k_binary_magic[4] = {'D', 'S', 'H', 'B'};
+
+typedef struct BinaryHeader {
+  char magic[4];
+  uint32_t format;
+  uint32_t length;
+  uint32_t reserved;
+  uint64_t key;
+} BinaryHeader;
+
+// Compute entries keep their single stage in vs_name and leave fs_name
+// empty.
+typedef struct ShaderEntry {
+  char vs_name[64];
+  char fs_name[64];
+  char defines[SHADER_DEFINES_MAX];
+  time_t vs_mtime;
+  time_t fs_mtime;
+  ShaderProgram prog;
+} ShaderEntry;
+
+typedef struct ShaderCacheState {
+  char shader_dir[SHADER_PATH_MAX];
+  char cache_dir[SHADER_PATH_MAX];
+  bool binaries;
+  uint64_t driver_hash;
+  ShaderEntry entries[SHADER_CACHE_MAX];
+  int count;
+} ShaderCacheState;
+
+static ShaderCacheState g;
+
+static uint64_t fnv1a(uint64_t h, const void *data, size_t len) {
+  const unsigned char *p = (const unsigned char *)data;
+  for (size_t i = 0; i < len; i++) {
+    h ^= p[i];
+    h *= 1099511628211ull;
+  }
+  return h;
+}
+
+static uint64_t fnv1a_str(uint64_t h, const char *s) {
+  // Hash the terminator too so ("ab","c") and ("a","bc") differ.
+  return fnv1a(h, s ? s : "", s ? strlen(s) + 1 : 1);
+}
+
+static time_t file_mtime(const char *path) {
+  struct stat st;
+  if (stat(path, &st) != 0)
+    return 0;
+  return st.st_mtime;
+}
+
+static char *read_file(const char *path) {
+  FILE *f = fopen(path, "rb");
+  if (!f) {
+    fprintf(stderr, "Failed to open shader %s\n", path);
+    return NULL;
+  }
+
+  fseek(f, 0, SEEK_END);
+  long size = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  if (size < 0) {
+    fclose(f);
+    return NULL;
+  }
+
+  char *buf = (char *)mem_alloc((size_t)size + 1);
+  if (buf && fread(buf, 1, (size_t)size, f) != (size_t)size) {
+    mem_free(buf);
+    buf = NULL;
+  }
+  fclose(f);
+
+  if (buf)
+    buf[size] = 0;
+  return buf;
+}
+
+static void expand_defines(const char *list, char *out, size_t cap) {
+  size_t at = 0;
+  out[0] = 0;
+  if (!list)
+    return;
+
+  const char *p = list;
+  while (*p) {
+    while (*p == ' ')
+      p++;
+    const char *start = p;
+    while (*p && *p != ' ')
+      p++;
+    if (p == start)
+      break;
+
+    int n = snprintf(out + at, cap - at, "#define %.*s\n", (int)(p - start),
+                     start);
+    if (n < 0 || (size_t)n >= cap - at)
+      break;
+    at += (size_t)n;
+  }
+}
+
+static void binary_path(char *out, size_t cap, uint64_t key) {
+  snprintf(out, cap, "%s/%016llx.bin", g.cache_dir, (unsigned long long)key);
+}
+
+static bool load_binary(ShaderProgram *out, uint64_t key) {
+  char path[SHADER_PATH_MAX + 32];
+  binary_path(path, sizeof(path), key);
+
+  FILE *f = fopen(path, "rb");
+  if (!f)
+    return false;
+
+  BinaryHeader hdr;
+  void *data = NULL;
+  bool ok = fread(&hdr, sizeof(hdr), 1, f) == 1 &&
+            memcmp(hdr.magic, k_binary_magic, 4) == 0 && hdr.key == key &&
+            hdr.length > 0;
+  if (ok) {
+    data = mem_alloc(hdr.length);
+    ok = data && fread(data, 1, hdr.length, f) == hdr.length;
+  }
+  fclose(f);
+
+  if (!ok) {
+    mem_free(data);
+    return false;
+  }
+
+  GLuint prog = glCreateProgram();
+  glProgramBinary(prog, hdr.format, data, (GLsizei)hdr.length);
+  mem_free(data);
+
+  // A driver update invalidates binaries; fall back to compiling quietly.
+  GLint linked = 0;
+  glGetProgramiv(prog, GL_LINK_STATUS, &linked);
+  if (!linked) {
+    glDeleteProgram(prog);
+    return false;
+  }
+
+  out->program = prog;
+  return true;
+}
+
+static void save_binary(const ShaderProgram *prog, uint64_t key) {
+  GLint len = 0;
+  glGetProgramiv(prog->program, GL_PROGRAM_BINARY_LENGTH, &len);
+  if (len <= 0)
+    return;
+
+  void *data = mem_alloc((size_t)len);
+  if (!data)
+    return;
+
+  BinaryHeader hdr;
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic, k_binary_magic, 4);
+  hdr.key = key;
+
+  GLenum format = 0;
+  GLsizei written = 0;
+  glGetProgramBinary(prog->program, len, &written, &format, data);
+  hdr.format = format;
+  hdr.length = (uint32_t)written;
+
+  char path[SHADER_PATH_MAX + 32];
+  binary_path(path, sizeof(path), key);
+
+  FILE *f = written > 0 ? fopen(path, "wb") : NULL;
+  if (f) {
+    fwrite(&hdr, sizeof(hdr), 1, f);
+    fwrite(data, 1, (size_t)written, f);
+    fclose(f);
+  }
+  mem_free(data);
+}
+
+static bool is_compute(const ShaderEntry *e) { return e->fs_name[0] == 0; }
+
+static bool build_entry(ShaderEntry *e, bool *from_binary) {
+  char vs_path[SHADER_PATH_MAX + 64];
+  char fs_path[SHADER_PATH_MAX + 64];
+  bool compute = is_compute(e);
+  snprintf(vs_path, sizeof(vs_path), "%s/%s", g.shader_dir, e->vs_name);
+  snprintf(fs_path, sizeof(fs_path), "%s/%s", g.shader_dir, e->fs_name);
+
+  e->vs_mtime = file_mtime(vs_path);
+  e->fs_mtime = compute ? 0 : file_mtime(fs_path);
+
+  char *vs = read_file(vs_path);
+  char *fs = compute ? NULL : read_file(fs_path);
+  if (!vs || (!compute && !fs)) {
+    mem_free(vs);
+    mem_free(fs);
+    return false;
+  }
+
+  char defines[SHADER_DEFINES_MAX * 2];
+  expand_defines(e->defines, defines, sizeof(defines));
+
+  uint64_t key = g.driver_hash;
+  key = fnv1a_str(key, vs);
+  key = fnv1a_str(key, fs);
+  key = fnv1a_str(key, defines);
+
+  ShaderProgram prog = {0};
+  bool ok = false;
+  *from_binary = false;
+
+  if (g.binaries && load_binary(&prog, key)) {
+    *from_binary = true;
+    ok = true;
+  } else if (compute ? shader_build_compute(&prog, vs, defines, g.binaries)
+                     : shader_build_ex(&prog, vs, fs, defines, g.binaries)) {
+    if (g.binaries)
+      save_binary(&prog, key);
+    ok = true;
+  }
+
+  mem_free(vs);
+  mem_free(fs);
+
+  if (!ok)
+    return false;
+
+  shader_destroy(&e->prog);
+  e->prog = prog;
+  return true;
+}
+
+bool shader_cache_init(const char *shader_dir, const char *cache_dir) {
+  memset(&g, 0, sizeof(g));
+  snprintf(g.shader_dir, sizeof(g.shader_dir), "%s", shader_dir);
+
+  g.driver_hash = 14695981039346656037ull;
+  g.driver_hash =
+      fnv1a_str(g.driver_hash, (const char *)glGetString(GL_VENDOR));
+  g.driver_hash =
+      fnv1a_str(g.driver_hash, (const char *)glGetString(GL_RENDERER));
+  g.driver_hash =
+      fnv1a_str(g.driver_hash, (const char *)glGetString(GL_VERSION));
+
+  GLint formats = 0;
+  if (GLAD_GL_VERSION_4_1)
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+
+  if (cache_dir && formats > 0) {
+    snprintf(g.cache_dir, sizeof(g.cache_dir), "%s", cache_dir);
+    make_dir(g.cache_dir);
+    g.binaries = true;
+  }
+
+  printf("Shader dir     : %s\n", g.shader_dir);
+  printf("Shader binaries: %s\n", g.binaries ? g.cache_dir : "unsupported");
+  return true;
+}
+
+void shader_cache_shutdown(void) {
+  for (int i = 0; i < g.count; i++)
+    shader_destroy(&g.entries[i].prog);
+  memset(&g, 0, sizeof(g));
+}
+
+static int load_entry(const char *vs_name, const char *fs_name,
+                      const char *defines) {
+  const char *defs = defines ? defines : "";
+
+  for (int i = 0; i < g.count; i++) {
+    ShaderEntry *e = &g.entries[i];
+    if (strcmp(e->vs_name, vs_name) == 0 &&
+        strcmp(e->fs_name, fs_name) == 0 && strcmp(e->defines, defs) == 0)
+      return i;
+  }
+
+  if (g.count >= SHADER_CACHE_MAX) {
+    fprintf(stderr, "Shader cache full\n");
+    return -1;
+  }
+
+  ShaderEntry *e = &g.entries[g.count];
+  memset(e, 0, sizeof(*e));
+  snprintf(e->vs_name, sizeof(e->vs_name), "%s", vs_name);
+  snprintf(e->fs_name, sizeof(e->fs_name), "%s", fs_name);
+  snprintf(e->defines, sizeof(e->defines), "%s", defs);
+
+  bool from_binary = false;
+  if (!build_entry(e, &from_binary)) {
+    fprintf(stderr, "Failed to build shader %s + %s [%s]\n", vs_name, fs_name,
+            defs);
+    return -1;
+  }
+
+  printf("Shader %s + %s [%s]: %s\n", vs_name, fs_name, defs,
+         from_binary ? "cached binary" : "compiled");
+  return g.count++;
+}
+
+int shader_cache_load(const char *vs_name, const char *fs_name,
+                      const char *defines) {
+  return load_entry(vs_name, fs_name, defines);
+}
+
+int shader_cache_load_compute(const char *cs_name, const char *defines) {
+  if (!GLAD_GL_VERSION_4_3)
+    return -1;
+  return load_entry(cs_name, "", defines);
+}
+
+GLuint shader_cache_program(int handle) {
+  if (handle < 0 || handle >= g.count)
+    return 0;
+  return g.entries[handle].prog.program;
+}
+
+bool shader_cache_reload_changed(void) {
+  bool changed = false;
+  char path[SHADER_PATH_MAX + 64];
+
+  for (int i = 0; i < g.count; i++) {
+    ShaderEntry *e = &g.entries[i];
+
+    snprintf(path, sizeof(path), "%s/%s", g.shader_dir, e->vs_name);
+    time_t vs_mtime = file_mtime(path);
+    snprintf(path, sizeof(path), "%s/%s", g.shader_dir, e->fs_name);
+    time_t fs_mtime = is_compute(e) ? 0 : file_mtime(path);
+
+    if (vs_mtime == e->vs_mtime && fs_mtime == e->fs_mtime)
+      continue;
+
+    bool from_binary = false;
+    if (build_entry(e, &from_binary)) {
+      printf("Reloaded shader %s + %s [%s]\n", e->vs_name, e->fs_name,
+             e->defines);
+      changed = true;
+    } else {
+      // Keep the last good program; retry once the file changes again.
+      fprintf(stderr, "Keeping previous %s + %s [%s]\n", e->vs_name,
+              e->fs_name, e->defines);
+    }
+  }
+
+  return changed;
+}
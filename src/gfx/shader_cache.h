@@ -0,0 +1,19 @@
+#ifndef SHADER_CACHE_H
+#define SHADER_CACHE_H
+
+#include <glad/glad.h>
+#include <stdbool.h>
+
+bool shader_cache_init(const char *shader_dir, const char *cache_dir);
+void shader_cache_shutdown(void);
+
+// defines is a space separated list of macro names, or NULL.
+int shader_cache_load(const char *vs_name, const char *fs_name,
+                      const char *defines);
+// Compute programs share the cache; needs a GL 4.3 context.
+int shader_cache_load_compute(const char *cs_name, const char *defines);
+GLuint shader_cache_program(int handle);
+
+bool shader_cache_reload_changed(void);
+
+#endif // !SHADER_CACHE_H
@@ -0,0 +1,240 @@
+#include "sprite_batch.h"
+#include "../core/mem.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+enum { INST_FLOATS = 10 };
+
+static bool grow(SpriteBatch *b, int capacity) {
+  float **fields[] = {&b->x,  &b->y,  &b->z,  &b->w,  &b->h,
+                      &b->u0, &b->v0, &b->u1, &b->v1, &b->light};
+  for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+    float *p =
+        (float *)mem_realloc(*fields[i], (size_t)capacity * sizeof(float));
+    if (!p)
+      return false;
+    *fields[i] = p;
+  }
+
+  unsigned char *blend =
+      (unsigned char *)mem_realloc(b->blend, (size_t)capacity);
+  if (!blend)
+    return false;
+  b->blend = blend;
+
+  float *inst = (float *)mem_realloc(
+      b->instances, (size_t)capacity * INST_FLOATS * sizeof(float));
+  if (!inst)
+    return false;
+  b->instances = inst;
+
+  float *keys = (float *)mem_realloc(
+      b->sort_keys, (size_t)capacity * sizeof(float));
+  if (!keys)
+    return false;
+  b->sort_keys = keys;
+
+  int *order =
+      (int *)mem_realloc(b->sort_order, (size_t)capacity * sizeof(int));
+  if (!order)
+    return false;
+  b->sort_order = order;
+
+  b->capacity = capacity;
+  return true;
+}
+
+static void bind_instance_attribs(int first) {
+  GLsizei stride = (GLsizei)(INST_FLOATS * sizeof(float));
+  size_t base = (size_t)first * INST_FLOATS * sizeof(float);
+
+  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void *)base);
+  glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride,
+                        (void *)(base + 3 * sizeof(float)));
+  glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, stride,
+                        (void *)(base + 5 * sizeof(float)));
+  glVertexAttribPointer(4, 1, GL_FLOAT, GL_FALSE, stride,
+                        (void *)(base + 9 * sizeof(float)));
+}
+
+bool sprite_batch_init(SpriteBatch *b, int capacity) {
+  memset(b, 0, sizeof(*b));
+  if (capacity < 16)
+    capacity = 16;
+  if (!grow(b, capacity)) {
+    sprite_batch_destroy(b);
+    return false;
+  }
+
+  const float quad[] = {
+      -0.5f, 0.0f, 0.5f, 0.0f, -0.5f, 1.0f, 0.5f, 1.0f,
+  };
+
+  glGenVertexArrays(1, &b->vao);
+  glGenBuffers(1, &b->quad_vbo);
+  glGenBuffers(1, &b->inst_vbo);
+
+  glBindVertexArray(b->vao);
+
+  glBindBuffer(GL_ARRAY_BUFFER, b->quad_vbo);
+  glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)sizeof(quad), quad,
+               GL_STATIC_DRAW);
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float),
+                        (void *)0);
+
+  glBindBuffer(GL_ARRAY_BUFFER, b->inst_vbo);
+  for (GLuint a = 1; a <= 4; a++) {
+    glEnableVertexAttribArray(a);
+    glVertexAttribDivisor(a, 1);
+  }
+  bind_instance_attribs(0);
+
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glBindVertexArray(0);
+
+  return true;
+}
+
+void sprite_batch_destroy(SpriteBatch *b) {
+  if (!b)
+    return;
+
+  mem_free(b->x);
+  mem_free(b->y);
+  mem_free(b->z);
+  mem_free(b->w);
+  mem_free(b->h);
+  mem_free(b->u0);
+  mem_free(b->v0);
+  mem_free(b->u1);
+  mem_free(b->v1);
+  mem_free(b->light);
+  mem_free(b->blend);
+  mem_free(b->instances);
+  mem_free(b->sort_keys);
+  mem_free(b->sort_order);
+
+  if (b->inst_vbo)
+    glDeleteBuffers(1, &b->inst_vbo);
+  if (b->quad_vbo)
+    glDeleteBuffers(1, &b->quad_vbo);
+  if (b->vao)
+    glDeleteVertexArrays(1, &b->vao);
+
+  memset(b, 0, sizeof(*b));
+}
+
+void sprite_batch_clear(SpriteBatch *b) {
+  b->count = 0;
+  b->cutout_count = 0;
+  b->translucent_count = 0;
+}
+
+bool sprite_batch_push(SpriteBatch *b, Vec3 pos, float w, float h,
+                       AtlasRect rect, float light, SpriteBlend blend) {
+  if (b->count == b->capacity && !grow(b, b->capacity * 2))
+    return false;
+
+  int i = b->count++;
+  b->x[i] = pos.x;
+  b->y[i] = pos.y;
+  b->z[i] = pos.z;
+  b->w[i] = w;
+  b->h[i] = h;
+  b->u0[i] = rect.u0;
+  b->v0[i] = rect.v0;
+  b->u1[i] = rect.u1;
+  b->v1[i] = rect.v1;
+  b->light[i] = light;
+  b->blend[i] = (unsigned char)blend;
+  return true;
+}
+
+static const float *g_sort_keys;
+
+static int cmp_back_to_front(const void *pa, const void *pb) {
+  float ka = g_sort_keys[*(const int *)pa];
+  float kb = g_sort_keys[*(const int *)pb];
+  return (ka < kb) - (ka > kb);
+}
+
+static void write_instance(const SpriteBatch *b, int src, int dst) {
+  float *o = &b->instances[(size_t)dst * INST_FLOATS];
+  o[0] = b->x[src];
+  o[1] = b->y[src];
+  o[2] = b->z[src];
+  o[3] = b->w[src];
+  o[4] = b->h[src];
+  o[5] = b->u0[src];
+  o[6] = b->v0[src];
+  o[7] = b->u1[src];
+  o[8] = b->v1[src];
+  o[9] = b->light[src];
+}
+
+void sprite_batch_upload(SpriteBatch *b, Vec3 cam_pos, Vec3 cam_forward) {
+  int at = 0;
+  int nt = 0;
+
+  for (int i = 0; i < b->count; i++) {
+    if (b->blend[i] == SPRITE_CUTOUT) {
+      write_instance(b, i, at++);
+    } else {
+      b->sort_keys[i] = (b->x[i] - cam_pos.x) * cam_forward.x +
+                        (b->y[i] - cam_pos.y) * cam_forward.y +
+                        (b->z[i] - cam_pos.z) * cam_forward.z;
+      b->sort_order[nt++] = i;
+    }
+  }
+
+  b->cutout_count = at;
+  b->translucent_count = nt;
+
+  if (nt > 1) {
+    g_sort_keys = b->sort_keys;
+    qsort(b->sort_order, (size_t)nt, sizeof(int), cmp_back_to_front);
+    g_sort_keys = NULL;
+  }
+  for (int i = 0; i < nt; i++)
+    write_instance(b, b->sort_order[i], at++);
+
+  if (at == 0)
+    return;
+
+  size_t bytes = (size_t)at * INST_FLOATS * sizeof(float);
+  glBindBuffer(GL_ARRAY_BUFFER, b->inst_vbo);
+  if (b->inst_capacity < b->capacity)
+    b->inst_capacity = b->capacity;
+  glBufferData(GL_ARRAY_BUFFER,
+               (GLsizeiptr)((size_t)b->inst_capacity * INST_FLOATS *
+                            sizeof(float)),
+               NULL, GL_STREAM_DRAW);
+  glBufferSubData(GL_ARRAY_BUFFER, 0, (GLsizeiptr)bytes, b->instances);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void sprite_batch_draw_cutout(const SpriteBatch *b) {
+  if (b->cutout_count <= 0)
+    return;
+
+  glBindVertexArray(b->vao);
+  glBindBuffer(GL_ARRAY_BUFFER, b->inst_vbo);
+  bind_instance_attribs(0);
+  glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, b->cutout_count);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glBindVertexArray(0);
+}
+
+void sprite_batch_draw_translucent(const SpriteBatch *b) {
+  if (b->translucent_count <= 0)
+    return;
+
+  glBindVertexArray(b->vao);
+  glBindBuffer(GL_ARRAY_BUFFER, b->inst_vbo);
+  bind_instance_attribs(b->cutout_count);
+  glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, b->translucent_count);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glBindVertexArray(0);
+}
@@ -0,0 +1,54 @@
+#ifndef SPRITE_BATCH_H
+#define SPRITE_BATCH_H
+
+#include <glad/glad.h>
+#include <stdbool.h>
+
+#include "../math/vec3.h"
+
+typedef struct AtlasRect {
+  float u0, v0;
+  float u1, v1;
+} AtlasRect;
+
+typedef enum SpriteBlend {
+  SPRITE_CUTOUT = 0,
+  SPRITE_TRANSLUCENT = 1,
+} SpriteBlend;
+
+// Per-sprite data is kept as parallel arrays; upload packs it into one
+// instance buffer with cutout sprites first, then translucent back to front.
+typedef struct SpriteBatch {
+  int count;
+  int capacity;
+
+  float *x, *y, *z;
+  float *w, *h;
+  float *u0, *v0, *u1, *v1;
+  float *light;
+  unsigned char *blend;
+
+  float *instances;
+  float *sort_keys;
+  int *sort_order;
+  int cutout_count;
+  int translucent_count;
+
+  GLuint vao;
+  GLuint quad_vbo;
+  GLuint inst_vbo;
+  int inst_capacity;
+} SpriteBatch;
+
+bool sprite_batch_init(SpriteBatch *b, int capacity);
+void sprite_batch_destroy(SpriteBatch *b);
+
+void sprite_batch_clear(SpriteBatch *b);
+bool sprite_batch_push(SpriteBatch *b, Vec3 pos, float w, float h,
+                       AtlasRect rect, float light, SpriteBlend blend);
+
+void sprite_batch_upload(SpriteBatch *b, Vec3 cam_pos, Vec3 cam_forward);
+void sprite_batch_draw_cutout(const SpriteBatch *b);
+void sprite_batch_draw_translucent(const SpriteBatch *b);
+
+#endif // !SPRITE_BATCH_H
@@ -0,0 +1,74 @@
+#include "world_mesh.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#include "../core/mem.h"
+
+bool world_mesh_upload(WorldMesh *m, const MeshData *data) {
+  memset(m, 0, sizeof(*m));
+  size_t n = (size_t)data->range_count;
+  m->sector_first = (int *)mem_alloc(n * 4 * sizeof(int) + 1);
+  if (!m->sector_first)
+    return false;
+  m->sector_count = m->sector_first + n;
+  m->lod_first = m->sector_count + n;
+  m->lod_count = m->lod_first + n;
+  memcpy(m->sector_first, data->sector_first, n * sizeof(int));
+  memcpy(m->sector_count, data->sector_count, n * sizeof(int));
+  memcpy(m->lod_first, data->lod_first, n * sizeof(int));
+  memcpy(m->lod_count, data->lod_count, n * sizeof(int));
+  m->vertex_count = data->vertex_count;
+  m->index_count = data->index_count;
+  m->stats = data->stats;
+
+  glGenVertexArrays(1, &m->vao);
+  glGenBuffers(1, &m->vbo);
+  glGenBuffers(1, &m->ibo);
+
+  glBindVertexArray(m->vao);
+  glBindBuffer(GL_ARRAY_BUFFER, m->vbo);
+  glBufferData(GL_ARRAY_BUFFER,
+               (GLsizeiptr)data->vertex_count *
+                   (GLsizeiptr)sizeof(WorldVertex),
+               data->verts, GL_STATIC_DRAW);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m->ibo);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+               (GLsizeiptr)data->index_count * (GLsizeiptr)sizeof(uint32_t),
+               data->indices, GL_STATIC_DRAW);
+
+  GLsizei stride = (GLsizei)sizeof(WorldVertex);
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride,
+                        (void *)offsetof(WorldVertex, px));
+
+  glEnableVertexAttribArray(1);
+  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride,
+                        (void *)offsetof(WorldVertex, cr));
+
+  glEnableVertexAttribArray(2);
+  glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride,
+                        (void *)offsetof(WorldVertex, u));
+
+  glEnableVertexAttribArray(3);
+  glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, stride,
+                        (void *)offsetof(WorldVertex, lu));
+
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+  return true;
+}
+
+void world_mesh_destroy(WorldMesh *m) {
+  if (!m)
+    return;
+  if (m->vbo)
+    glDeleteBuffers(1, &m->vbo);
+  if (m->ibo)
+    glDeleteBuffers(1, &m->ibo);
+  if (m->vao)
+    glDeleteVertexArrays(1, &m->vao);
+  mem_free(m->sector_first);
+  memset(m, 0, sizeof(*m));
+}
@@ -0,0 +1,28 @@
+#ifndef WORLD_MESH_H
+#define WORLD_MESH_H
+
+#include <glad/glad.h>
+#include <stdbool.h>
+
+#include "../geom/mesh_data.h"
+
+// GPU copy of a MeshData plus the per-sector index ranges the renderer
+// draws from (see MeshData for their meaning).
+typedef struct WorldMesh {
+  GLuint vao;
+  GLuint vbo;
+  GLuint ibo;
+  int vertex_count;
+  int index_count;
+  int *sector_first;
+  int *sector_count;
+  int *lod_first;
+  int *lod_count;
+  MeshOptStats stats;
+} WorldMesh;
+
+// Uploads the arrays as they are; nothing is rebuilt or converted.
+bool world_mesh_upload(WorldMesh *m, const MeshData *data);
+void world_mesh_destroy(WorldMesh *m);
+
+#endif // !WORLD_MESH_H
@@ -46,3 +46,26 @@ void input_process_event(InputState *in, const SDL_Event *e) {
     break;
   }
 }
+
+PlayerCmd input_player_cmd(const InputState *in) {
+  PlayerCmd cmd = {0};
+  if (in->key_down[SDL_SCANCODE_W])
+    cmd.buttons |= PLAYER_BTN_FORWARD;
+  if (in->key_down[SDL_SCANCODE_S])
+    cmd.buttons |= PLAYER_BTN_BACK;
+  if (in->key_down[SDL_SCANCODE_A])
+    cmd.buttons |= PLAYER_BTN_STRAFE_LEFT;
+  if (in->key_down[SDL_SCANCODE_D])
+    cmd.buttons |= PLAYER_BTN_STRAFE_RIGHT;
+  if (in->key_down[SDL_SCANCODE_LEFT])
+    cmd.buttons |= PLAYER_BTN_TURN_LEFT;
+  if (in->key_down[SDL_SCANCODE_RIGHT])
+    cmd.buttons |= PLAYER_BTN_TURN_RIGHT;
+  return cmd;
+}
+
+float input_latch_turn(void) {
+  SDL_PumpEvents();
+  const Uint8 *keys = SDL_GetKeyboardState(NULL);
+  return (float)keys[SDL_SCANCODE_LEFT] - (float)keys[SDL_SCANCODE_RIGHT];
+}
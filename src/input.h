@@ -4,6 +4,8 @@
 #include <SDL2/SDL.h>
 #include <stdbool.h>
 
+#include "game/player.h"
+
 typedef struct InputState {
   bool quit_requested;
   bool key_down[SDL_NUM_SCANCODES];
@@ -17,5 +19,10 @@ typedef struct InputState {
 void input_init(InputState *in, int w, int h);
 void input_begin_frame(InputState *in);
 void input_process_event(InputState *in, const SDL_Event *e);
+PlayerCmd input_player_cmd(const InputState *in);
+
+// Turn direction held at this moment, +1 left and -1 right, read from the
+// keyboard state rather than the events already polled.
+float input_latch_turn(void);
 
 #endif // !INPUT_H
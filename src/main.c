@@ -1,40 +1,369 @@
 #include <SDL2/SDL.h>
+#include <math.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "camera.h"
 #include "input.h"
 #include "renderer.h"
+#include "replay.h"
 #include "time.h"
 
+#include "core/jobs.h"
+#include "core/mem.h"
+#include "game/ecs.h"
 #include "game/player.h"
+#include "gfx/dynres.h"
+#include "gfx/frame_pacer.h"
 #include "map/map.h"
+#include "map/map_io.h"
+#include "map/package.h"
 
 static void log_sdl_error(const char *msg) {
   fprintf(stderr, "%s: %s\n", msg, SDL_GetError());
 }
 
+enum { MEM_WARMUP_FRAMES = 120 };
+
+static const size_t k_frame_scratch_bytes = 4u << 20;
+
 static Camera g_cam;
 static Mat4 g_vp;
 static Map g_map;
-static Player g_player;
+static MapPackage g_package;
+static bool g_packaged;
+static EcsWorld g_world;
+static int g_comp_player;
+static EntityId g_player_id;
+static SpriteBatch g_sprites;
+static PointLight g_torches[MAX_POINT_LIGHTS];
+static PointLight g_lights[MAX_POINT_LIGHTS];
+static int g_torch_count;
+
+typedef struct Thing {
+  Vec2 pos;
+  SpriteKind kind;
+  float w, h;
+  SpriteBlend blend;
+} Thing;
+
+static const Thing k_things[] = {
+    {{0.6f, 0.6f}, SPRITE_PILLAR, 0.6f, 2.0f, SPRITE_CUTOUT},
+    {{3.4f, 0.6f}, SPRITE_PILLAR, 0.6f, 2.0f, SPRITE_CUTOUT},
+    {{2.0f, 2.0f}, SPRITE_ORB, 0.4f, 0.4f, SPRITE_CUTOUT},
+    {{2.0f, 3.0f}, SPRITE_GLOW, 0.8f, 0.8f, SPRITE_TRANSLUCENT},
+    {{5.0f, 1.0f}, SPRITE_DIAMOND, 0.4f, 0.4f, SPRITE_CUTOUT},
+    {{6.0f, 2.0f}, SPRITE_DIAMOND, 0.4f, 0.4f, SPRITE_CUTOUT},
+    {{7.0f, 3.0f}, SPRITE_DIAMOND, 0.4f, 0.4f, SPRITE_CUTOUT},
+    {{6.0f, 3.0f}, SPRITE_GLOW, 0.8f, 0.8f, SPRITE_TRANSLUCENT},
+};
+
+enum { THING_COUNT = sizeof(k_things) / sizeof(k_things[0]) };
+
+// Sector under each thing on the loaded map, or -1 for none.
+static int g_thing_sector[THING_COUNT];
+
+static bool spawn_world(void) {
+  if (!ecs_init(&g_world))
+    return false;
+  g_comp_player = ecs_register_component(&g_world, sizeof(Player));
+  g_player_id = ecs_spawn(&g_world, ECS_MASK(g_comp_player));
+  if (g_player_id == ECS_NULL) {
+    ecs_shutdown(&g_world);
+    return false;
+  }
+
+  Player *p = (Player *)ecs_get(&g_world, g_player_id, g_comp_player);
+  player_init(p);
+  if (g_packaged) {
+    int s = sector_grid_locate(&g_package.grid, &g_map, p->pos);
+    p->sector = (s >= 0) ? s : 0;
+  }
+  return true;
+}
+
+static const Player *local_player(void) {
+  return (const Player *)ecs_get(&g_world, g_player_id, g_comp_player);
+}
 
 static void game_update(double fixed_dt, const InputState *in) {
-  player_update(&g_player, &g_map, in, (float)fixed_dt);
+  PlayerCmd cmd = input_player_cmd(in);
+  for (EcsIter it = ecs_query(&g_world, ECS_MASK(g_comp_player));
+       ecs_next(&it);) {
+    Player *players = (Player *)ecs_column(&it, g_comp_player);
+    for (int i = 0; i < it.count; i++)
+      player_update(&players[i], &g_map, &cmd, (float)fixed_dt);
+  }
+
+  const Player *p = local_player();
+  g_cam.pos = v3(p->pos.x, player_eye_z(p), p->pos.y);
+  g_cam.yaw = p->yaw;
+}
 
-  g_cam.pos = v3(g_player.pos.x, 1.6f, g_player.pos.y);
-  g_cam.yaw = g_player.yaw;
+static int locate_sector(Vec2 p) {
+  if (g_packaged)
+    return sector_grid_locate(&g_package.grid, &g_map, p);
+  for (int s = 0; s < g_map.sector_count; s++) {
+    if (sector_loop_contains(&g_map, &g_map.sectors[s].loop, p))
+      return s;
+  }
+  return -1;
+}
+
+// The things are laid out for the test map; on any other map those that
+// land outside every sector are left out.
+static void place_things(void) {
+  for (int i = 0; i < THING_COUNT; i++)
+    g_thing_sector[i] = locate_sector(k_things[i].pos);
+}
+
+static void push_things(void) {
+  sprite_batch_clear(&g_sprites);
+
+  for (int i = 0; i < THING_COUNT; i++) {
+    const Thing *t = &k_things[i];
+    if (g_thing_sector[i] < 0)
+      continue;
+    const Sector *sec = &g_map.sectors[g_thing_sector[i]];
+    sprite_batch_push(&g_sprites, v3(t->pos.x, sec->floor_h, t->pos.y), t->w,
+                      t->h, renderer_sprite_rect(t->kind), sec->light_level,
+                      t->blend);
+  }
+}
+
+// Torches at the first-corner centroid of random sectors, a third of the
+// way up.
+static void spawn_torches(int count) {
+  uint32_t rng = 0x9e3779b9u;
+  if (count > MAX_POINT_LIGHTS)
+    count = MAX_POINT_LIGHTS;
+  for (int i = 0; i < count; i++) {
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    const Sector *sec = &g_map.sectors[rng % (uint32_t)g_map.sector_count];
+    if (sec->loop.count < 3)
+      continue;
+    Vec2 a = g_map.verts[sec->loop.indices[0]];
+    Vec2 b = g_map.verts[sec->loop.indices[1]];
+    Vec2 c = g_map.verts[sec->loop.indices[2]];
+    float h = sec->floor_h + (sec->ceil_h - sec->floor_h) / 3.0f;
+    float hue = (float)(rng >> 8 & 0xff) / 255.0f;
+    g_torches[g_torch_count++] = (PointLight){
+        v3((a.x + b.x + c.x) / 3.0f, h, (a.y + b.y + c.y) / 3.0f),
+        2.5f + 1.5f * hue, v3(1.0f, 0.45f + 0.3f * hue, 0.15f)};
+  }
+}
+
+static void push_lights(double now) {
+  for (int i = 0; i < g_torch_count; i++) {
+    float t = (float)now * 7.0f + (float)i * 1.7f;
+    g_lights[i] = g_torches[i];
+    g_lights[i].radius *= 0.9f + 0.1f * sinf(t);
+    g_lights[i].pos.y += 0.05f * sinf(t * 0.37f);
+  }
+  renderer_set_lights(g_lights, g_torch_count);
 }
 
 static void game_render(double frame_dt) {
   (void)frame_dt;
   renderer_begin_frame();
+  renderer_cull_world(&g_cam, local_player()->sector, &g_vp);
   renderer_draw_world(&g_vp);
+
+  push_things();
+  renderer_draw_sprites(&g_sprites, &g_cam, &g_vp);
+}
+
+typedef struct Options {
+  DynResConfig dynres;
+  FramePacerConfig pacing;
+  const char *record_path;
+  const char *replay_path;
+  const char *map_path;
+  const char *package_path;
+  int lights;
+  float fog_near;
+  float fog_far;
+  bool render;
+} Options;
+
+static void parse_args(int argc, char **argv, Options *opt) {
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    const char *val = (i + 1 < argc) ? argv[i + 1] : NULL;
+
+    if (strcmp(arg, "--no-dynres") == 0) {
+      opt->dynres.enabled = false;
+    } else if (strcmp(arg, "--dynres-target-ms") == 0 && val) {
+      opt->dynres.target_ms = atof(val);
+      i++;
+    } else if (strcmp(arg, "--dynres-min") == 0 && val) {
+      opt->dynres.min_scale = (float)atof(val);
+      i++;
+    } else if (strcmp(arg, "--dynres-max") == 0 && val) {
+      opt->dynres.max_scale = (float)atof(val);
+      i++;
+    } else if (strcmp(arg, "--no-pacing") == 0) {
+      opt->pacing.enabled = false;
+    } else if (strcmp(arg, "--no-adaptive-vsync") == 0) {
+      opt->pacing.adaptive_vsync = false;
+    } else if (strcmp(arg, "--max-queued-frames") == 0 && val) {
+      opt->pacing.max_queued = atoi(val);
+      i++;
+    } else if (strcmp(arg, "--pacing-margin-ms") == 0 && val) {
+      opt->pacing.margin_ms = atof(val);
+      i++;
+    } else if (strcmp(arg, "--record") == 0 && val) {
+      opt->record_path = val;
+      i++;
+    } else if (strcmp(arg, "--replay") == 0 && val) {
+      opt->replay_path = val;
+      i++;
+    } else if (strcmp(arg, "--map") == 0 && val) {
+      opt->map_path = val;
+      i++;
+    } else if (strcmp(arg, "--package") == 0 && val) {
+      opt->package_path = val;
+      i++;
+    } else if (strcmp(arg, "--lights") == 0 && val) {
+      opt->lights = atoi(val);
+      i++;
+    } else if (strcmp(arg, "--fog-near") == 0 && val) {
+      opt->fog_near = (float)atof(val);
+      i++;
+    } else if (strcmp(arg, "--fog-far") == 0 && val) {
+      opt->fog_far = (float)atof(val);
+      i++;
+    } else if (strcmp(arg, "--no-render") == 0) {
+      opt->render = false;
+    } else {
+      fprintf(stderr, "Ignoring unknown argument: %s\n", arg);
+    }
+  }
+}
+
+static void report_replay(const ReplayReader *r, double seconds) {
+  printf("Replay: %u ticks in %.3f s (%.0f ticks/s)\n", r->tick, seconds,
+         seconds > 0.0 ? (double)r->tick / seconds : 0.0);
+  if (r->mismatches > 0)
+    printf("Replay: %u diverged ticks, first at %u\n", r->mismatches,
+           r->first_mismatch);
+  else
+    printf("Replay: no divergence\n");
+}
+
+static void print_frame_times(const char *label, FrameTimeStats s) {
+  printf("%s: p50 %.2f ms, p99 %.2f ms, max %.2f ms over %d frames\n", label,
+         s.p50_ms, s.p99_ms, s.max_ms, s.count);
+}
+
+// Anything allocated after warm-up is per-frame heap churn.
+static void report_steady_allocs(const MemStats *warm, long frames) {
+  if (frames <= MEM_WARMUP_FRAMES)
+    return;
+  MemStats now = mem_stats();
+  printf("Steady state: %llu heap allocations over %ld frames\n",
+         (unsigned long long)(now.allocs - warm->allocs),
+         frames - MEM_WARMUP_FRAMES);
+  mem_report("Memory");
+}
+
+// A package takes precedence over a map file; its map points into the
+// mapping and is released with it.
+static bool load_map(const Options *opt) {
+  if (opt->package_path) {
+    g_packaged = package_open(&g_package, &g_map, opt->package_path);
+    return g_packaged;
+  }
+  if (opt->map_path)
+    return map_load(&g_map, opt->map_path);
+  if (!map_build_test(&g_map)) {
+    printf("Failed to build test map\n");
+    return false;
+  }
+  return true;
+}
+
+static void unload_map(void) {
+  if (g_packaged)
+    package_close(&g_package, &g_map);
+  else
+    map_destroy(&g_map);
+  g_packaged = false;
+}
+
+static bool upload_world(void) {
+  if (g_packaged)
+    return renderer_upload_world(&g_map, &g_package.bake);
+  return renderer_build_world_meshes(&g_map);
+}
+
+static int run_replay_headless(const char *path, const Options *opt) {
+  ReplayReader replay;
+  if (!replay_reader_open(&replay, path))
+    return 1;
+
+  if (!load_map(opt)) {
+    replay_reader_close(&replay);
+    return 1;
+  }
+
+  if (!spawn_world()) {
+    printf("Failed to spawn player\n");
+    unload_map();
+    replay_reader_close(&replay);
+    return 1;
+  }
+
+  time_init();
+  camera_init(&g_cam);
+
+  InputState in;
+  input_init(&in, 0, 0);
+
+  uint32_t expected = 0;
+  double start = time_now_seconds();
+  MemStats warm = mem_stats();
+  long frames = 0;
+  while (replay_reader_next(&replay, &in, &expected)) {
+    mem_frame_reset();
+    game_update(replay.fixed_dt, &in);
+    replay_reader_verify(&replay, expected, player_checksum(local_player()));
+    if (++frames == MEM_WARMUP_FRAMES)
+      warm = mem_stats();
+  }
+  report_replay(&replay, time_now_seconds() - start);
+  report_steady_allocs(&warm, frames);
+
+  int status = replay.mismatches > 0 ? 2 : 0;
+  replay_reader_close(&replay);
+  ecs_shutdown(&g_world);
+  unload_map();
+  return status;
 }
 
 int main(int argc, char **argv) {
-  (void)argc;
-  (void)argv;
+  Options opt = {.dynres = dynres_default_config(),
+                 .pacing = frame_pacer_default_config(),
+                 .lights = 32,
+                 .render = true};
+  parse_args(argc, argv, &opt);
+
+  if (!mem_frame_init(k_frame_scratch_bytes)) {
+    printf("Failed to allocate frame scratch\n");
+    return 1;
+  }
+  jobs_start(jobs_hardware_threads());
+
+  if (opt.replay_path && !opt.render) {
+    int status = run_replay_headless(opt.replay_path, &opt);
+    jobs_stop();
+    mem_frame_shutdown();
+    return status;
+  }
 
   if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_EVENTS | SDL_INIT_TIMER) != 0) {
     log_sdl_error("SDL_Init failed");
@@ -45,7 +374,8 @@ int main(int argc, char **argv) {
   const int start_h = 720;
 
   SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
-  SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
+  // 4.3 enables GPU culling; the renderer falls back to the CPU on 3.3.
+  SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 4);
   SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
   SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
   SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 24);
@@ -62,6 +392,11 @@ int main(int argc, char **argv) {
   }
 
   SDL_GLContext gl = SDL_GL_CreateContext(window);
+  if (!gl) {
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
+    gl = SDL_GL_CreateContext(window);
+  }
   if (!gl) {
     log_sdl_error("SDL_GL_CreateContext failed");
     SDL_DestroyWindow(window);
@@ -70,7 +405,6 @@ int main(int argc, char **argv) {
   }
 
   SDL_GL_MakeCurrent(window, gl);
-  SDL_GL_SetSwapInterval(1);
 
   if (!renderer_init()) {
     SDL_GL_DeleteContext(gl);
@@ -79,15 +413,26 @@ int main(int argc, char **argv) {
     return 1;
   }
 
+  DynRes dynres;
+  dynres_init(&dynres, &opt.dynres);
+
   InputState in;
   input_init(&in, start_w, start_h);
+  renderer_configure_scaling(dynres.cfg.enabled, dynres.cfg.max_scale);
   renderer_set_viewport(start_w, start_h);
 
+  RendererFog fog = renderer_fog();
+  if (opt.fog_near > 0.0f)
+    fog.near_dist = opt.fog_near;
+  if (opt.fog_far > 0.0f)
+    fog.far_dist = opt.fog_far;
+  renderer_set_fog(&fog);
+
   time_init();
   camera_init(&g_cam);
+  g_cam.zfar = renderer_fog().far_dist;
 
-  if (!map_build_test(&g_map)) {
-    printf("Failed to build test map\n");
+  if (!load_map(&opt)) {
     renderer_shutdown();
     SDL_GL_DeleteContext(gl);
     SDL_DestroyWindow(window);
@@ -95,9 +440,9 @@ int main(int argc, char **argv) {
     return 1;
   }
 
-  if (!renderer_build_world_meshes(&g_map)) {
+  if (!upload_world()) {
     printf("Failed to build world meshes\n");
-    map_destroy(&g_map);
+    unload_map();
     renderer_shutdown();
     SDL_GL_DeleteContext(gl);
     SDL_DestroyWindow(window);
@@ -105,16 +450,65 @@ int main(int argc, char **argv) {
     return 1;
   }
 
-  player_init(&g_player);
+  spawn_torches(opt.lights);
+  place_things();
+
+  if (!sprite_batch_init(&g_sprites, 256)) {
+    printf("Failed to create sprite batch\n");
+    unload_map();
+    renderer_shutdown();
+    SDL_GL_DeleteContext(gl);
+    SDL_DestroyWindow(window);
+    SDL_Quit();
+    return 1;
+  }
+
+  if (!spawn_world()) {
+    printf("Failed to spawn player\n");
+    sprite_batch_destroy(&g_sprites);
+    unload_map();
+    renderer_shutdown();
+    SDL_GL_DeleteContext(gl);
+    SDL_DestroyWindow(window);
+    SDL_Quit();
+    return 1;
+  }
 
   const double fixed_dt = 1.0 / 60.0;
   const double max_frame_dt = 0.25;
 
+  ReplayWriter recorder = {0};
+  ReplayReader replay = {0};
+  InputState replay_in;
+  input_init(&replay_in, start_w, start_h);
+
+  if (opt.record_path && !replay_writer_open(&recorder, opt.record_path,
+                                             fixed_dt))
+    opt.record_path = NULL;
+  if (opt.replay_path && !replay_reader_open(&replay, opt.replay_path))
+    opt.replay_path = NULL;
+
+  // Replays run unthrottled, as fast as the frames render.
+  FramePacer pacer;
+  frame_pacer_init(&pacer, &opt.pacing, window, !opt.replay_path);
+
   double prev = time_now_seconds();
   double acc = 0.0;
+  double last_stats = prev;
+  double last_cull_stats = prev;
+  bool cull_stats = false;
+  bool lights = true;
+  double last_shader_poll = prev;
+  double replay_start = prev;
+  MemStats warm = mem_stats();
+  long frames = 0;
 
   bool running = true;
   while (running) {
+    // Frame time runs wake to wake, not around whatever the swap blocked
+    // on; paced, that is one refresh.
+    double frame_dt = frame_pacer_wait(&pacer, max_frame_dt);
+    mem_frame_reset();
     input_begin_frame(&in);
 
     SDL_Event e;
@@ -127,11 +521,81 @@ int main(int argc, char **argv) {
       continue;
     }
 
-    double now = time_now_seconds();
-    double frame_dt = now - prev;
-    prev = now;
-    if (frame_dt > max_frame_dt)
-      frame_dt = max_frame_dt;
+    double now = pacer.wake;
+
+    if (in.key_pressed[SDL_SCANCODE_F1]) {
+      renderer_set_depth_prepass(!renderer_depth_prepass());
+      printf("Depth pre-pass: %s\n", renderer_depth_prepass() ? "on" : "off");
+    }
+    if (in.key_pressed[SDL_SCANCODE_F2]) {
+      bool overdraw = renderer_debug_view() != RENDERER_VIEW_OVERDRAW;
+      renderer_set_debug_view(overdraw ? RENDERER_VIEW_OVERDRAW
+                                       : RENDERER_VIEW_LIT);
+      printf("Overdraw view: %s\n", overdraw ? "on" : "off");
+    }
+
+    if (in.key_pressed[SDL_SCANCODE_F3]) {
+      dynres.cfg.enabled = !dynres.cfg.enabled;
+      renderer_configure_scaling(dynres.cfg.enabled, dynres.cfg.max_scale);
+      printf("Dynamic resolution: %s\n", dynres.cfg.enabled ? "on" : "off");
+    }
+
+    if (in.key_pressed[SDL_SCANCODE_F4]) {
+      renderer_set_occlusion_culling(!renderer_occlusion_culling());
+      printf("Occlusion culling: %s\n",
+             renderer_occlusion_culling() ? "on" : "off");
+    }
+    if (in.key_pressed[SDL_SCANCODE_F5]) {
+      cull_stats = !cull_stats;
+    }
+    if (in.key_pressed[SDL_SCANCODE_F6]) {
+      renderer_set_gpu_culling(!renderer_gpu_culling());
+      printf("GPU culling: %s\n", renderer_gpu_culling() ? "on" : "off");
+    }
+    if (in.key_pressed[SDL_SCANCODE_F7]) {
+      lights = !lights;
+      printf("Dynamic lights: %s\n", lights ? "on" : "off");
+    }
+    if (in.key_pressed[SDL_SCANCODE_F8]) {
+      pacer.cfg.enabled = !pacer.cfg.enabled;
+      printf("Frame pacing: %s (swap interval %d)\n",
+             pacer.cfg.enabled ? "on" : "off", pacer.swap_interval);
+    }
+
+    if (renderer_debug_view() == RENDERER_VIEW_OVERDRAW &&
+        now - last_stats >= 1.0) {
+      printf("Overdraw: %.2f shaded fragments/pixel (pre-pass %s)\n",
+             renderer_overdraw(), renderer_depth_prepass() ? "on" : "off");
+      last_stats = now;
+    }
+    if (cull_stats && now - last_cull_stats >= 1.0) {
+      RendererCullStats cs = renderer_cull_stats();
+      if (cs.gpu) {
+        printf("Culling: %d sectors on the GPU (%d occluders, %.3f ms CPU)\n",
+               cs.sectors, cs.occluders, cs.cpu_ms);
+      } else {
+        printf("Culling: %d/%d sectors drawn (%d LOD, %d vertices), "
+               "%d outside PVS, %d fogged, %d outside frustum, "
+               "%d occluded (%d occluders, %.3f ms)\n",
+               cs.drawn, cs.sectors, cs.lod, cs.vertices, cs.pvs_rejected,
+               cs.fogged,
+               cs.frustum_rejected, cs.occlusion_rejected, cs.occluders,
+               cs.cpu_ms);
+      }
+      LightClusterStats ls = renderer_light_stats();
+      printf("Lights: %d binned, %d cluster refs (max %d, %d dropped), "
+             "%.3f ms\n",
+             ls.lights, ls.refs, ls.max_per_cluster, ls.dropped, ls.cpu_ms);
+      print_frame_times("Frames", frame_pacer_frame_stats(&pacer));
+      print_frame_times("Input to present", frame_pacer_latency_stats(&pacer));
+      print_frame_times("Fence wait", frame_pacer_fence_stats(&pacer));
+      last_cull_stats = now;
+    }
+
+    if (now - last_shader_poll >= 0.5) {
+      renderer_reload_shaders();
+      last_shader_poll = now;
+    }
 
     if (in.resized) {
       renderer_set_viewport(in.window_w, in.window_h);
@@ -140,21 +604,75 @@ int main(int argc, char **argv) {
     float aspect = (float)in.window_w / (float)in.window_h;
     g_vp = camera_view_proj(&g_cam, aspect);
 
-    acc += frame_dt;
-    while (acc >= fixed_dt) {
-      game_update(fixed_dt, &in);
-      acc -= fixed_dt;
+    if (opt.replay_path) {
+      uint32_t expected = 0;
+      if (!replay_reader_next(&replay, &replay_in, &expected)) {
+        running = false;
+        continue;
+      }
+      game_update(replay.fixed_dt, &replay_in);
+      replay_reader_verify(&replay, expected, player_checksum(local_player()));
+    } else {
+      if (opt.record_path)
+        replay_writer_note_input(&recorder, &in);
+
+      acc += frame_dt;
+      while (acc >= fixed_dt) {
+        game_update(fixed_dt, &in);
+        if (opt.record_path)
+          replay_writer_tick(&recorder, &in, player_checksum(local_player()));
+        acc -= fixed_dt;
+      }
+    }
+
+    // Late latch: turn the view by what the keys held right now add over
+    // the time the sim has not covered yet, just before the matrix is built.
+    if (!opt.replay_path) {
+      float turn = input_latch_turn();
+      frame_pacer_latch(&pacer);
+      double ahead = acc + (pacer.latch - now);
+      g_cam.yaw = local_player()->yaw + turn * PLAYER_TURN_SPEED * (float)ahead;
     }
 
     aspect = (float)in.window_w / (float)in.window_h;
     g_vp = camera_view_proj(&g_cam, aspect);
 
+    if (lights)
+      push_lights(now);
+    else
+      renderer_set_lights(NULL, 0);
     game_render(frame_dt);
-    SDL_GL_SwapWindow(window);
+    renderer_end_frame();
+
+    double cpu_ms = (time_now_seconds() - now) * 1000.0;
+    frame_pacer_swap(&pacer, window);
+
+    renderer_set_render_scale(
+        dynres_update(&dynres, cpu_ms, renderer_gpu_ms()));
+
+    if (++frames == MEM_WARMUP_FRAMES)
+      warm = mem_stats();
+  }
+
+  report_steady_allocs(&warm, frames);
+  print_frame_times("Frames", frame_pacer_frame_stats(&pacer));
+  print_frame_times("Input to present", frame_pacer_latency_stats(&pacer));
+  print_frame_times("Fence wait", frame_pacer_fence_stats(&pacer));
+  frame_pacer_shutdown(&pacer);
+
+  if (opt.replay_path) {
+    report_replay(&replay, time_now_seconds() - replay_start);
+    replay_reader_close(&replay);
   }
+  if (opt.record_path)
+    replay_writer_close(&recorder);
 
-  map_destroy(&g_map);
+  ecs_shutdown(&g_world);
+  sprite_batch_destroy(&g_sprites);
+  unload_map();
   renderer_shutdown();
+  jobs_stop();
+  mem_frame_shutdown();
   SDL_GL_DeleteContext(gl);
   SDL_DestroyWindow(window);
   SDL_Quit();
@@ -1,7 +1,7 @@
 #include "map.h"
 
+#include <math.h>
 #include <stdio.h>
-#include <stdlib.h>
 #include <string.h>
 
 static void map_zero(Map *m) { memset(m, 0, sizeof(*m)); }
@@ -10,42 +10,166 @@ void map_destroy(Map *m) {
   if (!m)
     return;
 
-  for (int i = 0; i < m->sector_count; i++) {
-    free(m->sectors[i].loop.indices);
-    m->sectors[i].loop.indices = NULL;
-    m->sectors[i].loop.count = 0;
-  }
+  arena_destroy(&m->arena);
+  map_zero(m);
+}
 
-  free(m->verts);
-  free(m->lines);
-  free(m->sectors);
+static size_t aligned(size_t n) { return (n + 15) & ~(size_t)15; }
 
+bool map_alloc(Map *m, int vcount, int lcount, int scount, int loop_indices,
+               size_t extra) {
   map_zero(m);
-}
 
-static bool alloc_arrays(Map *m, int vcount, int lcount, int scount) {
-  m->verts = (Vec2 *)calloc((size_t)vcount, sizeof(Vec2));
-  m->lines = (Linedef *)calloc((size_t)lcount, sizeof(Linedef));
-  m->sectors = (Sector *)calloc((size_t)scount, sizeof(Sector));
-  if (!m->verts || !m->lines || !m->sectors)
+  size_t bytes = aligned((size_t)vcount * sizeof(Vec2)) +
+                 aligned((size_t)lcount * sizeof(Linedef)) +
+                 aligned((size_t)scount * sizeof(Sector)) +
+                 aligned((size_t)loop_indices * sizeof(int)) +
+                 aligned(((size_t)scount + 1) * sizeof(int)) +
+                 aligned(((size_t)lcount * 2 + 1) * sizeof(int)) +
+                 10 * aligned((size_t)lcount * sizeof(float)) +
+                 aligned((size_t)lcount) + aligned(extra);
+  if (!arena_init(&m->arena, bytes))
     return false;
 
+  m->verts = (Vec2 *)arena_alloc(&m->arena, (size_t)vcount * sizeof(Vec2), 16);
+  m->lines = (Linedef *)arena_alloc(&m->arena,
+                                    (size_t)lcount * sizeof(Linedef), 16);
+  m->sectors =
+      (Sector *)arena_alloc(&m->arena, (size_t)scount * sizeof(Sector), 16);
+  if (!m->verts || !m->lines || !m->sectors) {
+    map_destroy(m);
+    return false;
+  }
+
+  memset(m->verts, 0, (size_t)vcount * sizeof(Vec2));
+  memset(m->lines, 0, (size_t)lcount * sizeof(Linedef));
+  memset(m->sectors, 0, (size_t)scount * sizeof(Sector));
   m->vert_count = vcount;
   m->line_count = lcount;
   m->sector_count = scount;
-
   return true;
 }
 
-bool map_build_test(Map *out) {
-  if (!out)
+int *map_alloc_loop(Map *m, int sector, int count) {
+  int *indices =
+      (int *)arena_alloc(&m->arena, (size_t)count * sizeof(int), sizeof(int));
+  if (!indices)
+    return NULL;
+  m->sectors[sector].loop.indices = indices;
+  m->sectors[sector].loop.count = count;
+  return indices;
+}
+
+// Counts land in start[s], prefix sums turn them into end offsets, and
+// filling backwards walks each one down to its sector's first slot.
+bool map_build_adjacency(Map *m) {
+  int *start = (int *)arena_alloc(
+      &m->arena, ((size_t)m->sector_count + 1) * sizeof(int), sizeof(int));
+  int *lines = (int *)arena_alloc(
+      &m->arena, ((size_t)m->line_count * 2 + 1) * sizeof(int), sizeof(int));
+  if (!start || !lines)
     return false;
-  map_zero(out);
 
-  if (!alloc_arrays(out, 6, 7, 2)) {
-    map_destroy(out);
+  memset(start, 0, ((size_t)m->sector_count + 1) * sizeof(int));
+  for (int i = 0; i < m->line_count; i++) {
+    start[m->lines[i].front_sector]++;
+    if (m->lines[i].back_sector >= 0)
+      start[m->lines[i].back_sector]++;
+  }
+  for (int s = 1; s <= m->sector_count; s++)
+    start[s] += start[s - 1];
+
+  for (int i = m->line_count - 1; i >= 0; i--) {
+    lines[--start[m->lines[i].front_sector]] = i;
+    if (m->lines[i].back_sector >= 0)
+      lines[--start[m->lines[i].back_sector]] = i;
+  }
+
+  m->sector_line_start = start;
+  m->sector_lines = lines;
+  return true;
+}
+
+static uint8_t line_flags(const Map *m, const Linedef *l) {
+  if (l->back_sector < 0)
+    return 0;
+
+  const Sector *f = &m->sectors[l->front_sector];
+  const Sector *b = &m->sectors[l->back_sector];
+  uint8_t flags = LINE_TWO_SIDED;
+  if (map_portal_passable(f, b, f->floor_h, MAP_STD_HEIGHT, MAP_STD_STEP))
+    flags |= LINE_PASS_FRONT_TO_BACK;
+  if (map_portal_passable(b, f, b->floor_h, MAP_STD_HEIGHT, MAP_STD_STEP))
+    flags |= LINE_PASS_BACK_TO_FRONT;
+  return flags;
+}
+
+bool map_build_line_table(Map *m) {
+  LineTable *t = &m->linetab;
+  size_t bytes = (size_t)m->line_count * sizeof(float);
+  float **fields[] = {&t->x0, &t->y0, &t->x1,       &t->y1, &t->dx,
+                      &t->dy, &t->len, &t->inv_len2, &t->nx, &t->ny};
+  for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+    *fields[i] = (float *)arena_alloc(&m->arena, bytes, 16);
+    if (!*fields[i])
+      return false;
+  }
+  t->flags = (uint8_t *)arena_alloc(&m->arena, (size_t)m->line_count, 16);
+  if (!t->flags)
     return false;
+
+  for (int i = 0; i < m->line_count; i++) {
+    const Linedef *l = &m->lines[i];
+    Vec2 a = m->verts[l->v0];
+    Vec2 b = m->verts[l->v1];
+    float dx = b.x - a.x;
+    float dy = b.y - a.y;
+    float len2 = dx * dx + dy * dy;
+    float len = sqrtf(len2);
+
+    t->x0[i] = a.x;
+    t->y0[i] = a.y;
+    t->x1[i] = b.x;
+    t->y1[i] = b.y;
+    t->dx[i] = dx;
+    t->dy[i] = dy;
+    t->len[i] = len;
+    t->inv_len2[i] = (len2 > 1e-12f) ? 1.0f / len2 : 0.0f;
+    t->nx[i] = (len > 1e-6f) ? -dy / len : 0.0f;
+    t->ny[i] = (len > 1e-6f) ? dx / len : 0.0f;
+    t->flags[i] = line_flags(m, l);
   }
+  return true;
+}
+
+void map_set_sector_heights(Map *m, int sector, float floor_h, float ceil_h) {
+  Sector *s = &m->sectors[sector];
+  if (s->floor_h == floor_h && s->ceil_h == ceil_h)
+    return;
+  s->floor_h = floor_h;
+  s->ceil_h = ceil_h;
+  m->height_revision++;
+
+  for (int k = m->sector_line_start[sector];
+       k < m->sector_line_start[sector + 1]; k++) {
+    int li = m->sector_lines[k];
+    m->linetab.flags[li] = line_flags(m, &m->lines[li]);
+  }
+}
+
+bool map_portal_passable(const Sector *from, const Sector *to, float z,
+                         float height, float step) {
+  float floor = (from->floor_h > to->floor_h) ? from->floor_h : to->floor_h;
+  float ceil = (from->ceil_h < to->ceil_h) ? from->ceil_h : to->ceil_h;
+  if (floor - z > step)
+    return false;
+  float base = (floor > z) ? floor : z;
+  return (ceil - base) >= height;
+}
+
+bool map_build_test(Map *out) {
+  if (!out || !map_alloc(out, 6, 7, 2, 8, 0))
+    return false;
 
   out->verts[0] = v2(0.0f, 0.0f);
   out->verts[1] = v2(4.0f, 0.0f);
@@ -62,24 +186,21 @@ bool map_build_test(Map *out) {
   out->sectors[1].ceil_h = 3.0f;
   out->sectors[1].light_level = 0.6f;
 
-  out->sectors[0].loop.count = 4;
-  out->sectors[0].loop.indices = (int *)calloc(4, sizeof(int));
-  out->sectors[0].loop.indices[0] = 0;
-  out->sectors[0].loop.indices[1] = 1;
-  out->sectors[0].loop.indices[2] = 2;
-  out->sectors[0].loop.indices[3] = 3;
-
-  out->sectors[1].loop.count = 4;
-  out->sectors[1].loop.indices = (int *)calloc(4, sizeof(int));
-  out->sectors[1].loop.indices[0] = 1;
-  out->sectors[1].loop.indices[1] = 4;
-  out->sectors[1].loop.indices[2] = 5;
-  out->sectors[1].loop.indices[3] = 2;
-
-  if (!out->sectors[0].loop.indices || !out->sectors[1].loop.indices) {
+  int *loop0 = map_alloc_loop(out, 0, 4);
+  int *loop1 = map_alloc_loop(out, 1, 4);
+  if (!loop0 || !loop1) {
     map_destroy(out);
     return false;
   }
+  loop0[0] = 0;
+  loop0[1] = 1;
+  loop0[2] = 2;
+  loop0[3] = 3;
+
+  loop1[0] = 1;
+  loop1[1] = 4;
+  loop1[2] = 5;
+  loop1[3] = 2;
 
   out->lines[0] =
       (Linedef){.v0 = 0, .v1 = 1, .front_sector = 0, .back_sector = -1};
@@ -97,6 +218,11 @@ bool map_build_test(Map *out) {
   out->lines[6] =
       (Linedef){.v0 = 5, .v1 = 2, .front_sector = 1, .back_sector = -1};
 
+  if (!map_build_adjacency(out) || !map_build_line_table(out)) {
+    map_destroy(out);
+    return false;
+  }
+
   return true;
 }
 
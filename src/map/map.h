@@ -4,6 +4,8 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+#include "../core/mem.h"
+#include "../geom/geom2d_batch.h"
 #include "../math/vec2.h"
 
 typedef struct SectorLoop {
@@ -25,6 +27,28 @@ typedef struct Linedef {
   int back_sector;
 } Linedef;
 
+enum {
+  LINE_TWO_SIDED = 1 << 0,
+  // Walkable at MAP_STD_HEIGHT/MAP_STD_STEP starting on the source floor.
+  LINE_PASS_FRONT_TO_BACK = 1 << 1,
+  LINE_PASS_BACK_TO_FRONT = 1 << 2,
+};
+
+#define MAP_STD_HEIGHT 1.6f
+#define MAP_STD_STEP 0.6f
+
+// Per-line geometry precomputed at load, one packed array per field.
+// (nx, ny) is the unit normal pointing into the front sector, as Line2.n.
+typedef struct LineTable {
+  float *x0, *y0;
+  float *x1, *y1;
+  float *dx, *dy;
+  float *len;
+  float *inv_len2;
+  float *nx, *ny;
+  uint8_t *flags;
+} LineTable;
+
 typedef struct Map {
   Vec2 *verts;
   int vert_count;
@@ -34,11 +58,65 @@ typedef struct Map {
 
   Sector *sectors;
   int sector_count;
+
+  // Lines touching each sector: sector_lines[sector_line_start[s] ..
+  // sector_line_start[s + 1]). Portals appear under both of their sectors.
+  int *sector_line_start;
+  int *sector_lines;
+
+  LineTable linetab;
+
+  // Bumped whenever a sector's floor or ceiling moves.
+  uint32_t height_revision;
+
+  // Baked sector-to-sector visibility, one bit row per sector; NULL when the
+  // map was not baked, in which case everything counts as visible.
+  uint8_t *pvs;
+  int pvs_row_bytes;
+
+  // Every array above lives in this one block.
+  Arena arena;
 } Map;
 
+// Sizes the arena for the given counts (plus adjacency, the line table and
+// `extra` bytes for the caller) and carves the vertex, line and sector arrays
+// out of it.
+bool map_alloc(Map *m, int vcount, int lcount, int scount, int loop_indices,
+               size_t extra);
+int *map_alloc_loop(Map *m, int sector, int count);
+
 bool map_build_test(Map *out);
+bool map_build_adjacency(Map *m);
+bool map_build_line_table(Map *m);
+void map_set_sector_heights(Map *m, int sector, float floor_h, float ceil_h);
+
+// Whether something standing at z in `from` fits through into `to`: the
+// higher floor must be within step reach and the opening above the feet (or
+// that floor) must be at least `height` tall.
+bool map_portal_passable(const Sector *from, const Sector *to, float z,
+                         float height, float step);
 void map_destroy(Map *m);
 
+static inline bool map_pvs_visible(const Map *m, int from, int to) {
+  if (!m->pvs)
+    return true;
+  const uint8_t *row = m->pvs + (size_t)from * (size_t)m->pvs_row_bytes;
+  return (row[to >> 3] >> (to & 7)) & 1;
+}
+
+// The lines of sector s, read in place from the line table.
+static inline Seg2Batch map_sector_batch(const Map *m, int s) {
+  Seg2Batch b;
+  b.x0 = m->linetab.x0;
+  b.y0 = m->linetab.y0;
+  b.dx = m->linetab.dx;
+  b.dy = m->linetab.dy;
+  b.inv_len2 = m->linetab.inv_len2;
+  b.index = m->sector_lines + m->sector_line_start[s];
+  b.count = m->sector_line_start[s + 1] - m->sector_line_start[s];
+  return b;
+}
+
 void map_debug_print(const Map *m);
 
 #endif // !MAP_H
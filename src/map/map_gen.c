@@ -0,0 +1,178 @@
+#include "map_gen.h"
+
+#include <math.h>
+
+static uint32_t xorshift32(uint32_t *s) {
+  uint32_t x = *s;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  *s = x;
+  return x;
+}
+
+static float rand01(uint32_t *s) {
+  return (float)(xorshift32(s) >> 8) * (1.0f / 16777216.0f);
+}
+
+// Segments per zigzag edge of MAP_GEN_CONCAVE and their offset from the
+// straight edge, as a share of the cell size.
+enum { CONCAVE_TEETH = 4 };
+static const float k_tooth_depth = 0.2f;
+
+MapGenParams map_gen_default_params(void) {
+  MapGenParams p;
+  p.cols = 100;
+  p.rows = 100;
+  p.cell_size = 4.0f;
+  p.wall_chance = 0.2f;
+  p.seed = 1u;
+  p.layout = MAP_GEN_ROOMS;
+  return p;
+}
+
+void map_gen_size_for_lines(MapGenParams *params, int lines) {
+  // Lines per cell: one horizontal and one vertical edge, walls doubling
+  // their share; corridors wall off nearly every horizontal edge.
+  float per_cell = 2.0f * (1.0f + params->wall_chance);
+  if (params->layout == MAP_GEN_CORRIDORS)
+    per_cell = 3.0f;
+  else if (params->layout == MAP_GEN_CONCAVE)
+    per_cell = (1.0f + CONCAVE_TEETH) * (1.0f + params->wall_chance);
+
+  int side = (int)ceilf(sqrtf((float)lines / per_cell));
+  params->cols = (side < 1) ? 1 : side;
+  params->rows = params->cols;
+}
+
+static void add_line(Map *m, int v0, int v1, int front, int back) {
+  m->lines[m->line_count++] = (Linedef){
+      .v0 = v0, .v1 = v1, .front_sector = front, .back_sector = back};
+}
+
+// Edge v0 -> v1 with sector `left` on its left and `right` on its right;
+// either may be -1 outside the grid. A shared edge is a portal, or a pair
+// of one-sided walls when `wall` is set.
+static void add_edge(Map *m, int v0, int v1, int left, int right,
+                     bool wall) {
+  if (left < 0) {
+    add_line(m, v1, v0, right, -1);
+  } else if (right < 0) {
+    add_line(m, v0, v1, left, -1);
+  } else if (wall) {
+    add_line(m, v0, v1, left, -1);
+    add_line(m, v1, v0, right, -1);
+  } else {
+    add_line(m, v0, v1, left, right);
+  }
+}
+
+typedef struct GridShape {
+  int cols;
+  int rows;
+  int teeth;
+} GridShape;
+
+// Vertex j of the vertical edge rising from grid corner (x, y): the corners
+// at j = 0 and j = teeth, zigzag points between them.
+static int edge_vertex(const GridShape *g, int x, int y, int j) {
+  int corners = (g->cols + 1) * (g->rows + 1);
+  if (j == 0)
+    return y * (g->cols + 1) + x;
+  if (j == g->teeth)
+    return (y + 1) * (g->cols + 1) + x;
+  return corners + (y * (g->cols + 1) + x) * (g->teeth - 1) + j - 1;
+}
+
+// Corridor rows link to the next row at alternating ends.
+static bool corridor_wall(const GridShape *g, int x, int row_below) {
+  return x != ((row_below % 2 == 0) ? g->cols - 1 : 0);
+}
+
+bool map_generate_grid(Map *out, const MapGenParams *params) {
+  if (!out || !params || params->cols < 1 || params->rows < 1)
+    return false;
+
+  GridShape g = {params->cols, params->rows,
+                 params->layout == MAP_GEN_CONCAVE ? CONCAVE_TEETH : 1};
+  int cols = g.cols;
+  int rows = g.rows;
+  int vcount = (cols + 1) * (rows + 1) + (cols + 1) * rows * (g.teeth - 1);
+  int scount = cols * rows;
+  int loop_count = 4 + 2 * (g.teeth - 1);
+  int max_lines = 2 * (cols * (rows + 1) + rows * (cols + 1) * g.teeth);
+
+  if (!map_alloc(out, vcount, max_lines, scount, scount * loop_count, 0))
+    return false;
+  out->line_count = 0;
+
+  uint32_t rng = params->seed ? params->seed : 1u;
+  float cs = params->cell_size;
+  float ch = (params->layout == MAP_GEN_CORRIDORS) ? cs * 0.5f : cs;
+  bool corridors = params->layout == MAP_GEN_CORRIDORS;
+
+  for (int y = 0; y <= rows; y++)
+    for (int x = 0; x <= cols; x++)
+      out->verts[y * (cols + 1) + x] = v2((float)x * cs, (float)y * ch);
+  for (int y = 0; y < rows; y++) {
+    for (int x = 0; x <= cols; x++) {
+      for (int j = 1; j < g.teeth; j++) {
+        float off = ((j & 1) ? 1.0f : -1.0f) * k_tooth_depth * cs;
+        out->verts[edge_vertex(&g, x, y, j)] =
+            v2((float)x * cs + off, ((float)y + (float)j / g.teeth) * ch);
+      }
+    }
+  }
+
+  for (int y = 0; y < rows; y++) {
+    for (int x = 0; x < cols; x++) {
+      Sector *s = &out->sectors[y * cols + x];
+      s->floor_h = (float)(xorshift32(&rng) % 3) * 0.25f;
+      s->ceil_h = 3.0f + (float)(xorshift32(&rng) % 3) * 0.5f;
+      s->light_level = 0.4f + 0.6f * rand01(&rng);
+
+      int *loop = map_alloc_loop(out, y * cols + x, loop_count);
+      if (!loop) {
+        map_destroy(out);
+        return false;
+      }
+      // Bottom left corner, up the right edge, down the left edge.
+      int n = 0;
+      loop[n++] = edge_vertex(&g, x, y, 0);
+      for (int j = 0; j <= g.teeth; j++)
+        loop[n++] = edge_vertex(&g, x + 1, y, j);
+      for (int j = g.teeth; j > 0; j--)
+        loop[n++] = edge_vertex(&g, x, y, j);
+    }
+  }
+
+  for (int y = 0; y <= rows; y++) {
+    for (int x = 0; x < cols; x++) {
+      int v = y * (cols + 1) + x;
+      int above = (y < rows) ? y * cols + x : -1;
+      int below = (y > 0) ? (y - 1) * cols + x : -1;
+      bool wall = above >= 0 && below >= 0 &&
+                  (corridors ? corridor_wall(&g, x, y - 1)
+                             : rand01(&rng) < params->wall_chance);
+      add_edge(out, v, v + 1, above, below, wall);
+    }
+  }
+
+  for (int y = 0; y < rows; y++) {
+    for (int x = 0; x <= cols; x++) {
+      int left = (x > 0) ? y * cols + x - 1 : -1;
+      int right = (x < cols) ? y * cols + x : -1;
+      bool wall = left >= 0 && right >= 0 && !corridors &&
+                  rand01(&rng) < params->wall_chance;
+      for (int j = 0; j < g.teeth; j++)
+        add_edge(out, edge_vertex(&g, x, y, j), edge_vertex(&g, x, y, j + 1),
+                 left, right, wall);
+    }
+  }
+
+  if (!map_build_adjacency(out) || !map_build_line_table(out)) {
+    map_destroy(out);
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,35 @@
+#ifndef MAP_GEN_H
+#define MAP_GEN_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "map.h"
+
+typedef enum MapGenLayout {
+  MAP_GEN_ROOMS,
+  // Half-height cells joined into one corridor that snakes row by row.
+  MAP_GEN_CORRIDORS,
+  // Rooms whose vertical edges zigzag, so every sector is concave.
+  MAP_GEN_CONCAVE,
+} MapGenLayout;
+
+typedef struct MapGenParams {
+  int cols;
+  int rows;
+  float cell_size;
+  float wall_chance;
+  uint32_t seed;
+  MapGenLayout layout;
+} MapGenParams;
+
+MapGenParams map_gen_default_params(void);
+
+// Square grid sized so the layout comes out near `lines` linedefs.
+void map_gen_size_for_lines(MapGenParams *params, int lines);
+
+// Grid of rooms, one sector each. Shared edges become portals, or a pair of
+// one-sided walls with probability wall_chance; corridors ignore it.
+bool map_generate_grid(Map *out, const MapGenParams *params);
+
+#endif // !MAP_GEN_H
@@ -0,0 +1,287 @@
+#include "map_io.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static const char k_magic[4] = {'D', 'M', 'A', 'P'};
+static const uint32_t k_version = 1;
+
+typedef struct MapReader {
+  const unsigned char *data;
+  size_t size;
+  size_t at;
+} MapReader;
+
+static void put_u32(FILE *f, uint32_t v) {
+  unsigned char b[4] = {(unsigned char)v, (unsigned char)(v >> 8),
+                        (unsigned char)(v >> 16), (unsigned char)(v >> 24)};
+  fwrite(b, 1, 4, f);
+}
+
+static void put_f32(FILE *f, float v) {
+  uint32_t u;
+  memcpy(&u, &v, 4);
+  put_u32(f, u);
+}
+
+static void put_chunk(FILE *f, const char tag[4], size_t size) {
+  fwrite(tag, 1, 4, f);
+  put_u32(f, (uint32_t)size);
+}
+
+static bool get_u32(MapReader *r, uint32_t *v) {
+  if (r->at + 4 > r->size)
+    return false;
+  const unsigned char *b = r->data + r->at;
+  *v = (uint32_t)b[0] | ((uint32_t)b[1] << 8) | ((uint32_t)b[2] << 16) |
+       ((uint32_t)b[3] << 24);
+  r->at += 4;
+  return true;
+}
+
+static bool get_i32(MapReader *r, int *v) {
+  uint32_t u;
+  if (!get_u32(r, &u))
+    return false;
+  *v = (int)(int32_t)u;
+  return true;
+}
+
+static bool get_f32(MapReader *r, float *v) {
+  uint32_t u;
+  if (!get_u32(r, &u))
+    return false;
+  memcpy(v, &u, 4);
+  return true;
+}
+
+bool map_save(const Map *m, const PvsData *pvs, const char *path) {
+  FILE *f = fopen(path, "wb");
+  if (!f) {
+    fprintf(stderr, "Failed to open %s for writing\n", path);
+    return false;
+  }
+
+  int loop_total = 0;
+  for (int s = 0; s < m->sector_count; s++)
+    loop_total += m->sectors[s].loop.count;
+
+  fwrite(k_magic, 1, 4, f);
+  put_u32(f, k_version);
+  put_u32(f, pvs ? 5u : 4u);
+
+  put_chunk(f, "VERT", (size_t)m->vert_count * 8);
+  for (int i = 0; i < m->vert_count; i++) {
+    put_f32(f, m->verts[i].x);
+    put_f32(f, m->verts[i].y);
+  }
+
+  put_chunk(f, "LINE", (size_t)m->line_count * 16);
+  for (int i = 0; i < m->line_count; i++) {
+    const Linedef *l = &m->lines[i];
+    put_u32(f, (uint32_t)l->v0);
+    put_u32(f, (uint32_t)l->v1);
+    put_u32(f, (uint32_t)l->front_sector);
+    put_u32(f, (uint32_t)l->back_sector);
+  }
+
+  put_chunk(f, "SECT", (size_t)m->sector_count * 16);
+  for (int s = 0; s < m->sector_count; s++) {
+    const Sector *sec = &m->sectors[s];
+    put_f32(f, sec->floor_h);
+    put_f32(f, sec->ceil_h);
+    put_f32(f, sec->light_level);
+    put_u32(f, (uint32_t)sec->loop.count);
+  }
+
+  put_chunk(f, "LOOP", (size_t)loop_total * 4);
+  for (int s = 0; s < m->sector_count; s++) {
+    const SectorLoop *loop = &m->sectors[s].loop;
+    for (int i = 0; i < loop->count; i++)
+      put_u32(f, (uint32_t)loop->indices[i]);
+  }
+
+  if (pvs) {
+    size_t n = (size_t)pvs->sector_count;
+    put_chunk(f, "PVS ", 8 + (n + 1) * 4 + pvs->rle_size);
+    put_u32(f, (uint32_t)pvs->sector_count);
+    put_u32(f, (uint32_t)pvs->row_bytes);
+    for (size_t i = 0; i <= n; i++)
+      put_u32(f, pvs->row_offsets[i]);
+    fwrite(pvs->rle, 1, pvs->rle_size, f);
+  }
+
+  bool ok = !ferror(f);
+  if (fclose(f) != 0)
+    ok = false;
+  if (!ok)
+    fprintf(stderr, "Failed to write %s\n", path);
+  return ok;
+}
+
+typedef struct MapChunks {
+  MapReader vert, line, sect, loop, pvs;
+  bool has_pvs;
+} MapChunks;
+
+static bool find_chunks(MapReader *r, MapChunks *c) {
+  char magic[4];
+  uint32_t version = 0, count = 0;
+  if (r->size < 12)
+    return false;
+  memcpy(magic, r->data, 4);
+  r->at = 4;
+  if (memcmp(magic, k_magic, 4) != 0 || !get_u32(r, &version) ||
+      version != k_version || !get_u32(r, &count))
+    return false;
+
+  bool seen[4] = {false, false, false, false};
+  for (uint32_t i = 0; i < count; i++) {
+    char tag[4];
+    uint32_t size = 0;
+    if (r->at + 4 > r->size)
+      return false;
+    memcpy(tag, r->data + r->at, 4);
+    r->at += 4;
+    if (!get_u32(r, &size) || size > r->size - r->at)
+      return false;
+
+    MapReader body = {r->data + r->at, size, 0};
+    r->at += size;
+    if (memcmp(tag, "VERT", 4) == 0) {
+      c->vert = body;
+      seen[0] = true;
+    } else if (memcmp(tag, "LINE", 4) == 0) {
+      c->line = body;
+      seen[1] = true;
+    } else if (memcmp(tag, "SECT", 4) == 0) {
+      c->sect = body;
+      seen[2] = true;
+    } else if (memcmp(tag, "LOOP", 4) == 0) {
+      c->loop = body;
+      seen[3] = true;
+    } else if (memcmp(tag, "PVS ", 4) == 0) {
+      c->pvs = body;
+      c->has_pvs = true;
+    }
+  }
+  return seen[0] && seen[1] && seen[2] && seen[3];
+}
+
+static bool read_geometry(Map *m, MapChunks *c) {
+  for (int i = 0; i < m->vert_count; i++) {
+    if (!get_f32(&c->vert, &m->verts[i].x) ||
+        !get_f32(&c->vert, &m->verts[i].y))
+      return false;
+  }
+
+  for (int i = 0; i < m->line_count; i++) {
+    Linedef *l = &m->lines[i];
+    if (!get_i32(&c->line, &l->v0) || !get_i32(&c->line, &l->v1) ||
+        !get_i32(&c->line, &l->front_sector) ||
+        !get_i32(&c->line, &l->back_sector))
+      return false;
+    if (l->v0 < 0 || l->v0 >= m->vert_count || l->v1 < 0 ||
+        l->v1 >= m->vert_count || l->front_sector < 0 ||
+        l->front_sector >= m->sector_count ||
+        l->back_sector >= m->sector_count)
+      return false;
+  }
+
+  for (int s = 0; s < m->sector_count; s++) {
+    Sector *sec = &m->sectors[s];
+    uint32_t count = 0;
+    if (!get_f32(&c->sect, &sec->floor_h) ||
+        !get_f32(&c->sect, &sec->ceil_h) ||
+        !get_f32(&c->sect, &sec->light_level) || !get_u32(&c->sect, &count))
+      return false;
+
+    int *loop = map_alloc_loop(m, s, (int)count);
+    if (count > 0 && !loop)
+      return false;
+    for (uint32_t i = 0; i < count; i++) {
+      if (!get_i32(&c->loop, &loop[i]) || loop[i] < 0 ||
+          loop[i] >= m->vert_count)
+        return false;
+    }
+  }
+  return true;
+}
+
+static bool read_pvs(Map *m, MapReader *r) {
+  uint32_t count = 0, row_bytes = 0;
+  if (!get_u32(r, &count) || !get_u32(r, &row_bytes) ||
+      (int)count != m->sector_count ||
+      (int)row_bytes != pvs_row_bytes(m->sector_count))
+    return false;
+
+  size_t table = ((size_t)count + 1) * 4;
+  if (table > r->size - r->at)
+    return false;
+  MapReader offsets = {r->data + r->at, table, 0};
+  const unsigned char *rle = r->data + r->at + table;
+  size_t rle_size = r->size - r->at - table;
+
+  size_t bytes = (size_t)count * row_bytes;
+  m->pvs = (uint8_t *)arena_alloc(&m->arena, bytes, 16);
+  if (!m->pvs)
+    return false;
+  m->pvs_row_bytes = (int)row_bytes;
+
+  uint32_t start = 0, end = 0;
+  if (!get_u32(&offsets, &start))
+    return false;
+  for (uint32_t s = 0; s < count; s++, start = end) {
+    if (!get_u32(&offsets, &end) || end < start || end > rle_size ||
+        !pvs_rle_decode(rle + start, end - start,
+                        m->pvs + (size_t)s * row_bytes, (int)row_bytes))
+      return false;
+  }
+  return true;
+}
+
+bool map_load(Map *m, const char *path) {
+  memset(m, 0, sizeof(*m));
+
+  FILE *f = fopen(path, "rb");
+  if (!f) {
+    fprintf(stderr, "Failed to open map %s\n", path);
+    return false;
+  }
+  fseek(f, 0, SEEK_END);
+  long size = ftell(f);
+  fseek(f, 0, SEEK_SET);
+
+  unsigned char *data =
+      (size > 0) ? (unsigned char *)mem_alloc((size_t)size) : NULL;
+  if (!data || fread(data, 1, (size_t)size, f) != (size_t)size) {
+    fclose(f);
+    mem_free(data);
+    fprintf(stderr, "Failed to read map %s\n", path);
+    return false;
+  }
+  fclose(f);
+
+  MapReader r = {data, (size_t)size, 0};
+  MapChunks c;
+  memset(&c, 0, sizeof(c));
+  bool ok = find_chunks(&r, &c);
+
+  int scount = (int)(c.sect.size / 16);
+  size_t pvs_bytes =
+      c.has_pvs ? (size_t)scount * (size_t)pvs_row_bytes(scount) : 0;
+  ok = ok && map_alloc(m, (int)(c.vert.size / 8), (int)(c.line.size / 16),
+                       scount, (int)(c.loop.size / 4), pvs_bytes);
+  ok = ok && read_geometry(m, &c) && map_build_adjacency(m) &&
+       map_build_line_table(m);
+  if (ok && c.has_pvs)
+    ok = read_pvs(m, &c.pvs);
+
+  mem_free(data);
+  if (!ok) {
+    fprintf(stderr, "%s is not a valid map (version %u)\n", path, k_version);
+    map_destroy(m);
+    return false;
+  }
+  return true;
+}
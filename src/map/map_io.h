@@ -0,0 +1,23 @@
+#ifndef MAP_IO_H
+#define MAP_IO_H
+
+#include <stdbool.h>
+
+#include "map.h"
+#include "pvs.h"
+
+// Map files are "DMAP", a version and a chunk count, followed by chunks of
+// a four-byte tag, a byte size and the payload, all little endian:
+//   VERT  x, y                           f32 each
+//   LINE  v0, v1, front, back            i32 each
+//   SECT  floor, ceil, light, loop count f32 x3, u32
+//   LOOP  vertex indices of every sector loop in sector order, i32
+//   PVS   sector count, row bytes, row offsets[count + 1], RLE rows
+// Readers skip chunks they do not know.
+bool map_save(const Map *m, const PvsData *pvs, const char *path);
+
+// Rebuilds adjacency and the line table, and expands the PVS chunk (when
+// present) into m->pvs so lookups are a single bit test.
+bool map_load(Map *m, const char *path);
+
+#endif // !MAP_IO_H
@@ -0,0 +1,560 @@
+#include "package.h"
+#include "pvs.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const char k_magic[4] = {'D', 'P', 'A', 'K'};
+// 3: line normals point into the front sector.
+static const uint32_t k_version = 3;
+static const uint32_t k_byte_order = 0x01020304u;
+
+enum { LINE_FIELDS = 10 };
+
+typedef struct PackageInfo {
+  int vert_count;
+  int line_count;
+  int sector_count;
+  int loop_count;
+  int adjacency_count;
+  int pvs_row_bytes;
+  int floor_verts;
+  int floor_indices;
+  int wall_verts;
+  int wall_indices;
+  MeshOptStats floor_stats;
+  MeshOptStats wall_stats;
+  float grid_origin_x;
+  float grid_origin_y;
+  float grid_cell;
+  int grid_cols;
+  int grid_rows;
+  int grid_entries;
+  int lightmap_width;
+  int lightmap_height;
+} PackageInfo;
+
+typedef struct PackSector {
+  float floor_h;
+  float ceil_h;
+  float light_level;
+  int loop_first;
+  int loop_count;
+} PackSector;
+
+static size_t aligned(size_t n) { return (n + 15) & ~(size_t)15; }
+
+static void put_pad(FILE *f, size_t size) {
+  static const unsigned char zero[16];
+  fwrite(zero, 1, aligned(size) - size, f);
+}
+
+static void put_chunk(FILE *f, const char tag[4], size_t size) {
+  uint32_t head[3] = {(uint32_t)size, 0, 0};
+  fwrite(tag, 1, 4, f);
+  fwrite(head, sizeof(head), 1, f);
+}
+
+static void put_array(FILE *f, const char tag[4], const void *data,
+                      size_t size) {
+  put_chunk(f, tag, size);
+  fwrite(data, 1, size, f);
+  put_pad(f, size);
+}
+
+static void put_line_table(FILE *f, const Map *m) {
+  const LineTable *t = &m->linetab;
+  const float *fields[LINE_FIELDS] = {t->x0, t->y0,  t->x1,       t->y1,
+                                      t->dx, t->dy,  t->len,      t->inv_len2,
+                                      t->nx, t->ny};
+  size_t bytes = (size_t)m->line_count * sizeof(float);
+  size_t size = LINE_FIELDS * aligned(bytes) + (size_t)m->line_count;
+
+  put_chunk(f, "LTAB", size);
+  for (int i = 0; i < LINE_FIELDS; i++) {
+    fwrite(fields[i], 1, bytes, f);
+    put_pad(f, bytes);
+  }
+  fwrite(t->flags, 1, (size_t)m->line_count, f);
+  put_pad(f, size);
+}
+
+static void put_ranges(FILE *f, const char tag[4], const MeshData *d) {
+  put_chunk(f, tag, (size_t)d->range_count * 4 * sizeof(int));
+  size_t bytes = (size_t)d->range_count * sizeof(int);
+  fwrite(d->sector_first, 1, bytes, f);
+  fwrite(d->sector_count, 1, bytes, f);
+  fwrite(d->lod_first, 1, bytes, f);
+  fwrite(d->lod_count, 1, bytes, f);
+  put_pad(f, bytes * 4);
+}
+
+static PackageInfo package_info(const Map *m, const WorldBake *bake,
+                                const SectorGrid *grid) {
+  PackageInfo info;
+  memset(&info, 0, sizeof(info));
+  info.vert_count = m->vert_count;
+  info.line_count = m->line_count;
+  info.sector_count = m->sector_count;
+  for (int s = 0; s < m->sector_count; s++)
+    info.loop_count += m->sectors[s].loop.count;
+  info.adjacency_count = m->sector_line_start[m->sector_count];
+  info.pvs_row_bytes = m->pvs ? m->pvs_row_bytes : 0;
+  info.floor_verts = bake->floors.vertex_count;
+  info.floor_indices = bake->floors.index_count;
+  info.wall_verts = bake->walls.vertex_count;
+  info.wall_indices = bake->walls.index_count;
+  info.floor_stats = bake->floors.stats;
+  info.wall_stats = bake->walls.stats;
+  info.grid_origin_x = grid->origin_x;
+  info.grid_origin_y = grid->origin_y;
+  info.grid_cell = grid->cell;
+  info.grid_cols = grid->cols;
+  info.grid_rows = grid->rows;
+  info.grid_entries = grid->cell_start[grid->cols * grid->rows];
+  info.lightmap_width = bake->lightmap.width;
+  info.lightmap_height = bake->lightmap.height;
+  return info;
+}
+
+bool package_save(const char *path, const Map *m, const WorldBake *bake,
+                  const SectorGrid *grid) {
+  PackageInfo info = package_info(m, bake, grid);
+  size_t n = (size_t)m->sector_count;
+
+  MemTemp temp;
+  if (!mem_temp_begin(&temp, n * sizeof(PackSector) + 1))
+    return false;
+  PackSector *secs = (PackSector *)temp.ptr;
+  int loop_at = 0;
+  for (size_t s = 0; s < n; s++) {
+    const Sector *sec = &m->sectors[s];
+    secs[s] = (PackSector){sec->floor_h, sec->ceil_h, sec->light_level,
+                           loop_at, sec->loop.count};
+    loop_at += sec->loop.count;
+  }
+
+  FILE *f = fopen(path, "wb");
+  if (!f) {
+    fprintf(stderr, "Failed to open %s for writing\n", path);
+    mem_temp_end(&temp);
+    return false;
+  }
+
+  uint32_t head[3] = {k_version, k_byte_order, m->pvs ? 19u : 18u};
+  fwrite(k_magic, 1, 4, f);
+  fwrite(head, sizeof(head), 1, f);
+
+  put_array(f, "HEAD", &info, sizeof(info));
+  put_array(f, "VERT", m->verts, (size_t)m->vert_count * sizeof(Vec2));
+  put_array(f, "LINE", m->lines, (size_t)m->line_count * sizeof(Linedef));
+  put_array(f, "SECT", secs, n * sizeof(PackSector));
+
+  put_chunk(f, "LOOP", (size_t)info.loop_count * sizeof(int));
+  for (size_t s = 0; s < n; s++)
+    fwrite(m->sectors[s].loop.indices, sizeof(int),
+           (size_t)m->sectors[s].loop.count, f);
+  put_pad(f, (size_t)info.loop_count * sizeof(int));
+
+  put_array(f, "ADJS", m->sector_line_start, (n + 1) * sizeof(int));
+  put_array(f, "ADJL", m->sector_lines,
+            (size_t)info.adjacency_count * sizeof(int));
+  put_line_table(f, m);
+  if (m->pvs)
+    put_array(f, "PVS ", m->pvs, n * (size_t)m->pvs_row_bytes);
+
+  put_array(f, "FVTX", bake->floors.verts,
+            (size_t)info.floor_verts * sizeof(WorldVertex));
+  put_array(f, "FIDX", bake->floors.indices,
+            (size_t)info.floor_indices * sizeof(uint32_t));
+  put_ranges(f, "FRNG", &bake->floors);
+  put_array(f, "WVTX", bake->walls.verts,
+            (size_t)info.wall_verts * sizeof(WorldVertex));
+  put_array(f, "WIDX", bake->walls.indices,
+            (size_t)info.wall_indices * sizeof(uint32_t));
+  put_ranges(f, "WRNG", &bake->walls);
+
+  put_chunk(f, "BNDS", n * 2 * sizeof(Vec3));
+  fwrite(bake->sector_min, sizeof(Vec3), n, f);
+  fwrite(bake->sector_max, sizeof(Vec3), n, f);
+  put_pad(f, n * 2 * sizeof(Vec3));
+
+  put_array(f, "GCEL", grid->cell_start,
+            ((size_t)info.grid_cols * (size_t)info.grid_rows + 1) *
+                sizeof(int));
+  put_array(f, "GSEC", grid->cell_sectors,
+            (size_t)info.grid_entries * sizeof(int));
+  put_array(f, "LMAP", bake->lightmap.pixels,
+            (size_t)info.lightmap_width * (size_t)info.lightmap_height);
+
+  mem_temp_end(&temp);
+  bool ok = !ferror(f);
+  if (fclose(f) != 0)
+    ok = false;
+  if (!ok)
+    fprintf(stderr, "Failed to write %s\n", path);
+  return ok;
+}
+
+static bool map_file(MapPackage *p, const char *path) {
+#ifdef _WIN32
+  HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL,
+                            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (file == INVALID_HANDLE_VALUE)
+    return false;
+  LARGE_INTEGER size;
+  HANDLE mapping = NULL;
+  void *base = NULL;
+  if (GetFileSizeEx(file, &size) && size.QuadPart > 0)
+    mapping = CreateFileMappingA(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+  if (mapping)
+    base = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+  if (!base) {
+    if (mapping)
+      CloseHandle(mapping);
+    CloseHandle(file);
+    return false;
+  }
+  p->file = file;
+  p->mapping = mapping;
+  p->base = base;
+  p->size = (size_t)size.QuadPart;
+  return true;
+#else
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return false;
+  struct stat st;
+  void *base = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && st.st_size > 0)
+    base = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED)
+    return false;
+  p->base = base;
+  p->size = (size_t)st.st_size;
+  return true;
+#endif
+}
+
+static void unmap_file(MapPackage *p) {
+  if (!p->base)
+    return;
+#ifdef _WIN32
+  UnmapViewOfFile(p->base);
+  CloseHandle((HANDLE)p->mapping);
+  CloseHandle((HANDLE)p->file);
+#else
+  munmap(p->base, p->size);
+#endif
+}
+
+enum {
+  CHUNK_HEAD,
+  CHUNK_VERT,
+  CHUNK_LINE,
+  CHUNK_SECT,
+  CHUNK_LOOP,
+  CHUNK_ADJS,
+  CHUNK_ADJL,
+  CHUNK_LTAB,
+  CHUNK_PVS,
+  CHUNK_FVTX,
+  CHUNK_FIDX,
+  CHUNK_FRNG,
+  CHUNK_WVTX,
+  CHUNK_WIDX,
+  CHUNK_WRNG,
+  CHUNK_BNDS,
+  CHUNK_GCEL,
+  CHUNK_GSEC,
+  CHUNK_LMAP,
+  CHUNK_COUNT
+};
+
+static const char k_tags[CHUNK_COUNT][4] = {
+    {'H', 'E', 'A', 'D'}, {'V', 'E', 'R', 'T'}, {'L', 'I', 'N', 'E'},
+    {'S', 'E', 'C', 'T'}, {'L', 'O', 'O', 'P'}, {'A', 'D', 'J', 'S'},
+    {'A', 'D', 'J', 'L'}, {'L', 'T', 'A', 'B'}, {'P', 'V', 'S', ' '},
+    {'F', 'V', 'T', 'X'}, {'F', 'I', 'D', 'X'}, {'F', 'R', 'N', 'G'},
+    {'W', 'V', 'T', 'X'}, {'W', 'I', 'D', 'X'}, {'W', 'R', 'N', 'G'},
+    {'B', 'N', 'D', 'S'}, {'G', 'C', 'E', 'L'}, {'G', 'S', 'E', 'C'},
+    {'L', 'M', 'A', 'P'},
+};
+
+typedef struct PackChunk {
+  unsigned char *data;
+  size_t size;
+} PackChunk;
+
+static bool find_chunks(const MapPackage *p, PackChunk *chunks) {
+  const unsigned char *base = (const unsigned char *)p->base;
+  uint32_t head[3];
+  if (p->size < 16 || memcmp(base, k_magic, 4) != 0)
+    return false;
+  memcpy(head, base + 4, sizeof(head));
+  if (head[0] != k_version || head[1] != k_byte_order)
+    return false;
+
+  size_t at = 16;
+  for (uint32_t i = 0; i < head[2]; i++) {
+    uint32_t size;
+    if (p->size - at < 16)
+      return false;
+    memcpy(&size, base + at + 4, 4);
+    if (size > p->size - at - 16)
+      return false;
+    for (int c = 0; c < CHUNK_COUNT; c++) {
+      if (memcmp(base + at, k_tags[c], 4) == 0)
+        chunks[c] = (PackChunk){(unsigned char *)p->base + at + 16, size};
+    }
+    at += 16 + aligned(size);
+    if (at > p->size)
+      at = p->size;
+  }
+  return true;
+}
+
+// Every array must be exactly as long as the counts in HEAD say.
+static bool check_sizes(const PackChunk *c, const PackageInfo *info) {
+  if (info->vert_count < 0 || info->line_count < 0 || info->loop_count < 0 ||
+      info->adjacency_count < 0 || info->pvs_row_bytes < 0 ||
+      info->floor_verts < 0 || info->floor_indices < 0 ||
+      info->wall_verts < 0 || info->wall_indices < 0 ||
+      info->grid_entries < 0)
+    return false;
+  size_t n = (size_t)info->sector_count;
+  size_t lines = (size_t)info->line_count;
+  size_t cells = (size_t)info->grid_cols * (size_t)info->grid_rows;
+  size_t expect[CHUNK_COUNT] = {
+      sizeof(PackageInfo),
+      (size_t)info->vert_count * sizeof(Vec2),
+      lines * sizeof(Linedef),
+      n * sizeof(PackSector),
+      (size_t)info->loop_count * sizeof(int),
+      (n + 1) * sizeof(int),
+      (size_t)info->adjacency_count * sizeof(int),
+      LINE_FIELDS * aligned(lines * sizeof(float)) + lines,
+      n * (size_t)info->pvs_row_bytes,
+      (size_t)info->floor_verts * sizeof(WorldVertex),
+      (size_t)info->floor_indices * sizeof(uint32_t),
+      n * 4 * sizeof(int),
+      (size_t)info->wall_verts * sizeof(WorldVertex),
+      (size_t)info->wall_indices * sizeof(uint32_t),
+      n * 4 * sizeof(int),
+      n * 2 * sizeof(Vec3),
+      (cells + 1) * sizeof(int),
+      (size_t)info->grid_entries * sizeof(int),
+      (size_t)info->lightmap_width * (size_t)info->lightmap_height,
+  };
+  for (int i = 0; i < CHUNK_COUNT; i++) {
+    if (i == CHUNK_PVS && info->pvs_row_bytes == 0)
+      continue;
+    if (!c[i].data || c[i].size != expect[i])
+      return false;
+  }
+  return info->sector_count > 0 && info->grid_cols > 0 &&
+         info->grid_rows > 0 && info->lightmap_width > 0 &&
+         info->lightmap_height > 0;
+}
+
+// Offsets must start at 0, never decrease and end at `total`.
+static bool check_offsets(const int *start, int count, int total) {
+  if (start[0] != 0 || start[count] != total)
+    return false;
+  for (int i = 0; i < count; i++) {
+    if (start[i] > start[i + 1])
+      return false;
+  }
+  return true;
+}
+
+static bool check_indices(const int *idx, int count, int limit) {
+  for (int i = 0; i < count; i++) {
+    if (idx[i] < 0 || idx[i] >= limit)
+      return false;
+  }
+  return true;
+}
+
+static bool check_mesh(const PackChunk *idx, const PackChunk *rng,
+                       int sectors, int verts) {
+  const uint32_t *indices = (const uint32_t *)idx->data;
+  int index_count = (int)(idx->size / sizeof(uint32_t));
+  for (int i = 0; i < index_count; i++) {
+    if (indices[i] >= (uint32_t)verts)
+      return false;
+  }
+  // First and count pairs for the full and the LOD mesh.
+  const int *r = (const int *)rng->data;
+  for (int k = 0; k < 2; k++, r += 2 * sectors) {
+    for (int s = 0; s < sectors; s++) {
+      int first = r[s], count = r[sectors + s];
+      if (first < 0 || count < 0 || first > index_count - count)
+        return false;
+    }
+  }
+  return true;
+}
+
+// Packages come from the command line, so every index the runtime follows
+// is range checked once here; afterwards the mapping is trusted.
+static bool check_contents(const PackChunk *c, const PackageInfo *info) {
+  int n = info->sector_count;
+  const Linedef *lines = (const Linedef *)c[CHUNK_LINE].data;
+  for (int i = 0; i < info->line_count; i++) {
+    const Linedef *l = &lines[i];
+    if (l->v0 < 0 || l->v0 >= info->vert_count || l->v1 < 0 ||
+        l->v1 >= info->vert_count || l->front_sector < 0 ||
+        l->front_sector >= n || l->back_sector >= n)
+      return false;
+  }
+
+  const PackSector *secs = (const PackSector *)c[CHUNK_SECT].data;
+  for (int s = 0; s < n; s++) {
+    if (secs[s].loop_first < 0 || secs[s].loop_count < 0 ||
+        secs[s].loop_first > info->loop_count - secs[s].loop_count)
+      return false;
+  }
+  if (!check_indices((const int *)c[CHUNK_LOOP].data, info->loop_count,
+                     info->vert_count))
+    return false;
+
+  if (!check_offsets((const int *)c[CHUNK_ADJS].data, n,
+                     info->adjacency_count) ||
+      !check_indices((const int *)c[CHUNK_ADJL].data, info->adjacency_count,
+                     info->line_count))
+    return false;
+
+  if (info->pvs_row_bytes != 0 && info->pvs_row_bytes != pvs_row_bytes(n))
+    return false;
+
+  if (!check_mesh(&c[CHUNK_FIDX], &c[CHUNK_FRNG], n, info->floor_verts) ||
+      !check_mesh(&c[CHUNK_WIDX], &c[CHUNK_WRNG], n, info->wall_verts))
+    return false;
+
+  int cells = info->grid_cols * info->grid_rows;
+  return info->grid_cell > 0.0f &&
+         check_offsets((const int *)c[CHUNK_GCEL].data, cells,
+                       info->grid_entries) &&
+         check_indices((const int *)c[CHUNK_GSEC].data, info->grid_entries,
+                       n);
+}
+
+static void view_mesh(MeshData *d, const PackChunk *vtx, const PackChunk *idx,
+                      const PackChunk *rng, int sectors,
+                      const MeshOptStats *stats) {
+  memset(d, 0, sizeof(*d));
+  d->verts = (WorldVertex *)vtx->data;
+  d->vertex_count = (int)(vtx->size / sizeof(WorldVertex));
+  d->indices = (uint32_t *)idx->data;
+  d->index_count = (int)(idx->size / sizeof(uint32_t));
+  d->range_count = sectors;
+  d->sector_first = (int *)rng->data;
+  d->sector_count = d->sector_first + sectors;
+  d->lod_first = d->sector_count + sectors;
+  d->lod_count = d->lod_first + sectors;
+  d->stats = *stats;
+}
+
+static bool view_map(Map *m, const PackChunk *c, const PackageInfo *info) {
+  memset(m, 0, sizeof(*m));
+  size_t n = (size_t)info->sector_count;
+  if (!arena_init(&m->arena, n * sizeof(Sector) + 16))
+    return false;
+  m->sectors = (Sector *)arena_alloc(&m->arena, n * sizeof(Sector), 16);
+  if (!m->sectors)
+    return false;
+
+  const PackSector *secs = (const PackSector *)c[CHUNK_SECT].data;
+  int *loops = (int *)c[CHUNK_LOOP].data;
+  for (size_t s = 0; s < n; s++) {
+    m->sectors[s] = (Sector){secs[s].floor_h, secs[s].ceil_h,
+                             secs[s].light_level,
+                             {loops + secs[s].loop_first, secs[s].loop_count}};
+  }
+
+  m->verts = (Vec2 *)c[CHUNK_VERT].data;
+  m->vert_count = info->vert_count;
+  m->lines = (Linedef *)c[CHUNK_LINE].data;
+  m->line_count = info->line_count;
+  m->sector_count = info->sector_count;
+  m->sector_line_start = (int *)c[CHUNK_ADJS].data;
+  m->sector_lines = (int *)c[CHUNK_ADJL].data;
+
+  LineTable *t = &m->linetab;
+  float **fields[LINE_FIELDS] = {&t->x0, &t->y0,  &t->x1,       &t->y1,
+                                 &t->dx, &t->dy,  &t->len,      &t->inv_len2,
+                                 &t->nx, &t->ny};
+  size_t stride = aligned((size_t)info->line_count * sizeof(float));
+  unsigned char *at = c[CHUNK_LTAB].data;
+  for (int i = 0; i < LINE_FIELDS; i++, at += stride)
+    *fields[i] = (float *)at;
+  t->flags = at;
+
+  if (info->pvs_row_bytes > 0) {
+    m->pvs = c[CHUNK_PVS].data;
+    m->pvs_row_bytes = info->pvs_row_bytes;
+  }
+  return true;
+}
+
+bool package_open(MapPackage *p, Map *map, const char *path) {
+  memset(p, 0, sizeof(*p));
+  memset(map, 0, sizeof(*map));
+  if (!map_file(p, path)) {
+    fprintf(stderr, "Failed to map package %s\n", path);
+    return false;
+  }
+
+  PackChunk c[CHUNK_COUNT];
+  PackageInfo info;
+  memset(c, 0, sizeof(c));
+  bool ok = find_chunks(p, c) && c[CHUNK_HEAD].size == sizeof(info);
+  if (ok) {
+    memcpy(&info, c[CHUNK_HEAD].data, sizeof(info));
+    ok = check_sizes(c, &info) && check_contents(c, &info) &&
+         view_map(map, c, &info);
+  }
+  if (!ok) {
+    fprintf(stderr, "%s is not a valid package (version %u)\n", path,
+            k_version);
+    package_close(p, map);
+    return false;
+  }
+
+  view_mesh(&p->bake.floors, &c[CHUNK_FVTX], &c[CHUNK_FIDX], &c[CHUNK_FRNG],
+            info.sector_count, &info.floor_stats);
+  view_mesh(&p->bake.walls, &c[CHUNK_WVTX], &c[CHUNK_WIDX], &c[CHUNK_WRNG],
+            info.sector_count, &info.wall_stats);
+  p->bake.sector_min = (Vec3 *)c[CHUNK_BNDS].data;
+  p->bake.sector_max = p->bake.sector_min + info.sector_count;
+  p->bake.lightmap.width = info.lightmap_width;
+  p->bake.lightmap.height = info.lightmap_height;
+  p->bake.lightmap.pixels = c[CHUNK_LMAP].data;
+
+  p->grid.origin_x = info.grid_origin_x;
+  p->grid.origin_y = info.grid_origin_y;
+  p->grid.cell = info.grid_cell;
+  p->grid.cols = info.grid_cols;
+  p->grid.rows = info.grid_rows;
+  p->grid.cell_start = (int *)c[CHUNK_GCEL].data;
+  p->grid.cell_sectors = (int *)c[CHUNK_GSEC].data;
+  return true;
+}
+
+void package_close(MapPackage *p, Map *map) {
+  map_destroy(map);
+  unmap_file(p);
+  memset(p, 0, sizeof(*p));
+}
@@ -0,0 +1,45 @@
+#ifndef PACKAGE_H
+#define PACKAGE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "../geom/world_bake.h"
+#include "map.h"
+#include "sector_grid.h"
+
+// Baked map packages are "DPAK", a version, a byte-order marker and a chunk
+// count, followed by chunks of a four-byte tag, a byte size, padding to 16
+// bytes and the payload, padded to 16 bytes as well. Payloads are the
+// engine's own arrays in native layout, so a package only loads on the
+// byte order and ABI that wrote it:
+//   HEAD  counts and mesh stats         VERT, LINE  Map arrays
+//   SECT  floor, ceil, light, loop first and count per sector
+//   LOOP  loop vertex indices           ADJS, ADJL  sector line adjacency
+//   LTAB  LineTable fields, each 16-byte aligned, then the flags
+//   PVS   expanded visibility rows (optional)
+//   FVTX, FIDX, FRNG  floor WorldVertex array, indices, MeshData ranges
+//   WVTX, WIDX, WRNG  the same for the walls
+//   BNDS  sector boxes, all minimums then all maximums
+//   GCEL, GSEC  SectorGrid cell starts and cell sectors
+//   LMAP  lightmap luxels, width by height bytes; charts are not kept
+bool package_save(const char *path, const Map *m, const WorldBake *bake,
+                  const SectorGrid *grid);
+
+// A package mapped copy-on-write into memory. The map, the bake and the grid
+// all point into the mapping; only the Sector array is built at load.
+typedef struct MapPackage {
+  WorldBake bake;
+  SectorGrid grid;
+  void *base;
+  size_t size;
+  // Win32 file and mapping handles.
+  void *file;
+  void *mapping;
+} MapPackage;
+
+bool package_open(MapPackage *p, Map *map, const char *path);
+// Destroys the map opened with the package, then unmaps it.
+void package_close(MapPackage *p, Map *map);
+
+#endif // !PACKAGE_H
@@ -0,0 +1,415 @@
+#include "pvs.h"
+#include "../core/jobs.h"
+#include "../time.h"
+
+#include <math.h>
+#include <string.h>
+
+// Slack for points lying on a clip line, in world units.
+#define PVS_EPS 1e-4f
+// Every time a portal's reachable span grows it is padded by this much (in
+// line parameter) so the flood cannot crawl forward in float-sized steps.
+#define PVS_SPAN_PAD 1e-3f
+
+// A portal still in sight: `line` clipped to [u0, u1], crossed into `sector`.
+typedef struct PvsEntry {
+  int sector;
+  int line;
+  float u0, u1;
+} PvsEntry;
+
+typedef struct PvsScratch {
+  uint32_t *stamp;
+  float *lo, *hi;
+  uint32_t cur;
+  PvsEntry *stack;
+  int stack_capacity;
+  uint64_t clips;
+  bool failed;
+} PvsScratch;
+
+typedef struct PvsBake {
+  const Map *m;
+  uint8_t *rows;
+  int row_bytes;
+  PvsScratch *scratch;
+} PvsBake;
+
+static float cross2(Vec2 a, Vec2 b) { return a.x * b.y - a.y * b.x; }
+
+static void set_bit(uint8_t *row, int i) {
+  row[i >> 3] |= (uint8_t)(1u << (i & 7));
+}
+
+static bool see_through(const Map *m, int li) {
+  const Linedef *l = &m->lines[li];
+  if (l->back_sector < 0)
+    return false;
+  const Sector *f = &m->sectors[l->front_sector];
+  const Sector *b = &m->sectors[l->back_sector];
+  float floor = (f->floor_h > b->floor_h) ? f->floor_h : b->floor_h;
+  float ceil = (f->ceil_h < b->ceil_h) ? f->ceil_h : b->ceil_h;
+  return ceil - floor > 0.001f;
+}
+
+static int other_side(const Map *m, int li, int sector) {
+  const Linedef *l = &m->lines[li];
+  return (l->front_sector == sector) ? l->back_sector : l->front_sector;
+}
+
+// The span of a portal as a segment with the sector it leads into on its
+// left, so "beyond the portal" is always the positive side of cross2.
+static void portal_points(const Map *m, int li, int into, float u0, float u1,
+                          Vec2 *p0, Vec2 *p1) {
+  const Linedef *l = &m->lines[li];
+  Vec2 a = m->verts[l->v0];
+  Vec2 d = v2_sub(m->verts[l->v1], a);
+  Vec2 s = v2_add(a, v2_mul(d, u0));
+  Vec2 e = v2_add(a, v2_mul(d, u1));
+  if (l->front_sector == into) {
+    *p0 = s;
+    *p1 = e;
+  } else {
+    *p0 = e;
+    *p1 = s;
+  }
+}
+
+// Narrows [*u0, *u1] on origin + u * d to where `side` * cross2(dir, p - q)
+// is not negative (within PVS_EPS). False once nothing is left.
+static bool clip_span(Vec2 origin, Vec2 d, Vec2 q, Vec2 dir, float side,
+                      float *u0, float *u1) {
+  float dir_len = v2_len(dir);
+  if (dir_len < 1e-6f)
+    return true;
+  float k0 = side * cross2(dir, v2_sub(origin, q));
+  float k1 = side * cross2(dir, d);
+  float slack = PVS_EPS * dir_len;
+
+  if (fabsf(k1) < 1e-12f) {
+    if (k0 < -slack)
+      return false;
+  } else {
+    float r = (-slack - k0) / k1;
+    if (k1 > 0.0f) {
+      if (r > *u0)
+        *u0 = r;
+    } else if (r < *u1) {
+      *u1 = r;
+    }
+  }
+  return *u1 > *u0;
+}
+
+// Lines through one endpoint of the source and one of the pass portal that
+// keep the two portals on opposite sides bound everything visible through
+// both; targets are clipped to the pass portal's side of each.
+static bool clip_to_separators(Vec2 origin, Vec2 d, const Vec2 a[2],
+                               const Vec2 b[2], float *u0, float *u1) {
+  for (int i = 0; i < 2; i++) {
+    for (int j = 0; j < 2; j++) {
+      Vec2 dir = v2_sub(b[j], a[i]);
+      float scale = v2_len(dir);
+      if (scale < 1e-6f)
+        continue;
+      float sa = cross2(dir, v2_sub(a[1 - i], a[i]));
+      float sb = cross2(dir, v2_sub(b[1 - j], a[i]));
+      float slack = PVS_EPS * scale;
+      if (!((sa > slack && sb < -slack) || (sa < -slack && sb > slack)))
+        continue;
+      if (!clip_span(origin, d, a[i], dir, sb > 0.0f ? 1.0f : -1.0f, u0, u1))
+        return false;
+    }
+  }
+  return true;
+}
+
+static bool push_entry(PvsScratch *s, int *sp, PvsEntry e) {
+  if (*sp == s->stack_capacity) {
+    int cap = s->stack_capacity ? s->stack_capacity * 2 : 256;
+    PvsEntry *p =
+        (PvsEntry *)mem_realloc(s->stack, (size_t)cap * sizeof(PvsEntry));
+    if (!p)
+      return false;
+    s->stack = p;
+    s->stack_capacity = cap;
+  }
+  s->stack[(*sp)++] = e;
+  return true;
+}
+
+static void next_stamp(const Map *m, PvsScratch *s) {
+  if (++s->cur == 0) {
+    memset(s->stamp, 0, (size_t)m->line_count * 2 * sizeof(uint32_t));
+    s->cur = 1;
+  }
+}
+
+static bool flood_portal(const Map *m, PvsScratch *s, uint8_t *row,
+                         int source_line, int first) {
+  Vec2 a[2];
+  portal_points(m, source_line, first, 0.0f, 1.0f, &a[0], &a[1]);
+  next_stamp(m, s);
+
+  int sp = 0;
+  if (!push_entry(s, &sp, (PvsEntry){first, source_line, 0.0f, 1.0f}))
+    return false;
+
+  while (sp > 0) {
+    PvsEntry e = s->stack[--sp];
+    Vec2 b[2];
+    portal_points(m, e.line, e.sector, e.u0, e.u1, &b[0], &b[1]);
+    Vec2 pass_dir = v2_sub(b[1], b[0]);
+
+    for (int k = m->sector_line_start[e.sector];
+         k < m->sector_line_start[e.sector + 1]; k++) {
+      int li = m->sector_lines[k];
+      if (li == e.line || !see_through(m, li))
+        continue;
+
+      const Linedef *l = &m->lines[li];
+      Vec2 origin = m->verts[l->v0];
+      Vec2 d = v2_sub(m->verts[l->v1], origin);
+      float u0 = 0.0f;
+      float u1 = 1.0f;
+
+      s->clips++;
+      if (!clip_span(origin, d, b[0], pass_dir, 1.0f, &u0, &u1) ||
+          !clip_to_separators(origin, d, a, b, &u0, &u1))
+        continue;
+
+      int to = other_side(m, li, e.sector);
+      int id = li * 2 + (l->front_sector == to ? 0 : 1);
+      if (s->stamp[id] == s->cur) {
+        if (s->lo[id] <= u0 && s->hi[id] >= u1)
+          continue;
+        u0 = fminf(u0, s->lo[id]);
+        u1 = fmaxf(u1, s->hi[id]);
+      }
+      u0 = fmaxf(u0 - PVS_SPAN_PAD, 0.0f);
+      u1 = fminf(u1 + PVS_SPAN_PAD, 1.0f);
+      s->stamp[id] = s->cur;
+      s->lo[id] = u0;
+      s->hi[id] = u1;
+
+      set_bit(row, to);
+      if (!push_entry(s, &sp, (PvsEntry){to, li, u0, u1}))
+        return false;
+    }
+  }
+  return true;
+}
+
+static void bake_range(void *ctx, int worker, int begin, int end) {
+  PvsBake *bake = (PvsBake *)ctx;
+  const Map *m = bake->m;
+  PvsScratch *s = &bake->scratch[worker];
+
+  for (int sector = begin; sector < end; sector++) {
+    uint8_t *row = bake->rows + (size_t)sector * (size_t)bake->row_bytes;
+    set_bit(row, sector);
+
+    for (int k = m->sector_line_start[sector];
+         k < m->sector_line_start[sector + 1]; k++) {
+      int li = m->sector_lines[k];
+      if (!see_through(m, li))
+        continue;
+      int first = other_side(m, li, sector);
+      set_bit(row, first);
+      if (!flood_portal(m, s, row, li, first))
+        s->failed = true;
+    }
+  }
+}
+
+size_t pvs_rle_encode(const uint8_t *row, int row_bytes, uint8_t *dst) {
+  size_t at = 0;
+  for (int i = 0; i < row_bytes;) {
+    if (row[i]) {
+      dst[at++] = row[i++];
+      continue;
+    }
+    int run = 1;
+    while (i + run < row_bytes && run < 255 && !row[i + run])
+      run++;
+    dst[at++] = 0;
+    dst[at++] = (uint8_t)run;
+    i += run;
+  }
+  return at;
+}
+
+bool pvs_rle_decode(const uint8_t *src, size_t size, uint8_t *row,
+                    int row_bytes) {
+  int out = 0;
+  for (size_t i = 0; i < size; i++) {
+    if (src[i]) {
+      if (out >= row_bytes)
+        return false;
+      row[out++] = src[i];
+      continue;
+    }
+    if (++i >= size)
+      return false;
+    int run = src[i];
+    if (run == 0 || out + run > row_bytes)
+      return false;
+    memset(row + out, 0, (size_t)run);
+    out += run;
+  }
+  return out == row_bytes;
+}
+
+void pvs_free(PvsData *p) {
+  if (!p)
+    return;
+  mem_free(p->row_offsets);
+  mem_free(p->rle);
+  memset(p, 0, sizeof(*p));
+}
+
+// Bit j of byte i moves to bit i of byte j.
+static uint64_t transpose8(uint64_t x) {
+  uint64_t t = (x ^ (x >> 7)) & 0x00aa00aa00aa00aaull;
+  x ^= t ^ (t << 7);
+  t = (x ^ (x >> 14)) & 0x0000cccc0000ccccull;
+  x ^= t ^ (t << 14);
+  t = (x ^ (x >> 28)) & 0x00000000f0f0f0f0ull;
+  return x ^ t ^ (t << 28);
+}
+
+// Byte `col` of rows 8 * blk .. 8 * blk + 7, one row per byte.
+static uint64_t load_block(const uint8_t *rows, int n, int row_bytes,
+                           int blk, int col) {
+  uint64_t m = 0;
+  for (int i = 0; i < 8 && blk * 8 + i < n; i++)
+    m |= (uint64_t)rows[(size_t)(blk * 8 + i) * (size_t)row_bytes + col]
+         << (8 * i);
+  return m;
+}
+
+static void store_block(uint8_t *rows, int n, int row_bytes, int blk,
+                        int col, uint64_t m) {
+  for (int i = 0; i < 8 && blk * 8 + i < n; i++)
+    rows[(size_t)(blk * 8 + i) * (size_t)row_bytes + col] =
+        (uint8_t)(m >> (8 * i));
+}
+
+// Sight lines run both ways, so a bit found from either end is kept for both.
+// The matrix is ORed with its transpose an 8x8 block of bits at a time.
+static void make_symmetric(uint8_t *rows, int n, int row_bytes) {
+  for (int a = 0; a < row_bytes; a++) {
+    for (int b = a; b < row_bytes; b++) {
+      uint64_t m = load_block(rows, n, row_bytes, a, b) |
+                   transpose8(load_block(rows, n, row_bytes, b, a));
+      store_block(rows, n, row_bytes, a, b, m);
+      store_block(rows, n, row_bytes, b, a, transpose8(m));
+    }
+  }
+}
+
+static bool encode_rows(const uint8_t *rows, int n, int row_bytes,
+                        PvsData *out) {
+  out->row_offsets = (uint32_t *)mem_alloc(((size_t)n + 1) * sizeof(uint32_t));
+  size_t capacity = (size_t)row_bytes * 2 + 64;
+  out->rle = (uint8_t *)mem_alloc(capacity);
+  if (!out->row_offsets || !out->rle)
+    return false;
+
+  size_t at = 0;
+  for (int s = 0; s < n; s++) {
+    // A row never encodes to more than twice its size.
+    size_t need = at + (size_t)row_bytes * 2;
+    if (need > UINT32_MAX)
+      return false;
+    if (need > capacity) {
+      while (capacity < need)
+        capacity *= 2;
+      uint8_t *p = (uint8_t *)mem_realloc(out->rle, capacity);
+      if (!p)
+        return false;
+      out->rle = p;
+    }
+    out->row_offsets[s] = (uint32_t)at;
+    at += pvs_rle_encode(rows + (size_t)s * (size_t)row_bytes, row_bytes,
+                         out->rle + at);
+  }
+  out->row_offsets[n] = (uint32_t)at;
+  out->rle_size = at;
+  return true;
+}
+
+bool pvs_bake(const Map *m, int threads, PvsData *out, PvsBakeStats *stats) {
+  memset(out, 0, sizeof(*out));
+  if (!m || m->sector_count <= 0 || !m->sector_line_start)
+    return false;
+  if (threads < 1)
+    threads = jobs_hardware_threads();
+
+  double t0 = time_now_seconds();
+  int n = m->sector_count;
+  int row_bytes = pvs_row_bytes(n);
+  size_t raw_bytes = (size_t)n * (size_t)row_bytes;
+  size_t portals = (size_t)m->line_count * 2;
+
+  PvsBake bake;
+  memset(&bake, 0, sizeof(bake));
+  bake.m = m;
+  bake.row_bytes = row_bytes;
+  bake.rows = (uint8_t *)mem_calloc(raw_bytes, 1);
+  bake.scratch = (PvsScratch *)mem_calloc((size_t)threads, sizeof(PvsScratch));
+  bool ok = bake.rows && bake.scratch;
+  for (int i = 0; ok && i < threads; i++) {
+    PvsScratch *s = &bake.scratch[i];
+    s->stamp = (uint32_t *)mem_calloc(portals, sizeof(uint32_t));
+    s->lo = (float *)mem_alloc(portals * sizeof(float));
+    s->hi = (float *)mem_alloc(portals * sizeof(float));
+    ok = s->stamp && s->lo && s->hi;
+  }
+
+  if (ok) {
+    jobs_parallel_for(n, 16, threads, bake_range, &bake);
+    for (int i = 0; i < threads; i++)
+      ok = ok && !bake.scratch[i].failed;
+  }
+  if (ok) {
+    make_symmetric(bake.rows, n, row_bytes);
+    out->sector_count = n;
+    out->row_bytes = row_bytes;
+    ok = encode_rows(bake.rows, n, row_bytes, out);
+  }
+
+  uint64_t clips = 0;
+  uint64_t visible = 0;
+  if (ok) {
+    for (size_t i = 0; i < raw_bytes; i++) {
+      for (uint8_t v = bake.rows[i]; v; v &= (uint8_t)(v - 1))
+        visible++;
+    }
+  }
+  for (int i = 0; bake.scratch && i < threads; i++) {
+    PvsScratch *s = &bake.scratch[i];
+    clips += s->clips;
+    mem_free(s->stamp);
+    mem_free(s->lo);
+    mem_free(s->hi);
+    mem_free(s->stack);
+  }
+  mem_free(bake.scratch);
+  mem_free(bake.rows);
+
+  if (!ok) {
+    pvs_free(out);
+    return false;
+  }
+
+  if (stats) {
+    stats->seconds = time_now_seconds() - t0;
+    stats->threads = threads;
+    stats->raw_bytes = raw_bytes;
+    stats->rle_bytes = out->rle_size + ((size_t)n + 1) * sizeof(uint32_t);
+    stats->portal_clips = clips;
+    stats->avg_visible = (double)visible / (double)n;
+  }
+  return true;
+}
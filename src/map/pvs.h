@@ -0,0 +1,46 @@
+#ifndef PVS_H
+#define PVS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "map.h"
+
+// Potentially visible set in its stored form: one run-length encoded bit
+// row per sector. Row s covers rle[row_offsets[s] .. row_offsets[s + 1]).
+// Zero bytes are written as a 0 followed by the run length (1..255); any
+// other byte is a literal.
+typedef struct PvsData {
+  int sector_count;
+  int row_bytes;
+  uint32_t *row_offsets;
+  uint8_t *rle;
+  size_t rle_size;
+} PvsData;
+
+typedef struct PvsBakeStats {
+  double seconds;
+  int threads;
+  size_t raw_bytes;
+  size_t rle_bytes;
+  uint64_t portal_clips;
+  double avg_visible;
+} PvsBakeStats;
+
+// Floods every sector through its portal sequences, clipping each portal to
+// the region still reachable by a straight line through the first portal and
+// the last one. Conservative: only portals provably out of sight (or closed
+// by their heights) are dropped.
+bool pvs_bake(const Map *m, int threads, PvsData *out, PvsBakeStats *stats);
+void pvs_free(PvsData *p);
+
+static inline int pvs_row_bytes(int sector_count) {
+  return (sector_count + 7) >> 3;
+}
+
+size_t pvs_rle_encode(const uint8_t *row, int row_bytes, uint8_t *dst);
+bool pvs_rle_decode(const uint8_t *src, size_t size, uint8_t *row,
+                    int row_bytes);
+
+#endif // !PVS_H
@@ -0,0 +1,96 @@
+#include "raycast.h"
+
+#include <float.h>
+#include <math.h>
+
+static bool opening_contains(const Map *m, const Linedef *l, float z) {
+  if (l->back_sector < 0)
+    return false;
+  const Sector *a = &m->sectors[l->front_sector];
+  const Sector *b = &m->sectors[l->back_sector];
+  float floor = (a->floor_h > b->floor_h) ? a->floor_h : b->floor_h;
+  float ceil = (a->ceil_h < b->ceil_h) ? a->ceil_h : b->ceil_h;
+  return z > floor && z < ceil;
+}
+
+// Follows o + t * d out of *sector for t in [0, t_max), at height
+// z0 + dz * t. Each step leaves the sector through its nearest exit line
+// beyond the entry point, so only the lines of visited sectors are ever
+// tested. Returns the first line whose opening misses the height and sets
+// *t_hit, or returns -1; *sector is left as the sector the walk ended in.
+static int walk_sectors(const Map *m, int *sector, Vec2 o, Vec2 d,
+                        float t_max, float z0, float dz, float *t_hit) {
+  int s = *sector;
+  int from = -1;
+  float t_min = 0.0f;
+
+  for (int steps = 0; steps <= m->line_count; steps++) {
+    Seg2Batch lines = map_sector_batch(m, s);
+    float best_t = t_max;
+    int k = ray2_cast_batch(o, d, t_min, t_max, &lines, from, &best_t);
+    if (k < 0)
+      break;
+
+    int best = lines.index[k];
+    const Linedef *l = &m->lines[best];
+    if (!opening_contains(m, l, z0 + dz * best_t)) {
+      *sector = s;
+      *t_hit = best_t;
+      return best;
+    }
+
+    s = (l->front_sector == s) ? l->back_sector : l->front_sector;
+    from = best;
+    t_min = best_t;
+  }
+  *sector = s;
+  return -1;
+}
+
+bool map_raycast(const Map *m, const Ray *ray, RayHit *hit) {
+  Vec2 o = ray->origin;
+  Vec2 d = ray->dir;
+  int sector = ray->sector;
+  float t = ray->max_dist;
+  // A wall exactly at max_dist still counts as hit.
+  int line = walk_sectors(m, &sector, o, d, nextafterf(ray->max_dist, FLT_MAX),
+                          ray->z, 0.0f, &t);
+
+  hit->line = line;
+  hit->sector = sector;
+  hit->dist = t;
+  hit->point = v2_add(o, v2_mul(d, t));
+  return line >= 0;
+}
+
+int map_raycast_batch(const Map *m, const Ray *rays, int count, RayHit *hits) {
+  int hit_count = 0;
+  for (int i = 0; i < count; i++)
+    hit_count += map_raycast(m, &rays[i], &hits[i]) ? 1 : 0;
+  return hit_count;
+}
+
+bool map_line_of_sight(const Map *m, int sector, Vec2 a, Vec2 b, float z) {
+  Vec2 ab = v2_sub(b, a);
+  float dist = v2_len(ab);
+  if (dist <= 1e-6f)
+    return true;
+
+  Ray ray;
+  ray.origin = a;
+  ray.dir = v2_mul(ab, 1.0f / dist);
+  ray.z = z;
+  ray.max_dist = dist;
+  ray.sector = sector;
+
+  RayHit hit;
+  return !map_raycast(m, &ray, &hit);
+}
+
+bool map_segment_visible(const Map *m, int sector, Vec2 a, float za, Vec2 b,
+                         float zb) {
+  // t runs over [0, 1] along a-b. Between portals the segment stays inside
+  // the flat floor and ceiling of each sector.
+  float t;
+  return walk_sectors(m, &sector, a, v2_sub(b, a), 1.0f, za, zb - za, &t) < 0;
+}
@@ -0,0 +1,38 @@
+#ifndef RAYCAST_H
+#define RAYCAST_H
+
+#include <stdbool.h>
+
+#include "../math/vec2.h"
+#include "map.h"
+
+// A horizontal ray at height z; dir is unit length. Portals let it through
+// when z lies inside their opening; anything else stops it.
+typedef struct Ray {
+  Vec2 origin;
+  Vec2 dir;
+  float z;
+  float max_dist;
+  int sector;
+} Ray;
+
+typedef struct RayHit {
+  int line;
+  int sector;
+  float dist;
+  Vec2 point;
+} RayHit;
+
+// Walks from ray->sector through portals. Returns true when a wall is hit
+// within max_dist; hit->sector is always the sector the ray ended in.
+bool map_raycast(const Map *m, const Ray *ray, RayHit *hit);
+int map_raycast_batch(const Map *m, const Ray *rays, int count, RayHit *hits);
+
+bool map_line_of_sight(const Map *m, int sector, Vec2 a, Vec2 b, float z);
+
+// Like map_line_of_sight for a sloped segment from height za at a to zb at
+// b: every portal must be open at the height where the segment crosses it.
+bool map_segment_visible(const Map *m, int sector, Vec2 a, float za, Vec2 b,
+                         float zb);
+
+#endif // !RAYCAST_H
@@ -0,0 +1,139 @@
+#include "sector_grid.h"
+
+#include <math.h>
+#include <string.h>
+
+enum { MAX_GRID_SIDE = 1024 };
+
+typedef struct Box2 {
+  float x0, y0, x1, y1;
+} Box2;
+
+static Box2 loop_box(const Map *map, const SectorLoop *loop) {
+  Box2 b = {1e30f, 1e30f, -1e30f, -1e30f};
+  for (int i = 0; i < loop->count; i++) {
+    Vec2 p = map->verts[loop->indices[i]];
+    b.x0 = fminf(b.x0, p.x);
+    b.y0 = fminf(b.y0, p.y);
+    b.x1 = fmaxf(b.x1, p.x);
+    b.y1 = fmaxf(b.y1, p.y);
+  }
+  return b;
+}
+
+static int clamp_cell(float v, int n) {
+  int c = (int)floorf(v);
+  return (c < 0) ? 0 : (c >= n) ? n - 1 : c;
+}
+
+static void cell_span(const SectorGrid *g, Box2 b, int *cx0, int *cy0,
+                      int *cx1, int *cy1) {
+  *cx0 = clamp_cell((b.x0 - g->origin_x) / g->cell, g->cols);
+  *cy0 = clamp_cell((b.y0 - g->origin_y) / g->cell, g->rows);
+  *cx1 = clamp_cell((b.x1 - g->origin_x) / g->cell, g->cols);
+  *cy1 = clamp_cell((b.y1 - g->origin_y) / g->cell, g->rows);
+}
+
+// Two passes over the sector boxes: count per cell, then fill back to
+// front so the prefix sums end up as each cell's start.
+bool sector_grid_build(SectorGrid *g, const Map *map) {
+  memset(g, 0, sizeof(*g));
+  if (map->vert_count <= 0 || map->sector_count <= 0)
+    return false;
+
+  Box2 all = {1e30f, 1e30f, -1e30f, -1e30f};
+  for (int i = 0; i < map->vert_count; i++) {
+    all.x0 = fminf(all.x0, map->verts[i].x);
+    all.y0 = fminf(all.y0, map->verts[i].y);
+    all.x1 = fmaxf(all.x1, map->verts[i].x);
+    all.y1 = fmaxf(all.y1, map->verts[i].y);
+  }
+
+  // About one sector per cell.
+  float w = fmaxf(all.x1 - all.x0, 1e-3f);
+  float h = fmaxf(all.y1 - all.y0, 1e-3f);
+  g->cell = sqrtf(w * h / (float)map->sector_count);
+  g->cell = fmaxf(g->cell, fmaxf(w, h) / MAX_GRID_SIDE);
+  g->origin_x = all.x0;
+  g->origin_y = all.y0;
+  g->cols = (int)(w / g->cell) + 1;
+  g->rows = (int)(h / g->cell) + 1;
+
+  size_t cells = (size_t)g->cols * (size_t)g->rows;
+  size_t entries = 0;
+  for (int s = 0; s < map->sector_count; s++) {
+    int cx0, cy0, cx1, cy1;
+    cell_span(g, loop_box(map, &map->sectors[s].loop), &cx0, &cy0, &cx1,
+              &cy1);
+    entries += (size_t)(cx1 - cx0 + 1) * (size_t)(cy1 - cy0 + 1);
+  }
+
+  g->block = mem_alloc((cells + 1 + entries) * sizeof(int));
+  if (!g->block)
+    return false;
+  g->cell_start = (int *)g->block;
+  g->cell_sectors = g->cell_start + cells + 1;
+  memset(g->cell_start, 0, (cells + 1) * sizeof(int));
+
+  for (int pass = 0; pass < 2; pass++) {
+    for (int s = map->sector_count - 1; s >= 0; s--) {
+      int cx0, cy0, cx1, cy1;
+      cell_span(g, loop_box(map, &map->sectors[s].loop), &cx0, &cy0, &cx1,
+                &cy1);
+      for (int cy = cy0; cy <= cy1; cy++) {
+        for (int cx = cx0; cx <= cx1; cx++) {
+          size_t c = (size_t)cy * (size_t)g->cols + (size_t)cx;
+          if (pass == 0)
+            g->cell_start[c + 1]++;
+          else
+            g->cell_sectors[--g->cell_start[c + 1]] = s;
+        }
+      }
+    }
+    if (pass == 0) {
+      for (size_t c = 0; c < cells; c++)
+        g->cell_start[c + 1] += g->cell_start[c];
+    }
+  }
+  // The fill walked every end down to the next cell's start.
+  memmove(g->cell_start, g->cell_start + 1, cells * sizeof(int));
+  g->cell_start[cells] = (int)entries;
+  return true;
+}
+
+void sector_grid_free(SectorGrid *g) {
+  if (!g)
+    return;
+  mem_free(g->block);
+  memset(g, 0, sizeof(*g));
+}
+
+bool sector_loop_contains(const Map *map, const SectorLoop *loop, Vec2 p) {
+  bool inside = false;
+  for (int i = 0, j = loop->count - 1; i < loop->count; j = i++) {
+    Vec2 a = map->verts[loop->indices[i]];
+    Vec2 b = map->verts[loop->indices[j]];
+    if ((a.y > p.y) != (b.y > p.y) &&
+        p.x < a.x + (p.y - a.y) * (b.x - a.x) / (b.y - a.y))
+      inside = !inside;
+  }
+  return inside;
+}
+
+int sector_grid_locate(const SectorGrid *g, const Map *map, Vec2 p) {
+  if (!g->cell_start)
+    return -1;
+  float fx = (p.x - g->origin_x) / g->cell;
+  float fy = (p.y - g->origin_y) / g->cell;
+  if (fx < 0.0f || fy < 0.0f || fx >= (float)g->cols ||
+      fy >= (float)g->rows)
+    return -1;
+
+  size_t c = (size_t)fy * (size_t)g->cols + (size_t)fx;
+  for (int k = g->cell_start[c]; k < g->cell_start[c + 1]; k++) {
+    int s = g->cell_sectors[k];
+    if (sector_loop_contains(map, &map->sectors[s].loop, p))
+      return s;
+  }
+  return -1;
+}
@@ -0,0 +1,31 @@
+#ifndef SECTOR_GRID_H
+#define SECTOR_GRID_H
+
+#include <stdbool.h>
+
+#include "map.h"
+
+// Uniform grid over the map listing, per cell, every sector whose bounding
+// box touches it: cell c holds cell_sectors[cell_start[c] ..
+// cell_start[c + 1]). Either owns one block or is a view into a package.
+typedef struct SectorGrid {
+  float origin_x;
+  float origin_y;
+  float cell;
+  int cols;
+  int rows;
+  int *cell_start;
+  int *cell_sectors;
+  void *block;
+} SectorGrid;
+
+bool sector_grid_build(SectorGrid *g, const Map *map);
+void sector_grid_free(SectorGrid *g);
+
+// Even-odd crossing test against a sector's boundary loop.
+bool sector_loop_contains(const Map *map, const SectorLoop *loop, Vec2 p);
+
+// The sector whose loop contains p, or -1.
+int sector_grid_locate(const SectorGrid *g, const Map *map, Vec2 p);
+
+#endif // !SECTOR_GRID_H
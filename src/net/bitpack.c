@@ -0,0 +1,87 @@
+#include "bitpack.h"
+
+// Variable length values: a zero bit for 0, otherwise a one bit, a 2-bit
+// size class and the value in 4, 8, 16 or 32 bits.
+static const int k_class_bits[4] = {4, 8, 16, 32};
+
+BitWriter bit_writer(void *buf, size_t cap) {
+  BitWriter w = {(uint8_t *)buf, cap, 0, 0, 0, false};
+  return w;
+}
+
+void bits_write(BitWriter *w, uint32_t value, int count) {
+  if (count < 32)
+    value &= (1u << count) - 1u;
+
+  w->scratch |= (uint64_t)value << w->scratch_bits;
+  w->scratch_bits += count;
+
+  while (w->scratch_bits >= 8) {
+    if (w->at >= w->cap) {
+      w->overflow = true;
+    } else {
+      w->buf[w->at++] = (uint8_t)w->scratch;
+    }
+    w->scratch >>= 8;
+    w->scratch_bits -= 8;
+  }
+}
+
+void bits_write_varuint(BitWriter *w, uint32_t value) {
+  if (value == 0) {
+    bits_write(w, 0, 1);
+    return;
+  }
+
+  int cls = 0;
+  while (cls < 3 && value >= (1ull << k_class_bits[cls]))
+    cls++;
+
+  bits_write(w, 1, 1);
+  bits_write(w, (uint32_t)cls, 2);
+  bits_write(w, value, k_class_bits[cls]);
+}
+
+void bits_write_varint(BitWriter *w, int32_t value) {
+  uint32_t zz = ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+  bits_write_varuint(w, zz);
+}
+
+size_t bits_flush(BitWriter *w) {
+  if (w->scratch_bits > 0)
+    bits_write(w, 0, 8 - w->scratch_bits);
+  return w->overflow ? 0 : w->at;
+}
+
+BitReader bit_reader(const void *buf, size_t size) {
+  BitReader r = {(const uint8_t *)buf, size, 0, 0, 0, false};
+  return r;
+}
+
+uint32_t bits_read(BitReader *r, int count) {
+  while (r->scratch_bits < count) {
+    if (r->at >= r->size) {
+      r->overflow = true;
+      return 0;
+    }
+    r->scratch |= (uint64_t)r->buf[r->at++] << r->scratch_bits;
+    r->scratch_bits += 8;
+  }
+
+  uint32_t value = (uint32_t)(r->scratch & ((1ull << count) - 1ull));
+  r->scratch >>= count;
+  r->scratch_bits -= count;
+  return value;
+}
+
+uint32_t bits_read_varuint(BitReader *r) {
+  if (!bits_read(r, 1))
+    return 0;
+  int cls = (int)bits_read(r, 2);
+  return bits_read(r, k_class_bits[cls]);
+}
+
+int32_t bits_read_varint(BitReader *r) {
+  uint32_t zz = bits_read_varuint(r);
+  return (int32_t)((zz >> 1) ^ (~(zz & 1u) + 1u));
+}
@@ -0,0 +1,37 @@
+#ifndef BITPACK_H
+#define BITPACK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct BitWriter {
+  uint8_t *buf;
+  size_t cap;
+  size_t at;
+  uint64_t scratch;
+  int scratch_bits;
+  bool overflow;
+} BitWriter;
+
+typedef struct BitReader {
+  const uint8_t *buf;
+  size_t size;
+  size_t at;
+  uint64_t scratch;
+  int scratch_bits;
+  bool overflow;
+} BitReader;
+
+BitWriter bit_writer(void *buf, size_t cap);
+void bits_write(BitWriter *w, uint32_t value, int count);
+void bits_write_varuint(BitWriter *w, uint32_t value);
+void bits_write_varint(BitWriter *w, int32_t value);
+size_t bits_flush(BitWriter *w);
+
+BitReader bit_reader(const void *buf, size_t size);
+uint32_t bits_read(BitReader *r, int count);
+uint32_t bits_read_varuint(BitReader *r);
+int32_t bits_read_varint(BitReader *r);
+
+#endif // !BITPACK_H
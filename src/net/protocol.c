@@ -0,0 +1,127 @@
+#include "protocol.h"
+
+#include <string.h>
+
+ByteWriter byte_writer(void *buf, size_t cap) {
+  ByteWriter w = {(uint8_t *)buf, cap, 0, false};
+  return w;
+}
+
+static uint8_t *bw_reserve(ByteWriter *w, size_t n) {
+  if (w->overflow || w->at + n > w->cap) {
+    w->overflow = true;
+    return NULL;
+  }
+  uint8_t *p = w->buf + w->at;
+  w->at += n;
+  return p;
+}
+
+void bw_u8(ByteWriter *w, uint8_t v) {
+  uint8_t *p = bw_reserve(w, 1);
+  if (p)
+    p[0] = v;
+}
+
+void bw_u16(ByteWriter *w, uint16_t v) {
+  uint8_t *p = bw_reserve(w, 2);
+  if (p) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+  }
+}
+
+void bw_u32(ByteWriter *w, uint32_t v) {
+  uint8_t *p = bw_reserve(w, 4);
+  if (p) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+  }
+}
+
+void bw_f32(ByteWriter *w, float v) {
+  uint32_t bits;
+  memcpy(&bits, &v, sizeof(bits));
+  bw_u32(w, bits);
+}
+
+ByteReader byte_reader(const void *buf, size_t size) {
+  ByteReader r = {(const uint8_t *)buf, size, 0, false};
+  return r;
+}
+
+static const uint8_t *br_take(ByteReader *r, size_t n) {
+  if (r->overflow || r->at + n > r->size) {
+    r->overflow = true;
+    return NULL;
+  }
+  const uint8_t *p = r->buf + r->at;
+  r->at += n;
+  return p;
+}
+
+uint8_t br_u8(ByteReader *r) {
+  const uint8_t *p = br_take(r, 1);
+  return p ? p[0] : 0;
+}
+
+uint16_t br_u16(ByteReader *r) {
+  const uint8_t *p = br_take(r, 2);
+  return p ? (uint16_t)(p[0] | (p[1] << 8)) : 0;
+}
+
+uint32_t br_u32(ByteReader *r) {
+  const uint8_t *p = br_take(r, 4);
+  if (!p)
+    return 0;
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) |
+         ((uint32_t)p[3] << 24);
+}
+
+float br_f32(ByteReader *r) {
+  uint32_t bits = br_u32(r);
+  float v;
+  memcpy(&v, &bits, sizeof(v));
+  return v;
+}
+
+static size_t finish(const ByteWriter *w) { return w->overflow ? 0 : w->at; }
+
+size_t msg_write_connect(void *buf, size_t cap) {
+  ByteWriter w = byte_writer(buf, cap);
+  bw_u8(&w, MSG_CONNECT);
+  return finish(&w);
+}
+
+size_t msg_write_welcome(void *buf, size_t cap, uint16_t player) {
+  ByteWriter w = byte_writer(buf, cap);
+  bw_u8(&w, MSG_WELCOME);
+  bw_u16(&w, player);
+  return finish(&w);
+}
+
+size_t msg_write_reject(void *buf, size_t cap) {
+  ByteWriter w = byte_writer(buf, cap);
+  bw_u8(&w, MSG_REJECT);
+  return finish(&w);
+}
+
+size_t msg_write_input(void *buf, size_t cap, uint16_t player, uint32_t tick,
+                       uint32_t ack_tick, PlayerCmd cmd) {
+  ByteWriter w = byte_writer(buf, cap);
+  bw_u8(&w, MSG_INPUT);
+  bw_u16(&w, player);
+  bw_u32(&w, tick);
+  bw_u32(&w, ack_tick);
+  bw_u8(&w, cmd.buttons);
+  return finish(&w);
+}
+
+size_t msg_write_disconnect(void *buf, size_t cap, uint16_t player) {
+  ByteWriter w = byte_writer(buf, cap);
+  bw_u8(&w, MSG_DISCONNECT);
+  bw_u16(&w, player);
+  return finish(&w);
+}
@@ -0,0 +1,52 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../game/player.h"
+
+enum {
+  MSG_CONNECT = 1,
+  MSG_WELCOME,
+  MSG_REJECT,
+  MSG_INPUT,
+  MSG_SNAPSHOT,
+  MSG_DISCONNECT,
+};
+
+typedef struct ByteWriter {
+  uint8_t *buf;
+  size_t cap;
+  size_t at;
+  bool overflow;
+} ByteWriter;
+
+typedef struct ByteReader {
+  const uint8_t *buf;
+  size_t size;
+  size_t at;
+  bool overflow;
+} ByteReader;
+
+ByteWriter byte_writer(void *buf, size_t cap);
+void bw_u8(ByteWriter *w, uint8_t v);
+void bw_u16(ByteWriter *w, uint16_t v);
+void bw_u32(ByteWriter *w, uint32_t v);
+void bw_f32(ByteWriter *w, float v);
+
+ByteReader byte_reader(const void *buf, size_t size);
+uint8_t br_u8(ByteReader *r);
+uint16_t br_u16(ByteReader *r);
+uint32_t br_u32(ByteReader *r);
+float br_f32(ByteReader *r);
+
+size_t msg_write_connect(void *buf, size_t cap);
+size_t msg_write_welcome(void *buf, size_t cap, uint16_t player);
+size_t msg_write_reject(void *buf, size_t cap);
+size_t msg_write_input(void *buf, size_t cap, uint16_t player, uint32_t tick,
+                       uint32_t ack_tick, PlayerCmd cmd);
+size_t msg_write_disconnect(void *buf, size_t cap, uint16_t player);
+
+#endif // !PROTOCOL_H
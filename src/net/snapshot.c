@@ -0,0 +1,188 @@
+#include "snapshot.h"
+#include "../core/mem.h"
+#include "bitpack.h"
+#include "protocol.h"
+
+#include <math.h>
+#include <string.h>
+
+static const NetEntity k_zero_entity = {0, 0, 0, 0, 0, 0};
+
+bool snapshot_init(Snapshot *s, int capacity) {
+  memset(s, 0, sizeof(*s));
+  s->active = (uint8_t *)mem_calloc((size_t)capacity, 1);
+  s->ents = (NetEntity *)mem_calloc((size_t)capacity, sizeof(NetEntity));
+  if (!s->active || !s->ents) {
+    snapshot_free(s);
+    return false;
+  }
+  s->capacity = capacity;
+  return true;
+}
+
+void snapshot_free(Snapshot *s) {
+  mem_free(s->active);
+  mem_free(s->ents);
+  memset(s, 0, sizeof(*s));
+}
+
+void snapshot_clear(Snapshot *s, uint32_t tick) {
+  s->tick = tick;
+  memset(s->active, 0, (size_t)s->capacity);
+}
+
+void snapshot_set_player(Snapshot *s, int id, const Player *p) {
+  const float two_pi = 6.28318530718f;
+  float turns = p->yaw / two_pi;
+  turns -= floorf(turns);
+
+  NetEntity *e = &s->ents[id];
+  e->x = (int32_t)lrintf(p->pos.x * SNAPSHOT_POS_SCALE);
+  e->y = (int32_t)lrintf(p->pos.y * SNAPSHOT_POS_SCALE);
+  e->z = (int32_t)lrintf(p->z * SNAPSHOT_POS_SCALE);
+  e->yaw = (uint16_t)lrintf(turns * 65536.0f);
+  e->on_ground = p->on_ground ? 1 : 0;
+  e->sector = (int32_t)p->sector;
+  s->active[id] = 1;
+}
+
+void snapshot_to_player(const Snapshot *s, int id, Player *p) {
+  const NetEntity *e = &s->ents[id];
+  p->pos.x = (float)e->x / SNAPSHOT_POS_SCALE;
+  p->pos.y = (float)e->y / SNAPSHOT_POS_SCALE;
+  p->z = (float)e->z / SNAPSHOT_POS_SCALE;
+  p->yaw = (float)e->yaw * (6.28318530718f / 65536.0f);
+  p->on_ground = e->on_ground != 0;
+  p->sector = e->sector;
+}
+
+static bool entity_equal(const NetEntity *a, const NetEntity *b) {
+  return a->x == b->x && a->y == b->y && a->z == b->z && a->yaw == b->yaw &&
+         a->on_ground == b->on_ground && a->sector == b->sector;
+}
+
+bool snapshot_equal(const Snapshot *a, const Snapshot *b) {
+  if (a->capacity != b->capacity)
+    return false;
+  for (int i = 0; i < a->capacity; i++) {
+    if (a->active[i] != b->active[i])
+      return false;
+    if (a->active[i] && !entity_equal(&a->ents[i], &b->ents[i]))
+      return false;
+  }
+  return true;
+}
+
+static bool slot_changed(const Snapshot *cur, const Snapshot *base, int i) {
+  bool was = base && base->active[i];
+  if (cur->active[i] != was)
+    return true;
+  return cur->active[i] && !entity_equal(&cur->ents[i], &base->ents[i]);
+}
+
+size_t snapshot_encode(const Snapshot *cur, const Snapshot *base, void *out,
+                       size_t cap) {
+  if (base && base->capacity != cur->capacity)
+    base = NULL;
+
+  int changed = 0;
+  for (int i = 0; i < cur->capacity; i++)
+    changed += slot_changed(cur, base, i);
+
+  BitWriter w = bit_writer(out, cap);
+  bits_write(&w, MSG_SNAPSHOT, 8);
+  bits_write(&w, cur->tick, 32);
+  bits_write(&w, base ? base->tick : 0, 32);
+  bits_write(&w, (uint32_t)cur->capacity, 16);
+  bits_write(&w, (uint32_t)changed, 16);
+
+  // Only changed slots are sent, as a slot gap followed by per-field deltas
+  // against the acknowledged baseline (or zero for a full snapshot).
+  int prev = -1;
+  for (int i = 0; i < cur->capacity; i++) {
+    if (!slot_changed(cur, base, i))
+      continue;
+
+    bits_write_varuint(&w, (uint32_t)(i - prev - 1));
+    prev = i;
+
+    bits_write(&w, cur->active[i], 1);
+    if (!cur->active[i])
+      continue;
+
+    const NetEntity *e = &cur->ents[i];
+    const NetEntity *b =
+        (base && base->active[i]) ? &base->ents[i] : &k_zero_entity;
+    bits_write_varint(&w, (int32_t)((uint32_t)e->x - (uint32_t)b->x));
+    bits_write_varint(&w, (int32_t)((uint32_t)e->y - (uint32_t)b->y));
+    bits_write_varint(&w, (int32_t)((uint32_t)e->z - (uint32_t)b->z));
+    bits_write_varint(&w, (int16_t)(uint16_t)(e->yaw - b->yaw));
+    bits_write(&w, e->on_ground, 1);
+    bits_write_varint(&w,
+                      (int32_t)((uint32_t)e->sector - (uint32_t)b->sector));
+  }
+
+  return bits_flush(&w);
+}
+
+bool snapshot_peek(const void *data, size_t size, uint32_t *tick,
+                   uint32_t *base_tick, int *capacity) {
+  BitReader r = bit_reader(data, size);
+  if (bits_read(&r, 8) != MSG_SNAPSHOT)
+    return false;
+  *tick = bits_read(&r, 32);
+  *base_tick = bits_read(&r, 32);
+  *capacity = (int)bits_read(&r, 16);
+  return !r.overflow;
+}
+
+bool snapshot_decode(Snapshot *out, const Snapshot *base, const void *data,
+                     size_t size) {
+  BitReader r = bit_reader(data, size);
+  if (bits_read(&r, 8) != MSG_SNAPSHOT)
+    return false;
+
+  uint32_t tick = bits_read(&r, 32);
+  uint32_t base_tick = bits_read(&r, 32);
+  int capacity = (int)bits_read(&r, 16);
+  int changed = (int)bits_read(&r, 16);
+  if (r.overflow || capacity != out->capacity)
+    return false;
+  if (base_tick != 0 &&
+      (!base || base->tick != base_tick || base->capacity != capacity))
+    return false;
+  if (base_tick == 0)
+    base = NULL;
+
+  if (base) {
+    memcpy(out->active, base->active, (size_t)capacity);
+    memcpy(out->ents, base->ents, (size_t)capacity * sizeof(NetEntity));
+  } else {
+    memset(out->active, 0, (size_t)capacity);
+  }
+  out->tick = tick;
+
+  int slot = -1;
+  for (int n = 0; n < changed; n++) {
+    slot += (int)bits_read_varuint(&r) + 1;
+    if (r.overflow || slot >= capacity)
+      return false;
+
+    out->active[slot] = (uint8_t)bits_read(&r, 1);
+    if (!out->active[slot])
+      continue;
+
+    const NetEntity *b =
+        (base && base->active[slot]) ? &base->ents[slot] : &k_zero_entity;
+    NetEntity *e = &out->ents[slot];
+    e->x = (int32_t)((uint32_t)b->x + (uint32_t)bits_read_varint(&r));
+    e->y = (int32_t)((uint32_t)b->y + (uint32_t)bits_read_varint(&r));
+    e->z = (int32_t)((uint32_t)b->z + (uint32_t)bits_read_varint(&r));
+    e->yaw = (uint16_t)(b->yaw + (uint16_t)bits_read_varint(&r));
+    e->on_ground = (uint8_t)bits_read(&r, 1);
+    e->sector =
+        (int32_t)((uint32_t)b->sector + (uint32_t)bits_read_varint(&r));
+  }
+
+  return !r.overflow;
+}
@@ -0,0 +1,44 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../game/player.h"
+
+// Positions and heights travel in 1/256 map units, yaw as a 16-bit turn
+// fraction.
+enum { SNAPSHOT_POS_SCALE = 256, SNAPSHOT_HISTORY = 32 };
+
+typedef struct NetEntity {
+  int32_t x;
+  int32_t y;
+  int32_t z;
+  uint16_t yaw;
+  uint8_t on_ground;
+  int32_t sector;
+} NetEntity;
+
+typedef struct Snapshot {
+  uint32_t tick;
+  int capacity;
+  uint8_t *active;
+  NetEntity *ents;
+} Snapshot;
+
+bool snapshot_init(Snapshot *s, int capacity);
+void snapshot_free(Snapshot *s);
+void snapshot_clear(Snapshot *s, uint32_t tick);
+void snapshot_set_player(Snapshot *s, int id, const Player *p);
+void snapshot_to_player(const Snapshot *s, int id, Player *p);
+bool snapshot_equal(const Snapshot *a, const Snapshot *b);
+
+size_t snapshot_encode(const Snapshot *cur, const Snapshot *base, void *out,
+                       size_t cap);
+bool snapshot_peek(const void *data, size_t size, uint32_t *tick,
+                   uint32_t *base_tick, int *capacity);
+bool snapshot_decode(Snapshot *out, const Snapshot *base, const void *data,
+                     size_t size);
+
+#endif // !SNAPSHOT_H
@@ -0,0 +1,86 @@
+#include "udp.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static struct sockaddr_in to_sockaddr(NetAddr a) {
+  struct sockaddr_in sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sin_family = AF_INET;
+  sa.sin_addr.s_addr = htonl(a.ip);
+  sa.sin_port = htons(a.port);
+  return sa;
+}
+
+bool udp_open(UdpSocket *s, uint16_t port) {
+  s->fd = socket(AF_INET, SOCK_DGRAM, 0);
+  s->port = 0;
+  if (s->fd < 0) {
+    perror("socket");
+    return false;
+  }
+
+  // Loopback only: simulation instances are local by design.
+  struct sockaddr_in sa = to_sockaddr(net_loopback(port));
+  if (bind(s->fd, (struct sockaddr *)&sa, sizeof(sa)) != 0) {
+    perror("bind");
+    udp_close(s);
+    return false;
+  }
+
+  int flags = fcntl(s->fd, F_GETFL, 0);
+  fcntl(s->fd, F_SETFL, flags | O_NONBLOCK);
+
+  int buf = 4 * 1024 * 1024;
+  setsockopt(s->fd, SOL_SOCKET, SO_RCVBUF, &buf, sizeof(buf));
+  setsockopt(s->fd, SOL_SOCKET, SO_SNDBUF, &buf, sizeof(buf));
+
+  socklen_t len = sizeof(sa);
+  getsockname(s->fd, (struct sockaddr *)&sa, &len);
+  s->port = ntohs(sa.sin_port);
+  return true;
+}
+
+void udp_close(UdpSocket *s) {
+  if (s->fd >= 0)
+    close(s->fd);
+  s->fd = -1;
+  s->port = 0;
+}
+
+NetAddr net_loopback(uint16_t port) {
+  NetAddr a = {INADDR_LOOPBACK, port};
+  return a;
+}
+
+bool net_addr_equal(NetAddr a, NetAddr b) {
+  return a.ip == b.ip && a.port == b.port;
+}
+
+bool udp_send(const UdpSocket *s, NetAddr to, const void *data, size_t len) {
+  struct sockaddr_in sa = to_sockaddr(to);
+  ssize_t n =
+      sendto(s->fd, data, len, 0, (const struct sockaddr *)&sa, sizeof(sa));
+  return n == (ssize_t)len;
+}
+
+int udp_recv(const UdpSocket *s, NetAddr *from, void *buf, size_t cap) {
+  struct sockaddr_in sa;
+  socklen_t len = sizeof(sa);
+  ssize_t n = recvfrom(s->fd, buf, cap, 0, (struct sockaddr *)&sa, &len);
+  if (n < 0) {
+    if (errno != EAGAIN && errno != EWOULDBLOCK)
+      perror("recvfrom");
+    return -1;
+  }
+
+  from->ip = ntohl(sa.sin_addr.s_addr);
+  from->port = ntohs(sa.sin_port);
+  return (int)n;
+}
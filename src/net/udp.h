@@ -0,0 +1,29 @@
+#ifndef UDP_H
+#define UDP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+enum { UDP_MAX_PACKET = 65507 };
+
+typedef struct NetAddr {
+  uint32_t ip;
+  uint16_t port;
+} NetAddr;
+
+typedef struct UdpSocket {
+  int fd;
+  uint16_t port;
+} UdpSocket;
+
+bool udp_open(UdpSocket *s, uint16_t port);
+void udp_close(UdpSocket *s);
+
+NetAddr net_loopback(uint16_t port);
+bool net_addr_equal(NetAddr a, NetAddr b);
+
+bool udp_send(const UdpSocket *s, NetAddr to, const void *data, size_t len);
+int udp_recv(const UdpSocket *s, NetAddr *from, void *buf, size_t cap);
+
+#endif // !UDP_H
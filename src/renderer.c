@@ -1,84 +1,336 @@
 #include "renderer.h"
-#include "geom/sector_mesh.h"
-#include "geom/wall_mesh.h"
-#include "gfx/shader.h"
+#include "gfx/light_clusters.h"
+#include "gfx/occlusion.h"
+#include "gfx/render_target.h"
+#include "gfx/shader_cache.h"
+#include "gfx/world_mesh.h"
 #include "map/map.h"
+#include "time.h"
 
 #include <SDL2/SDL.h>
 #include <glad/glad.h>
+#include <math.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
+#ifndef DAEMON_SHADER_DIR
+#define DAEMON_SHADER_DIR "shaders"
+#endif
+
+enum { ATLAS_CELLS = 4, ATLAS_CELL_PX = 32 };
+enum { GPU_TIMER_QUERIES = 4 };
+enum { MAX_OCCLUDERS = 64, OCCLUDER_CHUNK = 256 };
+// DrawElementsIndirectCommand: count, instances, first index, base vertex,
+// base instance.
+enum { GPU_COMMAND_BYTES = 5 * sizeof(uint32_t) };
+
+// Sectors switch to their LOD meshes where fog reaches this strength.
+static const float k_lod_fog = 0.5f;
+
 typedef struct RendererState {
-  ShaderProgram prog;
+  int world_shader;
   GLuint vao;
   GLuint vbo;
   GLint u_viewProj;
   GLint u_model;
-  SectorMesh sector_mesh;
-  WallMesh wall_mesh;
+  GLint u_fogRange;
+  GLint u_fogColor;
+  GLint u_clusterGrid;
+  GLint u_lightIndex;
+  GLint u_lights;
+  GLint u_clusters;
+  GLint u_tileScale;
+  GLint u_slice;
+  GLint u_eye;
+  GLint u_lightmap;
+  RendererFog fog;
+  LightClusters clusters;
+  Vec3 eye;
+  const PointLight *lights;
+  int light_count;
+  GLuint light_buffers[3];
+  GLuint light_textures[3];
+  WorldMesh sector_mesh;
+  WorldMesh wall_mesh;
+  GLuint lightmap_tex;
+  const Map *map;
+  Vec3 *sector_min;
+  Vec3 *sector_max;
+  const void **floor_offset;
+  GLsizei *floor_count;
+  int floor_draws;
+  const void **wall_offset;
+  GLsizei *wall_count;
+  int wall_draws;
+  OcclusionBuffer occlusion;
+  bool occlusion_culling;
+  RendererCullStats cull;
+  int cull_shader;
+  GLint u_cull_viewProj;
+  GLint u_cull_sectorCount;
+  GLint u_cull_occlusion;
+  GLint u_cull_hizLevels;
+  GLint u_cull_hizSize;
+  GLint u_cull_hiz;
+  GLint u_cull_eye;
+  GLint u_cull_lodDist;
+  GLint u_cull_pvs;
+  GLuint cull_sectors;
+  GLuint cull_commands;
+  GLuint cull_pvs;
+  GLuint hiz_tex;
+  bool gpu_culling;
+  bool gpu_culled;
+  int sprite_shader;
+  GLint u_sprite_viewProj;
+  GLint u_sprite_camRight;
+  GLint u_sprite_atlas;
+  GLint u_sprite_cutout;
+  GLint u_sprite_fogRange;
+  GLint u_sprite_fogColor;
+  GLuint sprite_atlas;
+  int depth_shader;
+  GLint u_depth_viewProj;
+  GLint u_depth_model;
+  int overdraw_shader;
+  GLint u_overdraw_viewProj;
+  GLint u_overdraw_model;
+  bool depth_prepass;
+  RendererDebugView debug_view;
+  GLuint frag_queries[2];
+  int frag_query_frame;
+  double overdraw;
+  int viewport_w;
+  int viewport_h;
+  int window_w;
+  int window_h;
+  bool scaling;
+  float max_scale;
+  float render_scale;
+  RenderTarget target;
+  GLuint gpu_queries[GPU_TIMER_QUERIES];
+  int gpu_query_frame;
+  double gpu_ms;
 } RendererState;
 
 static RendererState g;
 
-static const char *k_vs =
-    "#version 330 core\n"
-    "layout(location=0) in vec3 a_pos;\n"
-    "layout(location=1) in vec3 a_col;\n"
-    "layout(location=2) in vec2 a_uv;\n"
-    "layout(location=3) in float a_light;\n"
-    "out vec3 v_col;\n"
-    "out vec2 v_uv;\n"
-    "out float v_light;\n"
-    "out float v_depth;\n"
-    "uniform mat4 u_viewProj;\n"
-    "uniform mat4 u_model;\n"
-    "void main(){\n"
-    "  v_col = a_col;\n"
-    "  v_uv = a_uv;\n"
-    "  v_light = a_light;\n"
-    "  vec4 pos = u_viewProj * u_model * vec4(a_pos, 1.0);\n"
-    "  v_depth = pos.w;\n"
-    "  gl_Position = pos;\n"
-    "}\n";
-
-static const char *k_fs =
-    "#version 330 core\n"
-    "in vec3 v_col;\n"
-    "in vec2 v_uv;\n"
-    "in float v_light;\n"
-    "in float v_depth;\n"
-    "out vec4 o_color;\n"
-    "void main(){\n"
-    "  vec3 col = v_col;\n"
-    "  if (v_col.r == 0.2 && v_col.g == 0.8 && v_col.b == 0.2) {\n"
-    "    vec2 grid = floor(v_uv * 2.0);\n"
-    "    float checker = mod(grid.x + grid.y, 2.0);\n"
-    "    col *= 0.8 + 0.2 * checker;\n"
-    "  } else if (v_col.r == 0.2 && v_col.g == 0.2 && v_col.b == 0.8) {\n"
-    "    float d = length(fract(v_uv * 4.0) - 0.5);\n"
-    "    float star = smoothstep(0.1, 0.05, d);\n"
-    "    col += vec3(star * 0.5);\n"
-    "  } else {\n"
-    "    vec2 uv = v_uv * vec2(2.0, 4.0);\n"
-    "    if (mod(floor(uv.y), 2.0) > 0.5) uv.x += 0.5;\n"
-    "    vec2 f = fract(uv);\n"
-    "    float border = 0.05;\n"
-    "    float brick = (1.0 - smoothstep(0.0, border, f.x)) + \n"
-    "                  (smoothstep(1.0 - border, 1.0, f.x)) +\n"
-    "                  (1.0 - smoothstep(0.0, border, f.y)) + \n"
-    "                  (smoothstep(1.0 - border, 1.0, f.y));\n"
-    "    col *= (1.0 - clamp(brick, 0.0, 1.0) * 0.5);\n"
-    "  }\n"
-    "  col *= v_light;\n"
-    "  float fog_near = 2.0;\n"
-    "  float fog_far = 15.0;\n"
-    "  float fog = clamp((v_depth - fog_near) / (fog_far - fog_near), 0.0, "
-    "1.0);\n"
-    "  col = mix(col, vec3(0.0), fog);\n"
-    "  o_color = vec4(col, 1.0);\n"
-    "}\n";
+static const char *env_or(const char *name, const char *fallback) {
+  const char *v = getenv(name);
+  return (v && v[0]) ? v : fallback;
+}
+
+static bool load_shaders(void) {
+  g.world_shader = shader_cache_load("world.vert", "world.frag", NULL);
+  g.depth_shader = shader_cache_load("world.vert", "depth.frag", "DEPTH_ONLY");
+  g.overdraw_shader =
+      shader_cache_load("world.vert", "overdraw.frag", "DEPTH_ONLY");
+  g.sprite_shader = shader_cache_load("sprite.vert", "sprite.frag", NULL);
+  // Optional: without GL 4.3 the CPU culling path is used.
+  g.cull_shader = shader_cache_load_compute("cull.comp", NULL);
+
+  return g.world_shader >= 0 && g.depth_shader >= 0 &&
+         g.overdraw_shader >= 0 && g.sprite_shader >= 0;
+}
+
+static void lookup_uniforms(void) {
+  GLuint world = shader_cache_program(g.world_shader);
+  g.u_viewProj = glGetUniformLocation(world, "u_viewProj");
+  g.u_model = glGetUniformLocation(world, "u_model");
+  g.u_fogRange = glGetUniformLocation(world, "u_fogRange");
+  g.u_fogColor = glGetUniformLocation(world, "u_fogColor");
+  g.u_clusterGrid = glGetUniformLocation(world, "u_clusterGrid");
+  g.u_lightIndex = glGetUniformLocation(world, "u_lightIndex");
+  g.u_lights = glGetUniformLocation(world, "u_lights");
+  g.u_clusters = glGetUniformLocation(world, "u_clusters");
+  g.u_tileScale = glGetUniformLocation(world, "u_tileScale");
+  g.u_slice = glGetUniformLocation(world, "u_slice");
+  g.u_eye = glGetUniformLocation(world, "u_eye");
+  g.u_lightmap = glGetUniformLocation(world, "u_lightmap");
+
+  GLuint depth = shader_cache_program(g.depth_shader);
+  g.u_depth_viewProj = glGetUniformLocation(depth, "u_viewProj");
+  g.u_depth_model = glGetUniformLocation(depth, "u_model");
+
+  GLuint overdraw = shader_cache_program(g.overdraw_shader);
+  g.u_overdraw_viewProj = glGetUniformLocation(overdraw, "u_viewProj");
+  g.u_overdraw_model = glGetUniformLocation(overdraw, "u_model");
+
+  GLuint sprite = shader_cache_program(g.sprite_shader);
+  g.u_sprite_viewProj = glGetUniformLocation(sprite, "u_viewProj");
+  g.u_sprite_camRight = glGetUniformLocation(sprite, "u_camRight");
+  g.u_sprite_atlas = glGetUniformLocation(sprite, "u_atlas");
+  g.u_sprite_cutout = glGetUniformLocation(sprite, "u_cutout");
+  g.u_sprite_fogRange = glGetUniformLocation(sprite, "u_fogRange");
+  g.u_sprite_fogColor = glGetUniformLocation(sprite, "u_fogColor");
+
+  if (g.cull_shader >= 0) {
+    GLuint cull = shader_cache_program(g.cull_shader);
+    g.u_cull_viewProj = glGetUniformLocation(cull, "u_viewProj");
+    g.u_cull_sectorCount = glGetUniformLocation(cull, "u_sectorCount");
+    g.u_cull_occlusion = glGetUniformLocation(cull, "u_occlusion");
+    g.u_cull_hizLevels = glGetUniformLocation(cull, "u_hizLevels");
+    g.u_cull_hizSize = glGetUniformLocation(cull, "u_hizSize");
+    g.u_cull_hiz = glGetUniformLocation(cull, "u_hiz");
+    g.u_cull_eye = glGetUniformLocation(cull, "u_eye");
+    g.u_cull_lodDist = glGetUniformLocation(cull, "u_lodDist");
+    g.u_cull_pvs = glGetUniformLocation(cull, "u_pvs");
+  }
+}
+
+static void atlas_texel(int kind, float x, float y, unsigned char *o) {
+  float dx = x - 0.5f;
+  float dy = y - 0.5f;
+  float r = sqrtf(dx * dx + dy * dy);
+  float cr = 0.0f, cg = 0.0f, cb = 0.0f, a = 0.0f;
+
+  switch (kind) {
+  case SPRITE_ORB:
+    if (r < 0.45f) {
+      float shade = 1.0f - r * 1.2f;
+      cr = 0.2f * shade;
+      cg = 0.6f * shade;
+      cb = 1.0f * shade;
+      a = 1.0f;
+    }
+    break;
+  case SPRITE_PILLAR:
+    if (fabsf(dx) < 0.2f) {
+      float band = (fmodf(y * 8.0f, 1.0f) < 0.15f) ? 0.6f : 1.0f;
+      cr = 0.7f * band;
+      cg = 0.65f * band;
+      cb = 0.55f * band;
+      a = 1.0f;
+    }
+    break;
+  case SPRITE_DIAMOND:
+    if (fabsf(dx) + fabsf(dy) < 0.4f) {
+      cr = 1.0f;
+      cg = 0.8f;
+      cb = 0.1f;
+      a = 1.0f;
+    }
+    break;
+  case SPRITE_GLOW:
+  default: {
+    float t = 1.0f - r * 2.0f;
+    if (t < 0.0f)
+      t = 0.0f;
+    cr = 1.0f;
+    cg = 0.5f;
+    cb = 0.2f;
+    a = t * t;
+  } break;
+  }
+
+  o[0] = (unsigned char)(cr * 255.0f);
+  o[1] = (unsigned char)(cg * 255.0f);
+  o[2] = (unsigned char)(cb * 255.0f);
+  o[3] = (unsigned char)(a * 255.0f);
+}
+
+static GLuint build_sprite_atlas(void) {
+  enum { SIZE = ATLAS_CELLS * ATLAS_CELL_PX };
+  static unsigned char pixels[SIZE * SIZE * 4];
+
+  for (int y = 0; y < SIZE; y++) {
+    for (int x = 0; x < SIZE; x++) {
+      int kind = (y / ATLAS_CELL_PX) * ATLAS_CELLS + (x / ATLAS_CELL_PX);
+      float fx = ((float)(x % ATLAS_CELL_PX) + 0.5f) / (float)ATLAS_CELL_PX;
+      float fy = ((float)(y % ATLAS_CELL_PX) + 0.5f) / (float)ATLAS_CELL_PX;
+      atlas_texel(kind, fx, fy, &pixels[(y * SIZE + x) * 4]);
+    }
+  }
+
+  GLuint tex = 0;
+  glGenTextures(1, &tex);
+  glBindTexture(GL_TEXTURE_2D, tex);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, SIZE, SIZE, 0, GL_RGBA,
+               GL_UNSIGNED_BYTE, pixels);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  return tex;
+}
+
+AtlasRect renderer_sprite_rect(SpriteKind kind) {
+  int cx = (int)kind % ATLAS_CELLS;
+  int cy = (int)kind / ATLAS_CELLS;
+  const float inv = 1.0f / (float)ATLAS_CELLS;
+  AtlasRect r = {(float)cx * inv, (float)cy * inv, (float)(cx + 1) * inv,
+                 (float)(cy + 1) * inv};
+  return r;
+}
+
+// Cluster ranges, light indices and light data, each a buffer texture
+// sized for the worst case and refilled every frame.
+static void create_light_buffers(void) {
+  static const GLenum formats[3] = {GL_RG32UI, GL_R32UI, GL_RGBA32F};
+  const GLsizeiptr sizes[3] = {
+      CLUSTER_COUNT * 2 * sizeof(uint32_t),
+      CLUSTER_COUNT * MAX_CLUSTER_LIGHTS * sizeof(uint32_t),
+      MAX_POINT_LIGHTS * 8 * sizeof(float),
+  };
+  glGenBuffers(3, g.light_buffers);
+  glGenTextures(3, g.light_textures);
+  for (int i = 0; i < 3; i++) {
+    glBindBuffer(GL_TEXTURE_BUFFER, g.light_buffers[i]);
+    glBufferData(GL_TEXTURE_BUFFER, sizes[i], NULL, GL_STREAM_DRAW);
+    glBindTexture(GL_TEXTURE_BUFFER, g.light_textures[i]);
+    glTexBuffer(GL_TEXTURE_BUFFER, formats[i], g.light_buffers[i]);
+  }
+  glBindTexture(GL_TEXTURE_BUFFER, 0);
+  glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+static void upload_light_buffer(int i, const void *data, size_t size) {
+  glBindBuffer(GL_TEXTURE_BUFFER, g.light_buffers[i]);
+  if (size > 0)
+    glBufferSubData(GL_TEXTURE_BUFFER, 0, (GLsizeiptr)size, data);
+}
+
+static void upload_lights(Camera *cam) {
+  float aspect = (g.window_h > 0) ? (float)g.window_w / (float)g.window_h
+                                  : 1.0f;
+  LightClusters *lc = &g.clusters;
+  light_clusters_build(lc, cam, aspect, g.lights, g.light_count);
+
+  upload_light_buffer(0, lc->grid, CLUSTER_COUNT * 2 * sizeof(uint32_t));
+  upload_light_buffer(1, lc->indices,
+                      (size_t)lc->index_count * sizeof(uint32_t));
+  upload_light_buffer(2, lc->data,
+                      (size_t)lc->light_count * 8 * sizeof(float));
+  glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+static void set_light_uniforms(void) {
+  GLint units[3] = {g.u_clusterGrid, g.u_lightIndex, g.u_lights};
+  for (int i = 0; i < 3; i++) {
+    glActiveTexture(GL_TEXTURE0 + (GLenum)i);
+    glBindTexture(GL_TEXTURE_BUFFER, g.light_textures[i]);
+    glUniform1i(units[i], i);
+  }
+  glActiveTexture(GL_TEXTURE3);
+  glBindTexture(GL_TEXTURE_2D, g.lightmap_tex);
+  glUniform1i(g.u_lightmap, 3);
+  glActiveTexture(GL_TEXTURE0);
+  glUniform3i(g.u_clusters, CLUSTER_X, CLUSTER_Y, CLUSTER_Z);
+  glUniform2f(g.u_tileScale, (float)CLUSTER_X / (float)g.viewport_w,
+              (float)CLUSTER_Y / (float)g.viewport_h);
+  glUniform2f(g.u_slice, g.clusters.slice_scale, g.clusters.slice_bias);
+  glUniform3f(g.u_eye, g.eye.x, g.eye.y, g.eye.z);
+}
+
+void renderer_set_lights(const PointLight *lights, int count) {
+  g.lights = lights;
+  g.light_count = count;
+}
+
+LightClusterStats renderer_light_stats(void) { return g.clusters.stats; }
 
 bool renderer_init(void) {
   memset(&g, 0, sizeof(g));
@@ -92,15 +344,45 @@ bool renderer_init(void) {
   printf("OpenGL Renderer: %s\n", glGetString(GL_RENDERER));
   printf("OpenGL Version : %s\n", glGetString(GL_VERSION));
 
+  g.fog = (RendererFog){2.0f, 15.0f, v3(0.0f, 0.0f, 0.0f)};
+
   glDisable(GL_CULL_FACE);
   glEnable(GL_DEPTH_TEST);
   glDepthFunc(GL_LESS);
 
-  if (!shader_build(&g.prog, k_vs, k_fs))
+  shader_cache_init(env_or("DAEMON_SHADER_DIR", DAEMON_SHADER_DIR),
+                    env_or("DAEMON_SHADER_CACHE", "shader_cache"));
+  if (!load_shaders())
     return false;
+  lookup_uniforms();
 
-  g.u_viewProj = glGetUniformLocation(g.prog.program, "u_viewProj");
-  g.u_model = glGetUniformLocation(g.prog.program, "u_model");
+  if (!occlusion_init(&g.occlusion))
+    return false;
+  g.occlusion_culling = true;
+  if (g.cull_shader >= 0) {
+    glGenTextures(1, &g.hiz_tex);
+    glBindTexture(GL_TEXTURE_2D, g.hiz_tex);
+    glTexStorage2D(GL_TEXTURE_2D, g.occlusion.level_count, GL_R32F,
+                   OCC_WIDTH, OCC_HEIGHT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                    GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    g.gpu_culling = true;
+  }
+  printf("World culling  : %s\n",
+         g.cull_shader >= 0 ? "GPU compute + indirect" : "CPU");
+
+  if (!light_clusters_init(&g.clusters))
+    return false;
+  create_light_buffers();
+
+  glGenQueries(2, g.frag_queries);
+  glGenQueries(GPU_TIMER_QUERIES, g.gpu_queries);
+  g.max_scale = 1.0f;
+  g.render_scale = 1.0f;
+
+  g.sprite_atlas = build_sprite_atlas();
 
   const float s = 2.0f;
   float verts[] = {
@@ -131,59 +413,712 @@ bool renderer_init(void) {
   return true;
 }
 
+static void update_render_size(void) {
+  float scale = g.scaling ? g.render_scale : 1.0f;
+  int w = (int)((float)g.window_w * scale + 0.5f);
+  int h = (int)((float)g.window_h * scale + 0.5f);
+  if (w < 1)
+    w = 1;
+  if (h < 1)
+    h = 1;
+  if (g.scaling) {
+    if (w > g.target.width)
+      w = g.target.width;
+    if (h > g.target.height)
+      h = g.target.height;
+  }
+  g.viewport_w = w;
+  g.viewport_h = h;
+}
+
+static void update_render_target(void) {
+  if (!g.scaling) {
+    render_target_destroy(&g.target);
+    return;
+  }
+
+  int w = (int)ceilf((float)g.window_w * g.max_scale);
+  int h = (int)ceilf((float)g.window_h * g.max_scale);
+  if (g.target.fbo && g.target.width == w && g.target.height == h)
+    return;
+
+  render_target_destroy(&g.target);
+  if (!render_target_create(&g.target, w, h)) {
+    fprintf(stderr, "Dynamic resolution disabled\n");
+    g.scaling = false;
+  }
+}
+
 void renderer_set_viewport(int w, int h) {
   if (w < 1)
     w = 1;
   if (h < 1)
     h = 1;
-  glViewport(0, 0, w, h);
+  g.window_w = w;
+  g.window_h = h;
+  update_render_target();
+  update_render_size();
+}
+
+void renderer_configure_scaling(bool enabled, float max_scale) {
+  g.scaling = enabled;
+  g.max_scale = (max_scale > 0.0f) ? max_scale : 1.0f;
+  if (g.render_scale > g.max_scale)
+    g.render_scale = g.max_scale;
+  if (g.window_w > 0 && g.window_h > 0) {
+    update_render_target();
+    update_render_size();
+  }
+}
+
+void renderer_set_render_scale(float scale) {
+  if (scale > g.max_scale)
+    scale = g.max_scale;
+  g.render_scale = scale;
+  update_render_size();
+}
+
+float renderer_render_scale(void) { return g.scaling ? g.render_scale : 1.0f; }
+
+double renderer_gpu_ms(void) { return g.gpu_ms; }
+
+void renderer_set_depth_prepass(bool enabled) { g.depth_prepass = enabled; }
+
+bool renderer_depth_prepass(void) { return g.depth_prepass; }
+
+void renderer_set_debug_view(RendererDebugView view) { g.debug_view = view; }
+
+RendererDebugView renderer_debug_view(void) { return g.debug_view; }
+
+double renderer_overdraw(void) { return g.overdraw; }
+
+void renderer_set_occlusion_culling(bool enabled) {
+  g.occlusion_culling = enabled;
+}
+
+bool renderer_occlusion_culling(void) { return g.occlusion_culling; }
+
+RendererCullStats renderer_cull_stats(void) { return g.cull; }
+
+void renderer_set_gpu_culling(bool enabled) {
+  g.gpu_culling = enabled && g.cull_shader >= 0;
+}
+
+bool renderer_gpu_culling(void) { return g.gpu_culling; }
+
+void renderer_set_fog(const RendererFog *fog) {
+  g.fog = *fog;
+  if (g.fog.far_dist <= g.fog.near_dist)
+    g.fog.far_dist = g.fog.near_dist + 0.01f;
+}
+
+RendererFog renderer_fog(void) { return g.fog; }
+
+static float lod_distance(void) {
+  return g.fog.near_dist + (g.fog.far_dist - g.fog.near_dist) * k_lod_fog;
+}
+
+static void collect_gpu_time(void) {
+  if (g.gpu_query_frame < GPU_TIMER_QUERIES)
+    return;
+
+  GLuint q = g.gpu_queries[g.gpu_query_frame % GPU_TIMER_QUERIES];
+  GLuint available = 0;
+  glGetQueryObjectuiv(q, GL_QUERY_RESULT_AVAILABLE, &available);
+  if (!available)
+    return;
+
+  GLuint64 ns = 0;
+  glGetQueryObjectui64v(q, GL_QUERY_RESULT, &ns);
+  g.gpu_ms = (double)ns / 1.0e6;
+}
+
+void renderer_reload_shaders(void) {
+  if (shader_cache_reload_changed())
+    lookup_uniforms();
 }
 
 void renderer_begin_frame(void) {
-  glClearColor(0.05f, 0.05f, 0.08f, 1.0f);
+  collect_gpu_time();
+  glBeginQuery(GL_TIME_ELAPSED,
+               g.gpu_queries[g.gpu_query_frame % GPU_TIMER_QUERIES]);
+
+  if (g.scaling) {
+    glBindFramebuffer(GL_FRAMEBUFFER, g.target.fbo);
+    glViewport(0, 0, g.viewport_w, g.viewport_h);
+  } else {
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, g.window_w, g.window_h);
+  }
+
+  if (g.debug_view == RENDERER_VIEW_OVERDRAW)
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+  else
+    glClearColor(g.fog.color.x, g.fog.color.y, g.fog.color.z, 1.0f);
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 }
 
-bool renderer_build_sector_mesh(const Map *map) {
-  sector_mesh_destroy(&g.sector_mesh);
-  return sector_mesh_build(&g.sector_mesh, map);
+static void free_world_cull(void) {
+  if (g.cull_sectors)
+    glDeleteBuffers(1, &g.cull_sectors);
+  if (g.cull_commands)
+    glDeleteBuffers(1, &g.cull_commands);
+  if (g.cull_pvs)
+    glDeleteBuffers(1, &g.cull_pvs);
+  g.cull_sectors = 0;
+  g.cull_commands = 0;
+  g.cull_pvs = 0;
+  mem_free(g.sector_min);
+  g.map = NULL;
+  g.sector_min = NULL;
+  g.sector_max = NULL;
+  g.floor_offset = NULL;
+  g.floor_count = NULL;
+  g.wall_offset = NULL;
+  g.wall_count = NULL;
+  g.floor_draws = 0;
+  g.wall_draws = 0;
 }
 
-bool renderer_build_world_meshes(const Map *map) {
-  sector_mesh_destroy(&g.sector_mesh);
-  wall_mesh_destroy(&g.wall_mesh);
+static const void *index_offset(int first) {
+  return (const void *)((uintptr_t)first * sizeof(uint32_t));
+}
+
+static int add_draw(int s, bool lod) {
+  const WorldMesh *sm = &g.sector_mesh;
+  const WorldMesh *wm = &g.wall_mesh;
+  int floor_count = lod ? sm->lod_count[s] : sm->sector_count[s];
+  int wall_count = lod ? wm->lod_count[s] : wm->sector_count[s];
+
+  if (floor_count > 0) {
+    g.floor_offset[g.floor_draws] =
+        index_offset(lod ? sm->lod_first[s] : sm->sector_first[s]);
+    g.floor_count[g.floor_draws++] = floor_count;
+  }
+  if (wall_count > 0) {
+    g.wall_offset[g.wall_draws] =
+        index_offset(lod ? wm->lod_first[s] : wm->sector_first[s]);
+    g.wall_count[g.wall_draws++] = wall_count;
+  }
+  return floor_count + wall_count;
+}
+
+static void draw_all_sectors(void) {
+  g.floor_draws = 0;
+  g.wall_draws = 0;
+  for (int s = 0; s < g.map->sector_count; s++)
+    add_draw(s, false);
+}
+
+// Matches SectorBounds and DrawCommand in cull.comp (std430).
+typedef struct GpuSector {
+  float bmin[4];
+  float bmax[4];
+  uint32_t ranges[4];
+  uint32_t lod_ranges[4];
+} GpuSector;
 
-  if (!sector_mesh_build(&g.sector_mesh, map))
+static bool upload_gpu_sectors(const Map *map) {
+  size_t n = (size_t)map->sector_count;
+  MemTemp temp;
+  if (!mem_temp_begin(&temp, n * sizeof(GpuSector)))
     return false;
-  if (!wall_mesh_build(&g.wall_mesh, map))
+
+  GpuSector *gs = (GpuSector *)temp.ptr;
+  for (size_t s = 0; s < n; s++) {
+    Vec3 lo = g.sector_min[s];
+    Vec3 hi = g.sector_max[s];
+    gs[s] = (GpuSector){
+        {lo.x, lo.y, lo.z, 0.0f},
+        {hi.x, hi.y, hi.z, 0.0f},
+        {(uint32_t)g.sector_mesh.sector_first[s],
+         (uint32_t)g.sector_mesh.sector_count[s],
+         (uint32_t)g.wall_mesh.sector_first[s],
+         (uint32_t)g.wall_mesh.sector_count[s]},
+        {(uint32_t)g.sector_mesh.lod_first[s],
+         (uint32_t)g.sector_mesh.lod_count[s],
+         (uint32_t)g.wall_mesh.lod_first[s],
+         (uint32_t)g.wall_mesh.lod_count[s]},
+    };
+  }
+
+  glGenBuffers(1, &g.cull_sectors);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, g.cull_sectors);
+  glBufferData(GL_SHADER_STORAGE_BUFFER, (GLsizeiptr)(n * sizeof(GpuSector)),
+               gs, GL_STATIC_DRAW);
+
+  glGenBuffers(1, &g.cull_commands);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, g.cull_commands);
+  glBufferData(GL_SHADER_STORAGE_BUFFER,
+               (GLsizeiptr)(n * 2 * GPU_COMMAND_BYTES), NULL,
+               GL_DYNAMIC_DRAW);
+
+  // The camera sector's PVS row, rewritten each frame; read as uints.
+  if (map->pvs) {
+    glGenBuffers(1, &g.cull_pvs);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, g.cull_pvs);
+    glBufferData(GL_SHADER_STORAGE_BUFFER,
+                 (GLsizeiptr)((map->pvs_row_bytes + 3) & ~3), NULL,
+                 GL_DYNAMIC_DRAW);
+  }
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+  mem_temp_end(&temp);
+  return true;
+}
+
+// Static light for the world meshes, filtered across luxels; charts carry
+// their own borders so nothing bleeds between them.
+static void upload_lightmap(const Lightmap *lm) {
+  if (g.lightmap_tex)
+    glDeleteTextures(1, &g.lightmap_tex);
+  glGenTextures(1, &g.lightmap_tex);
+  glBindTexture(GL_TEXTURE_2D, g.lightmap_tex);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, lm->width, lm->height, 0, GL_RED,
+               GL_UNSIGNED_BYTE, lm->pixels);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+bool renderer_upload_world(const Map *map, const WorldBake *bake) {
+  world_mesh_destroy(&g.sector_mesh);
+  world_mesh_destroy(&g.wall_mesh);
+  free_world_cull();
+
+  if (!world_mesh_upload(&g.sector_mesh, &bake->floors) ||
+      !world_mesh_upload(&g.wall_mesh, &bake->walls))
+    return false;
+  upload_lightmap(&bake->lightmap);
+
+  size_t n = (size_t)map->sector_count;
+  unsigned char *block = (unsigned char *)mem_alloc(
+      n * 2 * sizeof(Vec3) + n * 2 * (sizeof(void *) + sizeof(GLsizei)));
+  if (!block)
+    return false;
+  g.sector_min = (Vec3 *)block;
+  g.sector_max = g.sector_min + n;
+  g.floor_offset = (const void **)(g.sector_max + n);
+  g.wall_offset = g.floor_offset + n;
+  g.floor_count = (GLsizei *)(g.wall_offset + n);
+  g.wall_count = g.floor_count + n;
+  g.map = map;
+  memcpy(g.sector_min, bake->sector_min, n * sizeof(Vec3));
+  memcpy(g.sector_max, bake->sector_max, n * sizeof(Vec3));
+
+  mesh_opt_report("Floor mesh", &g.sector_mesh.stats);
+  mesh_opt_report("Wall mesh", &g.wall_mesh.stats);
+
+  draw_all_sectors();
+  if (g.cull_shader >= 0 && !upload_gpu_sectors(map))
     return false;
   return true;
 }
 
-void renderer_draw_world(const Mat4 *view_proj) {
-  glUseProgram(g.prog.program);
-  if (g.u_viewProj >= 0)
-    glUniformMatrix4fv(g.u_viewProj, 1, GL_FALSE, view_proj->m);
-  if (g.u_model >= 0)
-    glUniformMatrix4fv(g.u_model, 1, GL_FALSE, m4_identity().m);
+bool renderer_build_world_meshes(const Map *map) {
+  WorldBake bake;
+  if (!world_bake(&bake, map))
+    return false;
+  bool ok = renderer_upload_world(map, &bake);
+  world_bake_free(&bake);
+  return ok;
+}
+
+typedef struct Occluder {
+  float dist2;
+  int line;
+} Occluder;
+
+// Max-heap on distance: the root is the farthest occluder kept so far.
+static void heap_sift_down(Occluder *h, int n, int i) {
+  for (;;) {
+    int l = i * 2 + 1;
+    int big = i;
+    if (l < n && h[l].dist2 > h[big].dist2)
+      big = l;
+    if (l + 1 < n && h[l + 1].dist2 > h[big].dist2)
+      big = l + 1;
+    if (big == i)
+      return;
+    Occluder t = h[i];
+    h[i] = h[big];
+    h[big] = t;
+    i = big;
+  }
+}
+
+static void heap_sift_up(Occluder *h, int i) {
+  while (i > 0) {
+    int p = (i - 1) / 2;
+    if (h[p].dist2 >= h[i].dist2)
+      return;
+    Occluder t = h[i];
+    h[i] = h[p];
+    h[p] = t;
+    i = p;
+  }
+}
+
+// Keeps the MAX_OCCLUDERS solid one-sided walls nearest the eye that are
+// not entirely behind it, scanning the line table a chunk at a time.
+static int select_occluders(Vec3 eye, Vec3 forward, Occluder *heap) {
+  const Map *map = g.map;
+  const LineTable *t = &map->linetab;
+  float side0[OCCLUDER_CHUNK], side1[OCCLUDER_CHUNK], d2[OCCLUDER_CHUNK];
+  int n = 0;
+
+  // Points behind the eye lie on the negative side of this line.
+  Vec2 e = v2(eye.x, eye.z);
+  Vec2 across = v2_add(e, v2(forward.z, -forward.x));
+
+  for (int base = 0; base < map->line_count; base += OCCLUDER_CHUNK) {
+    int count = map->line_count - base;
+    if (count > OCCLUDER_CHUNK)
+      count = OCCLUDER_CHUNK;
+    Seg2Batch lines = {t->x0 + base, t->y0 + base,       t->dx + base,
+                       t->dy + base, t->inv_len2 + base, NULL,
+                       count};
+    seg2_side_batch(e, across, t->x0 + base, t->y0 + base, count, side0);
+    seg2_side_batch(e, across, t->x1 + base, t->y1 + base, count, side1);
+    seg2_dist2_batch(e, &lines, d2);
+
+    for (int k = 0; k < count; k++) {
+      int i = base + k;
+      bool behind = side0[k] < 0.0f && side1[k] < 0.0f;
+      if ((t->flags[i] & LINE_TWO_SIDED) || behind)
+        continue;
+
+      if (n < MAX_OCCLUDERS) {
+        heap[n] = (Occluder){d2[k], i};
+        heap_sift_up(heap, n++);
+      } else if (d2[k] < heap[0].dist2) {
+        heap[0] = (Occluder){d2[k], i};
+        heap_sift_down(heap, n, 0);
+      }
+    }
+  }
+  return n;
+}
+
+static void rasterize_occluders(Camera *cam, const Mat4 *view_proj) {
+  const Map *map = g.map;
+  OcclusionBuffer *ob = &g.occlusion;
+  occlusion_begin(ob, view_proj);
+
+  Occluder heap[MAX_OCCLUDERS];
+  int count = select_occluders(cam->pos, camera_forward(cam), heap);
+  for (int i = 0; i < count; i++) {
+    int li = heap[i].line;
+    const Sector *sec = &map->sectors[map->lines[li].front_sector];
+    Vec3 quad[4] = {
+        v3(map->linetab.x0[li], sec->floor_h, map->linetab.y0[li]),
+        v3(map->linetab.x1[li], sec->floor_h, map->linetab.y1[li]),
+        v3(map->linetab.x1[li], sec->ceil_h, map->linetab.y1[li]),
+        v3(map->linetab.x0[li], sec->ceil_h, map->linetab.y0[li]),
+    };
+    occlusion_add_quad(ob, quad);
+  }
+  occlusion_build_pyramid(ob);
+  g.cull.occluders = ob->stats.occluders;
+}
+
+// One thread per sector writes that sector's floor and wall commands; a
+// hidden sector gets an instance count of zero. The CPU only rasterizes the
+// fixed set of occluders and uploads the pyramid and the camera's PVS row.
+static void cull_on_gpu(Camera *cam, const Mat4 *view_proj, bool pvs,
+                        int cam_sector) {
+  if (g.occlusion_culling) {
+    rasterize_occluders(cam, view_proj);
+    glBindTexture(GL_TEXTURE_2D, g.hiz_tex);
+    for (int l = 0; l < g.occlusion.level_count; l++) {
+      glTexSubImage2D(GL_TEXTURE_2D, l, 0, 0, g.occlusion.level_w[l],
+                      g.occlusion.level_h[l], GL_RED, GL_FLOAT,
+                      g.occlusion.levels[l]);
+    }
+  }
+
+  glUseProgram(shader_cache_program(g.cull_shader));
+  glUniformMatrix4fv(g.u_cull_viewProj, 1, GL_FALSE, view_proj->m);
+  glUniform1ui(g.u_cull_sectorCount, (GLuint)g.map->sector_count);
+  glUniform1i(g.u_cull_occlusion, g.occlusion_culling ? 1 : 0);
+  glUniform1i(g.u_cull_hizLevels, g.occlusion.level_count);
+  glUniform2f(g.u_cull_hizSize, (float)OCC_WIDTH, (float)OCC_HEIGHT);
+  glUniform1i(g.u_cull_hiz, 0);
+  glUniform3f(g.u_cull_eye, cam->pos.x, cam->pos.y, cam->pos.z);
+  glUniform1f(g.u_cull_lodDist, lod_distance());
+  glUniform1i(g.u_cull_pvs, pvs ? 1 : 0);
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, g.hiz_tex);
+
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, g.cull_sectors);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, g.cull_commands);
+  if (pvs) {
+    const Map *map = g.map;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, g.cull_pvs);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, map->pvs_row_bytes,
+                    map->pvs + (size_t)cam_sector * map->pvs_row_bytes);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, g.cull_pvs);
+  }
+  glDispatchCompute((GLuint)(g.map->sector_count + 63) / 64, 1, 1);
+  glMemoryBarrier(GL_COMMAND_BARRIER_BIT);
+
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, 0);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, 0);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, 0);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  glUseProgram(0);
+}
+
+// Smallest view depth of the box; fog is solid at and beyond far_dist.
+static float nearest_depth(Vec3 lo, Vec3 hi, Vec3 eye, Vec3 fwd) {
+  Vec3 c = v3_mul(v3_add(lo, hi), 0.5f);
+  Vec3 e = v3_mul(v3_sub(hi, lo), 0.5f);
+  float reach = fabsf(fwd.x) * e.x + fabsf(fwd.y) * e.y + fabsf(fwd.z) * e.z;
+  return v3_dot(v3_sub(c, eye), fwd) - reach;
+}
+
+// Horizontal distance from the eye to the box, which unlike depth does not
+// change as the camera turns.
+static float nearest_distance(Vec3 lo, Vec3 hi, Vec3 eye) {
+  float dx = fmaxf(fmaxf(lo.x - eye.x, eye.x - hi.x), 0.0f);
+  float dz = fmaxf(fmaxf(lo.z - eye.z, eye.z - hi.z), 0.0f);
+  return sqrtf(dx * dx + dz * dz);
+}
 
-  glBindVertexArray(g.sector_mesh.vao);
-  glDrawArrays(GL_TRIANGLES, 0, g.sector_mesh.vertex_count);
+void renderer_cull_world(Camera *cam, int cam_sector,
+                         const Mat4 *view_proj) {
+  if (!g.map)
+    return;
 
-  glBindVertexArray(g.wall_mesh.vao);
-  glDrawArrays(GL_TRIANGLES, 0, g.wall_mesh.vertex_count);
+  g.eye = cam->pos;
+  upload_lights(cam);
+
+  double start = time_now_seconds();
+  const Map *map = g.map;
+  memset(&g.cull, 0, sizeof(g.cull));
+  g.cull.sectors = map->sector_count;
+  g.gpu_culled = g.gpu_culling && g.cull_sectors;
+  // Outside every sector (noclip, a bad spawn) nothing can be ruled out.
+  bool pvs = map->pvs && cam_sector >= 0 && cam_sector < map->sector_count;
+
+  if (g.gpu_culled) {
+    cull_on_gpu(cam, view_proj, pvs && g.cull_pvs, cam_sector);
+    g.cull.gpu = true;
+    g.cull.cpu_ms = (time_now_seconds() - start) * 1000.0;
+    return;
+  }
+
+  if (g.occlusion_culling)
+    rasterize_occluders(cam, view_proj);
+
+  OcclusionBuffer *ob = &g.occlusion;
+  Vec3 eye = cam->pos;
+  Vec3 fwd = camera_forward(cam);
+  float lod_dist = lod_distance();
+  g.floor_draws = 0;
+  g.wall_draws = 0;
+  for (int s = 0; s < map->sector_count; s++) {
+    Vec3 lo = g.sector_min[s];
+    Vec3 hi = g.sector_max[s];
+    if (pvs && !map_pvs_visible(map, cam_sector, s)) {
+      g.cull.pvs_rejected++;
+      continue;
+    }
+    if (nearest_depth(lo, hi, eye, fwd) >= g.fog.far_dist) {
+      g.cull.fogged++;
+      continue;
+    }
+    if (g.occlusion_culling && !occlusion_test_box(ob, lo, hi))
+      continue;
+
+    bool lod = nearest_distance(lo, hi, eye) >= lod_dist;
+    g.cull.vertices += add_draw(s, lod);
+    g.cull.lod += lod ? 1 : 0;
+    g.cull.drawn++;
+  }
+
+  if (g.occlusion_culling) {
+    g.cull.frustum_rejected = ob->stats.frustum_rejected;
+    g.cull.occlusion_rejected = ob->stats.occlusion_rejected;
+  }
+  g.cull.cpu_ms = (time_now_seconds() - start) * 1000.0;
+}
+
+static void draw_world_geometry(void) {
+  if (g.gpu_culled) {
+    GLsizei n = (GLsizei)g.map->sector_count;
+    size_t wall_offset = (size_t)n * GPU_COMMAND_BYTES;
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, g.cull_commands);
+    glBindVertexArray(g.sector_mesh.vao);
+    glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void *)0, n,
+                                0);
+    glBindVertexArray(g.wall_mesh.vao);
+    glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+                                (void *)wall_offset, n, 0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    glBindVertexArray(0);
+    return;
+  }
+
+  if (g.floor_draws > 0) {
+    glBindVertexArray(g.sector_mesh.vao);
+    glMultiDrawElements(GL_TRIANGLES, g.floor_count, GL_UNSIGNED_INT,
+                        g.floor_offset, g.floor_draws);
+  }
+
+  if (g.wall_draws > 0) {
+    glBindVertexArray(g.wall_mesh.vao);
+    glMultiDrawElements(GL_TRIANGLES, g.wall_count, GL_UNSIGNED_INT,
+                        g.wall_offset, g.wall_draws);
+  }
 
   glBindVertexArray(0);
+}
+
+static void use_world_program(int shader, GLint u_viewProj, GLint u_model,
+                              const Mat4 *view_proj) {
+  glUseProgram(shader_cache_program(shader));
+  if (u_viewProj >= 0)
+    glUniformMatrix4fv(u_viewProj, 1, GL_FALSE, view_proj->m);
+  if (u_model >= 0)
+    glUniformMatrix4fv(u_model, 1, GL_FALSE, m4_identity().m);
+}
+
+static void set_fog_uniforms(GLint u_range, GLint u_color) {
+  glUniform2f(u_range, g.fog.near_dist, g.fog.far_dist);
+  glUniform3f(u_color, g.fog.color.x, g.fog.color.y, g.fog.color.z);
+}
+
+static void collect_overdraw(void) {
+  GLuint prev = g.frag_queries[(g.frag_query_frame + 1) & 1];
+  if (g.frag_query_frame == 0 || g.viewport_w <= 0 || g.viewport_h <= 0)
+    return;
+
+  GLuint available = 0;
+  glGetQueryObjectuiv(prev, GL_QUERY_RESULT_AVAILABLE, &available);
+  if (!available)
+    return;
+
+  GLuint64 samples = 0;
+  glGetQueryObjectui64v(prev, GL_QUERY_RESULT, &samples);
+  g.overdraw = (double)samples / ((double)g.viewport_w * g.viewport_h);
+}
+
+void renderer_draw_world(const Mat4 *view_proj) {
+  collect_overdraw();
+
+  if (g.depth_prepass) {
+    use_world_program(g.depth_shader, g.u_depth_viewProj, g.u_depth_model,
+                      view_proj);
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    draw_world_geometry();
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+    glDepthFunc(GL_EQUAL);
+    glDepthMask(GL_FALSE);
+  }
+
+  if (g.debug_view == RENDERER_VIEW_OVERDRAW) {
+    use_world_program(g.overdraw_shader, g.u_overdraw_viewProj,
+                      g.u_overdraw_model, view_proj);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE);
+  } else {
+    use_world_program(g.world_shader, g.u_viewProj, g.u_model, view_proj);
+    set_fog_uniforms(g.u_fogRange, g.u_fogColor);
+    set_light_uniforms();
+  }
+
+  GLuint query = g.frag_queries[g.frag_query_frame & 1];
+  glBeginQuery(GL_SAMPLES_PASSED, query);
+  draw_world_geometry();
+  glEndQuery(GL_SAMPLES_PASSED);
+  g.frag_query_frame++;
+
+  glDisable(GL_BLEND);
+  glDepthFunc(GL_LESS);
+  glDepthMask(GL_TRUE);
+  glUseProgram(0);
+}
+
+void renderer_draw_sprites(SpriteBatch *batch, Camera *cam,
+                           const Mat4 *view_proj) {
+  if (g.debug_view == RENDERER_VIEW_OVERDRAW)
+    return;
+
+  sprite_batch_upload(batch, cam->pos, camera_forward(cam));
+  if (batch->cutout_count + batch->translucent_count == 0)
+    return;
+
+  Vec3 right = camera_right(cam);
+
+  glUseProgram(shader_cache_program(g.sprite_shader));
+  glUniformMatrix4fv(g.u_sprite_viewProj, 1, GL_FALSE, view_proj->m);
+  glUniform3f(g.u_sprite_camRight, right.x, right.y, right.z);
+  glUniform1i(g.u_sprite_atlas, 0);
+  set_fog_uniforms(g.u_sprite_fogRange, g.u_sprite_fogColor);
+
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, g.sprite_atlas);
+
+  glUniform1i(g.u_sprite_cutout, 1);
+  sprite_batch_draw_cutout(batch);
+
+  if (batch->translucent_count > 0) {
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glDepthMask(GL_FALSE);
+
+    glUniform1i(g.u_sprite_cutout, 0);
+    sprite_batch_draw_translucent(batch);
+
+    glDepthMask(GL_TRUE);
+    glDisable(GL_BLEND);
+  }
+
+  glBindTexture(GL_TEXTURE_2D, 0);
   glUseProgram(0);
 }
 
+void renderer_end_frame(void) {
+  if (g.scaling) {
+    render_target_blit(&g.target, g.viewport_w, g.viewport_h, g.window_w,
+                       g.window_h);
+  }
+
+  glEndQuery(GL_TIME_ELAPSED);
+  g.gpu_query_frame++;
+}
+
 void renderer_shutdown(void) {
+  render_target_destroy(&g.target);
+  if (g.gpu_queries[0])
+    glDeleteQueries(GPU_TIMER_QUERIES, g.gpu_queries);
+  if (g.sprite_atlas)
+    glDeleteTextures(1, &g.sprite_atlas);
+  if (g.frag_queries[0])
+    glDeleteQueries(2, g.frag_queries);
   if (g.vbo)
     glDeleteBuffers(1, &g.vbo);
   if (g.vao)
     glDeleteVertexArrays(1, &g.vao);
-  shader_destroy(&g.prog);
-  sector_mesh_destroy(&g.sector_mesh);
-  wall_mesh_destroy(&g.wall_mesh);
+  shader_cache_shutdown();
+  world_mesh_destroy(&g.sector_mesh);
+  world_mesh_destroy(&g.wall_mesh);
+  free_world_cull();
+  occlusion_destroy(&g.occlusion);
+  if (g.light_buffers[0])
+    glDeleteBuffers(3, g.light_buffers);
+  if (g.light_textures[0])
+    glDeleteTextures(3, g.light_textures);
+  light_clusters_destroy(&g.clusters);
+  if (g.hiz_tex)
+    glDeleteTextures(1, &g.hiz_tex);
+  if (g.lightmap_tex)
+    glDeleteTextures(1, &g.lightmap_tex);
   memset(&g, 0, sizeof(g));
 }
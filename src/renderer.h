@@ -3,15 +3,92 @@
 
 #include <stdbool.h>
 
+#include "camera.h"
+#include "geom/world_bake.h"
+#include "gfx/light_clusters.h"
+#include "gfx/sprite_batch.h"
 #include "map/map.h"
 #include "math/mat4.h"
+#include "math/vec3.h"
+
+typedef enum SpriteKind {
+  SPRITE_ORB = 0,
+  SPRITE_PILLAR,
+  SPRITE_DIAMOND,
+  SPRITE_GLOW,
+} SpriteKind;
+
+typedef enum RendererDebugView {
+  RENDERER_VIEW_LIT = 0,
+  RENDERER_VIEW_OVERDRAW,
+} RendererDebugView;
+
+// Fog blends towards color between near_dist and far_dist of view depth.
+// Nothing beyond far_dist can be seen, so it also bounds culling and the
+// camera far plane.
+typedef struct RendererFog {
+  float near_dist;
+  float far_dist;
+  Vec3 color;
+} RendererFog;
+
+// Sector draws for the last renderer_cull_world call. With gpu set the
+// per-sector results stay on the GPU and only sectors, occluders and cpu_ms
+// are filled in.
+typedef struct RendererCullStats {
+  bool gpu;
+  int sectors;
+  int drawn;
+  int lod;
+  int pvs_rejected;
+  int fogged;
+  int vertices;
+  int occluders;
+  int frustum_rejected;
+  int occlusion_rejected;
+  double cpu_ms;
+} RendererCullStats;
 
 bool renderer_init(void);
 void renderer_set_viewport(int w, int h);
+void renderer_configure_scaling(bool enabled, float max_scale);
+void renderer_set_render_scale(float scale);
+float renderer_render_scale(void);
+double renderer_gpu_ms(void);
+void renderer_set_depth_prepass(bool enabled);
+bool renderer_depth_prepass(void);
+void renderer_set_debug_view(RendererDebugView view);
+RendererDebugView renderer_debug_view(void);
+double renderer_overdraw(void);
+void renderer_set_occlusion_culling(bool enabled);
+bool renderer_occlusion_culling(void);
+RendererCullStats renderer_cull_stats(void);
+// Compute-shader culling into an indirect draw buffer; only has an effect on
+// GL 4.3 contexts.
+void renderer_set_gpu_culling(bool enabled);
+bool renderer_gpu_culling(void);
+void renderer_set_fog(const RendererFog *fog);
+RendererFog renderer_fog(void);
+// Dynamic point lights for the next renderer_cull_world, which bins them
+// into view clusters; the array is read there and must live until then.
+void renderer_set_lights(const PointLight *lights, int count);
+LightClusterStats renderer_light_stats(void);
+void renderer_reload_shaders(void);
 void renderer_begin_frame(void);
-bool renderer_build_sector_mesh(const Map *map);
+// The map must outlive the meshes; culling reads its line table. Uploading
+// takes the bake as it is, e.g. straight out of a mapped package.
+bool renderer_upload_world(const Map *map, const WorldBake *bake);
 bool renderer_build_world_meshes(const Map *map);
+// Picks the sectors renderer_draw_world submits: sectors outside the PVS of
+// cam_sector (the sector holding the eye, or -1) and fully fogged ones are
+// dropped, walls nearest the camera are rasterized into a CPU depth buffer
+// and sector boxes tested against it. Distant sectors use their LOD meshes.
+void renderer_cull_world(Camera *cam, int cam_sector, const Mat4 *view_proj);
 void renderer_draw_world(const Mat4 *view_proj);
+AtlasRect renderer_sprite_rect(SpriteKind kind);
+void renderer_draw_sprites(SpriteBatch *batch, Camera *cam,
+                           const Mat4 *view_proj);
+void renderer_end_frame(void);
 void renderer_shutdown(void);
 
 #endif // !RENDERER_H
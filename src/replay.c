@@ -0,0 +1,229 @@
+#include "replay.h"
+#include "core/mem.h"
+
+#include <string.h>
+
+static const char k_magic[4] = {'D', 'R', 'E', 'C'};
+// 2: checksums cover fall velocity and grounding.
+static const uint32_t k_version = 2;
+
+enum {
+  TICK_KEYS = 1 << 0,
+  TICK_RESIZE = 1 << 1,
+  TICK_END = 1 << 7,
+};
+
+static void put_u16(FILE *f, uint16_t v) {
+  unsigned char b[2] = {(unsigned char)v, (unsigned char)(v >> 8)};
+  fwrite(b, 1, 2, f);
+}
+
+static void put_u32(FILE *f, uint32_t v) {
+  unsigned char b[4] = {(unsigned char)v, (unsigned char)(v >> 8),
+                        (unsigned char)(v >> 16), (unsigned char)(v >> 24)};
+  fwrite(b, 1, 4, f);
+}
+
+// Doubles travel as their IEEE bit pattern, low word first.
+static void put_f64(FILE *f, double v) {
+  uint64_t bits;
+  memcpy(&bits, &v, sizeof(bits));
+  put_u32(f, (uint32_t)bits);
+  put_u32(f, (uint32_t)(bits >> 32));
+}
+
+static bool get_bytes(ReplayReader *r, void *out, size_t n) {
+  if (r->at + n > r->size)
+    return false;
+  memcpy(out, r->data + r->at, n);
+  r->at += n;
+  return true;
+}
+
+static bool get_u16(ReplayReader *r, uint16_t *v) {
+  unsigned char b[2];
+  if (!get_bytes(r, b, 2))
+    return false;
+  *v = (uint16_t)(b[0] | (b[1] << 8));
+  return true;
+}
+
+static bool get_u32(ReplayReader *r, uint32_t *v) {
+  unsigned char b[4];
+  if (!get_bytes(r, b, 4))
+    return false;
+  *v = (uint32_t)b[0] | ((uint32_t)b[1] << 8) | ((uint32_t)b[2] << 16) |
+       ((uint32_t)b[3] << 24);
+  return true;
+}
+
+static bool get_f64(ReplayReader *r, double *v) {
+  uint32_t lo, hi;
+  if (!get_u32(r, &lo) || !get_u32(r, &hi))
+    return false;
+  uint64_t bits = ((uint64_t)hi << 32) | lo;
+  memcpy(v, &bits, sizeof(*v));
+  return true;
+}
+
+bool replay_writer_open(ReplayWriter *w, const char *path, double fixed_dt) {
+  memset(w, 0, sizeof(*w));
+  w->file = fopen(path, "wb");
+  if (!w->file) {
+    fprintf(stderr, "Failed to open %s for recording\n", path);
+    return false;
+  }
+
+  fwrite(k_magic, 1, 4, w->file);
+  put_u32(w->file, k_version);
+  put_f64(w->file, fixed_dt);
+  return true;
+}
+
+void replay_writer_note_input(ReplayWriter *w, const InputState *in) {
+  if (in->resized) {
+    w->pending_resize = true;
+    w->window_w = in->window_w;
+    w->window_h = in->window_h;
+  }
+}
+
+bool replay_writer_tick(ReplayWriter *w, const InputState *in,
+                        uint32_t checksum) {
+  uint16_t changed[SDL_NUM_SCANCODES];
+  int n = 0;
+  for (int i = 0; i < SDL_NUM_SCANCODES; i++) {
+    if (in->key_down[i] != w->prev_down[i])
+      changed[n++] = (uint16_t)i;
+  }
+
+  // Key changes are stored as toggled scancodes, so an idle tick costs only
+  // the flag byte and the checksum.
+  unsigned char flags = 0;
+  if (n > 0)
+    flags |= TICK_KEYS;
+  if (w->pending_resize)
+    flags |= TICK_RESIZE;
+
+  fputc(flags, w->file);
+  if (flags & TICK_KEYS) {
+    put_u16(w->file, (uint16_t)n);
+    for (int i = 0; i < n; i++)
+      put_u16(w->file, changed[i]);
+    memcpy(w->prev_down, in->key_down, sizeof(w->prev_down));
+  }
+  if (flags & TICK_RESIZE) {
+    put_u32(w->file, (uint32_t)w->window_w);
+    put_u32(w->file, (uint32_t)w->window_h);
+    w->pending_resize = false;
+  }
+  put_u32(w->file, checksum);
+
+  w->ticks++;
+  return !ferror(w->file);
+}
+
+void replay_writer_close(ReplayWriter *w) {
+  if (!w->file)
+    return;
+  fputc(TICK_END, w->file);
+  fclose(w->file);
+  printf("Recorded %u ticks\n", w->ticks);
+  memset(w, 0, sizeof(*w));
+}
+
+bool replay_reader_open(ReplayReader *r, const char *path) {
+  memset(r, 0, sizeof(*r));
+
+  FILE *f = fopen(path, "rb");
+  if (!f) {
+    fprintf(stderr, "Failed to open replay %s\n", path);
+    return false;
+  }
+
+  fseek(f, 0, SEEK_END);
+  long size = ftell(f);
+  fseek(f, 0, SEEK_SET);
+
+  r->data = (size > 0) ? (unsigned char *)mem_alloc((size_t)size) : NULL;
+  if (!r->data || fread(r->data, 1, (size_t)size, f) != (size_t)size) {
+    fclose(f);
+    replay_reader_close(r);
+    fprintf(stderr, "Failed to read replay %s\n", path);
+    return false;
+  }
+  fclose(f);
+  r->size = (size_t)size;
+
+  char magic[4];
+  uint32_t version = 0;
+  if (!get_bytes(r, magic, 4) || memcmp(magic, k_magic, 4) != 0 ||
+      !get_u32(r, &version) || version != k_version ||
+      !get_f64(r, &r->fixed_dt)) {
+    fprintf(stderr, "%s is not a replay (version %u)\n", path, k_version);
+    replay_reader_close(r);
+    return false;
+  }
+
+  return true;
+}
+
+bool replay_reader_next(ReplayReader *r, InputState *in,
+                        uint32_t *out_checksum) {
+  unsigned char flags = 0;
+  if (!get_bytes(r, &flags, 1) || (flags & TICK_END))
+    return false;
+
+  memset(in->key_pressed, 0, sizeof(in->key_pressed));
+  memset(in->key_released, 0, sizeof(in->key_released));
+  in->resized = false;
+
+  if (flags & TICK_KEYS) {
+    uint16_t n = 0;
+    if (!get_u16(r, &n))
+      return false;
+    for (uint16_t i = 0; i < n; i++) {
+      uint16_t sc = 0;
+      if (!get_u16(r, &sc) || sc >= SDL_NUM_SCANCODES)
+        return false;
+      bool down = !in->key_down[sc];
+      in->key_down[sc] = down;
+      if (down)
+        in->key_pressed[sc] = true;
+      else
+        in->key_released[sc] = true;
+    }
+  }
+
+  if (flags & TICK_RESIZE) {
+    uint32_t w = 0, h = 0;
+    if (!get_u32(r, &w) || !get_u32(r, &h))
+      return false;
+    in->window_w = (int)w;
+    in->window_h = (int)h;
+    in->resized = true;
+  }
+
+  if (!get_u32(r, out_checksum))
+    return false;
+
+  r->tick++;
+  return true;
+}
+
+void replay_reader_verify(ReplayReader *r, uint32_t expected,
+                          uint32_t actual) {
+  if (expected == actual)
+    return;
+  if (r->mismatches == 0) {
+    r->first_mismatch = r->tick;
+    fprintf(stderr, "Replay diverged at tick %u (%08x != %08x)\n", r->tick,
+            actual, expected);
+  }
+  r->mismatches++;
+}
+
+void replay_reader_close(ReplayReader *r) {
+  mem_free(r->data);
+  memset(r, 0, sizeof(*r));
+}
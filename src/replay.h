@@ -0,0 +1,42 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "input.h"
+
+typedef struct ReplayWriter {
+  FILE *file;
+  bool prev_down[SDL_NUM_SCANCODES];
+  bool pending_resize;
+  int window_w;
+  int window_h;
+  uint32_t ticks;
+} ReplayWriter;
+
+typedef struct ReplayReader {
+  unsigned char *data;
+  size_t size;
+  size_t at;
+  double fixed_dt;
+  uint32_t tick;
+  uint32_t mismatches;
+  uint32_t first_mismatch;
+} ReplayReader;
+
+bool replay_writer_open(ReplayWriter *w, const char *path, double fixed_dt);
+void replay_writer_note_input(ReplayWriter *w, const InputState *in);
+bool replay_writer_tick(ReplayWriter *w, const InputState *in,
+                        uint32_t checksum);
+void replay_writer_close(ReplayWriter *w);
+
+bool replay_reader_open(ReplayReader *r, const char *path);
+bool replay_reader_next(ReplayReader *r, InputState *in,
+                        uint32_t *out_checksum);
+void replay_reader_verify(ReplayReader *r, uint32_t expected,
+                          uint32_t actual);
+void replay_reader_close(ReplayReader *r);
+
+#endif // !REPLAY_H
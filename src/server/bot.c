@@ -0,0 +1,114 @@
+#include "bot.h"
+#include "../net/protocol.h"
+
+#include <string.h>
+
+static uint32_t xorshift32(uint32_t *s) {
+  uint32_t x = *s;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  *s = x;
+  return x;
+}
+
+bool bot_open(Bot *b, uint16_t server_port, uint32_t seed) {
+  memset(b, 0, sizeof(*b));
+  b->player = -1;
+  b->rng = seed ? seed : 1u;
+  b->server = net_loopback(server_port);
+  return udp_open(&b->sock, 0);
+}
+
+void bot_close(Bot *b) {
+  uint8_t buf[16];
+  if (b->player >= 0)
+    udp_send(&b->sock, b->server, buf,
+             msg_write_disconnect(buf, sizeof(buf), (uint16_t)b->player));
+  udp_close(&b->sock);
+  b->player = -1;
+
+  for (int i = 0; i < SNAPSHOT_HISTORY; i++)
+    snapshot_free(&b->history[i]);
+}
+
+void bot_connect(Bot *b) {
+  uint8_t buf[16];
+  udp_send(&b->sock, b->server, buf, msg_write_connect(buf, sizeof(buf)));
+}
+
+void bot_send_input(Bot *b) {
+  if (b->player < 0)
+    return;
+
+  // Hold each button combination for a while, like a person would.
+  if (b->tick % 30 == 0)
+    b->cmd.buttons = (uint8_t)(xorshift32(&b->rng) & 0x3f);
+  b->tick++;
+
+  uint8_t buf[16];
+  udp_send(&b->sock, b->server, buf,
+           msg_write_input(buf, sizeof(buf), (uint16_t)b->player, b->tick,
+                           b->last_snapshot_tick, b->cmd));
+}
+
+static void handle_snapshot(Bot *b, const uint8_t *data, size_t size) {
+  uint32_t tick = 0, base_tick = 0;
+  int capacity = 0;
+  if (!snapshot_peek(data, size, &tick, &base_tick, &capacity) ||
+      tick <= b->last_snapshot_tick)
+    return;
+
+  if (b->history[0].capacity != capacity) {
+    for (int i = 0; i < SNAPSHOT_HISTORY; i++) {
+      snapshot_free(&b->history[i]);
+      if (!snapshot_init(&b->history[i], capacity))
+        return;
+    }
+  }
+
+  const Snapshot *base = NULL;
+  if (base_tick != 0) {
+    base = &b->history[base_tick % SNAPSHOT_HISTORY];
+    if (base->tick != base_tick) {
+      b->dropped++;
+      return;
+    }
+  }
+
+  Snapshot *out = &b->history[tick % SNAPSHOT_HISTORY];
+  if (!snapshot_decode(out, base, data, size)) {
+    out->tick = 0;
+    b->dropped++;
+    return;
+  }
+
+  b->last_snapshot_tick = tick;
+  b->snapshots++;
+}
+
+void bot_receive(Bot *b) {
+  static uint8_t buf[UDP_MAX_PACKET];
+  NetAddr from;
+  int n;
+
+  while ((n = udp_recv(&b->sock, &from, buf, sizeof(buf))) > 0) {
+    b->bytes_in += (uint64_t)n;
+    ByteReader r = byte_reader(buf, (size_t)n);
+
+    switch (br_u8(&r)) {
+    case MSG_WELCOME: {
+      uint16_t id = br_u16(&r);
+      if (!r.overflow)
+        b->player = id;
+    } break;
+
+    case MSG_SNAPSHOT:
+      handle_snapshot(b, buf, (size_t)n);
+      break;
+
+    default:
+      break;
+    }
+  }
+}
@@ -0,0 +1,32 @@
+#ifndef BOT_H
+#define BOT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "../game/player.h"
+#include "../net/snapshot.h"
+#include "../net/udp.h"
+
+typedef struct Bot {
+  UdpSocket sock;
+  NetAddr server;
+  int player;
+  uint32_t rng;
+  uint32_t tick;
+  PlayerCmd cmd;
+  uint32_t last_snapshot_tick;
+  uint64_t bytes_in;
+  uint64_t snapshots;
+  uint64_t dropped;
+  Snapshot history[SNAPSHOT_HISTORY];
+} Bot;
+
+bool bot_open(Bot *b, uint16_t server_port, uint32_t seed);
+void bot_close(Bot *b);
+
+void bot_connect(Bot *b);
+void bot_send_input(Bot *b);
+void bot_receive(Bot *b);
+
+#endif // !BOT_H
@@ -0,0 +1,289 @@
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../core/mem.h"
+#include "../map/map.h"
+#include "../time.h"
+#include "bot.h"
+#include "server.h"
+#include "snapshot_bench.h"
+
+typedef struct Options {
+  uint16_t port;
+  int players;
+  double tick_rate;
+  long ticks;
+  int bots;
+  bool bench;
+  bool bench_snapshot;
+  int bench_max;
+  int bench_ticks;
+} Options;
+
+static volatile sig_atomic_t g_running = 1;
+
+// Ctrl-C or a service stop ends the tick loop, so shutdown still runs.
+static void on_stop_signal(int sig) {
+  (void)sig;
+  g_running = 0;
+}
+
+static void parse_args(int argc, char **argv, Options *opt) {
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    const char *val = (i + 1 < argc) ? argv[i + 1] : NULL;
+
+    if (strcmp(arg, "--port") == 0 && val) {
+      opt->port = (uint16_t)atoi(val);
+      i++;
+    } else if (strcmp(arg, "--players") == 0 && val) {
+      opt->players = atoi(val);
+      i++;
+    } else if (strcmp(arg, "--tick-rate") == 0 && val) {
+      opt->tick_rate = atof(val);
+      i++;
+    } else if (strcmp(arg, "--ticks") == 0 && val) {
+      opt->ticks = atol(val);
+      i++;
+    } else if (strcmp(arg, "--bots") == 0 && val) {
+      opt->bots = atoi(val);
+      i++;
+    } else if (strcmp(arg, "--bench") == 0) {
+      opt->bench = true;
+    } else if (strcmp(arg, "--bench-snapshot") == 0) {
+      opt->bench_snapshot = true;
+    } else if (strcmp(arg, "--bench-max") == 0 && val) {
+      opt->bench_max = atoi(val);
+      i++;
+    } else if (strcmp(arg, "--bench-ticks") == 0 && val) {
+      opt->bench_ticks = atoi(val);
+      i++;
+    } else {
+      fprintf(stderr, "Ignoring unknown argument: %s\n", arg);
+    }
+  }
+}
+
+static int run_server(const Options *opt, const Map *map) {
+  Server sv;
+  if (!server_init(&sv, map, opt->players, opt->port, opt->tick_rate)) {
+    fprintf(stderr, "Failed to start server on port %u\n", opt->port);
+    return 1;
+  }
+
+  printf("Serving %d players on 127.0.0.1:%u at %.0f Hz\n", opt->players,
+         sv.sock.port, opt->tick_rate);
+
+  const double dt = 1.0 / opt->tick_rate;
+  double next = time_now_seconds();
+  double last_report = next;
+  double busy = 0.0;
+  uint32_t report_ticks = 0;
+
+  while (g_running && (opt->ticks <= 0 || sv.tick < (uint32_t)opt->ticks)) {
+    double start = time_now_seconds();
+    server_tick(&sv);
+    double end = time_now_seconds();
+    busy += end - start;
+    report_ticks++;
+
+    if (end - last_report >= 5.0) {
+      printf("tick %u: %d players, %.3f ms/tick, %.1f%% of budget\n", sv.tick,
+             sv.active_players, busy * 1000.0 / report_ticks,
+             100.0 * busy / (report_ticks * dt));
+      busy = 0.0;
+      report_ticks = 0;
+      last_report = end;
+    }
+
+    next += dt;
+    double now = time_now_seconds();
+    if (next > now)
+      time_sleep(next - now);
+    else
+      next = now;
+  }
+
+  server_shutdown(&sv);
+  return 0;
+}
+
+static int run_bots(const Options *opt) {
+  Bot *bots = (Bot *)mem_calloc((size_t)opt->bots, sizeof(Bot));
+  if (!bots)
+    return 1;
+
+  int opened = 0;
+  for (; opened < opt->bots; opened++) {
+    if (!bot_open(&bots[opened], opt->port, 0x9e3779b9u * (opened + 1)))
+      break;
+    bot_connect(&bots[opened]);
+  }
+  printf("%d bots connecting to 127.0.0.1:%u\n", opened, opt->port);
+
+  const double dt = 1.0 / opt->tick_rate;
+  double next = time_now_seconds();
+  for (long t = 0; g_running && (opt->ticks <= 0 || t < opt->ticks); t++) {
+    for (int i = 0; i < opened; i++) {
+      bot_receive(&bots[i]);
+      if (bots[i].player < 0 && t % 60 == 0)
+        bot_connect(&bots[i]);
+      bot_send_input(&bots[i]);
+    }
+
+    next += dt;
+    double now = time_now_seconds();
+    if (next > now)
+      time_sleep(next - now);
+    else
+      next = now;
+  }
+
+  for (int i = 0; i < opened; i++)
+    bot_close(&bots[i]);
+  mem_free(bots);
+  return 0;
+}
+
+static int cmp_double(const void *a, const void *b) {
+  double x = *(const double *)a;
+  double y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+static bool bench_round(const Options *opt, const Map *map, int count) {
+  Server sv;
+  if (!server_init(&sv, map, count, 0, opt->tick_rate))
+    return false;
+
+  Bot *bots = (Bot *)mem_calloc((size_t)count, sizeof(Bot));
+  double *samples = (double *)mem_calloc((size_t)opt->bench_ticks,
+                                        sizeof(double));
+  bool ok = bots && samples;
+
+  int opened = 0;
+  for (; ok && opened < count; opened++) {
+    if (!bot_open(&bots[opened], sv.sock.port, 0x9e3779b9u * (opened + 1))) {
+      ok = false;
+      break;
+    }
+    bot_connect(&bots[opened]);
+  }
+
+  for (int attempt = 0; ok && sv.active_players < count && attempt < 100;
+       attempt++) {
+    server_poll(&sv);
+    for (int i = 0; i < opened; i++)
+      bot_receive(&bots[i]);
+    time_sleep(0.001);
+  }
+
+  if (ok && sv.active_players < count) {
+    fprintf(stderr, "Only %d of %d bots connected\n", sv.active_players,
+            count);
+    ok = false;
+  }
+
+  const int warmup = 30;
+  uint64_t bytes_start = 0;
+  for (int t = 0; ok && t < warmup + opt->bench_ticks; t++) {
+    if (t == warmup)
+      bytes_start = sv.stats.bytes_out;
+
+    for (int i = 0; i < opened; i++)
+      bot_send_input(&bots[i]);
+
+    double start = time_now_seconds();
+    server_tick(&sv);
+    double elapsed = time_now_seconds() - start;
+    if (t >= warmup)
+      samples[t - warmup] = elapsed * 1000.0;
+
+    for (int i = 0; i < opened; i++)
+      bot_receive(&bots[i]);
+  }
+
+  if (ok) {
+    double sum = 0.0;
+    for (int i = 0; i < opt->bench_ticks; i++)
+      sum += samples[i];
+    qsort(samples, (size_t)opt->bench_ticks, sizeof(double), cmp_double);
+
+    double avg = sum / opt->bench_ticks;
+    double p99 = samples[(opt->bench_ticks * 99) / 100];
+    double budget = 1000.0 / opt->tick_rate;
+    double bytes = (double)(sv.stats.bytes_out - bytes_start) /
+                   ((double)opt->bench_ticks * count);
+
+    double sent = (double)(sv.stats.full_snapshots + sv.stats.delta_snapshots);
+    double delta = sent > 0.0 ? 100.0 * sv.stats.delta_snapshots / sent : 0.0;
+
+    printf("%8d %10.4f %10.4f %10.3f %12.0f %12.0f %10.0f %8.1f\n", count,
+           avg, p99, avg * 1000.0 / count, budget / avg, count * budget / avg,
+           bytes, delta);
+  }
+
+  for (int i = 0; i < opened; i++)
+    bot_close(&bots[i]);
+  mem_free(bots);
+  mem_free(samples);
+  server_shutdown(&sv);
+  return ok;
+}
+
+static int run_bench(const Options *opt, const Map *map) {
+  printf("Server load: %d ticks per round at %.0f Hz, loopback UDP bots\n",
+         opt->bench_ticks, opt->tick_rate);
+  printf("%8s %10s %10s %10s %12s %12s %10s %8s\n", "players", "avg_ms",
+         "p99_ms", "us/player", "inst/core", "players/core", "B/cl/tick",
+         "delta%");
+
+  for (int count = 1; count <= opt->bench_max; count *= 2) {
+    if (!bench_round(opt, map, count))
+      return 1;
+  }
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  Options opt = {
+      .port = 27960,
+      .players = 16,
+      .tick_rate = 60.0,
+      .ticks = 0,
+      .bench_max = 256,
+      .bench_ticks = 600,
+  };
+  parse_args(argc, argv, &opt);
+
+  if (opt.tick_rate <= 0.0 || opt.players < 1 || opt.bench_ticks < 1) {
+    fprintf(stderr, "Invalid tick rate, player count or bench length\n");
+    return 1;
+  }
+
+  time_init();
+  signal(SIGINT, on_stop_signal);
+  signal(SIGTERM, on_stop_signal);
+
+  if (opt.bots > 0)
+    return run_bots(&opt);
+
+  Map map;
+  if (!map_build_test(&map)) {
+    fprintf(stderr, "Failed to build test map\n");
+    return 1;
+  }
+
+  int status = 0;
+  if (opt.bench_snapshot)
+    status = snapshot_bench_run(&map, opt.bench_max, opt.bench_ticks);
+  else if (opt.bench)
+    status = run_bench(&opt, &map);
+  else
+    status = run_server(&opt, &map);
+  map_destroy(&map);
+  return status;
+}
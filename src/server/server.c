@@ -0,0 +1,224 @@
+#include "server.h"
+#include "../core/mem.h"
+#include "../net/protocol.h"
+
+#include <stdio.h>
+#include <string.h>
+
+bool server_init(Server *sv, const Map *map, int max_players, uint16_t port,
+                 double tick_rate) {
+  memset(sv, 0, sizeof(*sv));
+  sv->sock.fd = -1;
+  if (max_players < 1 || max_players > 0xffff || tick_rate <= 0.0)
+    return false;
+
+  sv->map = map;
+  sv->max_players = max_players;
+  sv->tick_dt = (float)(1.0 / tick_rate);
+  sv->players = (Player *)mem_calloc((size_t)max_players, sizeof(Player));
+  sv->clients = (ServerClient *)mem_calloc((size_t)max_players,
+                                           sizeof(ServerClient));
+  sv->packet = (uint8_t *)mem_alloc(UDP_MAX_PACKET);
+  sv->encoded =
+      (uint8_t *)mem_alloc((size_t)(SNAPSHOT_HISTORY + 1) * UDP_MAX_PACKET);
+  if (!sv->players || !sv->clients || !sv->packet || !sv->encoded) {
+    server_shutdown(sv);
+    return false;
+  }
+
+  for (int i = 0; i < SNAPSHOT_HISTORY; i++) {
+    if (!snapshot_init(&sv->history[i], max_players)) {
+      server_shutdown(sv);
+      return false;
+    }
+  }
+
+  if (!udp_open(&sv->sock, port)) {
+    server_shutdown(sv);
+    return false;
+  }
+
+  return true;
+}
+
+void server_shutdown(Server *sv) {
+  if (sv->sock.fd >= 0)
+    udp_close(&sv->sock);
+  mem_free(sv->players);
+  mem_free(sv->clients);
+  mem_free(sv->packet);
+  mem_free(sv->encoded);
+  for (int i = 0; i < SNAPSHOT_HISTORY; i++)
+    snapshot_free(&sv->history[i]);
+  memset(sv, 0, sizeof(*sv));
+  sv->sock.fd = -1;
+}
+
+static void send_packet(Server *sv, NetAddr to, size_t len) {
+  if (len == 0)
+    return;
+  if (udp_send(&sv->sock, to, sv->packet, len)) {
+    sv->stats.packets_out++;
+    sv->stats.bytes_out += len;
+  }
+}
+
+static int find_client(const Server *sv, NetAddr addr) {
+  for (int i = 0; i < sv->max_players; i++) {
+    if (sv->clients[i].active && net_addr_equal(sv->clients[i].addr, addr))
+      return i;
+  }
+  return -1;
+}
+
+static void handle_connect(Server *sv, NetAddr from) {
+  int slot = find_client(sv, from);
+  if (slot < 0) {
+    for (int i = 0; i < sv->max_players; i++) {
+      if (!sv->clients[i].active) {
+        slot = i;
+        break;
+      }
+    }
+  }
+
+  if (slot < 0) {
+    send_packet(sv, from, msg_write_reject(sv->packet, UDP_MAX_PACKET));
+    return;
+  }
+
+  ServerClient *c = &sv->clients[slot];
+  if (!c->active) {
+    memset(c, 0, sizeof(*c));
+    c->active = true;
+    c->addr = from;
+    player_init(&sv->players[slot]);
+    sv->active_players++;
+  }
+
+  send_packet(sv, from,
+              msg_write_welcome(sv->packet, UDP_MAX_PACKET, (uint16_t)slot));
+}
+
+static ServerClient *client_for(Server *sv, uint16_t id, NetAddr from) {
+  if (id >= sv->max_players)
+    return NULL;
+  ServerClient *c = &sv->clients[id];
+  if (!c->active || !net_addr_equal(c->addr, from))
+    return NULL;
+  return c;
+}
+
+void server_poll(Server *sv) {
+  uint8_t buf[64];
+  NetAddr from;
+  int n;
+
+  while ((n = udp_recv(&sv->sock, &from, buf, sizeof(buf))) > 0) {
+    sv->stats.packets_in++;
+    ByteReader r = byte_reader(buf, (size_t)n);
+
+    switch (br_u8(&r)) {
+    case MSG_CONNECT:
+      handle_connect(sv, from);
+      break;
+
+    case MSG_INPUT: {
+      uint16_t id = br_u16(&r);
+      uint32_t tick = br_u32(&r);
+      uint32_t ack = br_u32(&r);
+      uint8_t buttons = br_u8(&r);
+      ServerClient *c = client_for(sv, id, from);
+      // Datagrams can arrive out of order; only newer input wins.
+      if (!r.overflow && c && tick >= c->last_input_tick) {
+        c->last_input_tick = tick;
+        c->cmd.buttons = buttons;
+        if (ack > c->acked_tick && ack <= sv->tick)
+          c->acked_tick = ack;
+      }
+    } break;
+
+    case MSG_DISCONNECT: {
+      uint16_t id = br_u16(&r);
+      ServerClient *c = client_for(sv, id, from);
+      if (!r.overflow && c) {
+        c->active = false;
+        sv->active_players--;
+      }
+    } break;
+
+    default:
+      break;
+    }
+  }
+}
+
+void server_simulate(Server *sv) {
+  for (int i = 0; i < sv->max_players; i++) {
+    if (!sv->clients[i].active)
+      continue;
+    player_update(&sv->players[i], sv->map, &sv->clients[i].cmd, sv->tick_dt);
+  }
+  sv->tick++;
+}
+
+static const Snapshot *history_at(const Server *sv, uint32_t tick) {
+  if (tick == 0 || tick > sv->tick || sv->tick - tick >= SNAPSHOT_HISTORY)
+    return NULL;
+  const Snapshot *s = &sv->history[tick % SNAPSHOT_HISTORY];
+  return (s->tick == tick) ? s : NULL;
+}
+
+void server_send_snapshots(Server *sv) {
+  Snapshot *cur = &sv->history[sv->tick % SNAPSHOT_HISTORY];
+  snapshot_clear(cur, sv->tick);
+  for (int i = 0; i < sv->max_players; i++) {
+    if (sv->clients[i].active)
+      snapshot_set_player(cur, i, &sv->players[i]);
+  }
+
+  // Every client sees the same world, so clients that acked the same tick
+  // share one encoded packet.
+  int cached = 0;
+
+  for (int i = 0; i < sv->max_players; i++) {
+    ServerClient *c = &sv->clients[i];
+    if (!c->active)
+      continue;
+
+    const Snapshot *base = history_at(sv, c->acked_tick);
+    uint32_t base_tick = base ? base->tick : 0;
+
+    int slot = 0;
+    while (slot < cached && sv->encoded_base[slot] != base_tick)
+      slot++;
+
+    uint8_t *data = sv->encoded + (size_t)slot * UDP_MAX_PACKET;
+    if (slot == cached) {
+      sv->encoded_base[slot] = base_tick;
+      sv->encoded_len[slot] =
+          snapshot_encode(cur, base, data, UDP_MAX_PACKET);
+      sv->stats.encodes++;
+      cached++;
+      if (sv->encoded_len[slot] == 0)
+        fprintf(stderr, "Snapshot for %d players exceeds one datagram\n",
+                sv->active_players);
+    }
+
+    size_t len = sv->encoded_len[slot];
+    if (len > 0 && udp_send(&sv->sock, c->addr, data, len)) {
+      sv->stats.packets_out++;
+      sv->stats.bytes_out += len;
+      if (base)
+        sv->stats.delta_snapshots++;
+      else
+        sv->stats.full_snapshots++;
+    }
+  }
+}
+
+void server_tick(Server *sv) {
+  server_poll(sv);
+  server_simulate(sv);
+  server_send_snapshots(sv);
+}
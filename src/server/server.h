@@ -0,0 +1,55 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "../game/player.h"
+#include "../map/map.h"
+#include "../net/snapshot.h"
+#include "../net/udp.h"
+
+typedef struct ServerClient {
+  bool active;
+  NetAddr addr;
+  PlayerCmd cmd;
+  uint32_t last_input_tick;
+  uint32_t acked_tick;
+} ServerClient;
+
+typedef struct ServerStats {
+  uint64_t packets_in;
+  uint64_t packets_out;
+  uint64_t bytes_out;
+  uint64_t full_snapshots;
+  uint64_t delta_snapshots;
+  uint64_t encodes;
+} ServerStats;
+
+typedef struct Server {
+  const Map *map;
+  UdpSocket sock;
+  int max_players;
+  int active_players;
+  Player *players;
+  ServerClient *clients;
+  uint32_t tick;
+  float tick_dt;
+  uint8_t *packet;
+  Snapshot history[SNAPSHOT_HISTORY];
+  uint8_t *encoded;
+  uint32_t encoded_base[SNAPSHOT_HISTORY + 1];
+  size_t encoded_len[SNAPSHOT_HISTORY + 1];
+  ServerStats stats;
+} Server;
+
+bool server_init(Server *sv, const Map *map, int max_players, uint16_t port,
+                 double tick_rate);
+void server_shutdown(Server *sv);
+
+void server_poll(Server *sv);
+void server_simulate(Server *sv);
+void server_send_snapshots(Server *sv);
+void server_tick(Server *sv);
+
+#endif // !SERVER_H
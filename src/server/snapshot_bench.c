@@ -0,0 +1,129 @@
+#include "snapshot_bench.h"
+#include "../game/player.h"
+#include "../net/snapshot.h"
+#include "../net/udp.h"
+#include "../time.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+enum { RAW_PLAYER_BYTES = 16, LAGGED_ACK = 4 };
+
+typedef struct BenchTotals {
+  double full_bytes;
+  double delta_bytes;
+  double lagged_bytes;
+  double encode_s;
+  double decode_s;
+  double encoded_bytes;
+  long encodes;
+  long mismatches;
+} BenchTotals;
+
+static uint32_t xorshift32(uint32_t *s) {
+  uint32_t x = *s;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  *s = x;
+  return x;
+}
+
+static size_t timed_roundtrip(const Snapshot *cur, const Snapshot *base,
+                              Snapshot *decoded, uint8_t *buf,
+                              BenchTotals *t) {
+  double t0 = time_now_seconds();
+  size_t len = snapshot_encode(cur, base, buf, UDP_MAX_PACKET);
+  double t1 = time_now_seconds();
+  bool ok = len > 0 && snapshot_decode(decoded, base, buf, len);
+  double t2 = time_now_seconds();
+
+  t->encode_s += t1 - t0;
+  t->decode_s += t2 - t1;
+  t->encoded_bytes += (double)len;
+  t->encodes++;
+  if (!ok || !snapshot_equal(cur, decoded))
+    t->mismatches++;
+  return len;
+}
+
+static bool bench_players(const Map *map, int count, int ticks) {
+  Player *players = (Player *)calloc((size_t)count, sizeof(Player));
+  PlayerCmd *cmds = (PlayerCmd *)calloc((size_t)count, sizeof(PlayerCmd));
+  uint8_t *buf = (uint8_t *)malloc(UDP_MAX_PACKET);
+  Snapshot history[SNAPSHOT_HISTORY];
+  Snapshot decoded;
+  bool ok = players && cmds && buf && snapshot_init(&decoded, count);
+  int inited = 0;
+  for (; ok && inited < SNAPSHOT_HISTORY; inited++)
+    ok = snapshot_init(&history[inited], count);
+
+  BenchTotals t = {0};
+  uint32_t rng = 0x12345678u;
+
+  for (int i = 0; ok && i < count; i++) {
+    player_init(&players[i]);
+    players[i].yaw = (float)(xorshift32(&rng) % 628) * 0.01f;
+  }
+
+  for (uint32_t tick = 1; ok && tick <= (uint32_t)ticks; tick++) {
+    for (int i = 0; i < count; i++) {
+      if ((tick + (uint32_t)i) % 30 == 0)
+        cmds[i].buttons = (uint8_t)(xorshift32(&rng) & 0x3f);
+      player_update(&players[i], map, &cmds[i], 1.0f / 60.0f);
+    }
+
+    Snapshot *cur = &history[tick % SNAPSHOT_HISTORY];
+    snapshot_clear(cur, tick);
+    for (int i = 0; i < count; i++)
+      snapshot_set_player(cur, i, &players[i]);
+
+    t.full_bytes += (double)timed_roundtrip(cur, NULL, &decoded, buf, &t);
+    if (tick > LAGGED_ACK) {
+      const Snapshot *prev = &history[(tick - 1) % SNAPSHOT_HISTORY];
+      const Snapshot *lagged = &history[(tick - LAGGED_ACK) % SNAPSHOT_HISTORY];
+      t.delta_bytes += (double)timed_roundtrip(cur, prev, &decoded, buf, &t);
+      t.lagged_bytes +=
+          (double)timed_roundtrip(cur, lagged, &decoded, buf, &t);
+    }
+  }
+
+  if (ok) {
+    double per_full = (double)count * ticks;
+    double per_delta = (double)count * (ticks - LAGGED_ACK);
+    double players_coded = (double)count * t.encodes;
+    printf("%8d %6d %8.2f %8.2f %8.2f %10.1f %10.1f %9.0f %9.0f %6ld\n", count,
+           RAW_PLAYER_BYTES, t.full_bytes / per_full,
+           t.delta_bytes / per_delta, t.lagged_bytes / per_delta,
+           t.encode_s * 1e9 / players_coded, t.decode_s * 1e9 / players_coded,
+           t.encoded_bytes / (t.encode_s * 1e6),
+           t.encoded_bytes / (t.decode_s * 1e6), t.mismatches);
+  }
+
+  for (int i = 0; i < inited; i++)
+    snapshot_free(&history[i]);
+  snapshot_free(&decoded);
+  free(players);
+  free(cmds);
+  free(buf);
+  return ok && t.mismatches == 0;
+}
+
+int snapshot_bench_run(const Map *map, int max_players, int ticks) {
+  if (ticks <= LAGGED_ACK) {
+    fprintf(stderr, "Snapshot bench needs more than %d ticks\n", LAGGED_ACK);
+    return 1;
+  }
+
+  printf("Snapshot codec: %d ticks, bytes are per player per tick\n", ticks);
+  printf("%8s %6s %8s %8s %8s %10s %10s %9s %9s %6s\n", "players", "raw",
+         "full", "delta1", "delta4", "enc_ns/pl", "dec_ns/pl", "enc_MB/s",
+         "dec_MB/s", "bad");
+
+  int status = 0;
+  for (int count = 16; count <= max_players; count *= 4) {
+    if (!bench_players(map, count, ticks))
+      status = 1;
+  }
+  return status;
+}
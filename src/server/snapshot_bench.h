@@ -0,0 +1,8 @@
+#ifndef SNAPSHOT_BENCH_H
+#define SNAPSHOT_BENCH_H
+
+#include "../map/map.h"
+
+int snapshot_bench_run(const Map *map, int max_players, int ticks);
+
+#endif // !SNAPSHOT_BENCH_H
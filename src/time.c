@@ -1,14 +1,41 @@
 #include "time.h"
 
-#include "SDL2/SDL.h"
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
 
-void time_init(void) { SDL_InitSubSystem(SDL_INIT_TIMER); }
+void time_init(void) { (void)time_now_seconds(); }
 
+#ifdef _WIN32
 double time_now_seconds(void) {
-  static uint64_t freq = 0;
-  if (freq == 0)
-    freq = (uint64_t)SDL_GetPerformanceFrequency();
+  static LARGE_INTEGER freq;
+  if (freq.QuadPart == 0)
+    QueryPerformanceFrequency(&freq);
 
-  uint64_t t = (uint64_t)SDL_GetPerformanceCounter();
-  return (double)t / (double)freq;
+  LARGE_INTEGER t;
+  QueryPerformanceCounter(&t);
+  return (double)t.QuadPart / (double)freq.QuadPart;
 }
+
+void time_sleep(double seconds) {
+  if (seconds > 0.0)
+    Sleep((DWORD)(seconds * 1000.0));
+}
+#else
+double time_now_seconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+void time_sleep(double seconds) {
+  if (seconds <= 0.0)
+    return;
+  struct timespec ts;
+  ts.tv_sec = (time_t)seconds;
+  ts.tv_nsec = (long)((seconds - (double)ts.tv_sec) * 1e9);
+  nanosleep(&ts, NULL);
+}
+#endif
@@ -5,5 +5,6 @@
 
 void time_init(void);
 double time_now_seconds(void);
+void time_sleep(double seconds);
 
 #endif // !TIME_H
@@ -0,0 +1,130 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../core/jobs.h"
+#include "../map/map.h"
+#include "../map/map_gen.h"
+#include "../map/map_io.h"
+#include "../map/pvs.h"
+
+typedef struct Options {
+  MapGenParams gen;
+  bool grid;
+  const char *in_path;
+  const char *out_path;
+  int threads;
+} Options;
+
+static void parse_args(int argc, char **argv, Options *opt) {
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    const char *val = (i + 1 < argc) ? argv[i + 1] : NULL;
+
+    if (strcmp(arg, "--grid") == 0 && val) {
+      opt->gen.cols = atoi(val);
+      opt->gen.rows = opt->gen.cols;
+      opt->grid = true;
+      i++;
+    } else if (strcmp(arg, "--seed") == 0 && val) {
+      opt->gen.seed = (uint32_t)strtoul(val, NULL, 10);
+      i++;
+    } else if (strcmp(arg, "--walls") == 0 && val) {
+      opt->gen.wall_chance = (float)atof(val);
+      i++;
+    } else if (strcmp(arg, "--in") == 0 && val) {
+      opt->in_path = val;
+      i++;
+    } else if (strcmp(arg, "--out") == 0 && val) {
+      opt->out_path = val;
+      i++;
+    } else if (strcmp(arg, "--threads") == 0 && val) {
+      opt->threads = atoi(val);
+      i++;
+    } else {
+      fprintf(stderr, "Ignoring unknown argument: %s\n", arg);
+    }
+  }
+}
+
+static bool build_source(const Options *opt, Map *m) {
+  if (opt->in_path)
+    return map_load(m, opt->in_path);
+  if (opt->grid)
+    return map_generate_grid(m, &opt->gen);
+  return map_build_test(m);
+}
+
+// Reads the file back and checks every expanded row against the bake.
+static bool verify(const char *path, const PvsData *pvs) {
+  Map loaded;
+  if (!map_load(&loaded, path))
+    return false;
+
+  bool ok = loaded.pvs && loaded.pvs_row_bytes == pvs->row_bytes;
+  uint8_t *row = (uint8_t *)mem_alloc((size_t)pvs->row_bytes);
+  ok = ok && row;
+  for (int s = 0; ok && s < pvs->sector_count; s++) {
+    uint32_t at = pvs->row_offsets[s];
+    ok = pvs_rle_decode(pvs->rle + at, pvs->row_offsets[s + 1] - at, row,
+                        pvs->row_bytes) &&
+         memcmp(row, loaded.pvs + (size_t)s * (size_t)pvs->row_bytes,
+                (size_t)pvs->row_bytes) == 0;
+  }
+  mem_free(row);
+  map_destroy(&loaded);
+  return ok;
+}
+
+int main(int argc, char **argv) {
+  Options opt = {
+      .gen = map_gen_default_params(),
+      .out_path = "map.dmap",
+  };
+  parse_args(argc, argv, &opt);
+  if (opt.threads < 1)
+    opt.threads = jobs_hardware_threads();
+  jobs_start(opt.threads);
+
+  Map map;
+  if (!build_source(&opt, &map)) {
+    fprintf(stderr, "Failed to build source map\n");
+    jobs_stop();
+    return 1;
+  }
+  printf("Map: %d sectors, %d lines\n", map.sector_count, map.line_count);
+
+  PvsData pvs;
+  PvsBakeStats stats;
+  if (!pvs_bake(&map, opt.threads, &pvs, &stats)) {
+    fprintf(stderr, "PVS bake failed\n");
+    map_destroy(&map);
+    jobs_stop();
+    return 1;
+  }
+
+  printf("Bake: %.3f s on %d threads, %llu portal clips\n", stats.seconds,
+         stats.threads, (unsigned long long)stats.portal_clips);
+  printf("Visible: %.1f sectors per sector on average (%.2f%%)\n",
+         stats.avg_visible, 100.0 * stats.avg_visible / map.sector_count);
+  printf("Size: %.1f KiB raw, %.1f KiB compressed (%.1f%%)\n",
+         stats.raw_bytes / 1024.0, stats.rle_bytes / 1024.0,
+         stats.raw_bytes ? 100.0 * (double)stats.rle_bytes / stats.raw_bytes
+                         : 0.0);
+
+  int status = 0;
+  if (!map_save(&map, &pvs, opt.out_path)) {
+    status = 1;
+  } else if (!verify(opt.out_path, &pvs)) {
+    fprintf(stderr, "Reloaded PVS does not match the bake\n");
+    status = 1;
+  } else {
+    printf("Wrote %s\n", opt.out_path);
+  }
+
+  pvs_free(&pvs);
+  map_destroy(&map);
+  jobs_stop();
+  return status;
+}
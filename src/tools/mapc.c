@@ -0,0 +1,242 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../core/jobs.h"
+#include "../geom/world_bake.h"
+#include "../map/map.h"
+#include "../map/map_gen.h"
+#include "../map/map_io.h"
+#include "../map/package.h"
+#include "../map/sector_grid.h"
+#include "../time.h"
+
+typedef struct Options {
+  MapGenParams gen;
+  bool grid;
+  int threads;
+  const char *in_path;
+  const char *out_path;
+} Options;
+
+static void parse_args(int argc, char **argv, Options *opt) {
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    const char *val = (i + 1 < argc) ? argv[i + 1] : NULL;
+
+    if (strcmp(arg, "--grid") == 0 && val) {
+      opt->gen.cols = atoi(val);
+      opt->gen.rows = opt->gen.cols;
+      opt->grid = true;
+      i++;
+    } else if (strcmp(arg, "--seed") == 0 && val) {
+      opt->gen.seed = (uint32_t)strtoul(val, NULL, 10);
+      i++;
+    } else if (strcmp(arg, "--walls") == 0 && val) {
+      opt->gen.wall_chance = (float)atof(val);
+      i++;
+    } else if (strcmp(arg, "--threads") == 0 && val) {
+      opt->threads = atoi(val);
+      i++;
+    } else if (strcmp(arg, "--in") == 0 && val) {
+      opt->in_path = val;
+      i++;
+    } else if (strcmp(arg, "--out") == 0 && val) {
+      opt->out_path = val;
+      i++;
+    } else {
+      fprintf(stderr, "Ignoring unknown argument: %s\n", arg);
+    }
+  }
+}
+
+static bool build_source(const Options *opt, Map *m) {
+  if (opt->in_path)
+    return map_load(m, opt->in_path);
+  if (opt->grid)
+    return map_generate_grid(m, &opt->gen);
+  return map_build_test(m);
+}
+
+// The engine trusts a package's contents, so anything it would index out of
+// range or divide by is rejected here.
+static bool validate(const Map *m) {
+  int errors = 0;
+  for (int i = 0; i < m->line_count; i++) {
+    const Linedef *l = &m->lines[i];
+    if (l->v0 < 0 || l->v0 >= m->vert_count || l->v1 < 0 ||
+        l->v1 >= m->vert_count || l->front_sector < 0 ||
+        l->front_sector >= m->sector_count ||
+        l->back_sector >= m->sector_count) {
+      fprintf(stderr, "Line %d references a missing vertex or sector\n", i);
+      errors++;
+    } else if (m->linetab.len[i] <= 1e-6f) {
+      fprintf(stderr, "Line %d has zero length\n", i);
+      errors++;
+    } else if (l->back_sector == l->front_sector) {
+      fprintf(stderr, "Line %d has the same sector on both sides\n", i);
+      errors++;
+    }
+  }
+  for (int s = 0; s < m->sector_count; s++) {
+    const SectorLoop *loop = &m->sectors[s].loop;
+    if (loop->count < 3) {
+      fprintf(stderr, "Sector %d has a degenerate loop\n", s);
+      errors++;
+    }
+    for (int i = 0; i < loop->count; i++) {
+      if (loop->indices[i] < 0 || loop->indices[i] >= m->vert_count) {
+        fprintf(stderr, "Sector %d loop references a missing vertex\n", s);
+        errors++;
+        break;
+      }
+    }
+    if (m->sector_line_start[s] == m->sector_line_start[s + 1]) {
+      fprintf(stderr, "Sector %d has no lines\n", s);
+      errors++;
+    }
+    if (m->sectors[s].ceil_h < m->sectors[s].floor_h) {
+      fprintf(stderr, "Sector %d has its ceiling below its floor\n", s);
+      errors++;
+    }
+  }
+  return errors == 0;
+}
+
+static bool same_mesh(const MeshData *a, const MeshData *b) {
+  size_t ranges = (size_t)a->range_count * sizeof(int);
+  return a->vertex_count == b->vertex_count &&
+         a->index_count == b->index_count &&
+         a->range_count == b->range_count &&
+         memcmp(a->verts, b->verts,
+                (size_t)a->vertex_count * sizeof(WorldVertex)) == 0 &&
+         memcmp(a->indices, b->indices,
+                (size_t)a->index_count * sizeof(uint32_t)) == 0 &&
+         memcmp(a->sector_first, b->sector_first, ranges) == 0 &&
+         memcmp(a->sector_count, b->sector_count, ranges) == 0 &&
+         memcmp(a->lod_first, b->lod_first, ranges) == 0 &&
+         memcmp(a->lod_count, b->lod_count, ranges) == 0;
+}
+
+// Maps the file back and checks it against what was baked. Grid lookups at
+// the centroid of each loop's first corner are reported, not required:
+// that point can fall outside a concave sector.
+static bool verify(const char *path, const Map *src, const WorldBake *bake) {
+  MapPackage pkg;
+  Map loaded;
+  if (!package_open(&pkg, &loaded, path))
+    return false;
+
+  size_t n = (size_t)src->sector_count;
+  bool ok = loaded.sector_count == src->sector_count &&
+            loaded.line_count == src->line_count &&
+            memcmp(loaded.lines, src->lines,
+                   (size_t)src->line_count * sizeof(Linedef)) == 0 &&
+            same_mesh(&pkg.bake.floors, &bake->floors) &&
+            same_mesh(&pkg.bake.walls, &bake->walls) &&
+            memcmp(pkg.bake.sector_min, bake->sector_min,
+                   n * sizeof(Vec3)) == 0 &&
+            pkg.bake.lightmap.width == bake->lightmap.width &&
+            pkg.bake.lightmap.height == bake->lightmap.height &&
+            memcmp(pkg.bake.lightmap.pixels, bake->lightmap.pixels,
+                   (size_t)bake->lightmap.width *
+                       (size_t)bake->lightmap.height) == 0 &&
+            (src->pvs == NULL) == (loaded.pvs == NULL);
+
+  int located = 0;
+  for (int s = 0; ok && s < src->sector_count; s++) {
+    const SectorLoop *loop = &src->sectors[s].loop;
+    Vec2 a = src->verts[loop->indices[0]];
+    Vec2 b = src->verts[loop->indices[1]];
+    Vec2 c = src->verts[loop->indices[2]];
+    Vec2 p = v2((a.x + b.x + c.x) / 3.0f, (a.y + b.y + c.y) / 3.0f);
+    located += sector_grid_locate(&pkg.grid, &loaded, p) == s;
+  }
+  if (ok)
+    printf("Grid: %d/%d sectors located at their first corner\n", located,
+           src->sector_count);
+
+  package_close(&pkg, &loaded);
+  return ok;
+}
+
+int main(int argc, char **argv) {
+  Options opt = {
+      .gen = map_gen_default_params(),
+      .threads = jobs_hardware_threads(),
+      .out_path = "map.dpak",
+  };
+  parse_args(argc, argv, &opt);
+  jobs_start(opt.threads);
+
+  Map map;
+  if (!build_source(&opt, &map)) {
+    fprintf(stderr, "Failed to build source map\n");
+    jobs_stop();
+    return 1;
+  }
+  printf("Map: %d sectors, %d lines%s\n", map.sector_count, map.line_count,
+         map.pvs ? ", with PVS" : "");
+  if (!validate(&map)) {
+    map_destroy(&map);
+    jobs_stop();
+    return 1;
+  }
+
+  double start = time_now_seconds();
+  WorldBake bake;
+  SectorGrid grid;
+  if (!world_bake(&bake, &map)) {
+    fprintf(stderr, "Mesh bake failed\n");
+    map_destroy(&map);
+    jobs_stop();
+    return 1;
+  }
+  if (!sector_grid_build(&grid, &map)) {
+    fprintf(stderr, "Sector grid build failed\n");
+    world_bake_free(&bake);
+    map_destroy(&map);
+    jobs_stop();
+    return 1;
+  }
+  printf("Bake: %.3f s\n", time_now_seconds() - start);
+
+  start = time_now_seconds();
+  LightmapStats light;
+  if (!lightmap_trace(&bake.lightmap, &map, opt.threads, &light)) {
+    fprintf(stderr, "Lightmap bake failed\n");
+    sector_grid_free(&grid);
+    world_bake_free(&bake);
+    map_destroy(&map);
+    jobs_stop();
+    return 1;
+  }
+  printf("Lightmap: %dx%d, %d charts at %.2f luxels/unit, %d emitters\n",
+         bake.lightmap.width, bake.lightmap.height, bake.lightmap.chart_count,
+         bake.lightmap.density, light.emitters);
+  printf("Lightmap: %d luxels, %lld rays (%lld occluded) on %d threads in "
+         "%.3f s\n",
+         light.luxels, (long long)light.rays, (long long)light.occluded,
+         opt.threads, time_now_seconds() - start);
+  mesh_opt_report("Floor mesh", &bake.floors.stats);
+  mesh_opt_report("Wall mesh", &bake.walls.stats);
+  printf("Grid: %dx%d cells of %.2f, %d entries\n", grid.cols, grid.rows,
+         grid.cell, grid.cell_start[grid.cols * grid.rows]);
+
+  int status = 0;
+  if (!package_save(opt.out_path, &map, &bake, &grid)) {
+    status = 1;
+  } else if (!verify(opt.out_path, &map, &bake)) {
+    fprintf(stderr, "Reloaded package does not match the bake\n");
+    status = 1;
+  } else {
+    printf("Wrote %s\n", opt.out_path);
+  }
+
+  sector_grid_free(&grid);
+  world_bake_free(&bake);
+  map_destroy(&map);
+  jobs_stop();
+  return status;
+}